@@ -251,6 +251,8 @@ int CmdLineParser::parse(int argc, char* argv[]) {
 			ctOptions++;
 
 			if(key == "--help") {
+				m_mapKeySwitch[key]->value = string("true");
+				m_mapKeySwitch[key]->isvalid = true;
 				printHelp();
 				return 1;
 			}
@@ -97,6 +97,7 @@ void EventLogger::add(const char* lpStrDesc, EVENTTYPE t,
     if(lpStrDesc == NULL)
         return;
 
+    tbb::recursive_mutex::scoped_lock lock(m_mtxLog);
     AnsiStr strEvent;
     //Write Event Type
     if(m_bWriteEventTypes)
@@ -177,6 +178,7 @@ void EventLogger::display(const char* chrMessage) const
 //Open File and Append
 bool EventLogger::flush()
 {
+    tbb::recursive_mutex::scoped_lock lock(m_mtxLog);
     if(m_lstLog.size() == 0)
         return false;
 
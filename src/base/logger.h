@@ -6,6 +6,7 @@
 #include <time.h>
 #include "str.h"
 #include "loki/Singleton.h"
+#include "tbb/recursive_mutex.h"
 
 using namespace std;
 using namespace ps;
@@ -119,6 +120,9 @@ private:
     AnsiStr m_strFP;
     AnsiStr m_strRootPath;
     std::vector<AnsiStr> m_lstLog;
+
+    //events are added from the worker threads too
+    tbb::recursive_mutex m_mtxLog;
 };
 
 typedef SingletonHolder<EventLogger, CreateUsingNew, PhoenixSingleton> TheEventLogger;
@@ -0,0 +1,124 @@
+/*
+ * mappedfile.cpp
+ */
+
+#include "mappedfile.h"
+
+#ifdef PS_OS_WINDOWS
+	#include "Windows.h"
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace ps {
+namespace base {
+
+MappedFile::MappedFile() {
+	m_lpData = NULL;
+	m_szData = 0;
+	m_isOpen = false;
+#ifdef PS_OS_WINDOWS
+	m_hFile = m_hMapping = NULL;
+#endif
+}
+
+MappedFile::MappedFile(const AnsiStr& strPath) {
+	m_lpData = NULL;
+	m_szData = 0;
+	m_isOpen = false;
+#ifdef PS_OS_WINDOWS
+	m_hFile = m_hMapping = NULL;
+#endif
+	open(strPath);
+}
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+bool MappedFile::open(const AnsiStr& strPath) {
+	close();
+
+#ifdef PS_OS_WINDOWS
+	HANDLE hFile = CreateFileA(strPath.cptr(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+							   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(hFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER sz;
+	if(!GetFileSizeEx(hFile, &sz)) {
+		CloseHandle(hFile);
+		return false;
+	}
+
+	m_hFile = hFile;
+	m_szData = (U64)sz.QuadPart;
+	m_isOpen = true;
+
+	//an empty file can not be mapped
+	if(m_szData == 0)
+		return true;
+
+	m_hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(m_hMapping != NULL)
+		m_lpData = (const char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+#else
+	int fd = ::open(strPath.cptr(), O_RDONLY);
+	if(fd < 0)
+		return false;
+
+	struct stat st;
+	if(fstat(fd, &st) != 0) {
+		::close(fd);
+		return false;
+	}
+
+	m_szData = (U64)st.st_size;
+	m_isOpen = true;
+
+	//an empty file can not be mapped
+	if(m_szData == 0) {
+		::close(fd);
+		return true;
+	}
+
+	void* lpData = mmap(NULL, m_szData, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if(lpData != MAP_FAILED) {
+		madvise(lpData, m_szData, MADV_SEQUENTIAL);
+		m_lpData = (const char*)lpData;
+	}
+#endif
+
+	if(m_lpData == NULL) {
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::close() {
+#ifdef PS_OS_WINDOWS
+	if(m_lpData)
+		UnmapViewOfFile(m_lpData);
+	if(m_hMapping)
+		CloseHandle((HANDLE)m_hMapping);
+	if(m_hFile)
+		CloseHandle((HANDLE)m_hFile);
+	m_hFile = m_hMapping = NULL;
+#else
+	if(m_lpData)
+		munmap((void*)m_lpData, m_szData);
+#endif
+
+	m_lpData = NULL;
+	m_szData = 0;
+	m_isOpen = false;
+}
+
+}
+}
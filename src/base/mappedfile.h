@@ -0,0 +1,50 @@
+/*
+ * mappedfile.h
+ */
+
+#ifndef MAPPEDFILE_H_
+#define MAPPEDFILE_H_
+
+#include "base.h"
+#include "str.h"
+
+namespace ps {
+namespace base {
+
+/*!
+ * Read-only view of a whole file. The file is mapped into memory so large meshes are parsed in
+ * place without copying them into line buffers.
+ */
+class MappedFile {
+public:
+	MappedFile();
+	explicit MappedFile(const AnsiStr& strPath);
+	virtual ~MappedFile();
+
+	bool open(const AnsiStr& strPath);
+	void close();
+
+	bool isOpen() const { return m_isOpen;}
+
+	//file contents, not null terminated
+	const char* data() const { return m_lpData;}
+	U64 size() const { return m_szData;}
+
+private:
+	MappedFile(const MappedFile& rhs);
+	MappedFile& operator=(const MappedFile& rhs);
+
+	const char* m_lpData;
+	U64 m_szData;
+	bool m_isOpen;
+
+#ifdef PS_OS_WINDOWS
+	void* m_hFile;
+	void* m_hMapping;
+#endif
+};
+
+}
+}
+
+#endif /* MAPPEDFILE_H_ */
@@ -63,8 +63,8 @@ void ProfileSession::cleanup() {
 		SAFE_DELETE(m_vEvents[i]);
 	m_vEvents.resize(0);
 
-	while(!m_stkCurrent.empty())
-		m_stkCurrent.pop();
+	m_stkCurrent.clear();
+	m_ctPending = 0;
 }
 
 void ProfileSession::start() {
@@ -110,17 +110,20 @@ void ProfileSession::startEvent(ProfileEvent* e) {
 		return;
 
 	m_vEvents.push_back(e);
-	m_stkCurrent.push(e);
+	m_stkCurrent.local().push(e);
+	m_ctPending++;
 }
 
 ProfileEvent* ProfileSession::endEvent() {
-	if(m_stkCurrent.empty()) {
+	std::stack<ProfileEvent*>& stkCurrent = m_stkCurrent.local();
+	if(stkCurrent.empty()) {
         vlogerror("The Profiler stack is empty! Did you forget to end an event before starting a new one?");
 		return NULL;
 	}
 
-	ProfileEvent* lpEvent = m_stkCurrent.top();
-	m_stkCurrent.pop();
+	ProfileEvent* lpEvent = stkCurrent.top();
+	stkCurrent.pop();
+	m_ctPending--;
 	lpEvent->end();
 	return lpEvent;
 }
@@ -187,6 +190,7 @@ Profiler::~Profiler() {
 }
 
 void Profiler::flush() {
+	tbb::recursive_mutex::scoped_lock lock(m_mtxSession);
 	if((m_flags & pbWriteToTextFile) != 0)
 		m_session.writeToTextFile();
 	if((m_flags & pbWriteToSqlDB) != 0)
@@ -207,11 +211,13 @@ void Profiler::endSession() {
 
 void Profiler::startEvent(const char* filename, const char* funcname, int line, const char* desc) {
 	ProfileEvent* lpEvent = new ProfileEvent(filename, funcname, line, desc);
+	tbb::recursive_mutex::scoped_lock lock(m_mtxSession);
 	lpEvent->start();
 	m_session.startEvent(lpEvent);
 }
 
 double Profiler::endEvent() {
+	tbb::recursive_mutex::scoped_lock lock(m_mtxSession);
 	ProfileEvent* e = m_session.endEvent();
 	if(e == NULL)
 		return 0.0;
@@ -222,11 +228,15 @@ double Profiler::endEvent() {
 		psLog(EventLogger::etProfile, strSource.cptr(), e->line(), "%s Took %.4f [ms]", e->desc().cptr(), e->timeMS());
 	}
 
-	//Flush if exceeded the container size and there is no pending events
-	if(m_session.count() > MAX_LOG_EVENTS && !m_session.hasPendingEvents())
+	//Flush if exceeded the container size and there is no pending events.
+	//flushed events are dropped so they are not written again
+	double ms = e->timeMS();
+	if(m_session.count() > MAX_LOG_EVENTS && !m_session.hasPendingEvents()) {
 		flush();
+		m_session.cleanup();
+	}
 
-	return e->timeMS();
+	return ms;
 }
 
 
@@ -7,6 +7,8 @@
 #include "str.h"
 #include "loki/Singleton.h"
 #include "tbb/tick_count.h"
+#include "tbb/recursive_mutex.h"
+#include "tbb/enumerable_thread_specific.h"
 
 using namespace std;
 using namespace Loki;
@@ -102,7 +104,7 @@ public:
 	double duration() const;
 	void setValid() {m_isStatsValid = true;}
 
-	bool hasPendingEvents() const { return (!m_stkCurrent.empty());}
+	bool hasPendingEvents() const { return (m_ctPending > 0);}
 	AnsiStr toString() const;
 
 	//Serialization
@@ -128,9 +130,10 @@ protected:
 	tick m_tickStart;
 	tick m_tickEnd;
 
-	//Storage
-	std::stack<ProfileEvent*> m_stkCurrent;
+	//Storage. events nest per thread, the list is shared by all threads
+	tbb::enumerable_thread_specific< std::stack<ProfileEvent*> > m_stkCurrent;
 	std::vector<ProfileEvent*> m_vEvents;
+	U32 m_ctPending;
 };
 
 /*!
@@ -167,6 +170,9 @@ protected:
 private:
 	ProfileSession m_session;
 	int m_flags;
+
+	//events are started and ended from the worker threads too
+	tbb::recursive_mutex m_mtxSession;
 };
 
 //Singleton Instance
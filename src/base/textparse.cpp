@@ -0,0 +1,101 @@
+/*
+ * textparse.cpp
+ */
+
+#include <sstream>
+#include <locale>
+#include "textparse.h"
+
+namespace ps {
+namespace base {
+
+const double g_arrPow10[EXACT_POW10_COUNT] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+bool ParseDouble(const char*& p, const char* end, double& out) {
+	const char* start = SkipBlanks(p, end);
+	const char* q = start;
+	bool neg = false;
+	if(q < end && (*q == '-' || *q == '+')) {
+		neg = (*q == '-');
+		q++;
+	}
+
+	U64 mantissa = 0;
+	int ctDigits = 0;
+	int exp10 = 0;
+	bool hasDigits = false;
+	bool isTruncated = false;
+	while(q < end && *q >= '0' && *q <= '9') {
+		if(ctDigits < 19) {
+			mantissa = mantissa * 10 + (*q - '0');
+			if(mantissa != 0)
+				ctDigits++;
+		}
+		else {
+			exp10++;
+			isTruncated = true;
+		}
+		hasDigits = true;
+		q++;
+	}
+
+	if(q < end && *q == '.') {
+		q++;
+		while(q < end && *q >= '0' && *q <= '9') {
+			if(ctDigits < 19) {
+				mantissa = mantissa * 10 + (*q - '0');
+				if(mantissa != 0)
+					ctDigits++;
+				exp10--;
+			}
+			else
+				isTruncated = true;
+			hasDigits = true;
+			q++;
+		}
+	}
+
+	if(!hasDigits)
+		return false;
+
+	if(q < end && (*q == 'e' || *q == 'E')) {
+		const char* e = q + 1;
+		bool negExp = false;
+		if(e < end && (*e == '-' || *e == '+')) {
+			negExp = (*e == '-');
+			e++;
+		}
+
+		if(e < end && *e >= '0' && *e <= '9') {
+			int x = 0;
+			while(e < end && *e >= '0' && *e <= '9') {
+				if(x < 100000)
+					x = x * 10 + (*e - '0');
+				e++;
+			}
+			exp10 += negExp ? -x : x;
+			q = e;
+		}
+	}
+
+	if(!isTruncated && mantissa < (1ULL << 53) && exp10 > -EXACT_POW10_COUNT && exp10 < EXACT_POW10_COUNT) {
+		double v = (double)mantissa;
+		v = (exp10 < 0) ? v / g_arrPow10[-exp10] : v * g_arrPow10[exp10];
+		out = neg ? -v : v;
+	}
+	else {
+		std::istringstream ss(std::string(start, q - start));
+		ss.imbue(std::locale::classic());
+		ss >> out;
+		if(ss.fail())
+			return false;
+	}
+
+	p = q;
+	return true;
+}
+
+}
+}
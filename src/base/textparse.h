@@ -0,0 +1,64 @@
+/*
+ * textparse.h
+ */
+
+#ifndef TEXTPARSE_H_
+#define TEXTPARSE_H_
+
+#include <string.h>
+#include "base.h"
+
+namespace ps {
+namespace base {
+
+//number of the powers of ten which are exact in double
+#define EXACT_POW10_COUNT 23
+
+//powers of ten from 1e0 up to 1e22, shared by the parsers and the formatters
+extern const double g_arrPow10[EXACT_POW10_COUNT];
+
+//parser helpers for memory mapped text. all of them stop at the end of the buffer
+inline bool IsBlank(char c) {
+	return (c == ' ' || c == '\t' || c == '\r' || c == ',');
+}
+
+inline const char* SkipBlanks(const char* p, const char* end) {
+	while(p < end && IsBlank(*p))
+		p++;
+	return p;
+}
+
+inline const char* LineEnd(const char* p, const char* end) {
+	const char* q = (const char*)memchr(p, '\n', end - p);
+	return q ? q : end;
+}
+
+inline bool ParseU32(const char*& p, const char* end, U32& out) {
+	const char* q = SkipBlanks(p, end);
+	if(q == end || *q < '0' || *q > '9')
+		return false;
+
+	U64 v = 0;
+	while(q < end && *q >= '0' && *q <= '9') {
+		v = v * 10 + (*q - '0');
+		if(v > 0xFFFFFFFFULL)
+			return false;
+		q++;
+	}
+
+	out = (U32)v;
+	p = q;
+	return true;
+}
+
+/*!
+ * locale independent decimal to double. Numbers with at most 19 significant digits and a
+ * mantissa and exponent small enough to be exact in double are converted with a single multiply
+ * or divide, which rounds correctly. The rest go through a classic locale stream.
+ */
+bool ParseDouble(const char*& p, const char* end, double& out);
+
+}
+}
+
+#endif /* TEXTPARSE_H_ */
@@ -0,0 +1,123 @@
+/*
+ * aabbtree.cpp
+ */
+
+#include <algorithm>
+#include "elastic/aabbtree.h"
+
+namespace ps {
+namespace elastic {
+
+AABBTree::AABBTree() {
+	m_leafSize = 1;
+}
+
+AABBTree::~AABBTree() {
+	clear();
+}
+
+void AABBTree::clear() {
+	m_vNodes.resize(0);
+	m_vItems.resize(0);
+	m_vLo.resize(0);
+	m_vHi.resize(0);
+}
+
+U32 AABBTree::build(const vector<vec3d>& vLo, const vector<vec3d>& vHi, const vector<U32>& vItems, U32 leafSize) {
+	clear();
+	if(vItems.size() == 0)
+		return 0;
+
+	m_vLo.assign(vLo.begin(), vLo.end());
+	m_vHi.assign(vHi.begin(), vHi.end());
+	m_vItems.assign(vItems.begin(), vItems.end());
+	m_leafSize = MATHMAX(leafSize, (U32)1);
+
+	m_vNodes.reserve(m_vItems.size() * 2);
+	m_vNodes.resize(1);
+	buildNode(0, 0, (U32)m_vItems.size());
+
+	return (U32)m_vItems.size();
+}
+
+void AABBTree::buildNode(U32 idxNode, U32 first, U32 count) {
+
+	//bounds of the node and of the box centers
+	vec3d lo = m_vLo[m_vItems[first]];
+	vec3d hi = m_vHi[m_vItems[first]];
+	vec3d clo = (lo + hi) * 0.5;
+	vec3d chi = clo;
+	for(U32 i = first + 1; i < first + count; i++) {
+		U32 item = m_vItems[i];
+		vec3d c = (m_vLo[item] + m_vHi[item]) * 0.5;
+		lo = vec3d::minP(lo, m_vLo[item]);
+		hi = vec3d::maxP(hi, m_vHi[item]);
+		clo = vec3d::minP(clo, c);
+		chi = vec3d::maxP(chi, c);
+	}
+
+	m_vNodes[idxNode].lo = lo;
+	m_vNodes[idxNode].hi = hi;
+	if(count <= m_leafSize) {
+		m_vNodes[idxNode].first = first;
+		m_vNodes[idxNode].count = count;
+		return;
+	}
+
+	//median split along the longest axis of the box centers
+	int axis = (chi - clo).longestAxis();
+	U32 half = count / 2;
+	const vector<vec3d>& vLo = m_vLo;
+	const vector<vec3d>& vHi = m_vHi;
+	std::nth_element(m_vItems.begin() + first, m_vItems.begin() + first + half, m_vItems.begin() + first + count,
+					 [&vLo, &vHi, axis](U32 a, U32 b) {
+						return (vLo[a].element(axis) + vHi[a].element(axis)) < (vLo[b].element(axis) + vHi[b].element(axis));
+					 });
+
+	//children are stored next to each other
+	U32 idxLeft = (U32)m_vNodes.size();
+	m_vNodes.resize(idxLeft + 2);
+	m_vNodes[idxNode].first = idxLeft;
+	m_vNodes[idxNode].count = 0;
+
+	buildNode(idxLeft, first, half);
+	buildNode(idxLeft + 1, first + half, count - half);
+}
+
+U32 AABBTree::query(const vec3d& lo, const vec3d& hi, vector<U32>& vOutItems) const {
+	vOutItems.resize(0);
+	if(m_vNodes.size() == 0)
+		return 0;
+
+	U32 stack[64];
+	int top = 0;
+	stack[top++] = 0;
+	while(top > 0) {
+		const NODE& node = m_vNodes[stack[--top]];
+		if(lo.x > node.hi.x || hi.x < node.lo.x ||
+		   lo.y > node.hi.y || hi.y < node.lo.y ||
+		   lo.z > node.hi.z || hi.z < node.lo.z)
+			continue;
+
+		if(node.isLeaf()) {
+			for(U32 i = node.first; i < node.first + node.count; i++) {
+				U32 item = m_vItems[i];
+				if(lo.x > m_vHi[item].x || hi.x < m_vLo[item].x ||
+				   lo.y > m_vHi[item].y || hi.y < m_vLo[item].y ||
+				   lo.z > m_vHi[item].z || hi.z < m_vLo[item].z)
+					continue;
+				vOutItems.push_back(item);
+			}
+		}
+		else {
+			stack[top++] = node.first;
+			stack[top++] = node.first + 1;
+		}
+	}
+
+	std::sort(vOutItems.begin(), vOutItems.end());
+	return (U32)vOutItems.size();
+}
+
+} /* namespace elastic */
+} /* namespace ps */
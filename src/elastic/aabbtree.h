@@ -0,0 +1,73 @@
+/*
+ * aabbtree.h
+ */
+
+#ifndef AABBTREE_H_
+#define AABBTREE_H_
+
+#include <vector>
+#include "base/vec.h"
+
+using namespace std;
+using namespace ps::base;
+
+namespace ps {
+namespace elastic {
+
+/*!
+ * Synopsis: static bounding volume hierarchy over a list of axis aligned boxes. Items are the
+ * indices of the boxes in the arrays passed to build. Built top-down by median splits along
+ * the longest axis of the box centers, queried with an explicit stack. Used by the broadphases
+ * over the swept quads of a cut and over the meshes of a mesh set.
+ */
+class AABBTree {
+public:
+	struct NODE {
+		vec3d lo;
+		vec3d hi;
+
+		//inner nodes: index of the left child, the right child follows it
+		//leaf nodes: range of items in the sorted item list
+		U32 first;
+		U32 count;
+
+		bool isLeaf() const { return count > 0;}
+	};
+
+public:
+	AABBTree();
+	virtual ~AABBTree();
+
+	void clear();
+
+	/*!
+	 * builds the hierarchy over the boxes [vLo[i], vHi[i]] of the given items.
+	 * @param leafSize max number of items stored in a leaf node
+	 * @return number of items in the hierarchy
+	 */
+	U32 build(const vector<vec3d>& vLo, const vector<vec3d>& vHi, const vector<U32>& vItems, U32 leafSize);
+
+	/*!
+	 * collects the items whose boxes overlap the box [lo, hi]. The items are reported sorted.
+	 * @return number of items found
+	 */
+	U32 query(const vec3d& lo, const vec3d& hi, vector<U32>& vOutItems) const;
+
+	U32 countItems() const { return (U32)m_vItems.size();}
+	U32 countNodes() const { return (U32)m_vNodes.size();}
+
+protected:
+	void buildNode(U32 idxNode, U32 first, U32 count);
+
+private:
+	vector<NODE> m_vNodes;
+	vector<U32> m_vItems;
+	vector<vec3d> m_vLo;
+	vector<vec3d> m_vHi;
+	U32 m_leafSize;
+};
+
+} /* namespace elastic */
+} /* namespace ps */
+
+#endif /* AABBTREE_H_ */
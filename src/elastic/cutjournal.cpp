@@ -0,0 +1,525 @@
+/*
+ * cutjournal.cpp
+ */
+
+#include <stdio.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include "base/directory.h"
+#include "base/logger.h"
+#include "base/mappedfile.h"
+#include "base/profiler.h"
+#include "elastic/cutjournal.h"
+#include "elastic/cuttablemesh.h"
+#include "elastic/volmeshio.h"
+
+//FNV-1a
+#define JOURNAL_HASH_OFFSET 14695981039346656037ULL
+#define JOURNAL_HASH_PRIME 1099511628211ULL
+
+#define CUT_JOURNAL_MAGIC "TCJOURNL"
+
+using namespace std;
+using namespace ps::base;
+using namespace ps::dir;
+
+namespace ps {
+namespace elastic {
+
+namespace {
+
+#pragma pack(push, 1)
+struct JOURNALHEADER {
+	char magic[8];
+	U32 version;
+	U32 reserved;
+};
+
+//every record starts with this header followed by its payload
+struct JOURNALRECORDHEADER {
+	U32 type;
+	U32 szPayload;
+
+	//checksum of the mesh after the operation and of the payload
+	U64 meshChecksum;
+	U64 payloadChecksum;
+};
+#pragma pack(pop)
+
+inline U64 HashBytes(const void* lpData, size_t szData, U64 h = JOURNAL_HASH_OFFSET) {
+	const U8* p = reinterpret_cast<const U8*>(lpData);
+	for(size_t i=0; i < szData; i++) {
+		h ^= p[i];
+		h *= JOURNAL_HASH_PRIME;
+	}
+	return h;
+}
+
+template <typename T>
+inline U64 HashValue(const T& value, U64 h) {
+	return HashBytes(&value, sizeof(T), h);
+}
+
+}
+
+CutJournal::CutJournal() {
+	m_interval = DEFAULT_JOURNAL_CHECKPOINT_INTERVAL;
+	m_ctRecords = 0;
+	m_ctSinceCheckpoint = 0;
+	m_ctCheckpoints = 0;
+}
+
+CutJournal::~CutJournal() {
+	close();
+}
+
+bool CutJournal::create(const AnsiStr& strPath, const CuttableMesh* pmesh, U32 interval) {
+	close();
+	if(pmesh == NULL)
+		return false;
+
+	m_fpOut.open(strPath.cptr(), ios::out | ios::binary | ios::trunc);
+	if(!m_fpOut.is_open()) {
+		vlogerror("Unable to create the cut journal at: %s", strPath.cptr());
+		return false;
+	}
+
+	JOURNALHEADER header;
+	memset(&header, 0, sizeof(JOURNALHEADER));
+	memcpy(header.magic, CUT_JOURNAL_MAGIC, 8);
+	header.version = CUT_JOURNAL_VERSION;
+	m_fpOut.write((const char*)&header, sizeof(JOURNALHEADER));
+
+	m_strPath = strPath;
+	m_interval = (interval > 0) ? interval : DEFAULT_JOURNAL_CHECKPOINT_INTERVAL;
+	m_ctRecords = 0;
+	m_ctSinceCheckpoint = 0;
+	m_ctCheckpoints = 0;
+
+	//the first checkpoint is the base of the replay
+	if(!checkpoint(pmesh)) {
+		close();
+		return false;
+	}
+
+	vloginfo("Recording cuts in the journal: %s, checkpoint every %u records", strPath.cptr(), m_interval);
+	return true;
+}
+
+void CutJournal::close() {
+	if(m_fpOut.is_open())
+		m_fpOut.close();
+}
+
+bool CutJournal::append(const CuttableMesh* pmesh, const Record& rec) {
+	if(!writeRecord(pmesh, rec))
+		return false;
+
+	//a progressive cut keeps its partially cut elements in memory until it ends
+	m_ctSinceCheckpoint++;
+	bool isProgressiveCutPending = (pmesh->m_mapPendingCutEdges.size() > 0) ||
+								   (pmesh->m_mapPendingCutNodes.size() > 0) ||
+								   (pmesh->m_ctProgressiveSubdivided > 0);
+	if(m_ctSinceCheckpoint >= m_interval && !isProgressiveCutPending)
+		return checkpoint(pmesh);
+
+	return true;
+}
+
+bool CutJournal::checkpoint(const CuttableMesh* pmesh) {
+	if(!isOpen())
+		return false;
+
+	ProfileAutoArg("journal checkpoint");
+
+	U32 idxCheckpoint = m_ctCheckpoints;
+	if(!VolMeshIO::writeBinary(pmesh, checkpointPath(idxCheckpoint, false))) {
+		vlogerror("Unable to write the journal checkpoint: %s", checkpointPath(idxCheckpoint, false).cptr());
+		return false;
+	}
+
+	//cut state which is not part of the mesh file
+	Record rec(jrCheckpoint);
+	rec.write(checkpointPath(idxCheckpoint, true));
+	rec.write((U32)pmesh->m_ctCompletedCuts);
+	rec.write((I32)pmesh->m_lastCutCellGrowth);
+	rec.write((I32)pmesh->m_totalCutCellGrowth);
+	rec.write(pmesh->m_ctSplitPartLabels);
+	rec.write((U32)pmesh->m_vRecentCutRegions.size());
+	for(U32 i=0; i < pmesh->m_vRecentCutRegions.size(); i++) {
+		rec.write(pmesh->m_vRecentCutRegions[i].lower());
+		rec.write(pmesh->m_vRecentCutRegions[i].upper());
+	}
+
+	if(!writeRecord(pmesh, rec))
+		return false;
+
+	m_ctCheckpoints++;
+	m_ctSinceCheckpoint = 0;
+
+	//the records after the kept checkpoints are enough to replay
+	if(idxCheckpoint >= JOURNAL_KEPT_CHECKPOINTS)
+		remove(checkpointPath(idxCheckpoint - JOURNAL_KEPT_CHECKPOINTS, false).cptr());
+
+	return true;
+}
+
+bool CutJournal::writeRecord(const CuttableMesh* pmesh, const Record& rec) {
+	if(!isOpen())
+		return false;
+
+	Record settings(rec.type());
+	WriteSettings(pmesh, settings);
+
+	vector<U8> vPayload(settings.payload());
+	vPayload.insert(vPayload.end(), rec.payload().begin(), rec.payload().end());
+
+	JOURNALRECORDHEADER header;
+	header.type = (U32)rec.type();
+	header.szPayload = (U32)vPayload.size();
+	header.meshChecksum = ComputeMeshChecksum(pmesh);
+	header.payloadChecksum = HashBytes(&vPayload[0], vPayload.size());
+
+	//a crash leaves at most one torn record at the end
+	m_fpOut.write((const char*)&header, sizeof(JOURNALRECORDHEADER));
+	m_fpOut.write((const char*)&vPayload[0], vPayload.size());
+	m_fpOut.flush();
+	if(!m_fpOut.good()) {
+		vlogerror("Unable to append to the cut journal: %s", m_strPath.cptr());
+		return false;
+	}
+
+	m_ctRecords++;
+	return true;
+}
+
+AnsiStr CutJournal::checkpointPath(U32 idxCheckpoint, bool relative) const {
+	AnsiStr strName = ExtractFileName(m_strPath) + printToAStr(".%u.vmb", idxCheckpoint);
+	if(relative)
+		return strName;
+	return ExtractFilePath(m_strPath) + strName;
+}
+
+void CutJournal::WriteSettings(const CuttableMesh* pmesh, Record& rec) {
+	rec.write((U32)pmesh->getCutMode());
+	rec.write((U8)pmesh->getFlagSplitMeshAfterCut());
+	rec.write((U8)pmesh->getFlagDetectCutNodes());
+	rec.write((U8)pmesh->getFlagSnapCutNodes());
+	rec.write((U8)pmesh->getFlagFilterOutFlatCells());
+	rec.write(pmesh->getCutNodeROI());
+	rec.write(pmesh->getRefineEdgeLength());
+	rec.write(pmesh->getSliverQuality());
+	rec.write(pmesh->getFlatCellVolume());
+}
+
+bool CutJournal::ReadSettings(Record& rec, CuttableMesh* pmesh) {
+	U32 mode;
+	U8 split, detect, snap, filter;
+	double roi, refine, sliver, flatVolume;
+	if(!rec.read(mode) || !rec.read(split) || !rec.read(detect) || !rec.read(snap) || !rec.read(filter) ||
+	   !rec.read(roi) || !rec.read(refine) || !rec.read(sliver) || !rec.read(flatVolume))
+		return false;
+
+	if(mode > (U32)CuttableMesh::cmVirtualNode)
+		return false;
+
+	pmesh->setCutMode((CuttableMesh::CutMode)mode);
+	pmesh->setFlagSplitMeshAfterCut(split != 0);
+	pmesh->setFlagSnapCutNodes(snap != 0);
+	pmesh->setFlagDetectCutNodes(detect != 0);
+	pmesh->setFlagFilterOutFlatCells(filter != 0);
+	pmesh->setCutNodeROI(roi);
+	pmesh->setRefineEdgeLength(refine);
+	pmesh->setSliverQuality(sliver);
+	pmesh->setFlatCellVolume(flatVolume);
+	return true;
+}
+
+bool CutJournal::ApplyRecord(Record& rec, CuttableMesh* pmesh) {
+	vector<vec3d> vSegments, vQuadstrips;
+
+	switch(rec.type()) {
+	case jrCheckpoint:
+		//a later checkpoint which could not be loaded, the mesh is only verified
+		return true;
+
+	case jrCut:
+		if(!rec.read(vSegments) || !rec.read(vQuadstrips))
+			return false;
+		pmesh->cut(vSegments, vQuadstrips, true);
+		return true;
+
+	case jrCutBatch: {
+		U32 ctPaths = 0;
+		if(!rec.read(ctPaths))
+			return false;
+
+		vector< vector<vec3d> > vvSegments(ctPaths), vvQuadstrips(ctPaths);
+		for(U32 i=0; i < ctPaths; i++) {
+			if(!rec.read(vvSegments[i]) || !rec.read(vvQuadstrips[i]))
+				return false;
+		}
+		pmesh->cutBatch(vvSegments, vvQuadstrips);
+		return true;
+	}
+
+	case jrCutProgressive:
+		if(!rec.read(vSegments) || !rec.read(vQuadstrips))
+			return false;
+		pmesh->cutProgressive(vSegments, vQuadstrips);
+		return true;
+
+	case jrEndProgressiveCut:
+		if(!rec.read(vQuadstrips))
+			return false;
+		pmesh->endProgressiveCut(vQuadstrips);
+		return true;
+
+	case jrRefine: {
+		double maxEdgeLength, margin;
+		if(!rec.read(vQuadstrips) || !rec.read(maxEdgeLength) || !rec.read(margin))
+			return false;
+		pmesh->refineAlongPath(vQuadstrips, maxEdgeLength, margin);
+		return true;
+	}
+
+	case jrCoarsen: {
+		double minEdgeLength, margin;
+		U32 maxCollapses;
+		if(!rec.read(minEdgeLength) || !rec.read(margin) || !rec.read(maxCollapses))
+			return false;
+
+		//the recorded call changed the mesh so it was not skipped as converged
+		pmesh->m_coarsenedVersion = pmesh->version() + 1;
+		pmesh->coarsen(minEdgeLength, margin, maxCollapses);
+		return true;
+	}
+
+	case jrCleanupSlivers: {
+		double minVolume, minQuality;
+		if(!rec.read(minVolume) || !rec.read(minQuality))
+			return false;
+		pmesh->cleanupSlivers(minVolume, minQuality);
+		return true;
+	}
+
+	case jrTransform: {
+		mat44f mtx;
+		for(int i = 0; i < 4; i++) {
+			for(int j = 0; j < 4; j++) {
+				float v;
+				if(!rec.read(v))
+					return false;
+				mtx.setElement(i, j, v);
+			}
+		}
+		pmesh->applyTransform(mtx);
+		return true;
+	}
+
+	default:
+		return false;
+	}
+}
+
+CuttableMesh* CutJournal::LoadCheckpoint(const AnsiStr& strJournalPath, Record& rec, U64 checksum) {
+	VolMesh empty;
+	CuttableMesh* pmesh = new CuttableMesh(empty);
+
+	AnsiStr strName;
+	U32 ctCompletedCuts, ctSplitPartLabels, ctRegions;
+	I32 lastGrowth, totalGrowth;
+	if(!ReadSettings(rec, pmesh) || !rec.read(strName) || !rec.read(ctCompletedCuts) ||
+	   !rec.read(lastGrowth) || !rec.read(totalGrowth) || !rec.read(ctSplitPartLabels) || !rec.read(ctRegions) ||
+	   ctRegions > MAX_RECENT_CUT_REGIONS) {
+		vlogerror("Invalid checkpoint record in the journal: %s", strJournalPath.cptr());
+		SAFE_DELETE(pmesh);
+		return NULL;
+	}
+
+	vector<AABB> vRegions(ctRegions);
+	for(U32 i=0; i < ctRegions; i++) {
+		vec3f lo, hi;
+		if(!rec.read(lo) || !rec.read(hi)) {
+			SAFE_DELETE(pmesh);
+			return NULL;
+		}
+		vRegions[i] = AABB(lo, hi);
+	}
+
+	AnsiStr strPath = ExtractFilePath(strJournalPath) + strName;
+	if(!VolMeshIO::readBinary(pmesh, strPath)) {
+		vlogwarn("Unable to load the journal checkpoint: %s", strPath.cptr());
+		SAFE_DELETE(pmesh);
+		return NULL;
+	}
+
+	if(ComputeMeshChecksum(pmesh) != checksum) {
+		vlogwarn("The journal checkpoint does not match its checksum: %s", strPath.cptr());
+		SAFE_DELETE(pmesh);
+		return NULL;
+	}
+
+	//restore the cut state
+	pmesh->clearCutContext();
+	pmesh->m_quadstrips.clear();
+	pmesh->m_ctCompletedCuts = (int)ctCompletedCuts;
+	pmesh->m_lastCutCellGrowth = lastGrowth;
+	pmesh->m_totalCutCellGrowth = totalGrowth;
+	pmesh->m_ctSplitPartLabels = ctSplitPartLabels;
+	pmesh->m_vRecentCutRegions = vRegions;
+	pmesh->m_aabb = pmesh->computeAABB();
+	pmesh->m_aabb.expand(1.0);
+
+	vloginfo("Loaded the journal checkpoint: %s", strPath.cptr());
+	return pmesh;
+}
+
+CuttableMesh* CutJournal::Replay(const AnsiStr& strPath, JOURNALREPLAYSTATS* lpStats) {
+	ProfileAutoArg("journal replay");
+
+	JOURNALREPLAYSTATS stats;
+	memset(&stats, 0, sizeof(JOURNALREPLAYSTATS));
+	if(lpStats)
+		*lpStats = stats;
+
+	MappedFile mf;
+	if(!mf.open(strPath)) {
+		vlogerror("Unable to open the cut journal: %s", strPath.cptr());
+		return NULL;
+	}
+
+	const U8* lpData = (const U8*)mf.data();
+	const JOURNALHEADER* lpHeader = (const JOURNALHEADER*)lpData;
+	if(mf.size() < sizeof(JOURNALHEADER) || memcmp(lpHeader->magic, CUT_JOURNAL_MAGIC, 8) != 0) {
+		vlogerror("Not a cut journal: %s", strPath.cptr());
+		return NULL;
+	}
+
+	if(lpHeader->version != CUT_JOURNAL_VERSION) {
+		vlogerror("Unsupported cut journal version %u in %s", lpHeader->version, strPath.cptr());
+		return NULL;
+	}
+
+	//valid records up to the first torn or corrupt one
+	vector<JOURNALRECORDHEADER> vHeaders;
+	vector<U64> vOffsets;
+	U64 pos = sizeof(JOURNALHEADER);
+	while(pos < mf.size()) {
+		JOURNALRECORDHEADER header;
+		if(mf.size() - pos < sizeof(JOURNALRECORDHEADER)) {
+			stats.isTorn = true;
+			break;
+		}
+
+		memcpy(&header, lpData + pos, sizeof(JOURNALRECORDHEADER));
+		pos += sizeof(JOURNALRECORDHEADER);
+		if(header.type < jrCheckpoint || header.type > jrTransform || header.szPayload > mf.size() - pos ||
+		   HashBytes(lpData + pos, header.szPayload) != header.payloadChecksum) {
+			stats.isTorn = true;
+			break;
+		}
+
+		vHeaders.push_back(header);
+		vOffsets.push_back(pos);
+		pos += header.szPayload;
+	}
+	stats.ctRecords = (U32)vHeaders.size();
+
+	if(stats.isTorn)
+		vlogwarn("The cut journal ends with a torn record after %u valid records: %s", stats.ctRecords, strPath.cptr());
+
+	//the last checkpoint which loads
+	CuttableMesh* pmesh = NULL;
+	U32 idxFirst = 0;
+	for(U32 i = (U32)vHeaders.size(); i > 0 && pmesh == NULL; i--) {
+		if(vHeaders[i - 1].type != jrCheckpoint)
+			continue;
+
+		Record rec(jrCheckpoint, lpData + vOffsets[i - 1], vHeaders[i - 1].szPayload);
+		pmesh = LoadCheckpoint(strPath, rec, vHeaders[i - 1].meshChecksum);
+		stats.idxCheckpoint = i - 1;
+		idxFirst = i;
+	}
+
+	if(pmesh == NULL) {
+		vlogerror("The cut journal has no valid checkpoint: %s", strPath.cptr());
+		return NULL;
+	}
+
+	//apply the operations after the checkpoint
+	for(U32 i = idxFirst; i < vHeaders.size(); i++) {
+		Record rec((RecordType)vHeaders[i].type, lpData + vOffsets[i], vHeaders[i].szPayload);
+		if(!ReadSettings(rec, pmesh) || !ApplyRecord(rec, pmesh)) {
+			vlogerror("Invalid record %u in the cut journal: %s", i, strPath.cptr());
+			break;
+		}
+		stats.ctApplied++;
+
+		if(ComputeMeshChecksum(pmesh) != vHeaders[i].meshChecksum) {
+			vlogwarn("The mesh after record %u does not match the journal checksum", i);
+			stats.ctMismatches++;
+		}
+	}
+
+	vloginfo("Replayed %u records after checkpoint record %u of %s. checksum mismatches: %u",
+			 stats.ctApplied, stats.idxCheckpoint, strPath.cptr(), stats.ctMismatches);
+
+	if(lpStats)
+		*lpStats = stats;
+	return pmesh;
+}
+
+U64 CutJournal::ComputeMeshChecksum(const VolMesh* pmesh) {
+	const U32 ctNodes = pmesh->countNodes();
+	const U32 ctEdges = pmesh->countEdges();
+	const U32 ctCells = pmesh->countCells();
+	const U32 ctNodeBlocks = (ctNodes + JOURNAL_CHECKSUM_BLOCK_SIZE - 1) / JOURNAL_CHECKSUM_BLOCK_SIZE;
+	const U32 ctEdgeBlocks = (ctEdges + JOURNAL_CHECKSUM_BLOCK_SIZE - 1) / JOURNAL_CHECKSUM_BLOCK_SIZE;
+	const U32 ctCellBlocks = (ctCells + JOURNAL_CHECKSUM_BLOCK_SIZE - 1) / JOURNAL_CHECKSUM_BLOCK_SIZE;
+
+	//nodes, then edges, then cells
+	vector<U64> vBlockHashes(ctNodeBlocks + ctEdgeBlocks + ctCellBlocks);
+	tbb::parallel_for(tbb::blocked_range<U32>(0, (U32)vBlockHashes.size(), 1),
+		[&](const tbb::blocked_range<U32>& r) {
+		for(U32 b = r.begin(); b != r.end(); b++) {
+			U64 h = JOURNAL_HASH_OFFSET;
+			if(b < ctNodeBlocks) {
+				U32 first = b * JOURNAL_CHECKSUM_BLOCK_SIZE;
+				U32 last = std::min<U32>(first + JOURNAL_CHECKSUM_BLOCK_SIZE, ctNodes);
+				for(U32 i = first; i < last; i++) {
+					const vec3d& p = pmesh->const_nodeAt(i).pos;
+					h = HashValue(p.x, h);
+					h = HashValue(p.y, h);
+					h = HashValue(p.z, h);
+				}
+			}
+			else if(b < ctNodeBlocks + ctEdgeBlocks) {
+				U32 first = (b - ctNodeBlocks) * JOURNAL_CHECKSUM_BLOCK_SIZE;
+				U32 last = std::min<U32>(first + JOURNAL_CHECKSUM_BLOCK_SIZE, ctEdges);
+				for(U32 i = first; i < last; i++) {
+					const EDGE& e = pmesh->const_edgeAt(i);
+					h = HashValue(e.from, h);
+					h = HashValue(e.to, h);
+				}
+			}
+			else {
+				U32 first = (b - ctNodeBlocks - ctEdgeBlocks) * JOURNAL_CHECKSUM_BLOCK_SIZE;
+				U32 last = std::min<U32>(first + JOURNAL_CHECKSUM_BLOCK_SIZE, ctCells);
+				for(U32 i = first; i < last; i++)
+					h = HashBytes(pmesh->const_cellAt(i).nodes, sizeof(U32) * COUNT_CELL_NODES, h);
+			}
+			vBlockHashes[b] = h;
+		}
+	});
+
+	U64 h = HashValue(ctNodes, JOURNAL_HASH_OFFSET);
+	h = HashValue(ctEdges, h);
+	h = HashValue(ctCells, h);
+	if(vBlockHashes.size() > 0)
+		h = HashBytes(&vBlockHashes[0], vBlockHashes.size() * sizeof(U64), h);
+	return h;
+}
+
+}
+}
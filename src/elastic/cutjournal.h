@@ -0,0 +1,197 @@
+/*
+ * cutjournal.h
+ */
+
+#ifndef CUTJOURNAL_H_
+#define CUTJOURNAL_H_
+
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include "base/vec.h"
+#include "base/str.h"
+#include "elastic/volmesh.h"
+
+using namespace std;
+using namespace ps::base;
+
+namespace ps {
+namespace elastic {
+
+//version of the journal format
+#define CUT_JOURNAL_VERSION 1
+
+//records between two full checkpoints of the mesh
+#define DEFAULT_JOURNAL_CHECKPOINT_INTERVAL 32
+
+//checkpoint files kept next to the journal, the older ones are removed
+#define JOURNAL_KEPT_CHECKPOINTS 2
+
+//nodes, edges or cells hashed by one task of the mesh checksum
+#define JOURNAL_CHECKSUM_BLOCK_SIZE 4096
+
+class CuttableMesh;
+
+//statistics of a journal replay
+struct JOURNALREPLAYSTATS {
+	U32 ctRecords;
+	U32 ctApplied;
+	U32 ctMismatches;
+	U32 idxCheckpoint;
+	bool isTorn;
+};
+
+/*!
+ * Synopsis: append-only journal of the operations applied to a cuttable mesh. Every record holds
+ * the cut settings of the mesh, the inputs of the operation and a checksum of the resulting mesh.
+ * Every few records the mesh is stored as a full checkpoint in the native binary format next to
+ * the journal, so a replay loads the last valid checkpoint and applies only the records after it.
+ * Records are flushed as they are written. A torn record at the end of the file is ignored.
+ *
+ * A journal belongs to a single mesh. Implicit surface cuts and part conversions are not replayable
+ * from their inputs, a checkpoint is written after them instead.
+ */
+class CutJournal {
+public:
+	enum RecordType {jrCheckpoint = 1, jrCut, jrCutBatch, jrCutProgressive, jrEndProgressiveCut,
+					 jrRefine, jrCoarsen, jrCleanupSlivers, jrTransform};
+
+	/*!
+	 * payload of a record. Values are stored as raw little-endian bytes in the order they are
+	 * written and read back in the same order.
+	 */
+	class Record {
+	public:
+		explicit Record(RecordType type = jrCheckpoint): m_type(type), m_pos(0) {}
+		Record(RecordType type, const U8* lpData, U32 szData): m_type(type), m_vData(lpData, lpData + szData), m_pos(0) {}
+
+		RecordType type() const { return m_type;}
+		const vector<U8>& payload() const { return m_vData;}
+
+		template <typename T>
+		void write(const T& value) {
+			const U8* p = reinterpret_cast<const U8*>(&value);
+			m_vData.insert(m_vData.end(), p, p + sizeof(T));
+		}
+
+		void write(const vector<vec3d>& v) {
+			write((U32)v.size());
+			for(U32 i=0; i < v.size(); i++)
+				write(v[i]);
+		}
+
+		void write(const AnsiStr& str) {
+			write((U32)str.length());
+			m_vData.insert(m_vData.end(), str.cptr(), str.cptr() + str.length());
+		}
+
+		template <typename T>
+		bool read(T& value) {
+			if(m_pos + sizeof(T) > m_vData.size())
+				return false;
+			memcpy(&value, &m_vData[m_pos], sizeof(T));
+			m_pos += sizeof(T);
+			return true;
+		}
+
+		//vectors are not trivially copyable, their components are read one by one
+		template <typename T>
+		bool read(Vec3<T>& v) {
+			return read(v.x) && read(v.y) && read(v.z);
+		}
+
+		bool read(vector<vec3d>& v) {
+			U32 ct = 0;
+			if(!read(ct) || (U64)ct * sizeof(vec3d) > m_vData.size() - m_pos)
+				return false;
+			v.resize(ct);
+			for(U32 i=0; i < ct; i++)
+				read(v[i]);
+			return true;
+		}
+
+		bool read(AnsiStr& str) {
+			U32 ct = 0;
+			if(!read(ct) || ct > m_vData.size() - m_pos)
+				return false;
+			str = AnsiStr(string(m_vData.begin() + m_pos, m_vData.begin() + m_pos + ct).c_str());
+			m_pos += ct;
+			return true;
+		}
+
+	private:
+		RecordType m_type;
+		vector<U8> m_vData;
+		size_t m_pos;
+	};
+
+public:
+	CutJournal();
+	virtual ~CutJournal();
+
+	/*!
+	 * creates the journal file and stores the current mesh as its first checkpoint.
+	 * @param interval number of records between two checkpoints
+	 */
+	bool create(const AnsiStr& strPath, const CuttableMesh* pmesh,
+				U32 interval = DEFAULT_JOURNAL_CHECKPOINT_INTERVAL);
+	void close();
+
+	bool isOpen() const { return m_fpOut.is_open();}
+	const AnsiStr& path() const { return m_strPath;}
+	U32 countRecords() const { return m_ctRecords;}
+
+	/*!
+	 * appends a record of an operation applied to the mesh. The mesh settings and checksum are
+	 * taken now. Writes a checkpoint when the interval is reached and no progressive cut is pending.
+	 */
+	bool append(const CuttableMesh* pmesh, const Record& rec);
+
+	//stores the mesh in a new checkpoint file and records it
+	bool checkpoint(const CuttableMesh* pmesh);
+
+	/*!
+	 * checksum of the node positions, edges and cells of a mesh. Blocks of the arrays are hashed
+	 * in parallel, the result does not depend on the number of threads.
+	 */
+	static U64 ComputeMeshChecksum(const VolMesh* pmesh);
+
+	/*!
+	 * rebuilds a mesh from a journal. Loads the last checkpoint which matches its checksum and
+	 * applies the records after it with their settings.
+	 * @return the rebuilt mesh or NULL if the journal has no valid checkpoint
+	 */
+	static CuttableMesh* Replay(const AnsiStr& strPath, JOURNALREPLAYSTATS* lpStats = NULL);
+
+protected:
+	bool writeRecord(const CuttableMesh* pmesh, const Record& rec);
+
+	//path of a checkpoint file, relative to the journal directory when relative is set
+	AnsiStr checkpointPath(U32 idxCheckpoint, bool relative) const;
+
+	//settings of the mesh stored at the start of every record
+	static void WriteSettings(const CuttableMesh* pmesh, Record& rec);
+	static bool ReadSettings(Record& rec, CuttableMesh* pmesh);
+
+	//applies an operation record to the mesh
+	static bool ApplyRecord(Record& rec, CuttableMesh* pmesh);
+
+	//loads a checkpoint record and the mesh file it refers to
+	static CuttableMesh* LoadCheckpoint(const AnsiStr& strJournalPath, Record& rec, U64 checksum);
+
+private:
+	CutJournal(const CutJournal& rhs);
+	CutJournal& operator=(const CutJournal& rhs);
+
+	ofstream m_fpOut;
+	AnsiStr m_strPath;
+	U32 m_interval;
+	U32 m_ctRecords;
+	U32 m_ctSinceCheckpoint;
+	U32 m_ctCheckpoints;
+};
+
+}
+}
+
+#endif /* CUTJOURNAL_H_ */
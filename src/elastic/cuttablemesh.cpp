@@ -6,13 +6,16 @@
  */
 
 #include <map>
+#include <algorithm>
+#include <cfloat>
 #include "base/Logger.h"
 #include "base/FlatArray.h"
 #include "base/Profiler.h"
 #include "base/intersections.h"
 
 #include "elastic/cuttablemesh.h"
-#include "glbackend/glselect.h"
+#include "elastic/sweptquadbvh.h"
+#include "elastic/sdfcutsurface.h"
 #include "elastic/test_volmesh.h"
 #include "elastic/volmeshstats.h"
 
@@ -41,479 +44,2151 @@ CuttableMesh::CuttableMesh(int ctVertices, double* vertices, int ctElements, int
 }
 
 CuttableMesh::~CuttableMesh() {
+	cancelSpeculativeCut();
+	SAFE_DELETE(m_lpSpeculativeTask);
 	SAFE_DELETE(m_lpSubD);
-	SAFE_DELETE(m_lpRender);
 	m_quadstrips.resize(0);
 }
 
 void CuttableMesh::setup() {
 
-	resetTransform();
-	if(TheShaderManager::Instance().has("phong")) {
-        m_spEffect = SmartPtrSGEffect(new SGEffect(TheShaderManager::Instance().get("phong")));
-    }
-
 	//Perform all tests
 	TestVolMesh::tst_all(this);
     vloginfo("tests done!");
 
-	//Create Renderer
-	m_lpRender = new VolMeshRender();
-
 	//Create subdivider
 	m_lpSubD = new TetSubdivider();
 
-	//Create render
-	syncRender();
-
 	m_aabb = VolMesh::aabb();
 	m_aabb.expand(1.0);
 	m_ctCompletedCuts = 0;
 	m_flagSplitMeshAfterCut = false;
 	m_flagDetectCutNodes = false;
-	m_flagDrawSweepSurf = false;
-	m_flagDrawAABB = false;
-	m_flagDrawNodes = false;
-	m_flagDrawWireFrameMesh = false;
+	m_flagSnapCutNodes = false;
+	m_cutMode = cmSubdivide;
+	m_cutNodeROI = DEFAULT_CUT_NODE_ROI;
+	m_lastCutCellGrowth = 0;
+	m_totalCutCellGrowth = 0;
+	m_refineEdgeLength = 0.0;
+	m_sliverQuality = 0.0;
+	m_coarsenedVersion = 0;
+	m_isCutContextValid = false;
+	m_lpSpeculativeTask = new tbb::task_group();
+	m_isSpeculativeCutCancelled = false;
+	m_isSpeculativeCutRunning = false;
+	m_hasSpeculativeCutRequest = false;
+	m_pendingCutEdgesVersion = 0;
+	m_ctProgressiveSubdivided = 0;
+	m_ctProgressiveCellsBefore = 0;
+	m_lpJournal = NULL;
+	m_journalDepth = 0;
+
+	//label the input parts, the splits only visit the parts touched by the cuts
+	update_disjoint_parts();
+	m_ctSplitPartLabels = count_part_labels();
+}
+
+CuttableMesh::JournalScope::JournalScope(CuttableMesh* pmesh, CutJournal::RecordType type):
+	m_lpMesh(pmesh), m_version(pmesh->version()), m_record(type) {
+	m_isRecording = (pmesh->m_lpJournal != NULL) && (pmesh->m_journalDepth == 0);
+	pmesh->m_journalDepth++;
+}
+
+CuttableMesh::JournalScope::~JournalScope() {
+	m_lpMesh->m_journalDepth--;
+	if(!m_isRecording)
+		return;
+
+	//progressive cuts keep their pending cut edges across calls, so they are recorded even when
+	//the mesh is not changed yet
+	CutJournal::RecordType type = m_record.type();
+	bool isStateful = (type == CutJournal::jrCutProgressive) || (type == CutJournal::jrEndProgressiveCut);
+	if(m_lpMesh->version() == m_version && !isStateful)
+		return;
+
+	if(type == CutJournal::jrCheckpoint)
+		m_lpMesh->m_lpJournal->checkpoint(m_lpMesh);
+	else
+		m_lpMesh->m_lpJournal->append(m_lpMesh, m_record);
 }
 
 void CuttableMesh::clearCutContext() {
+	cancelSpeculativeCut();
 	m_mapCutEdges.clear();
 	m_mapCutNodes.clear();
+	m_cutContext = CutContext();
+	m_isCutContextValid = false;
+	m_mapPendingCutEdges.clear();
+	m_mapPendingCutNodes.clear();
+	m_progressiveEdgeGrid.clear();
+	m_ctProgressiveSubdivided = 0;
+}
+
+int CuttableMesh::computeCutEdgesKernel(const vec3d sweptquad[4],
+						  	  	  	  	std::map<U32, CutEdge>& mapCutEdges,
+						  	  	  	  	const vector<U32>* pvEdges) const {
+
+	//if the swept surface is degenerate then return
+	if(SweptQuadBVH::isQuadDegenerate(sweptquad))
+		return -1;
+
+	vector<vec3d> quadstrip(sweptquad, sweptquad + 4);
+	vector< std::map<U32, CutEdge> > vPerQuadCutEdges;
+	int res = computeCutEdgesBatchKernel(quadstrip, vPerQuadCutEdges, pvEdges);
+	if(res < 0)
+		return res;
+
+	return mergeCutEdges(vPerQuadCutEdges[0], mapCutEdges);
+}
+
+int CuttableMesh::computeCutEdgesBatchKernel(const vector<vec3d>& quadstrips,
+											 vector< std::map<U32, CutEdge> >& vPerQuadCutEdges,
+											 const vector<U32>* pvEdges) const {
+	if(quadstrips.size() < 4 || (quadstrips.size() % 2 != 0))
+		return CUT_ERR_INVALID_INPUT_ARG;
+
+	U32 ctQuads = (quadstrips.size() - 2) / 2;
+	vPerQuadCutEdges.resize(ctQuads);
+	for(U32 i = 0; i < ctQuads; i++)
+		vPerQuadCutEdges[i].clear();
+
+	//degenerate quads are left out of the hierarchy
+	SweptQuadBVH bvh(quadstrips);
+	if(bvh.countQuads() == 0)
+		return 0;
+
+	//swept surface normals
+	vector<vec3d> vNormals(ctQuads);
+	for(U32 i = 0; i < ctQuads; i++) {
+		const vec3d* q = &quadstrips[i * 2];
+		vNormals[i] = vec3d::cross(q[1] - q[0], q[2] - q[0]).normalized();
+	}
+
+	//vars
+	vec3d uvw, xyz, ss0, ss1;
+	double t;
+	vector<U32> vQuads;
+	vQuads.reserve(ctQuads);
+
+	//Cut-Edges: each edge is only tested against the quads its bounding box overlaps
+	U32 ctEdges = pvEdges ? (U32)pvEdges->size() : countEdges();
+	int found = 0;
+	for (U32 k=0; k < ctEdges; k++) {
+
+		//the background task is cancelled when the tool resets or the mesh is about to change
+		if((k & 0x0FFF) == 0 && m_isSpeculativeCutCancelled)
+			return CUT_ERR_USER_CANCELLED_CUT;
+
+		U32 i = pvEdges ? (*pvEdges)[k] : k;
+		const EDGE& e = this->const_edgeAt(i);
+
+		ss0 = this->const_nodeAt(e.from).pos;
+		ss1 = this->const_nodeAt(e.to).pos;
+		if(bvh.query(vec3d::minP(ss0, ss1), vec3d::maxP(ss0, ss1), vQuads) == 0)
+			continue;
+
+		for(U32 j=0; j < vQuads.size(); j++) {
+			const vec3d* q = &quadstrips[vQuads[j] * 2];
+			vec3d tri1[3] = {q[0], q[2], q[1]};
+			vec3d tri2[3] = {q[2], q[3], q[1]};
+
+			int res = IntersectSegmentTriangle(ss0, ss1, tri1, t, uvw, xyz);
+			if(res == 0)
+				res = IntersectSegmentTriangle(ss0, ss1, tri2, t, uvw, xyz);
+			if(res > 0) {
+				CutEdge ce;
+				ce.idxOrgFrom = e.from;
+				ce.idxOrgTo = e.to;
+				ce.pos = xyz;
+				ce.uvw = uvw;
+				ce.normal = vNormals[vQuads[j]];
+				ce.t = t;
+
+				//test
+				vec3d temp = ss0 + (ss1 - ss0).normalized() * t;
+				assert( (xyz - temp).length() < EPSILON);
+
+				//edges are visited in order
+				std::map<U32, CutEdge>& mapCutEdges = vPerQuadCutEdges[vQuads[j]];
+				mapCutEdges.insert(mapCutEdges.end(), std::make_pair(i, ce));
+				found++;
+			}
+		}
+	}
+
+	return found;
+}
+
+int CuttableMesh::mergeCutEdges(const std::map<U32, CutEdge>& mapQuadCutEdges,
+								std::map<U32, CutEdge>& mapCutEdges) {
+	int found = 0;
+	for(std::map<U32, CutEdge>::const_iterator it = mapQuadCutEdges.begin(); it != mapQuadCutEdges.end(); ++it) {
+
+		//add to cut edges map
+		if(mapCutEdges.find(it->first) == mapCutEdges.end()) {
+			mapCutEdges.insert(*it);
+			found++;
+		}
+		else {
+			mapCutEdges.erase(it->first);
+            vlogerror("Edge %d has already been cut!", it->first);
+		}
+	}
+
+	return found;
+}
+
+int CuttableMesh::computeCutNodesKernel(const vec3d& blade0,
+									   const vec3d& blade1,
+									   const vec3d sweptquad[4],
+									   std::map<U32, CutEdge>& mapCutEdges,
+									   std::map<U32, CutNode>& mapCutNodes) const {
+	//Radius of influence as a fraction of the cut edge length
+	const double roi = m_cutNodeROI;
+
+	//blade
+	const double edgelen2 = (blade1 - blade0).length2();
+	int ctRemovedCutEdges = 0;
+	vec3d ss0, ss1;
+
+	//swept surface normal to separate the elements incident to cut nodes
+	vec3d n = vec3d::cross(sweptquad[1] - sweptquad[0], sweptquad[2] - sweptquad[0]).normalized();
+	const vec3d q0 = sweptquad[0];
+
+	//detect all cut-nodes first
+	vector<U32> vDetectedNodes;
+	for (CUTEDGEITER it = mapCutEdges.begin(); it != mapCutEdges.end(); ++it) {
+
+		const EDGE& cutedge = const_edgeAt(it->first);
+		ss0 = const_nodeAt(cutedge.from).pos;
+		ss1 = const_nodeAt(cutedge.to).pos;
+		double d0 = pointLineDistance(blade0, blade1, edgelen2, ss0);
+		double d1 = pointLineDistance(blade0, blade1, edgelen2, ss1);
+		double denom = (ss1 - ss0).length();
+		if (denom == 0)
+			denom = 1;
+
+		double t = 10.0;
+		if (d0 < d1)
+			t = (it->second.pos - ss0).length() / denom;
+		else
+			t = (it->second.pos - ss1).length() / denom;
+
+		//If the start or the end of edge is close to the swept surface it is a cut node
+		if (t < roi && d0 != d1) {
+			CutNode cn;
+			cn.idxNode = (d0 < d1) ? cutedge.from : cutedge.to;
+			cn.pos = (d0 < d1) ? ss0 : ss1;
+			cn.normal = n;
+
+			//closest point on the swept quad plane
+			cn.snappos = cn.pos - n * vec3d::dot(cn.pos - q0, n);
+			if(mapCutNodes.insert(std::pair<U32, CutNode>(cn.idxNode, cn)).second)
+				vDetectedNodes.push_back(cn.idxNode);
+		}
+	}
+
+	//then remove all the cut-edges that emanate from a cut-node
+	for (U32 i = 0; i < vDetectedNodes.size(); i++) {
+		vector<U32> incidentEdges;
+		this->getNodeIncidentEdges(vDetectedNodes[i], incidentEdges);
+
+		for (U32 j = 0; j < incidentEdges.size(); j++)
+			ctRemovedCutEdges += mapCutEdges.erase(incidentEdges[j]);
+	}
+
+	return ctRemovedCutEdges;
+}
+
+
+bool CuttableMesh::CutContext::isComputedFor(const vector<vec3d>& segs, const vector<vec3d>& quads,
+											 bool flagDetectCutNodes, U64 meshVersion) const {
+	if(version != meshVersion || detectCutNodes != flagDetectCutNodes)
+		return false;
+	if(segs.size() != segments.size() || quads.size() != quadstrips.size())
+		return false;
+
+	//same swept geometry
+	for(U32 i=0; i < segs.size(); i++) {
+		if(vec3d::distance(segs[i], segments[i]) > 0.0)
+			return false;
+	}
+
+	for(U32 i=0; i < quads.size(); i++) {
+		if(vec3d::distance(quads[i], quadstrips[i]) > 0.0)
+			return false;
+	}
+
+	return true;
+}
+
+bool CuttableMesh::isCutContextValid(const vector<vec3d>& segments,
+									 const vector<vec3d>& quadstrips) const {
+	if(!m_isCutContextValid)
+		return false;
+
+	return m_cutContext.isComputedFor(segments, quadstrips, m_flagDetectCutNodes, version());
+}
+
+int CuttableMesh::computeCutContext(const vector<vec3d>& segments,
+									const vector<vec3d>& quadstrips) {
+	ProfileAutoArg("cut context");
+
+	clearCutContext();
+
+	CutContext ctx;
+	ctx.version = version();
+	computeCutContext(segments, quadstrips, m_flagDetectCutNodes, ctx);
+	return adoptCutContext(ctx);
+}
+
+int CuttableMesh::computeCutContext(const vector<vec3d>& segments,
+									const vector<vec3d>& quadstrips,
+									bool detectCutNodes,
+									CutContext& ctx) const {
+
+	//1.Compute all cut-edges
+	//2.Compute cut nodes and remove all incident edges to cut nodes from cut edges
+	//3.Compute the cut codes of all affected cells
+
+	//key the context by the swept geometry. The caller sets the mesh version
+	ctx.detectCutNodes = detectCutNodes;
+	ctx.segments.assign(segments.begin(), segments.end());
+	ctx.quadstrips.assign(quadstrips.begin(), quadstrips.end());
+	ctx.ctRemovedCutEdges = 0;
+
+	U32 ctSegments = segments.size() - 1;
+	U32 ctQuads = (quadstrips.size() - 2) / 2;
+	assert(ctSegments == ctQuads);
+
+	//intersect all quads of the strip in a single pass over the edges
+	vector< std::map<U32, CutEdge> > vPerQuadCutEdges;
+	if(computeCutEdgesBatchKernel(quadstrips, vPerQuadCutEdges) == CUT_ERR_USER_CANCELLED_CUT) {
+		ctx.result = CUT_ERR_USER_CANCELLED_CUT;
+		return ctx.result;
+	}
+
+	//scalpel segments: merge the per quad cut edges in strip order
+	ctx.vPerSegmentCuts.resize(ctSegments);
+	for(U32 i = 0; i < ctSegments; i++) {
+
+		vec3d s0 = segments[i];
+		vec3d s1 = segments[i + 1];
+		if(SweptQuadBVH::isQuadDegenerate(&quadstrips[i * 2]))
+			ctx.vPerSegmentCuts[i] = -1;
+		else
+			ctx.vPerSegmentCuts[i] = mergeCutEdges(vPerQuadCutEdges[i], ctx.mapCutEdges);
+
+		if (detectCutNodes) {
+			ctx.ctRemovedCutEdges += computeCutNodesKernel(s0, s1, &quadstrips[i * 2], ctx.mapCutEdges, ctx.mapCutNodes);
+		}
+	}
+
+	//nothing has been cut!?
+	if(ctx.mapCutEdges.size() == 0 && ctx.mapCutNodes.size() == 0) {
+		ctx.result = 0;
+		return ctx.result;
+	}
+
+	int res = computeCutCodes(ctx);
+
+	//cut nodes next to cut edges may form cases the subdivider can not handle. split the edges instead
+	if(res == CUT_ERR_UNHANDLED_CUT_STATE && detectCutNodes) {
+		vlogwarn("Cut nodes produce an unhandled cut case. Falling back to splitting the cut edges.");
+
+		CutContext fallback;
+		fallback.version = ctx.version;
+		res = computeCutContext(segments, quadstrips, false, fallback);
+		fallback.detectCutNodes = detectCutNodes;
+		ctx = std::move(fallback);
+	}
+
+	return res;
 }
 
-void CuttableMesh::draw() {
+int CuttableMesh::computeCutCodes(CutContext& ctx) const {
+
+	//Find the list of all tets impacted
+	ctx.vCutElements.reserve(128);
+	ctx.vCutEdgeCodes.reserve(128);
+	ctx.vCutNodeCodes.reserve(128);
+
+	//cells replaced by an earlier cut of a batch are no longer part of the mesh
+	set<U32> setPendingCells(m_pendingToDeleteCells.begin(), m_pendingToDeleteCells.end());
 
-	//draw volmesh
-	if(m_spEffect)
-		m_spEffect->bind();
-	if(m_spTransform)
-		m_spTransform->bind();
+	for(U32 i=0; i < this->countCells(); i++) {
+		if((i & 0x0FFF) == 0 && m_isSpeculativeCutCancelled) {
+			ctx.result = CUT_ERR_USER_CANCELLED_CUT;
+			return ctx.result;
+		}
+
+		if(setPendingCells.size() > 0 && setPendingCells.find(i) != setPendingCells.end())
+			continue;
+
+        const CELL& cell = this->const_cellAt_(CellLink::create(i));
+		U8 cutEdgeCode = 0;
+		U8 cutNodeCode = 0;
 
-	if(m_flagDrawAABB)
-		drawBBox();
+		//compute cutedge code
+		for(int e=0; e < COUNT_CELL_EDGES; e++) {
+			U32 edge = cell.edges[e];
+			if(ctx.mapCutEdges.find(edge) != ctx.mapCutEdges.end()) {
 
-	//VolMesh::draw();
-	if(m_lpRender)
-		m_lpRender->draw();
+				//check the edge
+				if(!isEdgeOfCell(edge, i)) {
+                    vlogerror("Edge %u does not belong to cell %u", edge, i);
+					ctx.result = -2;
+					return ctx.result;
+				}
 
-	if(m_spTransform)
-		m_spTransform->unbind();
-	if(m_spEffect)
-		m_spEffect->unbind();
+				cutEdgeCode |= (1 << e);
+			}
+		}
 
-	//draw cut context
-	int ctCutEdges = m_mapCutEdges.size();
-	int ctCutNodes = m_mapCutNodes.size();
-	if(ctCutNodes > 0 || ctCutEdges > 0) {
-		glDisable(GL_LIGHTING);
-		glPushAttrib(GL_ALL_ATTRIB_BITS);
-			//Draw nodes
-			glPointSize(7.0f);
-			glBegin(GL_POINTS);
-			//Draw cutedges crossing
-			for(CUTEDGEITER it = m_mapCutEdges.begin(); it != m_mapCutEdges.end(); ++it) {
-				glColor3f(0.0, 0.0, 0.0);
-				if(isNodeIndex(it->second.idxNP0))
-					glVertex3dv(const_nodeAt(it->second.idxNP0).pos.cptr());
+		//compute cut node code
+		for(int e=0; e < COUNT_CELL_NODES; e++) {
+			U32 node = cell.nodes[e];
+			if(ctx.mapCutNodes.find(node) != ctx.mapCutNodes.end()) {
+				cutNodeCode |= (1 << e);
+			}
+		}
 
-				glColor3f(0.0, 0.0, 1.0);
-				glVertex3dv(it->second.pos.cptr());
+		//if there is a cut in this cell
+		if(cutEdgeCode != 0 || cutNodeCode != 0) {
 
-				glColor3f(0.0, 0.0, 0.0);
-				if(isNodeIndex(it->second.idxNP1))
-					glVertex3dv(const_nodeAt(it->second.idxNP1).pos.cptr());
+			//push back all computed values
+			ctx.vCutElements.push_back(i);
+			ctx.vCutEdgeCodes.push_back(cutEdgeCode);
+			ctx.vCutNodeCodes.push_back(cutNodeCode);
+
+			//check if the codes are handled before modifying the mesh
+			TetSubdivider::CUTCASE cc = TetSubdivider::IdentifyCutCase(true, cutEdgeCode, cutNodeCode);
+			if(cc == TetSubdivider::cutUnknown) {
+                vlogerror("This cut contains a cut case which is not handled. case: %c, cutEdgeCode: %x, cutNodeCode: %x",
+							 TetSubdivider::toAlpha(cc), cutEdgeCode, cutNodeCode);
+				ctx.result = CUT_ERR_UNHANDLED_CUT_STATE;
+				return ctx.result;
 			}
-			glEnd();
+		}
+	}
+
+	ctx.result = (int)ctx.vCutElements.size();
+	return ctx.result;
+}
 
-			glColor3f(0, 0, 0);
-			glBegin(GL_POINTS);
-			//Draw cutnodes
-			for(CUTNODEITER it = m_mapCutNodes.begin(); it != m_mapCutNodes.end(); ++it) {
-				glVertex3dv(it->second.pos.cptr());
+int CuttableMesh::computeCutContext(const SDFCutSurface& sdf, CutContext& ctx) const {
+
+	//1.Classify all nodes by the sign of the distance field
+	//2.Nodes on the surface are cut nodes, edges with a sign change are cut edges
+	//3.Compute the cut codes of all affected cells
+	ctx.detectCutNodes = true;
+	ctx.segments.resize(0);
+	ctx.quadstrips.resize(0);
+	ctx.vPerSegmentCuts.resize(0);
+	ctx.ctRemovedCutEdges = 0;
+
+	U32 ctNodes = countNodes();
+	vector<double> vDist(ctNodes);
+	vector<int> vSign(ctNodes);
+
+	//nodes are gathered in blocks in structure of arrays layout for the vectorized distance functions
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctNodes, SDF_NODE_BLOCK_SIZE),
+		[this, &sdf, &vDist, &vSign](const tbb::blocked_range<U32>& r) {
+			U32 count = r.end() - r.begin();
+			vector<double> px(count), py(count), pz(count);
+			for(U32 i = 0; i < count; i++) {
+				const vec3d& p = const_nodeAt(r.begin() + i).pos;
+				px[i] = p.x;
+				py[i] = p.y;
+				pz[i] = p.z;
 			}
-			glEnd();
 
-		glPopAttrib();
-		glEnable(GL_LIGHTING);
+			sdf.distances(&px[0], &py[0], &pz[0], count, &vDist[r.begin()]);
+
+			for(U32 i = r.begin(); i < r.end(); i++)
+				vSign[i] = (vDist[i] > EPSILON) ? 1 : ((vDist[i] < -EPSILON) ? -1 : 0);
+		});
+
+	//cut nodes
+	for(U32 i = 0; i < ctNodes; i++) {
+		if(vSign[i] != 0)
+			continue;
+
+		CutNode cn;
+		cn.idxNode = i;
+		cn.pos = const_nodeAt(i).pos;
+		cn.snappos = cn.pos;
+		cn.normal = sdf.gradient(cn.pos).normalized();
+		ctx.mapCutNodes.insert(ctx.mapCutNodes.end(), std::make_pair(i, cn));
+	}
+
+	//cut edges: the crossing is found by regula falsi along the edge
+	U32 ctEdges = countEdges();
+	for(U32 i = 0; i < ctEdges; i++) {
+		const EDGE& e = const_edgeAt(i);
+		if(vSign[e.from] * vSign[e.to] >= 0)
+			continue;
+
+		const vec3d ss0 = const_nodeAt(e.from).pos;
+		const vec3d ss1 = const_nodeAt(e.to).pos;
+		double u = findSDFCrossing(sdf, ss0, ss1, vDist[e.from], vDist[e.to]);
+
+		CutEdge ce;
+		ce.idxOrgFrom = e.from;
+		ce.idxOrgTo = e.to;
+		ce.pos = ss0 + (ss1 - ss0) * u;
+		ce.uvw = vec3d(0.0, 0.0, 0.0);
+		ce.normal = sdf.gradient(ce.pos).normalized();
+		ce.t = u * (ss1 - ss0).length();
+		ctx.mapCutEdges.insert(ctx.mapCutEdges.end(), std::make_pair(i, ce));
+	}
+
+	if(ctx.mapCutEdges.size() == 0 && ctx.mapCutNodes.size() == 0) {
+		ctx.result = 0;
+		return ctx.result;
+	}
+
+	return computeCutCodes(ctx);
+}
+
+double CuttableMesh::findSDFCrossing(const SDFCutSurface& sdf, const vec3d& s0, const vec3d& s1,
+									 double d0, double d1) {
+	//illinois variant of regula falsi over the edge parameter [0, 1]
+	double a = 0.0;
+	double b = 1.0;
+	double fa = d0;
+	double fb = d1;
+	double u = fa / (fa - fb);
+	int side = 0;
+
+	for(int i = 0; i < SDF_MAX_ROOT_ITERATIONS; i++) {
+		u = (a * fb - b * fa) / (fb - fa);
+		double fu = sdf.distance(s0 + (s1 - s0) * u);
+		if(fabs(fu) < SDF_ROOT_TOLERANCE)
+			break;
+
+		if(fu * fb > 0) {
+			b = u;
+			fb = fu;
+			if(side == -1)
+				fa *= 0.5;
+			side = -1;
+		}
+		else {
+			a = u;
+			fa = fu;
+			if(side == 1)
+				fb *= 0.5;
+			side = 1;
+		}
+	}
+
+	return u;
+}
+
+int CuttableMesh::cut(const SDFCutSurface& sdf, bool modifyMesh) {
+	ProfileAutoArg("cut sdf");
+	JournalScope journal(this, CutJournal::jrCheckpoint);
+
+	clearCutContext();
+
+	CutContext ctx;
+	ctx.version = version();
+	computeCutContext(sdf, ctx);
+	int ctCutElements = adoptCutContext(ctx);
+
+	//the context is keyed by the swept geometry, there is nothing to reuse
+	m_isCutContextValid = false;
+	if(ctCutElements <= 0)
+		return ctCutElements;
+
+	//Return if we won't modify the mesh this time
+	if(!modifyMesh)
+		return CUT_ERR_USER_CANCELLED_CUT;
+
+    vloginfo("BEGIN SDF CUTTING# %u", m_ctCompletedCuts+1);
+
+	//curved and tilted surfaces produce thin sub-elements which are needed for a conforming cut
+	U32 ctCellsBefore = countLiveCells();
+	U32 ctSubdividedTets = 0;
+	U32 ctDuplicatedNodes = 0;
+	bool flagFilter = getFlagFilterOutFlatCells();
+	setFlagFilterOutFlatCells(false);
+
+	if(m_cutMode == cmVirtualNode)
+		ctSubdividedTets = duplicateCutElements(m_cutContext.vCutElements, m_cutContext.vCutEdgeCodes);
+	else {
+		int res = subdivideCutElements(m_cutContext.vCutElements, m_cutContext.vCutEdgeCodes, m_cutContext.vCutNodeCodes);
+		if(res < 0) {
+			setFlagFilterOutFlatCells(flagFilter);
+			return res;
+		}
+		ctSubdividedTets = (U32)res;
+	}
+
+	//separate the elements sharing the cut nodes. nodes on the surface are never part of a
+	//duplicated element, so this is needed in the virtual node mode as well
+	int res = duplicateCutNodes();
+	if(res < 0) {
+		setFlagFilterOutFlatCells(flagFilter);
+		return res;
+	}
+	ctDuplicatedNodes = (U32)res;
+	setFlagFilterOutFlatCells(flagFilter);
+	recordCellGrowth(ctCellsBefore);
+	recordCutRegion();
+
+	if(ctSubdividedTets > 0 || ctDuplicatedNodes > 0) {
+        vloginfo("END SDF CUTTING# %u: subdivided elements count: %u, duplicated nodes count: %u, cell growth: %d.",
+        		 m_ctCompletedCuts + 1, ctSubdividedTets, ctDuplicatedNodes, m_lastCutCellGrowth);
+		m_ctCompletedCuts ++;
+		m_quadstrips.clear();
+	}
+	else {
+        vlogwarn("END SDF CUTTING# %u: No elements are subdivided.", m_ctCompletedCuts + 1);
+	}
+
+	//the zero set is not a swept surface, the parts are not split
+	finalizeCut(vector<vec3d>());
+
+	return ctSubdividedTets + ctDuplicatedNodes;
+}
+
+int CuttableMesh::adoptCutContext(CutContext& ctx) {
+
+	//the cut edges and nodes are drawn and subdivided from the member maps
+	m_mapCutEdges.swap(ctx.mapCutEdges);
+	m_mapCutNodes.swap(ctx.mapCutNodes);
+	ctx.mapCutEdges.clear();
+	ctx.mapCutNodes.clear();
+	m_cutContext = std::move(ctx);
+	m_isCutContextValid = (m_cutContext.result != CUT_ERR_USER_CANCELLED_CUT);
+
+	if(m_mapCutNodes.size() > 0)
+		printf("Cut nodes count %u.\n", (U32)m_mapCutNodes.size());
+	if(m_mapCutEdges.size() > 0)
+		printf("Cut edges count %u. removed %u\n", (U32)m_mapCutEdges.size(), m_cutContext.ctRemovedCutEdges);
+
+	return m_cutContext.result;
+}
+
+void CuttableMesh::speculateCut(const vector<vec3d>& segments,
+								const vector<vec3d>& quadstrips) {
+	if(segments.size() < 2)
+		return;
+	if(quadstrips.size() < 4 || (quadstrips.size() % 2 != 0))
+		return;
+
+	tbb::mutex::scoped_lock lock(m_mtxSpeculativeCut);
+
+	//replace the pending request, the task always picks up the latest one
+	m_speculativeRequest.segments.assign(segments.begin(), segments.end());
+	m_speculativeRequest.quadstrips.assign(quadstrips.begin(), quadstrips.end());
+	m_speculativeRequest.detectCutNodes = m_flagDetectCutNodes;
+	m_speculativeRequest.version = version();
+	m_hasSpeculativeCutRequest = true;
+
+	if(!m_isSpeculativeCutRunning) {
+		m_isSpeculativeCutRunning = true;
+		m_lpSpeculativeTask->run([this]() { runSpeculativeCut(); });
 	}
+}
 
-	if(m_flagDrawSweepSurf) {
-		glDisable(GL_CULL_FACE);
-		glDisable(GL_LIGHTING);
-		glPushAttrib(GL_ALL_ATTRIB_BITS);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glEnable(GL_BLEND);
+void CuttableMesh::runSpeculativeCut() {
+	vector<vec3d> segments;
+	vector<vec3d> quadstrips;
+	bool detectCutNodes = false;
+	U64 meshVersion = 0;
+
+	while(true) {
+		{
+			tbb::mutex::scoped_lock lock(m_mtxSpeculativeCut);
+			if(!m_hasSpeculativeCutRequest || m_isSpeculativeCutCancelled) {
+				m_isSpeculativeCutRunning = false;
+				return;
+			}
 
-		glColor4f(1.0, 0.0, 0.0, 0.3);
-		glBegin(GL_QUAD_STRIP);
-		for(U32 i=0; i < m_quadstrips.size(); i++) {
-			glVertex3dv(m_quadstrips[i].cptr());
+			segments = m_speculativeRequest.segments;
+			quadstrips = m_speculativeRequest.quadstrips;
+			detectCutNodes = m_speculativeRequest.detectCutNodes;
+			meshVersion = m_speculativeRequest.version;
+			m_hasSpeculativeCutRequest = false;
 		}
-		glEnd();
 
-		glDisable(GL_BLEND);
-		glPopAttrib();
-		glEnable(GL_LIGHTING);
-		glEnable(GL_CULL_FACE);
+		CutContext ctx;
+		ctx.version = meshVersion;
+		computeCutContext(segments, quadstrips, detectCutNodes, ctx);
+
+		{
+			tbb::mutex::scoped_lock lock(m_mtxSpeculativeCut);
+			if(ctx.result != CUT_ERR_USER_CANCELLED_CUT)
+				m_speculativeResult = std::move(ctx);
+		}
 	}
 }
 
-void CuttableMesh::syncRender() {
-	m_lpRender->sync(this);
+void CuttableMesh::cancelSpeculativeCut() {
+	if(m_lpSpeculativeTask == NULL)
+		return;
+
+	m_isSpeculativeCutCancelled = true;
+	m_lpSpeculativeTask->wait();
+	m_isSpeculativeCutCancelled = false;
+
+	m_hasSpeculativeCutRequest = false;
+	m_speculativeRequest = CutContext();
+	m_speculativeResult = CutContext();
 }
 
-int CuttableMesh::computeCutEdgesKernel(const vec3d sweptquad[4],
-						  	  	  	  	std::map<U32, CutEdge>& mapCutEdges) {
+bool CuttableMesh::adoptSpeculativeCut(const vector<vec3d>& segments,
+									   const vector<vec3d>& quadstrips) {
+	if(m_lpSpeculativeTask == NULL)
+		return false;
+
+	//the task finishes the latest request before it returns
+	m_lpSpeculativeTask->wait();
+	if(!m_speculativeResult.isComputedFor(segments, quadstrips, m_flagDetectCutNodes, version())) {
+		cancelSpeculativeCut();
+		return false;
+	}
+
+	CutContext ctx = std::move(m_speculativeResult);
+	clearCutContext();
+	adoptCutContext(ctx);
+	return true;
+}
+
+int CuttableMesh::subdivideCutElements(const vector<U32>& vCutElements,
+									   const vector<U8>& vCutEdgeCodes,
+									   const vector<U8>& vCutNodeCodes) {
+	//cut all affected edges
+	for(CUTEDGEITER it = m_mapCutEdges.begin(); it != m_mapCutEdges.end(); it++) {
+		U32 idxNP0, idxNP1;
+
+		if(!this->cut_edge(it->first, it->second.t, &idxNP0, &idxNP1)) {
+            vlogerror("Unable to cut edge %d, edgecutpoint t = %.3f.", it->first, it->second.t);
+			return CUT_ERR_UNABLE_TO_CUT_EDGE;
+		}
+
+		it->second.idxNP0 = idxNP0;
+		it->second.idxNP1 = idxNP1;
+	}
+
+	U32 ctSubdividedTets = 0;
+	U32 middlePoints[12];
+	for(U32 i=0; i < vCutElements.size(); i++) {
+
+		U8 cutEdgeCode = vCutEdgeCodes[i];
+		U8 cutNodeCode = vCutNodeCodes[i];
+		if(cutEdgeCode != 0 || cutNodeCode != 0) {
+
+			const CELL& cell = this->const_cellAt(vCutElements[i]);
+
+			//select the middle points for cut edges
+			for(int e=0; e < COUNT_CELL_EDGES; e++) {
+				CUTEDGEITER it = m_mapCutEdges.find(cell.edges[e]);
+
+				//mid points
+				middlePoints[e * 2 + 0] = VolMesh::INVALID_INDEX;
+				middlePoints[e * 2 + 1] = VolMesh::INVALID_INDEX;
+
+				//if edge is in the list of cutedges
+				if(it != m_mapCutEdges.end()) {
+					U32 idxOrgFrom = it->second.idxOrgFrom;
+					U32 idxOrgTo = it->second.idxOrgTo;
+					U32 idxNP0 = it->second.idxNP0;
+					U32 idxNP1 = it->second.idxNP1;
+
+					bool res1 = edge_exists(idxOrgFrom, idxNP0);
+					bool res2 = edge_exists(idxNP1, idxOrgTo);
+
+					if(!res1 || !res2)
+						cerr << "invalid edge" << endl;
+					assert(res1 && res2);
+
+					middlePoints[e * 2 + 0] = idxNP0;
+					middlePoints[e * 2 + 1] = idxNP1;
+				}
+			}
+			//subdivide the element
+			ctSubdividedTets += m_lpSubD->subdivide(this, vCutElements[i], cutEdgeCode, cutNodeCode, middlePoints);
+		}
+	}
+
+	return ctSubdividedTets;
+}
+
+int CuttableMesh::prepareCutContext(const vector<vec3d>& segments,
+									const vector<vec3d>& quadstrips) {
+	if(isCutContextValid(segments, quadstrips)) {
+		vloginfo("Reusing the cut context of the preceding dry run");
+		return m_cutContext.result;
+	}
+
+	if(adoptSpeculativeCut(segments, quadstrips)) {
+		vloginfo("Reusing the cut context computed in the background while the tool moved");
+		return m_cutContext.result;
+	}
+
+	return computeCutContext(segments, quadstrips);
+}
+
+int CuttableMesh::applyCutContext(const vector<vec3d>& quadstrips) {
+
+	//the mesh is about to change
+	m_isCutContextValid = false;
+
+	//Now that cutedgecodes and cutnodecodes are computed then subdivide the element
+    vloginfo("BEGIN CUTTING# %u", m_ctCompletedCuts+1);
+	U32 ctCellsBefore = countLiveCells();
+	U32 ctSubdividedTets = 0;
+	U32 ctDuplicatedNodes = 0;
+	U32 ctSnappedNodes = 0;
+
+	if(m_cutMode == cmVirtualNode) {
+		//elements are duplicated not subdivided. the cut nodes are never part of a duplicated
+		//element, the elements sharing them are separated the same way as in the subdivide mode
+		ctSubdividedTets = duplicateCutElements(m_cutContext.vCutElements, m_cutContext.vCutEdgeCodes);
+
+		int res = duplicateCutNodes();
+		if(res < 0)
+			return res;
+		ctDuplicatedNodes = (U32)res;
+	}
+	else {
+		//move the cut nodes onto the swept surface before their cells are subdivided
+		if(m_flagSnapCutNodes)
+			ctSnappedNodes = snapCutNodes();
+
+		//the refined cells are smaller than the flat cell volume threshold allows for their sub-elements
+		bool flagFilter = getFlagFilterOutFlatCells();
+		if(m_refineEdgeLength > 0.0)
+			setFlagFilterOutFlatCells(false);
+
+		int res = subdivideCutElements(m_cutContext.vCutElements, m_cutContext.vCutEdgeCodes, m_cutContext.vCutNodeCodes);
+		if(res < 0) {
+			setFlagFilterOutFlatCells(flagFilter);
+			return res;
+		}
+		ctSubdividedTets = (U32)res;
+
+		//separate the elements sharing the cut nodes
+		res = duplicateCutNodes();
+		setFlagFilterOutFlatCells(flagFilter);
+		if(res < 0)
+			return res;
+		ctDuplicatedNodes = (U32)res;
+	}
+	recordCellGrowth(ctCellsBefore);
+	recordCutRegion();
+
+	//increment completed cuts
+	if(ctSubdividedTets > 0 || ctDuplicatedNodes > 0) {
+        vloginfo("END CUTTING# %u: subdivided elements count: %u, duplicated nodes count: %u, snapped nodes count: %u, cell growth: %d.",
+        		 m_ctCompletedCuts + 1, ctSubdividedTets, ctDuplicatedNodes, ctSnappedNodes, m_lastCutCellGrowth);
+		m_ctCompletedCuts ++;
+
+		//store sweep surf
+		m_quadstrips.clear();
+		m_quadstrips.insert(m_quadstrips.end(), quadstrips.begin(), quadstrips.end());
+	}
+	else {
+        vlogwarn("END CUTTING# %u: No elements are subdivided.", m_ctCompletedCuts + 1);
+	}
+
+	return ctSubdividedTets + ctDuplicatedNodes;
+}
+
+void CuttableMesh::finalizeCut(const vector<vec3d>& vSplitQuads) {
+
+	//collect all garbage
+	garbage_collection();
+
+	//Perform all tests
+	TestVolMesh::tst_all(this);
+
+	//split mesh parts
+	if(m_flagSplitMeshAfterCut) {
+		vector< vector<U32> > parts;
+		collectCutParts(parts);
+		for(U32 i = 0; i + 4 <= vSplitQuads.size(); i += 4)
+			splitParts(parts, &vSplitQuads[i], DEFAULT_MESH_SPLIT_DIST);
+	}
+
+	//repair the slivers left by the cut once the cut parts are collected, so the parts touched by
+	//the cleanup are not taken for cut ones. refined cells may be smaller than the flat cell volume
+	if(m_sliverQuality > 0.0)
+		cleanupSlivers((m_refineEdgeLength > 0.0) ? 0.0 : getFlatCellVolume(), m_sliverQuality);
+
+	//print mesh parts
+	//printParts();
+	VolMeshStats::printAllStats(this);
+
+	//recompute AABB and expand it to detect cuts
+	m_aabb = this->computeAABB();
+	m_aabb.expand(1.0);
+
+	//update renderer
+	notifyMeshChanged();
+}
+
+void CuttableMesh::collectSplitQuads(const vector<vec3d>& quadstrips, vector<vec3d>& vSplitQuads) const {
+	U32 ctSegments = (quadstrips.size() - 2) / 2;
+	for(U32 i = 0; i < ctSegments && i < m_cutContext.vPerSegmentCuts.size(); i++) {
+		if(m_cutContext.vPerSegmentCuts[i] > 0)
+			vSplitQuads.insert(vSplitQuads.end(), quadstrips.begin() + i * 2, quadstrips.begin() + i * 2 + 4);
+	}
+}
+
+int CuttableMesh::cut(const vector<vec3d>& segments,
+			 	 	  const vector<vec3d>& quadstrips,
+					  bool modifyMesh) {
+
+	if(segments.size() < 2)
+		return CUT_ERR_INVALID_INPUT_ARG;
+	if(quadstrips.size() < 4 || (quadstrips.size() % 2 != 0))
+		return CUT_ERR_INVALID_INPUT_ARG;
+
+	ProfileAutoArg("cut");
+	JournalScope journal(this, CutJournal::jrCut);
+	if(modifyMesh && journal.isRecording()) {
+		journal.record().write(segments);
+		journal.record().write(quadstrips);
+	}
+
+	//1.Compute the cut context unless a preceding dry run has computed it for the same inputs
+	//2.split cut edges and compute the reference position of the split point
+	//3.duplicate cut nodes and incident edges
+	//refine the cells along the path before the cut context is computed
+	if(modifyMesh && m_refineEdgeLength > 0.0)
+		refineAlongPath(quadstrips, m_refineEdgeLength, m_refineEdgeLength);
+
+	int ctCutElements = prepareCutContext(segments, quadstrips);
+	if(ctCutElements <= 0)
+		return ctCutElements;
+
+	//	int edgeMaskPos[6][2] = { {1, 2}, {2, 3}, {3, 1}, {2, 0}, {0, 3}, {0, 1} };
+	//	int edgeMaskNeg[6][2] = { {3, 2}, {2, 1}, {1, 3}, {3, 0}, {0, 2}, {1, 0} };
+	//	int faceMaskPos[4][3] = { {1, 2, 3}, {2, 0, 3}, {3, 0, 1}, {1, 0, 2} };
+	//	int faceMaskNeg[4][3] = { {3, 2, 1}, {3, 0, 2}, {1, 0, 3}, {2, 0, 1} };
+
+	//Return if we won't modify the mesh this time
+	if(!modifyMesh)
+		return CUT_ERR_USER_CANCELLED_CUT;
+
+	int res = applyCutContext(quadstrips);
+	if(res < 0)
+		return res;
+
+	vector<vec3d> vSplitQuads;
+	if(res > 0)
+		collectSplitQuads(quadstrips, vSplitQuads);
+	finalizeCut(vSplitQuads);
+
+	//Return number of tets cut and nodes separated
+	return res;
+}
+
+int CuttableMesh::cutBatch(const vector< vector<vec3d> >& vSegments,
+						   const vector< vector<vec3d> >& vQuadstrips) {
+	if(vSegments.size() != vQuadstrips.size())
+		return CUT_ERR_INVALID_INPUT_ARG;
+	for(U32 i = 0; i < vSegments.size(); i++) {
+		if(vSegments[i].size() < 2)
+			return CUT_ERR_INVALID_INPUT_ARG;
+		if(vQuadstrips[i].size() < 4 || (vQuadstrips[i].size() % 2 != 0))
+			return CUT_ERR_INVALID_INPUT_ARG;
+	}
+
+	ProfileAutoArg("cut batch");
+	JournalScope journal(this, CutJournal::jrCutBatch);
+	if(journal.isRecording()) {
+		journal.record().write((U32)vSegments.size());
+		for(U32 i = 0; i < vSegments.size(); i++) {
+			journal.record().write(vSegments[i]);
+			journal.record().write(vQuadstrips[i]);
+		}
+	}
+	tbb::tick_count tStart = tbb::tick_count::now();
+
+	//each path is cut on the mesh left by the previous one. The replaced cells stay pending
+	//until the single garbage collection at the end
+	int total = 0;
+	int err = 0;
+	U32 ctApplied = 0;
+	vector<vec3d> vSplitQuads;
+	for(U32 i = 0; i < vSegments.size(); i++) {
+		if(m_refineEdgeLength > 0.0)
+			refineAlongPath(vQuadstrips[i], m_refineEdgeLength, m_refineEdgeLength);
+
+		int ctCutElements = prepareCutContext(vSegments[i], vQuadstrips[i]);
+		if(ctCutElements == 0)
+			continue;
+		if(ctCutElements < 0) {
+			err = ctCutElements;
+			break;
+		}
+
+		int res = applyCutContext(vQuadstrips[i]);
+		if(res < 0) {
+			err = res;
+			break;
+		}
+
+		if(res > 0) {
+			collectSplitQuads(vQuadstrips[i], vSplitQuads);
+			ctApplied++;
+		}
+		total += res;
+	}
+
+	//the cuts applied so far are kept, post processing runs once for all of them
+	if(ctApplied > 0 || err < 0)
+		finalizeCut(vSplitQuads);
+
+	tbb::tick_count tEnd = tbb::tick_count::now();
+    vloginfo("Batch cut: applied %u of %u paths in %.2f ms. res = %d",
+    		 ctApplied, (U32)vSegments.size(), (tEnd - tStart).seconds() * 1000.0, (err < 0) ? err : total);
+
+	if(err < 0) {
+        vlogerror("Batch cut stopped at an error. code = %d", err);
+		return err;
+	}
+
+	return total;
+}
+
+int CuttableMesh::duplicateCutElements(const vector<U32>& vCutElements,
+										const vector<U8>& vCutEdgeCodes) {
+
+	//side of the cut every node is on, decided by the first cut element using the node
+	std::map<U32, U8> mapNodeSide;
+
+	//virtual copies of the nodes. key is node * 2 + side
+	std::map<U32, U32> mapVirtualNodes;
+
+	int ctDuplicated = 0;
+	for(U32 i=0; i < vCutElements.size(); i++) {
+		U8 cutEdgeCode = vCutEdgeCodes[i];
+		if(cutEdgeCode == 0)
+			continue;
+
+		U32 idxCell = vCutElements[i];
+		U32 nodes[4];
+		U32 edges[6];
+		{
+			const CELL& cell = const_cellAt(idxCell);
+			for(int j=0; j < COUNT_CELL_NODES; j++)
+				nodes[j] = cell.nodes[j];
+			for(int e=0; e < COUNT_CELL_EDGES; e++)
+				edges[e] = cell.edges[e];
+		}
+
+		//group the nodes connected by the uncut edges of the element
+		U32 edgeNodes[6][2];
+		U32 group[4] = {0, 1, 2, 3};
+		for(int e=0; e < COUNT_CELL_EDGES; e++) {
+			const EDGE& edge = const_edgeAt(edges[e]);
+			for(int j=0; j < COUNT_CELL_NODES; j++) {
+				if(nodes[j] == edge.from)
+					edgeNodes[e][0] = j;
+				else if(nodes[j] == edge.to)
+					edgeNodes[e][1] = j;
+			}
+		}
+
+		for(int pass=0; pass < 3; pass++) {
+			for(int e=0; e < COUNT_CELL_EDGES; e++) {
+				if(cutEdgeCode & (1 << e))
+					continue;
+
+				U32 g = MATHMIN(group[edgeNodes[e][0]], group[edgeNodes[e][1]]);
+				group[edgeNodes[e][0]] = group[edgeNodes[e][1]] = g;
+			}
+		}
+
+		//partially cut elements stay intact
+		U32 g0 = group[0];
+		U32 g1 = VolMesh::INVALID_INDEX;
+		for(int j=1; j < COUNT_CELL_NODES; j++) {
+			if(group[j] != g0)
+				g1 = group[j];
+		}
+		if(g1 == VolMesh::INVALID_INDEX)
+			continue;
+
+		//side of every group from the nodes classified before or from a cut edge of the group
+		int groupSide[2] = {-1, -1};
+		for(int j=0; j < COUNT_CELL_NODES; j++) {
+			int k = (group[j] == g0) ? 0 : 1;
+			std::map<U32, U8>::const_iterator it = mapNodeSide.find(nodes[j]);
+			if(it != mapNodeSide.end())
+				groupSide[k] = it->second;
+		}
+
+		for(int e=0; e < COUNT_CELL_EDGES; e++) {
+			CUTEDGEITER it = m_mapCutEdges.find(edges[e]);
+			if(!(cutEdgeCode & (1 << e)) || it == m_mapCutEdges.end())
+				continue;
+
+			U32 j = edgeNodes[e][0];
+			int k = (group[j] == g0) ? 0 : 1;
+			if(groupSide[k] < 0) {
+				double d = vec3d::dot(const_nodeAt(nodes[j]).pos - it->second.pos, it->second.normal);
+				groupSide[k] = (d >= 0.0) ? 0 : 1;
+			}
+		}
+
+		if(groupSide[0] < 0)
+			groupSide[0] = 1 - groupSide[1];
+		if(groupSide[1] < 0)
+			groupSide[1] = 1 - groupSide[0];
+
+		//nodes classified by different cuts may put both groups on the same side
+		if(groupSide[0] == groupSide[1]) {
+			vlogwarn("Both sides of the cut element %u are on the same side of the cut. Skipped.", idxCell);
+			continue;
+		}
+
+		U8 sides[4];
+		for(int j=0; j < COUNT_CELL_NODES; j++) {
+			sides[j] = (U8)groupSide[(group[j] == g0) ? 0 : 1];
+			mapNodeSide.insert(std::make_pair(nodes[j], sides[j]));
+		}
+
+		//one copy per side, real nodes on its own side and virtual nodes on the other
+		schedule_remove_cell(idxCell);
+		for(U8 s=0; s < 2; s++) {
+			U32 copy[4];
+			for(int j=0; j < COUNT_CELL_NODES; j++) {
+				if(sides[j] == s) {
+					copy[j] = nodes[j];
+					continue;
+				}
+
+				U32 key = nodes[j] * 2 + s;
+				std::map<U32, U32>::const_iterator it = mapVirtualNodes.find(key);
+				if(it == mapVirtualNodes.end()) {
+					NODE vn = const_nodeAt(nodes[j]);
+					it = mapVirtualNodes.insert(std::make_pair(key, insert_node(vn))).first;
+				}
+				copy[j] = it->second;
+			}
+
+			if(!insert_cell(copy)) {
+                vlogerror("Failed to insert the copy %u of the cut element %u", s, idxCell);
+			}
+		}
+
+		ctDuplicated++;
+	}
+
+	return ctDuplicated;
+}
+
+int CuttableMesh::snapCutNodes() {
+	if(m_mapCutNodes.size() == 0)
+		return 0;
+
+	set<U32> setPendingCells(m_pendingToDeleteCells.begin(), m_pendingToDeleteCells.end());
+
+	int ctSnapped = 0;
+	vec3d v[4];
+	for(CUTNODEITER it = m_mapCutNodes.begin(); it != m_mapCutNodes.end(); ++it) {
+		U32 idxNode = it->second.idxNode;
+		const vec3d disp = it->second.snappos - const_nodeAt(idxNode).pos;
+		if(disp.length2() == 0.0)
+			continue;
+
+		vector<U32> vIncidentCells;
+		getNodeIncidentCells(idxNode, vIncidentCells);
+
+		//the signed volume of every incident cell must keep its sign and most of its size
+		bool valid = true;
+		for(U32 i=0; i < vIncidentCells.size() && valid; i++) {
+			if(setPendingCells.find(vIncidentCells[i]) != setPendingCells.end())
+				continue;
+
+			const CELL& cell = const_cellAt(vIncidentCells[i]);
+			for(int j=0; j < COUNT_CELL_NODES; j++)
+				v[j] = const_nodeAt(cell.nodes[j]).pos;
+			double vol0 = vec3d::dot(v[0] - v[3], vec3d::cross(v[1] - v[3], v[2] - v[3]));
+
+			for(int j=0; j < COUNT_CELL_NODES; j++) {
+				if(cell.nodes[j] == idxNode)
+					v[j] = v[j] + disp;
+			}
+			double vol1 = vec3d::dot(v[0] - v[3], vec3d::cross(v[1] - v[3], v[2] - v[3]));
+
+			if(vol0 * vol1 <= 0.0 || fabs(vol1) < SNAP_MIN_VOLUME_RATIO * fabs(vol0))
+				valid = false;
+		}
+
+		if(!valid)
+			continue;
+
+		NODE& node = nodeAt(idxNode);
+		node.pos = it->second.snappos;
+		node.restpos = node.restpos + disp;
+
+		//separate the incident cells around the snapped position
+		it->second.pos = it->second.snappos;
+		ctSnapped++;
+	}
+
+	return ctSnapped;
+}
+
+int CuttableMesh::duplicateCutNodes() {
+	if(m_mapCutNodes.size() == 0)
+		return 0;
+
+	//cells replaced by their sub-elements are no longer part of the mesh
+	set<U32> setPendingCells(m_pendingToDeleteCells.begin(), m_pendingToDeleteCells.end());
+
+	int ctDuplicated = 0;
+	for(CUTNODEITER it = m_mapCutNodes.begin(); it != m_mapCutNodes.end(); ++it) {
+		U32 idxNode = it->second.idxNode;
+		const vec3d p = it->second.pos;
+		const vec3d n = it->second.normal;
+
+		vector<U32> vIncidentCells;
+		getNodeIncidentCells(idxNode, vIncidentCells);
+
+		//classify the incident cells by the side of the swept surface
+		vector<U32> vBackCells;
+		U32 ctFrontCells = 0;
+		for(U32 i=0; i < vIncidentCells.size(); i++) {
+			U32 idxCell = vIncidentCells[i];
+			if(setPendingCells.find(idxCell) != setPendingCells.end())
+				continue;
+
+			const CELL& cell = const_cellAt(idxCell);
+			vec3d c(0.0, 0.0, 0.0);
+			for(int j=0; j < COUNT_CELL_NODES; j++)
+				c = c + const_nodeAt(cell.nodes[j]).pos;
+			c = c * 0.25;
+
+			if(vec3d::dot(c - p, n) < 0)
+				vBackCells.push_back(idxCell);
+			else
+				ctFrontCells++;
+		}
+
+		//nothing to separate
+		if(vBackCells.size() == 0 || ctFrontCells == 0)
+			continue;
+
+		//validate all replacement cells before the mesh is changed, so the node is either
+		//separated or left as it is
+		bool isValid = true;
+		for(U32 i=0; i < vBackCells.size() && isValid; i++) {
+			const CELL& cell = const_cellAt(vBackCells[i]);
+			for(int j=0; j < COUNT_CELL_NODES; j++) {
+				if(!isNodeIndex(cell.nodes[j]))
+					isValid = false;
+				for(int k=j+1; k < COUNT_CELL_NODES; k++) {
+					if(cell.nodes[j] == cell.nodes[k])
+						isValid = false;
+				}
+			}
+		}
+
+		if(!isValid) {
+            vlogwarn("Invalid cells found around the cut node %u. The node is not duplicated.", idxNode);
+			continue;
+		}
+
+		NODE dup = const_nodeAt(idxNode);
+		U32 idxDup = insert_node(dup);
+
+		//replace the back cells with the ones using the duplicated node. The new cell has the same
+		//shape as the one it replaces, so it is not filtered as flat and is added before the old
+		//one is removed. A cell which still fails is kept on the original node
+		bool flagFilter = getFlagFilterOutFlatCells();
+		setFlagFilterOutFlatCells(false);
+		for(U32 i=0; i < vBackCells.size(); i++) {
+			U32 nodes[4];
+			const CELL& cell = const_cellAt(vBackCells[i]);
+			for(int j=0; j < COUNT_CELL_NODES; j++)
+				nodes[j] = (cell.nodes[j] == idxNode) ? idxDup : cell.nodes[j];
+
+			if(!insert_cell(nodes)) {
+                vlogerror("Failed to reinsert cell %u on the duplicated node %u. The cell is kept on node %u.",
+                		  vBackCells[i], idxDup, idxNode);
+				continue;
+			}
+
+			schedule_remove_cell(vBackCells[i]);
+			setPendingCells.insert(vBackCells[i]);
+		}
+		setFlagFilterOutFlatCells(flagFilter);
+
+		ctDuplicated++;
+	}
+
+	return ctDuplicated;
+}
+
+void CuttableMesh::refreshPendingCutEdges() {
+
+	//edge indices may have shifted after the last gc. find them using their nodes
+	std::map<U32, CutEdge> mapRefreshed;
+	for(CUTEDGEITER it = m_mapPendingCutEdges.begin(); it != m_mapPendingCutEdges.end(); ++it) {
+		CutEdge ce = it->second;
+		if(!isNodeIndex(ce.idxOrgFrom) || !isNodeIndex(ce.idxOrgTo))
+			continue;
+
+		U32 idxEdge = edge_handle(ce.idxOrgFrom, ce.idxOrgTo);
+		if(!isEdgeIndex(idxEdge))
+			continue;
+
+		//keep the cut point distance relative to the from node of the edge
+		const EDGE& e = const_edgeAt(idxEdge);
+		if(e.from != ce.idxOrgFrom) {
+			ce.t = vec3d::distance(const_nodeAt(e.from).pos, const_nodeAt(e.to).pos) - ce.t;
+			std::swap(ce.idxOrgFrom, ce.idxOrgTo);
+		}
+
+		mapRefreshed.insert(std::make_pair(idxEdge, ce));
+	}
+
+	m_mapPendingCutEdges.swap(mapRefreshed);
+	m_pendingCutEdgesVersion = version();
+}
+
+void CuttableMesh::classifyPendingCells(const std::set<U32>& setRemovedCells,
+									   std::map<U32, U8>& mapCellEdgeCodes,
+									   std::map<U32, U8>& mapCellNodeCodes,
+									   std::map<U32, vector<U32> >& mapEdgeCells,
+									   std::set<U32>& setReadyCells) {
+	mapCellEdgeCodes.clear();
+	mapCellNodeCodes.clear();
+	mapEdgeCells.clear();
+	setReadyCells.clear();
+
+	for(CUTEDGEITER it = m_mapPendingCutEdges.begin(); it != m_mapPendingCutEdges.end(); ++it) {
+		vector<U32> vcells;
+		getEdgeIncidentCells(it->first, vcells);
+
+		vector<U32>& vEdgeCells = mapEdgeCells[it->first];
+		for(U32 i=0; i < vcells.size(); i++) {
+			if(setRemovedCells.find(vcells[i]) != setRemovedCells.end())
+				continue;
+			vEdgeCells.push_back(vcells[i]);
+
+			const CELL& cell = const_cellAt(vcells[i]);
+			U8& edgeCode = mapCellEdgeCodes[vcells[i]];
+			for(int e=0; e < COUNT_CELL_EDGES; e++) {
+				if(cell.edges[e] == it->first)
+					edgeCode |= (1 << e);
+			}
+
+			U8& nodeCode = mapCellNodeCodes[vcells[i]];
+			for(int j=0; j < COUNT_CELL_NODES; j++) {
+				if(m_mapPendingCutNodes.find(cell.nodes[j]) != m_mapPendingCutNodes.end())
+					nodeCode |= (1 << j);
+			}
+		}
+	}
+
+	//completely cut cells
+	for(std::map<U32, U8>::const_iterator it = mapCellEdgeCodes.begin(); it != mapCellEdgeCodes.end(); ++it) {
+		TetSubdivider::CUTCASE cc = TetSubdivider::IdentifyCutCase(true, it->second, mapCellNodeCodes[it->first]);
+		if(cc == TetSubdivider::cutA || cc == TetSubdivider::cutB ||
+		   cc == TetSubdivider::cutX || cc == TetSubdivider::cutY)
+			setReadyCells.insert(it->first);
+	}
+}
+
+U32 CuttableMesh::bisectCutEdge(U32 idxEdge, const CutEdge& ce, std::set<U32>& setRemovedCells) {
+	return m_lpSubD->bisectEdge(this, idxEdge, ce.t, setRemovedCells);
+}
+
+int CuttableMesh::cutProgressive(const vector<vec3d>& segments,
+								 const vector<vec3d>& quadstrips) {
+	if(segments.size() < 2)
+		return CUT_ERR_INVALID_INPUT_ARG;
+	if(quadstrips.size() < 4 || (quadstrips.size() % 2 != 0))
+		return CUT_ERR_INVALID_INPUT_ARG;
+
+	ProfileAutoArg("cut progressive");
+	JournalScope journal(this, CutJournal::jrCutProgressive);
+	if(journal.isRecording()) {
+		journal.record().write(segments);
+		journal.record().write(quadstrips);
+	}
+
+	//the mesh is about to change
+	cancelSpeculativeCut();
+
+	//the growth of the progressive cut is measured from its first frame
+	if(m_ctProgressiveSubdivided == 0 && m_mapPendingCutEdges.size() == 0 && m_mapPendingCutNodes.size() == 0)
+		m_ctProgressiveCellsBefore = countLiveCells();
+
+	//the mesh was changed by another operation since the last frame
+	if(m_pendingCutEdgesVersion != version() || m_progressiveEdgeGrid.countBuckets() == 0) {
+		refreshPendingCutEdges();
+		m_progressiveEdgeGrid.build(this);
+	}
+
+	//the cells replaced in the earlier frames are still in the mesh
+	std::set<U32> setRemovedCells(m_pendingToDeleteCells.begin(), m_pendingToDeleteCells.end());
+
+	//1.merge the cut edges of the new quads into the pending cut edges. Only the edges near the
+	//quad are tested. The edges touching the pending cut nodes and the edges of the replaced
+	//cells are not cut.
+	U32 ctQuads = (quadstrips.size() - 2) / 2;
+	const vec3d expand(EPSILON, EPSILON, EPSILON);
+	vector<U32> vEdges;
+	for(U32 i = 0; i < ctQuads; i++) {
+		const vec3d* q = &quadstrips[i * 2];
+		vec3d lo = vec3d::minP(vec3d::minP(q[0], q[1]), vec3d::minP(q[2], q[3])) - expand;
+		vec3d hi = vec3d::maxP(vec3d::maxP(q[0], q[1]), vec3d::maxP(q[2], q[3])) + expand;
+		if(m_progressiveEdgeGrid.query(lo, hi, vEdges) == 0)
+			continue;
+
+		std::map<U32, CutEdge> mapQuadCutEdges;
+		if(computeCutEdgesKernel(q, mapQuadCutEdges, &vEdges) <= 0)
+			continue;
+
+		for(CUTEDGEITER it = mapQuadCutEdges.begin(); it != mapQuadCutEdges.end(); ++it) {
+			if(m_mapPendingCutNodes.find(it->second.idxOrgFrom) != m_mapPendingCutNodes.end() ||
+			   m_mapPendingCutNodes.find(it->second.idxOrgTo) != m_mapPendingCutNodes.end())
+				continue;
+
+			vector<U32> vcells;
+			getEdgeIncidentCells(it->first, vcells);
+			bool isLive = false;
+			for(U32 j=0; j < vcells.size() && !isLive; j++)
+				isLive = (setRemovedCells.find(vcells[j]) == setRemovedCells.end());
+			if(isLive)
+				m_mapPendingCutEdges.insert(*it);
+		}
+	}
+
+	if(m_mapPendingCutEdges.size() == 0)
+		return 0;
+
+	//2.classify the cells incident to the pending cut edges
+	std::map<U32, U8> mapCellEdgeCodes;
+	std::map<U32, U8> mapCellNodeCodes;
+	std::map<U32, vector<U32> > mapEdgeCells;
+	std::set<U32> setReadyCells;
+	classifyPendingCells(setRemovedCells, mapCellEdgeCodes, mapCellNodeCodes, mapEdgeCells, setReadyCells);
+	if(setReadyCells.size() == 0)
+		return 0;
+
+	//the pieces of the partially cut cells are cut again later, so the mesh has to stay
+	//conforming and slivers are kept
+	bool flagFilter = getFlagFilterOutFlatCells();
+	setFlagFilterOutFlatCells(false);
+
+	//3.the front edges are shared between completely and partially cut cells. Splitting them
+	//with a single node lets the completed cells be subdivided now. The node is a pending cut
+	//node which is separated once the blade has passed all of its cells.
+	vector<U32> vFrontEdges;
+	for(std::map<U32, vector<U32> >::const_iterator it = mapEdgeCells.begin(); it != mapEdgeCells.end(); ++it) {
+		const vector<U32>& vcells = it->second;
+		U32 ctReady = 0;
+		for(U32 i=0; i < vcells.size(); i++)
+			ctReady += (setReadyCells.find(vcells[i]) != setReadyCells.end());
+
+		if(ctReady > 0 && ctReady < vcells.size())
+			vFrontEdges.push_back(it->first);
+	}
+
+	if(vFrontEdges.size() > 0) {
+		for(U32 i=0; i < vFrontEdges.size(); i++) {
+			CUTEDGEITER it = m_mapPendingCutEdges.find(vFrontEdges[i]);
+
+			CutNode cn;
+			cn.idxNode = bisectCutEdge(it->first, it->second, setRemovedCells);
+			cn.pos = const_nodeAt(cn.idxNode).pos;
+			cn.snappos = cn.pos;
+			cn.normal = it->second.normal;
+			m_mapPendingCutNodes.insert(std::make_pair(cn.idxNode, cn));
+			m_mapPendingCutEdges.erase(it);
+		}
+
+		classifyPendingCells(setRemovedCells, mapCellEdgeCodes, mapCellNodeCodes, mapEdgeCells, setReadyCells);
+	}
+
+	//an edge is split only when all of its incident cells are subdivided in this pass
+	bool changed = true;
+	while(changed) {
+		changed = false;
+		for(std::map<U32, vector<U32> >::const_iterator it = mapEdgeCells.begin(); it != mapEdgeCells.end(); ++it) {
+			const vector<U32>& vcells = it->second;
+			bool isReady = true;
+			for(U32 i=0; i < vcells.size() && isReady; i++)
+				isReady = (setReadyCells.find(vcells[i]) != setReadyCells.end());
+
+			if(!isReady) {
+				for(U32 i=0; i < vcells.size(); i++)
+					changed |= (setReadyCells.erase(vcells[i]) > 0);
+			}
+		}
+	}
+
+	//4.move the edges of the ready cells to the cut edges and subdivide
+	m_isCutContextValid = false;
+	m_mapCutEdges.clear();
+	m_mapCutNodes.clear();
+
+	vector<U32> vCutElements(setReadyCells.begin(), setReadyCells.end());
+	vector<U8> vCutEdgeCodes(vCutElements.size());
+	vector<U8> vCutNodeCodes(vCutElements.size());
+	for(U32 i=0; i < vCutElements.size(); i++) {
+		vCutEdgeCodes[i] = mapCellEdgeCodes[vCutElements[i]];
+		vCutNodeCodes[i] = mapCellNodeCodes[vCutElements[i]];
+
+		const CELL& cell = const_cellAt(vCutElements[i]);
+		for(int e=0; e < COUNT_CELL_EDGES; e++) {
+			CUTEDGEITER it = m_mapPendingCutEdges.find(cell.edges[e]);
+			if(it != m_mapPendingCutEdges.end()) {
+				m_mapCutEdges.insert(*it);
+				m_mapPendingCutEdges.erase(it);
+			}
+		}
+	}
+
+	int res = subdivideCutElements(vCutElements, vCutEdgeCodes, vCutNodeCodes);
+	if(res < 0) {
+		setFlagFilterOutFlatCells(flagFilter);
+		return res;
+	}
+
+	//5.separate the pending cut nodes whose cells all lie on one side of the cut
+	std::set<U32> setPendingCells(m_pendingToDeleteCells.begin(), m_pendingToDeleteCells.end());
+	for(CUTNODEITER it = m_mapPendingCutNodes.begin(); it != m_mapPendingCutNodes.end(); ) {
+		vector<U32> vcells;
+		getNodeIncidentCells(it->first, vcells);
+
+		bool isResolved = true;
+		for(U32 i=0; i < vcells.size() && isResolved; i++) {
+			if(setPendingCells.find(vcells[i]) != setPendingCells.end())
+				continue;
+
+			const CELL& cell = const_cellAt(vcells[i]);
+			int sides = 0;
+			for(int j=0; j < COUNT_CELL_NODES; j++) {
+				double d = vec3d::dot(const_nodeAt(cell.nodes[j]).pos - it->second.pos, it->second.normal);
+				if(d > EPSILON)
+					sides |= 1;
+				else if(d < -EPSILON)
+					sides |= 2;
+			}
+			isResolved = (sides != 3);
+		}
+
+		if(isResolved) {
+			m_mapCutNodes.insert(*it);
+			m_mapPendingCutNodes.erase(it++);
+		}
+		else
+			++it;
+	}
 
-	//if the swept surface is degenerate then return
-	double area = (sweptquad[1] - sweptquad[0]).length2() * (sweptquad[2] - sweptquad[0]).length2();
-	if(area < EPSILON)
-		return -1;
-	double l2 = (sweptquad[3] - sweptquad[2]).length2();
-	if(l2 < EPSILON)
-		return -1;
+	int ctDuplicatedNodes = duplicateCutNodes();
+	setFlagFilterOutFlatCells(flagFilter);
+	if(ctDuplicatedNodes < 0)
+		return ctDuplicatedNodes;
 
+	//the replaced cells are collected at the end of the cut, the indices stay valid till then
+	m_progressiveEdgeGrid.update(this);
+	m_pendingCutEdgesVersion = version();
 
-	//vars
-	vec3d uvw, xyz, ss0, ss1;
-	double t;
+	m_ctProgressiveSubdivided += res + ctDuplicatedNodes;
+	notifyMeshChanged();
 
-	vec3d tri1[3] = {sweptquad[0], sweptquad[2], sweptquad[1]};
-	vec3d tri2[3] = {sweptquad[2], sweptquad[3], sweptquad[1]};
+	return res + ctDuplicatedNodes;
+}
 
+int CuttableMesh::endProgressiveCut(const vector<vec3d>& quadstrips) {
+	cancelSpeculativeCut();
+	JournalScope journal(this, CutJournal::jrEndProgressiveCut);
+	if(journal.isRecording())
+		journal.record().write(quadstrips);
 
-	//Cut-Edges
-	U32 ctEdges = countEdges();
-	int found = 0;
-	for (U32 i=0; i < ctEdges; i++) {
+	if(m_mapPendingCutEdges.size() > 0 || m_mapPendingCutNodes.size() > 0)
+        vlogwarn("Progressive cut ended with %u partially cut edges and %u unseparated cut nodes",
+        		 (U32)m_mapPendingCutEdges.size(), (U32)m_mapPendingCutNodes.size());
 
-		const EDGE& e = this->const_edgeAt(i);
+	int res = m_ctProgressiveSubdivided;
+	m_mapPendingCutEdges.clear();
+	m_mapPendingCutNodes.clear();
+	m_progressiveEdgeGrid.clear();
+	m_ctProgressiveSubdivided = 0;
 
-		ss0 = this->const_nodeAt(e.from).pos;
-		ss1 = this->const_nodeAt(e.to).pos;
+	//collect the cells replaced by all frames of the cut
+	if(m_pendingToDeleteCells.size() > 0)
+		garbage_collection();
 
-		int res = IntersectSegmentTriangle(ss0, ss1, tri1, t, uvw, xyz);
-		if(res == 0)
-			res = IntersectSegmentTriangle(ss0, ss1, tri2, t, uvw, xyz);
-		if(res > 0) {
-			CutEdge ce;
-			ce.idxOrgFrom = e.from;
-			ce.idxOrgTo = e.to;
-			ce.pos = xyz;
-			ce.uvw = uvw;
-			ce.t = t;
-
-			//test
-			vec3d temp = ss0 + (ss1 - ss0).normalized() * t;
-			assert( (xyz - temp).length() < EPSILON);
-
-			//add to cut edges map
-			if(mapCutEdges.find(i) == mapCutEdges.end()) {
-				mapCutEdges.insert( std::make_pair(i, ce));
-				found++;
-			}
-			else {
-				mapCutEdges.erase(i);
-                vlogerror("Edge %d has already been cut!", i);
-			}
-		}
+	if(res == 0) {
+		m_lastCutCellGrowth = 0;
+		return 0;
 	}
 
-	return found;
-}
+	recordCellGrowth(m_ctProgressiveCellsBefore);
+    vloginfo("END PROGRESSIVE CUTTING# %u: subdivided elements and separated nodes count: %d. Cell growth %d.",
+    		 m_ctCompletedCuts + 1, res, m_lastCutCellGrowth);
+	m_ctCompletedCuts++;
 
-int CuttableMesh::computeCutNodesKernel(const vec3d& blade0,
-									   const vec3d& blade1,
-									   const vec3d sweptquad[4],
-									   std::map<U32, CutEdge>& mapCutEdges,
-									   std::map<U32, CutNode>& mapCutNodes) {
-	//Radios of Influence in percent
-	const double roi = 0.2;
+	//store sweep surf
+	m_quadstrips.assign(quadstrips.begin(), quadstrips.end());
 
-	//blade
-	const double edgelen2 = (blade1 - blade0).length2();
-	int ctRemovedCutEdges = 0;
-	vec3d ss0, ss1;
+	//Perform all tests
+	TestVolMesh::tst_all(this);
 
-	//detect all cut-nodes and remove the cut-edges that emanate from a cut-node
-	for (CUTEDGEITER it = mapCutEdges.begin(); it != mapCutEdges.end(); ++it) {
+	//split mesh parts
+	if(m_flagSplitMeshAfterCut && quadstrips.size() >= 4) {
+		vector< vector<U32> > parts;
+		collectCutParts(parts);
+		U32 ctQuads = (quadstrips.size() - 2) / 2;
+		for(U32 i = 0; i < ctQuads; i++)
+			splitParts(parts, &quadstrips[i * 2], DEFAULT_MESH_SPLIT_DIST);
+	}
 
-		const EDGE& cutedge = const_edgeAt(it->first);
-		ss0 = const_nodeAt(cutedge.from).pos;
-		ss1 = const_nodeAt(cutedge.to).pos;
-		double d0 = pointLineDistance(blade0, blade1, edgelen2, ss0);
-		double d1 = pointLineDistance(blade0, blade1, edgelen2, ss1);
-		double denom = (ss1 - ss0).length();
-		if (denom == 0)
-			denom = 1;
+	VolMeshStats::printAllStats(this);
 
-		double t = 10.0;
-		if (d0 < d1)
-			t = (it->second.pos - ss0).length() / denom;
-		else
-			t = (it->second.pos - ss1).length() / denom;
+	//recompute AABB and expand it to detect cuts
+	m_aabb = this->computeAABB();
+	m_aabb.expand(1.0);
 
-		//If the start of edge is close to the swept surface remove all incident edges from Ec
-		if (d0 < d1 && t < roi) {
-			CutNode cn;
-			cn.idxNode = cutedge.from;
-			cn.pos = ss0;
-			mapCutNodes.insert(std::pair<U32, CutNode>(cn.idxNode, cn));
+	notifyMeshChanged();
 
-			//iterate over all incident edges
-			vector<U32> incidentEdges;
-			this->getNodeIncidentEdges(cn.idxNode, incidentEdges);
+	return res;
+}
 
-			for (U32 i = 0; i < incidentEdges.size(); i++) {
-				mapCutEdges.erase(incidentEdges[i]);
-				ctRemovedCutEdges++;
-			}
-		}
-		//If the end of edge close to the swept surface remove all incident edges from Ec
-		else if (d0 > d1 && t < roi) {
-			CutNode cn;
-			cn.idxNode = cutedge.to;
-			cn.pos = ss1;
-			mapCutNodes.insert(std::pair<U32, CutNode>(cn.idxNode, cn));
+void CuttableMesh::setFlagSnapCutNodes(bool flag) {
+	m_flagSnapCutNodes = flag;
+	if(flag)
+		m_flagDetectCutNodes = true;
+}
 
-			//iterate over all incident edges
-			vector<U32> incidentEdges;
-			this->getNodeIncidentEdges(cn.idxNode, incidentEdges);
+void CuttableMesh::setCutNodeROI(double roi) {
+	if(roi < 0.0)
+		roi = 0.0;
+	else if(roi > MAX_CUT_NODE_ROI)
+		roi = MAX_CUT_NODE_ROI;
+	if(roi == m_cutNodeROI)
+		return;
 
-			for (U32 i = 0; i < incidentEdges.size(); i++) {
-				mapCutEdges.erase(incidentEdges[i]);
-				ctRemovedCutEdges++;
-			}
-		}
-	}
+	//contexts computed with the old region of influence are stale
+	cancelSpeculativeCut();
+	m_isCutContextValid = false;
+	m_cutNodeROI = roi;
+}
 
-	return ctRemovedCutEdges;
+U32 CuttableMesh::countLiveCells() const {
+	set<U32> setPendingCells(m_pendingToDeleteCells.begin(), m_pendingToDeleteCells.end());
+	return countCells() - (U32)setPendingCells.size();
 }
 
+void CuttableMesh::recordCellGrowth(U32 ctCellsBefore) {
+	m_lastCutCellGrowth = (int)countLiveCells() - (int)ctCellsBefore;
+	m_totalCutCellGrowth += m_lastCutCellGrowth;
+}
 
-int CuttableMesh::cut(const vector<vec3d>& segments,
-			 	 	  const vector<vec3d>& quadstrips,
-					  bool modifyMesh) {
+void CuttableMesh::recordCutRegion() {
+	if(m_mapCutEdges.size() == 0 && m_mapCutNodes.size() == 0)
+		return;
 
-	if(segments.size() < 2)
-		return CUT_ERR_INVALID_INPUT_ARG;
-	if(quadstrips.size() < 4 || (quadstrips.size() % 2 != 0))
-		return CUT_ERR_INVALID_INPUT_ARG;
+	vec3d lo(FLT_MAX, FLT_MAX, FLT_MAX);
+	vec3d hi(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for(CUTEDGEITER it = m_mapCutEdges.begin(); it != m_mapCutEdges.end(); ++it) {
+		lo = vec3d::minP(lo, it->second.pos);
+		hi = vec3d::maxP(hi, it->second.pos);
+	}
+	for(CUTNODEITER it = m_mapCutNodes.begin(); it != m_mapCutNodes.end(); ++it) {
+		lo = vec3d::minP(lo, it->second.pos);
+		hi = vec3d::maxP(hi, it->second.pos);
+	}
 
-	ProfileAutoArg("cut");
+	m_vRecentCutRegions.push_back(AABB(vec3f(lo.x, lo.y, lo.z), vec3f(hi.x, hi.y, hi.z)));
+	if(m_vRecentCutRegions.size() > MAX_RECENT_CUT_REGIONS)
+		m_vRecentCutRegions.erase(m_vRecentCutRegions.begin());
+}
 
-	//1.Compute all cut-edges
-	//2.Compute cut nodes and remove all incident edges to cut nodes from cut edges
-	//3.split cut edges and compute the reference position of the split point
-	//4.duplicate cut nodes and incident edges
-	m_mapCutEdges.clear();
-	m_mapCutNodes.clear();
+bool CuttableMesh::isNearRecentCut(const vec3d& p, double margin) const {
+	for(U32 i=0; i < m_vRecentCutRegions.size(); i++) {
+		vec3f lo = m_vRecentCutRegions[i].lower();
+		vec3f hi = m_vRecentCutRegions[i].upper();
+		if(p.x >= lo.x - margin && p.x <= hi.x + margin &&
+		   p.y >= lo.y - margin && p.y <= hi.y + margin &&
+		   p.z >= lo.z - margin && p.z <= hi.z + margin)
+			return true;
+	}
 
-	std::map< U32, CutEdge > mapTempCutEdges;
-	std::map< U32, CutNode > mapTempCutNodes;
+	return false;
+}
 
-	U32 ctSegments = segments.size() - 1;
-	U32 ctQuads = (quadstrips.size() - 2) / 2;
-	assert(ctSegments == ctQuads);
+U32 CuttableMesh::longestCellEdge(U32 idxCell, double& len2) const {
+	const CELL& cell = const_cellAt(idxCell);
+
+	U32 longest = INVALID_INDEX;
+	len2 = 0.0;
+	for(int e=0; e < COUNT_CELL_EDGES; e++) {
+		const EDGE& edge = const_edgeAt(cell.edges[e]);
+		double l2 = (const_nodeAt(edge.to).pos - const_nodeAt(edge.from).pos).length2();
+		if(l2 > len2) {
+			len2 = l2;
+			longest = cell.edges[e];
+		}
+	}
 
-	U32 ctRemovedCutEdges = 0;
+	return longest;
+}
 
-	//scalpel segments
-	vector<int> vPerSegmentCuts;
-	vPerSegmentCuts.resize(ctSegments);
-	for(U32 i = 0; i < ctSegments; i++) {
+int CuttableMesh::refineAlongPath(const vector<vec3d>& quadstrips, double maxEdgeLength, double margin) {
+	if(quadstrips.size() < 4 || (quadstrips.size() % 2 != 0) || maxEdgeLength <= 0.0)
+		return CUT_ERR_INVALID_INPUT_ARG;
 
-		vec3d s0 = segments[i];
-		vec3d s1 = segments[i + 1];
-		vPerSegmentCuts[i] = computeCutEdgesKernel(&quadstrips[i * 2], mapTempCutEdges);
+	//the background cut context reads the cells which are bisected here
+	cancelSpeculativeCut();
 
-		if (m_flagDetectCutNodes) {
-			ctRemovedCutEdges += computeCutNodesKernel(s0, s1, &quadstrips[i * 2], mapTempCutEdges, mapTempCutNodes);
-		}
+	ProfileAutoArg("refine along path");
+	JournalScope journal(this, CutJournal::jrRefine);
+	if(journal.isRecording()) {
+		journal.record().write(quadstrips);
+		journal.record().write(maxEdgeLength);
+		journal.record().write(margin);
 	}
 
-	//nothing has been cut!?
-	if(mapTempCutEdges.size() == 0 && mapTempCutNodes.size() == 0)
-		return 0;
+	//expanded boxes and planes of the swept quads
+	U32 ctQuads = (quadstrips.size() - 2) / 2;
+	vector<vec3d> vLo(ctQuads), vHi(ctQuads), vNormals(ctQuads);
+	for(U32 i=0; i < ctQuads; i++) {
+		const vec3d* q = &quadstrips[i * 2];
+		vLo[i] = vec3d::minP(vec3d::minP(q[0], q[1]), vec3d::minP(q[2], q[3])) - vec3d(margin);
+		vHi[i] = vec3d::maxP(vec3d::maxP(q[0], q[1]), vec3d::maxP(q[2], q[3])) + vec3d(margin);
+		vNormals[i] = vec3d::cross(q[1] - q[0], q[2] - q[0]).normalized();
+	}
 
-	//Copy
-	m_mapCutEdges.insert(mapTempCutEdges.begin(), mapTempCutEdges.end());
-	m_mapCutNodes.insert(mapTempCutNodes.begin(), mapTempCutNodes.end());
-	if(m_mapCutNodes.size() > 0)
-		printf("Cut nodes count %u.\n", (U32)m_mapCutNodes.size());
-	if(m_mapCutEdges.size() > 0)
-		printf("Cut edges count %u. removed %u\n", (U32)m_mapCutEdges.size(), (U32)ctRemovedCutEdges);
+	//both halves of a bisected cell are kept however small they are
+	bool flagFilter = getFlagFilterOutFlatCells();
+	setFlagFilterOutFlatCells(false);
+
+	//longest edges of the neighbor cells to bisect first, by their nodes. Refinement does not
+	//remove nodes so they survive the garbage collection
+	std::set< std::pair<U32, U32> > setPropagated;
+
+	const double maxEdgeLength2 = maxEdgeLength * maxEdgeLength;
+	int ctBisected = 0;
+	for(U32 pass = 0; pass < REFINE_MAX_PASSES; pass++) {
+
+		//longest edge of every close cell which is too long
+		std::map<U32, double> mapEdgeLengths;
+		for(U32 i=0; i < countCells(); i++) {
+			double len2 = 0.0;
+			U32 longest = longestCellEdge(i, len2);
+			if(len2 <= maxEdgeLength2)
+				continue;
+
+			const CELL& cell = const_cellAt(i);
+			vec3d lo = const_nodeAt(cell.nodes[0]).pos;
+			vec3d hi = lo;
+			for(int j=1; j < COUNT_CELL_NODES; j++) {
+				lo = vec3d::minP(lo, const_nodeAt(cell.nodes[j]).pos);
+				hi = vec3d::maxP(hi, const_nodeAt(cell.nodes[j]).pos);
+			}
+			vec3d c = computeCellCentroid(i);
+			double reach = margin + sqrt(len2);
 
-	//Find the list of all tets impacted
-	vector<U32> vCutElements;
-	vector<U8> vCutEdgeCodes;
-	vector<U8> vCutNodeCodes;
-	vCutElements.reserve(128);
-	vCutEdgeCodes.reserve(128);
-	vCutNodeCodes.reserve(128);
+			bool isClose = false;
+			for(U32 q=0; q < ctQuads && !isClose; q++) {
+				if(lo.x > vHi[q].x || hi.x < vLo[q].x ||
+				   lo.y > vHi[q].y || hi.y < vLo[q].y ||
+				   lo.z > vHi[q].z || hi.z < vLo[q].z)
+					continue;
 
-	for(U32 i=0; i < this->countCells(); i++) {
-        const CELL& cell = this->const_cellAt_(CellLink::create(i));
-		U8 cutEdgeCode = 0;
-		U8 cutNodeCode = 0;
+				isClose = fabs(vec3d::dot(c - quadstrips[q * 2], vNormals[q])) <= reach;
+			}
 
-		//compute cutedge code
-		for(int e=0; e < COUNT_CELL_EDGES; e++) {
-			U32 edge = cell.edges[e];
-			if(m_mapCutEdges.find(edge) != m_mapCutEdges.end()) {
+			if(isClose)
+				mapEdgeLengths[longest] = len2;
+		}
 
-				//check the edge
-				if(!isEdgeOfCell(edge, i)) {
-                    vlogerror("Edge %u does not belong to cell %u", edge, i);
-					return -2;
+		for(std::set< std::pair<U32, U32> >::const_iterator it = setPropagated.begin(); it != setPropagated.end(); ++it) {
+			U32 idxEdge = edge_handle(it->first, it->second);
+			if(isEdgeIndex(idxEdge))
+				mapEdgeLengths[idxEdge] = (const_nodeAt(it->second).pos - const_nodeAt(it->first).pos).length2();
+		}
+		setPropagated.clear();
+
+		if(mapEdgeLengths.size() == 0)
+			break;
+
+		//longest edges first. an edge whose cells are already split in this pass waits for the next one
+		vector< std::pair<double, U32> > vEdges;
+		vEdges.reserve(mapEdgeLengths.size());
+		for(std::map<U32, double>::const_iterator it = mapEdgeLengths.begin(); it != mapEdgeLengths.end(); ++it)
+			vEdges.push_back(std::make_pair(-it->second, it->first));
+		std::sort(vEdges.begin(), vEdges.end());
+
+		std::set<U32> setRemovedCells;
+		U32 ctPassBisected = 0;
+		for(U32 i=0; i < vEdges.size(); i++) {
+			vector<U32> vcells;
+			getEdgeIncidentCells(vEdges[i].second, vcells);
+
+			//only the longest edge of all its cells is bisected to keep the quality of the cells.
+			//the longer edges of the neighbors are bisected first
+			bool isFree = true;
+			bool isLongest = true;
+			for(U32 j=0; j < vcells.size() && isFree; j++) {
+				if(setRemovedCells.find(vcells[j]) != setRemovedCells.end()) {
+					isFree = false;
+					continue;
 				}
 
-				cutEdgeCode |= (1 << e);
+				double len2 = 0.0;
+				U32 longest = longestCellEdge(vcells[j], len2);
+				if(longest != vEdges[i].second && len2 > -vEdges[i].first * (1.0 + EPSILON)) {
+					const EDGE& e = const_edgeAt(longest);
+					setPropagated.insert(std::make_pair(e.from, e.to));
+					isLongest = false;
+				}
+			}
+			if(!isFree || !isLongest) {
+				if(!isFree) {
+					const EDGE& e = const_edgeAt(vEdges[i].second);
+					setPropagated.insert(std::make_pair(e.from, e.to));
+				}
+				continue;
 			}
-		}
 
-		//compute cut node code
-		for(int e=0; e < COUNT_CELL_NODES; e++) {
-			U32 node = cell.nodes[e];
-			if(m_mapCutNodes.find(node) != m_mapCutNodes.end()) {
-				cutNodeCode |= (1 << e);
+			//a new node on the swept surface would make the cut degenerate, move it away along the edge
+			const EDGE& edge = const_edgeAt(vEdges[i].second);
+			const vec3d p0 = const_nodeAt(edge.from).pos;
+			const vec3d p1 = const_nodeAt(edge.to).pos;
+			double len = sqrt(-vEdges[i].first);
+			double t = 0.5;
+			vec3d mid = (p0 + p1) * 0.5;
+			for(U32 q=0; q < ctQuads; q++) {
+				if(mid.x < vLo[q].x || mid.x > vHi[q].x ||
+				   mid.y < vLo[q].y || mid.y > vHi[q].y ||
+				   mid.z < vLo[q].z || mid.z > vHi[q].z)
+					continue;
+
+				double d0 = vec3d::dot(p0 - quadstrips[q * 2], vNormals[q]);
+				double d1 = vec3d::dot(p1 - quadstrips[q * 2], vNormals[q]);
+				if(fabs(d0 + d1) * 0.5 < REFINE_PATH_CLEARANCE * len) {
+					t = (fabs(d0) > fabs(d1)) ? 0.5 - REFINE_PATH_CLEARANCE : 0.5 + REFINE_PATH_CLEARANCE;
+					break;
+				}
 			}
+
+			m_lpSubD->bisectEdge(this, vEdges[i].second, len * t, setRemovedCells);
+			ctPassBisected++;
 		}
 
-		//if there is a cut in this cell
-		if(cutEdgeCode != 0 || cutNodeCode != 0) {
+		garbage_collection();
+		ctBisected += ctPassBisected;
+		if(ctPassBisected == 0 && setPropagated.size() == 0)
+			break;
+	}
 
-			//push back all computed values
-			vCutElements.push_back(i);
-			vCutEdgeCodes.push_back(cutEdgeCode);
-			vCutNodeCodes.push_back(cutNodeCode);
+	setFlagFilterOutFlatCells(flagFilter);
 
-			//check if the codes are implemented already
-			TetSubdivider::CUTCASE cc = m_lpSubD->IdentifyCutCase(true, cutEdgeCode, cutNodeCode);
-			char chrCutCase = m_lpSubD->toAlpha(cc);
-			if(chrCutCase != 'A' && chrCutCase != 'B') {
-                vlogerror("This cut contains a cut case which is not handled yet. case: %c, cutEdgeCode: %x, cutNodeCode: %x",
-							 chrCutCase, cutEdgeCode, cutNodeCode);
-				return CUT_ERR_UNHANDLED_CUT_STATE;
-			}
-		}
+	if(ctBisected > 0) {
+		vloginfo("Refined along the path. bisected edges: %d, cells: %u", ctBisected, countCells());
+		m_aabb = this->computeAABB();
+		m_aabb.expand(1.0);
+		notifyMeshChanged();
 	}
 
-	//	int edgeMaskPos[6][2] = { {1, 2}, {2, 3}, {3, 1}, {2, 0}, {0, 3}, {0, 1} };
-	//	int edgeMaskNeg[6][2] = { {3, 2}, {2, 1}, {1, 3}, {3, 0}, {0, 2}, {1, 0} };
-	//	int faceMaskPos[4][3] = { {1, 2, 3}, {2, 0, 3}, {3, 0, 1}, {1, 0, 2} };
-	//	int faceMaskNeg[4][3] = { {3, 2, 1}, {3, 0, 2}, {1, 0, 3}, {2, 0, 1} };
+	return ctBisected;
+}
 
-	//Return if we won't modify the mesh this time
-	if(!modifyMesh)
-		return CUT_ERR_USER_CANCELLED_CUT;
+int CuttableMesh::coarsen(double minEdgeLength, double margin, U32 maxCollapses) {
+	if(minEdgeLength <= 0.0 || maxCollapses == 0)
+		return 0;
 
-	//Now that cutedgecodes and cutnodecodes are computed then subdivide the element
-    vloginfo("BEGIN CUTTING# %u", m_ctCompletedCuts+1);
+	//nothing changed since the last call converged
+	if(m_coarsenedVersion == version())
+		return 0;
 
-	//cut all affected edges
-	for(CUTEDGEITER it = m_mapCutEdges.begin(); it != m_mapCutEdges.end(); it++) {
-		U32 idxNP0, idxNP1;
+	//the tool is moving, coarsening waits until the background cut context is computed
+	{
+		tbb::mutex::scoped_lock lock(m_mtxSpeculativeCut);
+		if(m_isSpeculativeCutRunning || m_hasSpeculativeCutRequest)
+			return 0;
+	}
+	cancelSpeculativeCut();
+
+	ProfileAutoArg("coarsen");
+	JournalScope journal(this, CutJournal::jrCoarsen);
+	if(journal.isRecording()) {
+		journal.record().write(minEdgeLength);
+		journal.record().write(margin);
+		journal.record().write(maxCollapses);
+	}
 
-		if(!this->cut_edge(it->first, it->second.t, &idxNP0, &idxNP1)) {
-            vlogerror("Unable to cut edge %d, edgecutpoint t = %.3f.", it->first, it->second.t);
-			return CUT_ERR_UNABLE_TO_CUT_EDGE;
-		}
+	//boundary nodes keep the surface
+	vector<U8> vBoundary;
+	computeBoundaryNodes(vBoundary);
 
-		it->second.idxNP0 = idxNP0;
-		it->second.idxNP1 = idxNP1;
+	//short edges away from the recent cuts, shortest first
+	const double minEdgeLength2 = minEdgeLength * minEdgeLength;
+	vector< std::pair<double, U32> > vEdges;
+	for(U32 i=0; i < countEdges(); i++) {
+		const EDGE& e = const_edgeAt(i);
+		if(vBoundary[e.from] && vBoundary[e.to])
+			continue;
+
+		const vec3d& p0 = const_nodeAt(e.from).pos;
+		const vec3d& p1 = const_nodeAt(e.to).pos;
+		double l2 = (p1 - p0).length2();
+		if(l2 >= minEdgeLength2)
+			continue;
+
+		if(isNearRecentCut(p0, margin) || isNearRecentCut(p1, margin))
+			continue;
+
+		vEdges.push_back(std::make_pair(l2, i));
 	}
+	std::sort(vEdges.begin(), vEdges.end());
+
+	//the nodes around a collapsed edge are locked until the next garbage collection
+	vector<U8> vLocked(countNodes(), 0);
+	//the quality check of the collapse replaces the flat cell filter
+	bool flagFilter = getFlagFilterOutFlatCells();
+	setFlagFilterOutFlatCells(false);
+
+	std::set<U32> setRemovedCells;
+	U32 ctCollapsed = 0;
+	for(U32 i=0; i < vEdges.size() && ctCollapsed < maxCollapses; i++) {
+		const EDGE& e = const_edgeAt(vEdges[i].second);
+		U32 from = e.from;
+		U32 to = e.to;
+		if(vLocked[from] || vLocked[to])
+			continue;
 
-	U32 ctSubdividedTets = 0;
-	U32 middlePoints[12];
-	for(U32 i=0; i < vCutElements.size(); i++) {
+		//merge the interior node into the other one
+		U32 removed = vBoundary[to] ? from : to;
+		U32 kept = (removed == to) ? from : to;
 
-		U8 cutEdgeCode = vCutEdgeCodes[i];
-		U8 cutNodeCode = vCutNodeCodes[i];
-		if(cutEdgeCode != 0 || cutNodeCode != 0) {
+		vector<U32> vRing;
+		getNodeIncidentNodes(removed, vRing);
+		if(m_lpSubD->collapseEdge(this, kept, removed, COARSEN_MIN_QUALITY, setRemovedCells) < 0)
+			continue;
 
-			const CELL& cell = this->const_cellAt(vCutElements[i]);
+		vLocked[kept] = vLocked[removed] = 1;
+		for(U32 j=0; j < vRing.size(); j++)
+			vLocked[vRing[j]] = 1;
+		ctCollapsed++;
+	}
+	setFlagFilterOutFlatCells(flagFilter);
+
+	if(ctCollapsed > 0) {
+		garbage_collection();
+		vloginfo("Coarsened away from the cuts. collapsed edges: %u, cells: %u", ctCollapsed, countCells());
+
+		//coarsening keeps the parts in place, the next split should not move them
+		update_disjoint_parts();
+		m_ctSplitPartLabels = count_part_labels();
+		m_aabb = this->computeAABB();
+		m_aabb.expand(1.0);
+		notifyMeshChanged();
+	}
 
-			//select the middle points for cut edges
-			for(int e=0; e < COUNT_CELL_EDGES; e++) {
-				CUTEDGEITER it = m_mapCutEdges.find(cell.edges[e]);
+	//converged, skip the next calls until the mesh changes
+	if(ctCollapsed < maxCollapses)
+		m_coarsenedVersion = version();
 
-				//mid points
-				middlePoints[e * 2 + 0] = VolMesh::INVALID_INDEX;
-				middlePoints[e * 2 + 1] = VolMesh::INVALID_INDEX;
+	return (int)ctCollapsed;
+}
 
-				//if edge is in the list of cutedges
-				if(it != m_mapCutEdges.end()) {
-					const EDGE& edge = const_edgeAt(cell.edges[e]);
+int CuttableMesh::cleanupSlivers(double minVolume, double minQuality) {
+	vector<U32> vCells;
+	if(findDegenerateCells(0.0, minQuality, vCells) == 0)
+		return 0;
 
-					U32 idxOrgFrom = it->second.idxOrgFrom;
-					U32 idxOrgTo = it->second.idxOrgTo;
-					U32 idxNP0 = it->second.idxNP0;
-					U32 idxNP1 = it->second.idxNP1;
+	ProfileAutoArg("cleanup slivers");
+	JournalScope journal(this, CutJournal::jrCleanupSlivers);
+	if(journal.isRecording()) {
+		journal.record().write(minVolume);
+		journal.record().write(minQuality);
+	}
 
-					bool res1 = edge_exists(idxOrgFrom, idxNP0);
-					bool res2 = edge_exists(idxNP1, idxOrgTo);
+	//boundary nodes keep the surface unless they are on a flat patch of it
+	vector<U8> vBoundary;
+	computeBoundaryNodes(vBoundary, true);
 
-					if(!res1 || !res2)
-						cerr << "invalid edge" << endl;
-					assert(res1 && res2);
+	//the quality check of the collapse replaces the flat cell filter
+	bool flagFilter = getFlagFilterOutFlatCells();
+	setFlagFilterOutFlatCells(false);
 
-					middlePoints[e * 2 + 0] = idxNP0;
-					middlePoints[e * 2 + 1] = idxNP1;
+	std::set<U32> setRemovedCells;
+	U32 ctCollapsed = 0;
+	U32 ctRemoved = 0;
+	for(U32 i=0; i < vCells.size(); i++) {
+		U32 idxCell = vCells[i];
+		if(setRemovedCells.find(idxCell) != setRemovedCells.end())
+			continue;
+
+		//shortest edges first. an edge between two boundary nodes is collapsed only along the
+		//surface and into a node on a flat patch of it
+		const CELL& cell = const_cellAt(idxCell);
+		vector< std::pair<double, U32> > vEdges;
+		for(int e=0; e < COUNT_CELL_EDGES; e++) {
+			const EDGE& edge = const_edgeAt(cell.edges[e]);
+			if(vBoundary[edge.from] && vBoundary[edge.to]) {
+				if(vBoundary[edge.from] != 2 && vBoundary[edge.to] != 2)
+					continue;
+
+				bool isSurfaceEdge = false;
+				for(int f=0; f < COUNT_CELL_FACES && !isSurfaceEdge; f++) {
+					U32 nodes[3];
+					getFaceNodes(cell.faces[f], nodes);
+					U32 ctShared = 0;
+					for(int j=0; j < 3; j++)
+						ctShared += (nodes[j] == edge.from || nodes[j] == edge.to) ? 1 : 0;
+					isSurfaceEdge = (ctShared == 2) && (countIncidentCells(cell.faces[f]) == 1);
 				}
+				if(!isSurfaceEdge)
+					continue;
 			}
-			//subdivide the element
-			ctSubdividedTets += m_lpSubD->subdivide(this, vCutElements[i], cutEdgeCode, cutNodeCode, middlePoints);
+			vEdges.push_back(std::make_pair((const_nodeAt(edge.to).pos - const_nodeAt(edge.from).pos).length2(), cell.edges[e]));
+		}
+		std::sort(vEdges.begin(), vEdges.end());
+
+		//the reconnected cells must end up better than the sliver
+		vec3d v[COUNT_CELL_NODES];
+		for(int j=0; j < COUNT_CELL_NODES; j++)
+			v[j] = const_nodeAt(cell.nodes[j]).pos;
+		double q = fabs(ComputeCellQuality(v));
+
+		bool isRepaired = false;
+		for(U32 j=0; j < vEdges.size() && !isRepaired; j++) {
+			const EDGE& edge = const_edgeAt(vEdges[j].second);
+			U32 from = edge.from;
+			U32 to = edge.to;
+
+			//merge the interior or flat node into the other one
+			U32 removed = (vBoundary[to] == 1) ? from : to;
+			U32 kept = (removed == to) ? from : to;
+			isRepaired = m_lpSubD->collapseEdge(this, kept, removed, q, setRemovedCells) >= 0;
+			if(!isRepaired && vBoundary[kept] != 1)
+				isRepaired = m_lpSubD->collapseEdge(this, removed, kept, q, setRemovedCells) >= 0;
 		}
-	}
-
 
-	//increment completed cuts
-	if(ctSubdividedTets > 0) {
-        vloginfo("END CUTTING# %u: subdivided elements count: %u.", m_ctCompletedCuts + 1, ctSubdividedTets);
-		m_ctCompletedCuts ++;
+		if(isRepaired) {
+			ctCollapsed++;
+			continue;
+		}
 
-		//store sweep surf
-		m_quadstrips.clear();
-		m_quadstrips.insert(m_quadstrips.end(), quadstrips.begin(), quadstrips.end());
+		//a flat sliver on the surface is peeled off unless the mesh is only connected through it
+		if(computeCellVolume(idxCell) < minVolume && keepsNeighborsConnected(idxCell, setRemovedCells)) {
+			schedule_remove_cell(idxCell);
+			setRemovedCells.insert(idxCell);
+			ctRemoved++;
+		}
 	}
-	else {
-        vlogwarn("END CUTTING# %u: No elements are subdivided.", m_ctCompletedCuts + 1);
+	setFlagFilterOutFlatCells(flagFilter);
+
+	if(ctCollapsed + ctRemoved > 0) {
+		garbage_collection();
+		vloginfo("Cleaned up slivers. found: %u, collapsed: %u, removed: %u, cells: %u",
+				 (U32)vCells.size(), ctCollapsed, ctRemoved, countCells());
+
+		//the cleanup keeps the parts in place, the next split should not move them
+		update_disjoint_parts();
+		m_ctSplitPartLabels = count_part_labels();
+		m_aabb = this->computeAABB();
+		m_aabb.expand(1.0);
+		notifyMeshChanged();
 	}
 
+	return (int)(ctCollapsed + ctRemoved);
+}
 
-	//clear cut context
-	//clearCutContext();
-
-	//collect all garbage
-	garbage_collection();
-
-	//Perform all tests
-	TestVolMesh::tst_all(this);
+bool CuttableMesh::keepsNeighborsConnected(U32 idxCell, const std::set<U32>& setRemovedCells) const {
+	const CELL& cell = const_cellAt(idxCell);
+
+	//the cells around the nodes of the cell, a conservative local test
+	std::set<U32> setStar;
+	for(int j=0; j < COUNT_CELL_NODES; j++) {
+		vector<U32> vIncident;
+		getNodeIncidentCells(cell.nodes[j], vIncident);
+		for(U32 k=0; k < vIncident.size(); k++) {
+			if(vIncident[k] != idxCell && setRemovedCells.find(vIncident[k]) == setRemovedCells.end())
+				setStar.insert(vIncident[k]);
+		}
+	}
 
-	//split mesh parts
-	if(m_flagSplitMeshAfterCut && (ctSubdividedTets > 0)) {
+	std::set<U32> setNeighbors;
+	for(int f=0; f < COUNT_CELL_FACES; f++) {
+		const vector<U32>& cells = m_incident_cells_per_face[cell.faces[f]];
+		for(U32 k=0; k < cells.size(); k++) {
+			if(setStar.find(cells[k]) != setStar.end())
+				setNeighbors.insert(cells[k]);
+		}
+	}
 
-		for(U32 i = 0; i < ctSegments; i++) {
-			if(vPerSegmentCuts[i] > 0)
-				splitParts(&quadstrips[i * 2], DEFAULT_MESH_SPLIT_DIST);
+	//only a sliver lying flat on the surface with two faces exposed is removed, the others
+	//leave a cavity or a dent behind
+	if(setNeighbors.size() > 2)
+		return false;
+	if(setNeighbors.size() < 2)
+		return true;
+
+	//flood the star through the shared faces from one of the neighbours
+	std::set<U32> setVisited;
+	vector<U32> stkCells(1, *setNeighbors.begin());
+	setVisited.insert(stkCells.back());
+	U32 ctReached = 0;
+	while(stkCells.size() > 0) {
+		U32 idxCur = stkCells.back();
+		stkCells.pop_back();
+		if(setNeighbors.find(idxCur) != setNeighbors.end())
+			ctReached++;
+
+		const CELL& cur = const_cellAt(idxCur);
+		for(int f=0; f < COUNT_CELL_FACES; f++) {
+			const vector<U32>& cells = m_incident_cells_per_face[cur.faces[f]];
+			for(U32 k=0; k < cells.size(); k++) {
+				if(setStar.find(cells[k]) != setStar.end() && setVisited.insert(cells[k]).second)
+					stkCells.push_back(cells[k]);
+			}
 		}
 	}
 
-	//print mesh parts
-	//printParts();
-	VolMeshStats::printAllStats(this);
+	return ctReached == setNeighbors.size();
+}
 
-	//recompute AABB and expand it to detect cuts
-	m_aabb = this->computeAABB();
-	m_aabb.expand(1.0);
+void CuttableMesh::computeBoundaryNodes(vector<U8>& vBoundary, bool markFlat) const {
+	vBoundary.assign(countNodes(), 0);
+	vector<vec3d> vNormals;
+	if(markFlat)
+		vNormals.resize(countNodes());
 
-	//update renderer
-	syncRender();
+	for(U32 i=0; i < countFaces(); i++) {
+		if(countIncidentCells(i) != 1)
+			continue;
 
-	//Return number of tets cut
-	return ctSubdividedTets;
+		U32 nodes[3];
+		getFaceNodes(i, nodes);
+		if(!markFlat) {
+			vBoundary[nodes[0]] = vBoundary[nodes[1]] = vBoundary[nodes[2]] = 1;
+			continue;
+		}
+
+		//a node stays flat while all its boundary faces are coplanar
+		const vec3d& p0 = const_nodeAt(nodes[0]).pos;
+		vec3d n = vec3d::cross(const_nodeAt(nodes[1]).pos - p0, const_nodeAt(nodes[2]).pos - p0).normalized();
+		for(int j=0; j < 3; j++) {
+			U32 idxNode = nodes[j];
+			if(vBoundary[idxNode] == 0) {
+				vBoundary[idxNode] = 2;
+				vNormals[idxNode] = n;
+			}
+			else if(vBoundary[idxNode] == 2 && fabs(vec3d::dot(vNormals[idxNode], n)) < FLAT_BOUNDARY_COS)
+				vBoundary[idxNode] = 1;
+		}
+	}
 }
 
 vec3d CuttableMesh::vertexRestPosAt(U32 i) const {
@@ -538,14 +2213,14 @@ int CuttableMesh::findClosestVertex(const vec3d& query, double& dist, vec3d& out
 	return idxFound;
 }
 
-double CuttableMesh::pointLineDistance(const vec3d& v1, const vec3d& v2, const vec3d& p) {
+double CuttableMesh::pointLineDistance(const vec3d& v1, const vec3d& v2, const vec3d& p) const {
 	const double d2 = (v2 - v1).length2();
 	if(d2 == 0.0) return vec3d::distance(p, v1);
 	return pointLineDistance(v1, v2, d2, p);
 }
 
 double CuttableMesh::pointLineDistance(const vec3d& v1, const vec3d& v2,
-									   const double len2, const vec3d& p, double* outT) {
+									   const double len2, const vec3d& p, double* outT) const {
 	// Consider the line extending the segment, parameterized as v1 + t (v2 - v1).
 	// We find projection of point p onto the line.
 	// It falls where t = [(p-1) . (v2-v1)] / |v2-v1|^2
@@ -562,7 +2237,32 @@ double CuttableMesh::pointLineDistance(const vec3d& v1, const vec3d& v2,
 	return vec3d::distance(p, projection);
 }
 
-bool CuttableMesh::splitParts(const vec3d sweptquad[4], double dist) {
+int CuttableMesh::collectCutParts(vector< vector<U32> >& vOutParts) {
+	ProfileAutoArg("collect cut parts");
+
+	vOutParts.resize(0);
+	update_disjoint_parts();
+
+	//the labels given since the last call belong to the touched parts
+	U32 ctLabels = count_part_labels() - m_ctSplitPartLabels;
+	vector<U32> vGroups(ctLabels, (U32)INVALID_INDEX);
+	for(U32 i=0; i < countCells(); i++) {
+		if(cell_part(i) < m_ctSplitPartLabels)
+			continue;
+
+		U32 label = cell_part(i) - m_ctSplitPartLabels;
+		if(vGroups[label] == INVALID_INDEX) {
+			vGroups[label] = vOutParts.size();
+			vOutParts.push_back(vector<U32>());
+		}
+		vOutParts[vGroups[label]].push_back(i);
+	}
+
+	m_ctSplitPartLabels = count_part_labels();
+	return vOutParts.size();
+}
+
+bool CuttableMesh::splitParts(const vector< vector<U32> >& parts, const vec3d sweptquad[4], double dist) {
 
 	vec3d sweptSurfNormal = vec3d::cross(sweptquad[1] - sweptquad[0], sweptquad[2] - sweptquad[0]);
 	sweptSurfNormal.normalize();
@@ -576,19 +2276,14 @@ bool CuttableMesh::splitParts(const vec3d sweptquad[4], double dist) {
 	sweptSurfCentroid = sweptSurfCentroid * 0.25;
 
 
-	//find disjoint mesh-parts
-	vector< vector<U32> > cellgroups;
-	get_disjoint_parts(cellgroups);
-
-
 	//set of nodes
 	set<U32> setFrontNodes;
 	set<U32> setBackNodes;
 
 	//partition nodes to front and back of the sweep surf
-	for(U32 i = 0; i < cellgroups.size(); i++) {
+	for(U32 i = 0; i < parts.size(); i++) {
 
-		vector<U32> cells = cellgroups[i];
+		const vector<U32>& cells = parts[i];
 
 		U32 ctFront = 0;
 		for(vector<U32>::const_iterator it = cells.begin(); it !=cells.end(); ++it) {
@@ -638,8 +2333,10 @@ bool CuttableMesh::splitParts(const vec3d sweptquad[4], double dist) {
 }
 
 int CuttableMesh::convertDisjointPartsToMeshes(vector<CuttableMesh*>& vOutNewMeshes) {
+	cancelSpeculativeCut();
 
 	vOutNewMeshes.clear();
+	JournalScope journal(this, CutJournal::jrCheckpoint);
 	vector< vector<U32> > parts;
 	int count = get_disjoint_parts(parts);
 	if(count < 2)
@@ -685,10 +2382,15 @@ int CuttableMesh::convertDisjointPartsToMeshes(vector<CuttableMesh*>& vOutNewMes
 			}
 		}
 
-		//create the mesh
+		//create the mesh. the cells are already part of this mesh so none of them is filtered out
 		vector<double> vFlatNodes;
 		FlattenVec3<double>(vNewNodes, vFlatNodes);
-		CuttableMesh* amesh = new CuttableMesh(vFlatNodes, vNewCells);
+		VolMesh temp;
+		temp.setFlagFilterOutFlatCells(false);
+		temp.setup(vFlatNodes, vNewCells);
+		CuttableMesh* amesh = new CuttableMesh(temp);
+		amesh->setFlagFilterOutFlatCells(getFlagFilterOutFlatCells());
+		amesh->setFlatCellVolume(getFlatCellVolume());
 
 		AnsiStr strName = printToAStr("%s_cut%d_part%d", this->name().c_str(), countCompletedCuts(), i);
 		amesh->setName(string(strName.cptr()));
@@ -707,9 +2409,14 @@ int CuttableMesh::convertDisjointPartsToMeshes(vector<CuttableMesh*>& vOutNewMes
 	return vOutNewMeshes.size();
 }
 
-void CuttableMesh::applyTransformToMeshThenResetTransform() {
-	if(!m_spTransform)
-		return;
+void CuttableMesh::applyTransform(const mat44f& mtx) {
+	cancelSpeculativeCut();
+	JournalScope journal(this, CutJournal::jrTransform);
+	if(journal.isRecording()) {
+		for(int i = 0; i < 4; i++)
+			for(int j = 0; j < 4; j++)
+				journal.record().write(mtx.element(i, j));
+	}
 
 	for(U32 i = 0; i < countNodes(); i++) {
 		NODE& n = nodeAt(i);
@@ -717,15 +2424,16 @@ void CuttableMesh::applyTransformToMeshThenResetTransform() {
 		vec3d pd = n.pos;
 		vec3f pf = vec3f(pd.x, pd.y, pd.z);
 
-		pf = m_spTransform->forward().map(pf);
+		pf = mtx.map(pf);
 
 		pd = vec3d(pf.x, pf.y, pf.z);
 		n.pos = pd;
 		n.restpos = pd;
 	}
 
-	m_spTransform->reset();
+	m_version++;
 	computeAABB();
+	notifyMeshChanged();
 }
 
 }
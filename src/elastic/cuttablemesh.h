@@ -8,10 +8,14 @@
 #ifndef CUTTABLEMESH_H_
 #define CUTTABLEMESH_H_
 
+#include <tbb/task_group.h>
+#include <tbb/mutex.h>
+#include <tbb/atomic.h>
 #include "volmesh.h"
-#include "scene/sgmesh.h"
-#include "elastic/volmeshrender.h"
 #include "elastic/tetsubdivider.h"
+#include "elastic/sdfcutsurface.h"
+#include "elastic/cutjournal.h"
+#include "elastic/edgegrid.h"
 #include "base/vec.h"
 
 
@@ -28,14 +32,45 @@ namespace elastic {
 
 #define DEFAULT_MESH_SPLIT_DIST 0.1
 
+//cut nodes: region of influence as a fraction of the cut edge length. It stays below half the
+//edge, a cut crossing an edge near its middle would snap either end node depending on rounding
+#define DEFAULT_CUT_NODE_ROI 0.2
+#define MAX_CUT_NODE_ROI 0.45
+
+//a snapped node may shrink an incident cell down to this fraction of its volume
+#define SNAP_MIN_VOLUME_RATIO 0.1
+
+//adaptivity: refinement passes before a cut, recent cut regions kept from coarsening and the
+//minimum quality of the cells reconnected by an edge collapse
+#define REFINE_MAX_PASSES 12
+#define REFINE_PATH_CLEARANCE 0.1
+#define MAX_RECENT_CUT_REGIONS 8
+#define COARSEN_MIN_QUALITY 0.2
+
+//boundary faces around a node are coplanar above this cosine
+#define FLAT_BOUNDARY_COS 0.9999
+
+//implicit surface cuts
+#define SDF_NODE_BLOCK_SIZE 4096
+#define SDF_MAX_ROOT_ITERATIONS 32
+#define SDF_ROOT_TOLERANCE 1e-10
+
 class CuttableMesh : public VolMesh {
+	//restores the cut state of a checkpoint and replays the recorded operations
+	friend class CutJournal;
+
 public:
+	//Cut modes: subdivide the cut elements along the cut surface or duplicate them using the
+	//virtual node algorithm
+	enum CutMode {cmSubdivide, cmVirtualNode};
+
 	//CutEdge
 	class CutEdge {
 	public:
 		double t;
 		vec3d pos;
 		vec3d uvw;
+		vec3d normal;
 		U32 idxNP0;
 		U32 idxNP1;
 		U32 idxOrgFrom;
@@ -52,6 +87,7 @@ public:
 			t	= A.t;
 			pos = A.pos;
 			uvw = A.uvw;
+			normal = A.normal;
 			idxNP0 = A.idxNP0;
 			idxNP1 = A.idxNP1;
 			idxOrgFrom = A.idxOrgFrom;
@@ -64,15 +100,48 @@ public:
 	//CutNode
 	struct CutNode {
 		vec3d pos;
+		vec3d normal;
+		vec3d snappos;
 		U32 idxNode;
 
 		CutNode& operator = (const CutNode& A) {
 			pos = A.pos;
+			normal = A.normal;
+			snappos = A.snappos;
 			idxNode = A.idxNode;
 			return (*this);
 		}
 	};
 
+	//Cut context: the swept geometry it was computed for, the cut edges, cut nodes
+	//and the cut codes of all affected cells
+	struct CutContext {
+		vector<vec3d> segments;
+		vector<vec3d> quadstrips;
+		bool detectCutNodes;
+		U64 version;
+		int result;
+		U32 ctRemovedCutEdges;
+
+		std::map<U32, CutEdge> mapCutEdges;
+		std::map<U32, CutNode> mapCutNodes;
+		vector<U32> vCutElements;
+		vector<U8> vCutEdgeCodes;
+		vector<U8> vCutNodeCodes;
+		vector<int> vPerSegmentCuts;
+
+		CutContext() {
+			detectCutNodes = false;
+			version = 0;
+			result = 0;
+			ctRemovedCutEdges = 0;
+		}
+
+		//true if the context was computed for the same swept geometry on the same mesh version
+		bool isComputedFor(const vector<vec3d>& segs, const vector<vec3d>& quads,
+						   bool flagDetectCutNodes, U64 meshVersion) const;
+	};
+
 public:
 
 	CuttableMesh(const VolMesh& volmesh);
@@ -81,36 +150,194 @@ public:
 	virtual ~CuttableMesh();
 
 	//distances
-	double pointLineDistance(const vec3d& v1, const vec3d& v2, const vec3d& p);
+	double pointLineDistance(const vec3d& v1, const vec3d& v2, const vec3d& p) const;
 	double pointLineDistance(const vec3d& v1, const vec3d& v2,
-							 const double len2, const vec3d& p, double* outT = NULL);
+							 const double len2, const vec3d& p, double* outT = NULL) const;
 
 
-	//draw
-	void draw();
-
-	//sync renderer
-	void syncRender();
-
 	//cutting
 	void clearCutContext();
 
 	//kernel to compute cut-edges per tool segment
 	int computeCutEdgesKernel(const vec3d sweptquad[4],
-							  std::map<U32, CutEdge>& mapCutEdges);
+							  std::map<U32, CutEdge>& mapCutEdges,
+							  const vector<U32>* pvEdges = NULL) const;
+
+	/*!
+	 * computes the cut edges of all quads of a swept quad strip in one pass over the mesh edges.
+	 * The quads are put in a bounding volume hierarchy and every edge is tested only against the
+	 * quads its bounding box overlaps. The cut edges are reported per quad.
+	 * @param pvEdges sorted edges to test, all edges of the mesh when NULL
+	 * @return number of edge-quad intersections or a CUT_ERR code
+	 */
+	int computeCutEdgesBatchKernel(const vector<vec3d>& quadstrips,
+								   vector< std::map<U32, CutEdge> >& vPerQuadCutEdges,
+								   const vector<U32>* pvEdges = NULL) const;
+
+	//merges the cut edges of a quad into the cut edges map. Edges cut twice are removed
+	static int mergeCutEdges(const std::map<U32, CutEdge>& mapQuadCutEdges,
+							 std::map<U32, CutEdge>& mapCutEdges);
 
 	//kernel to compute cut nodes per tool segment
 	int computeCutNodesKernel(const vec3d& blade0,
 							  const vec3d& blade1,
 							  const vec3d sweptquad[4],
 							  std::map<U32, CutEdge>& mapCutEdges,
-							  std::map<U32, CutNode>& mapCutNodes);
+							  std::map<U32, CutNode>& mapCutNodes) const;
+
+
+	/*!
+	 * moves the cut nodes onto the swept surface so the elements are separated along their
+	 * existing faces. A node is left in place if the move would invert or flatten an incident cell.
+	 * @return number of snapped nodes
+	 */
+	int snapCutNodes();
 
+	/*!
+	 * virtual node algorithm: every completely cut element is replaced by two copies. Each copy keeps
+	 * the real nodes on one side of the cut and uses virtual copies of the nodes on the other side.
+	 * The virtual copy of a node is shared by all copies on the same side, so the material on either
+	 * side stays connected while the two sides are separated topologically. Partially cut elements
+	 * are left intact, so are the elements touching a cut node. Those are separated by duplicateCutNodes.
+	 * @return number of duplicated elements
+	 */
+	int duplicateCutElements(const vector<U32>& vCutElements,
+							 const vector<U8>& vCutEdgeCodes);
 
+	/*!
+	 * duplicates every cut node and moves the elements behind the swept surface
+	 * over to the duplicate, so the cut separates the mesh along the cut nodes.
+	 * The cells around a node are validated before the node is duplicated, a node with an invalid
+	 * cell is skipped. A cell which cannot be moved to the duplicate stays on the original node,
+	 * the other cells are still moved so the mesh is always left consistent.
+	 * @return number of duplicated nodes
+	 */
+	int duplicateCutNodes();
+
+	/*!
+	 * computes the cut edges, cut nodes and the cut codes of all affected cells.
+	 * @return number of affected cells or a CUT_ERR code
+	 */
+	int computeCutContext(const vector<vec3d>& segments,
+						  const vector<vec3d>& quadstrips);
+
+	/*!
+	 * computes the cut context into ctx without touching the mesh or the current cut context.
+	 * Safe to run on a worker thread as long as the mesh is not modified meanwhile.
+	 * @return number of affected cells or a CUT_ERR code
+	 */
+	int computeCutContext(const vector<vec3d>& segments,
+						  const vector<vec3d>& quadstrips,
+						  bool detectCutNodes,
+						  CutContext& ctx) const;
+
+	/*!
+	 * schedules the cut context of the swept geometry on a background task while the tool moves.
+	 * Only the latest request is computed; the committing cut() with the same inputs adopts it
+	 * and only subdivides.
+	 */
+	void speculateCut(const vector<vec3d>& segments,
+					  const vector<vec3d>& quadstrips);
+
+	//cancels the background cut context task and waits for it to finish
+	void cancelSpeculativeCut();
+
+	//true when the last computed cut context belongs to the same inputs and mesh version
+	bool isCutContextValid(const vector<vec3d>& segments,
+						   const vector<vec3d>& quadstrips) const;
+
+	/*!
+	 * cuts the mesh along the swept quads. A dry run (modifyMesh = false) keeps the
+	 * cut context so the committing call with the same inputs skips to subdivision.
+	 */
 	int cut(const vector<vec3d>& segments,
 			const vector<vec3d>& quadstrips,
 			bool modifyMesh);
 
+	/*!
+	 * applies a sequence of cut paths as one transaction. Each path is cut on the mesh left by the
+	 * previous one; garbage collection, tests, stats, AABB and the render sync run once at the end.
+	 * If a path fails the cuts applied before it are kept and post processed.
+	 * @return total number of subdivided elements and duplicated nodes or the first CUT_ERR code
+	 */
+	int cutBatch(const vector< vector<vec3d> >& vSegments,
+				 const vector< vector<vec3d> >& vQuadstrips);
+
+	/*!
+	 * computes the cut context of an implicit cut surface into ctx. The nodes are classified by the
+	 * sign of the distance field, edges with a sign change are cut at the root of the field and
+	 * nodes on the surface become cut nodes.
+	 * @return number of affected cells or a CUT_ERR code
+	 */
+	int computeCutContext(const SDFCutSurface& sdf, CutContext& ctx) const;
+
+	/*!
+	 * cuts the mesh along the zero set of a signed distance function. The elements behind the
+	 * surface are separated from the ones in front of it.
+	 * @return number of subdivided elements and duplicated nodes or a CUT_ERR code
+	 */
+	int cut(const SDFCutSurface& sdf, bool modifyMesh);
+
+	/*!
+	 * progressive cutting: merges the cut edges of the new swept quads into the pending cut edges
+	 * and subdivides only the elements which are completely cut. Partially cut elements are kept
+	 * across calls until the later quads complete them. Only the edges near the new quads are
+	 * tested, the replaced elements are collected by endProgressiveCut.
+	 * @return number of subdivided elements in this call or a CUT_ERR code
+	 */
+	int cutProgressive(const vector<vec3d>& segments,
+					   const vector<vec3d>& quadstrips);
+
+	/*!
+	 * ends a progressive cut, drops the remaining partially cut elements, collects the elements
+	 * replaced during the cut and splits the parts using the complete swept surface.
+	 * @return number of elements subdivided during the progressive cut
+	 */
+	int endProgressiveCut(const vector<vec3d>& quadstrips);
+
+	/*!
+	 * refines the cells close to a swept quad strip by longest edge bisection until none of their
+	 * edges is longer than maxEdgeLength. An edge is bisected only if it is the longest edge of all
+	 * its cells, otherwise the longer edges of the neighbors are bisected first. A cell is close if
+	 * its bounding box overlaps the box of a quad expanded by margin and its centroid is within margin plus its longest edge from the
+	 * plane of the quad. Runs at most REFINE_MAX_PASSES passes with a garbage collection after each.
+	 * Edges are split at the middle unless that is within REFINE_PATH_CLEARANCE of the edge length
+	 * from a quad plane, then the new node is moved away from the plane.
+	 * @return number of bisected edges
+	 */
+	int refineAlongPath(const vector<vec3d>& quadstrips, double maxEdgeLength, double margin);
+
+	/*!
+	 * coarsens the mesh away from the recent cuts by collapsing the edges shorter than
+	 * minEdgeLength, shortest first. Nodes within margin of the last MAX_RECENT_CUT_REGIONS cut
+	 * regions and boundary nodes are kept, so the surface does not change. At most maxCollapses
+	 * edges are collapsed per call so it can run in small steps between frames. Nothing is
+	 * collapsed while a speculative cut is pending.
+	 * @return number of collapsed edges
+	 */
+	int coarsen(double minEdgeLength, double margin, U32 maxCollapses);
+
+	//refines the cells along the swept quads before every cut when positive
+	double getRefineEdgeLength() const {return m_refineEdgeLength;}
+	void setRefineEdgeLength(double len) { m_refineEdgeLength = len;}
+
+	/*!
+	 * repairs the cells with a quality below minQuality. The cells are found in parallel and every
+	 * one is repaired by collapsing its shortest edge that keeps the surface, boundary nodes are
+	 * only merged along a flat patch of the surface. A sliver which can not be repaired is removed
+	 * only when its volume is below minVolume, two of its faces are on the surface and its face
+	 * neighbours stay connected without it. The cleanup does not change the parts of the mesh.
+	 * All removals are collected by a single garbage collection.
+	 * @return number of repaired and removed cells
+	 */
+	int cleanupSlivers(double minVolume, double minQuality);
+
+	//cleans up the cells below this quality after every cut when positive
+	double getSliverQuality() const {return m_sliverQuality;}
+	void setSliverQuality(double quality) { m_sliverQuality = quality;}
+
+	U32 countPendingCutEdges() const { return (U32)m_mapPendingCutEdges.size();}
+
 	//Access vertex neibors
 	vec3d vertexRestPosAt(U32 i) const;
 	int findClosestVertex(const vec3d& query, double& dist, vec3d& outP) const;
@@ -119,13 +346,22 @@ public:
 	//Access to subdivider
 	TetSubdivider* getSubD() const { return m_lpSubD;}
 
+	/*!
+	 * collects the parts relabelled since the last call. Only the parts touched by the cuts are
+	 * relabelled, the rest of the mesh is not visited.
+	 * @param vOutParts cells of every touched part
+	 * @return number of parts
+	 */
+	int collectCutParts(vector< vector<U32> >& vOutParts);
+
 	/*!
 	 * splits the mesh parts using the sweep surface.
-	 * @param vSweeptSurf
+	 * @param parts the parts to move, see collectCutParts
+	 * @param sweptquad
 	 * @param dist
 	 * @return
 	 */
-	bool splitParts(const vec3d sweptquad[4], double dist);
+	bool splitParts(const vector< vector<U32> >& parts, const vec3d sweptquad[4], double dist);
 
 	/*!
 	 * First finds all disjoint parts of the mesh and then produces new cuttablemesh nodes
@@ -137,11 +373,10 @@ public:
 	int convertDisjointPartsToMeshes(vector<CuttableMesh*>& vOutNewMeshes);
 
 	/*!
-	 * This is a convenient function to aid in transforming original volume meshes and placing them
-	 * in the right projection view. Later the transform is applied to all mesh nodes and then the
-	 * transform itself is reset.
+	 * maps all mesh nodes and their rest positions with the transformation matrix. Used to
+	 * bake the placement of a mesh into its nodes.
 	 */
-	void applyTransformToMeshThenResetTransform();
+	void applyTransform(const mat44f& mtx);
 
 	//splitting
 	bool getFlagSplitMeshAfterCut() const {return m_flagSplitMeshAfterCut;}
@@ -150,29 +385,161 @@ public:
 	bool getFlagDetectCutNodes() const {return m_flagDetectCutNodes;}
 	void setFlagDetectCutNodes(bool flag) { m_flagDetectCutNodes = flag;}
 
-	bool getFlagDrawSweepSurf() const { return m_flagDrawSweepSurf;}
-	void setFlagDrawSweepSurf(bool flag) { m_flagDrawSweepSurf = flag;}
+	/*!
+	 * snapping mode: mesh nodes within the region of influence of a cut edge become cut nodes
+	 * and are moved onto the swept surface instead of splitting their edges. Enabling it also
+	 * enables cut node detection.
+	 */
+	bool getFlagSnapCutNodes() const {return m_flagSnapCutNodes;}
+	void setFlagSnapCutNodes(bool flag);
+
+	//cut mode
+	CutMode getCutMode() const {return m_cutMode;}
+	void setCutMode(CutMode mode) { m_cutMode = mode;}
+
+	//region of influence of cut nodes as a fraction of the edge length, [0, MAX_CUT_NODE_ROI]
+	double getCutNodeROI() const {return m_cutNodeROI;}
+	void setCutNodeROI(double roi);
+
+	//number of cells added by the last cut and by all cuts so far
+	int getLastCutCellGrowth() const {return m_lastCutCellGrowth;}
+	int getTotalCutCellGrowth() const {return m_totalCutCellGrowth;}
+
+	//cut context and the swept surface of the last cut, for visualization
+	const std::map<U32, CutEdge>& cutEdges() const { return m_mapCutEdges;}
+	const std::map<U32, CutNode>& cutNodes() const { return m_mapCutNodes;}
+	const vector<vec3d>& sweptSurface() const { return m_quadstrips;}
+
+	/*!
+	 * journal recording the operations which change the mesh, not owned. NULL disables recording.
+	 * Only the outermost operation is recorded, the refinement and sliver cleanup of a cut are
+	 * repeated by its replay.
+	 */
+	CutJournal* getJournal() const { return m_lpJournal;}
+	void setJournal(CutJournal* lpJournal) { m_lpJournal = lpJournal;}
+
+
+protected:
+	/*!
+	 * records the outermost operation in the journal when it changes the mesh. The inputs are
+	 * written into the record by the operation, the record is appended when the scope ends.
+	 * Operations of type jrCheckpoint can not be replayed from their inputs, a checkpoint of the
+	 * mesh is written after them instead.
+	 */
+	class JournalScope {
+	public:
+		JournalScope(CuttableMesh* pmesh, CutJournal::RecordType type);
+		~JournalScope();
 
-	bool getFlagDrawAABB() const { return m_flagDrawAABB;}
-	void setFlagDrawAABB(bool flag) { m_flagDrawAABB = flag;}
+		bool isRecording() const { return m_isRecording;}
+		CutJournal::Record& record() { return m_record;}
 
+	private:
+		CuttableMesh* m_lpMesh;
+		U64 m_version;
+		bool m_isRecording;
+		CutJournal::Record m_record;
+	};
 
 protected:
 	void setup();
 
+	//splits the cut edges and subdivides the cut elements
+	int subdivideCutElements(const vector<U32>& vCutElements,
+							 const vector<U8>& vCutEdgeCodes,
+							 const vector<U8>& vCutNodeCodes);
+
+	//finds the pending cut edges after their indices are changed
+	void refreshPendingCutEdges();
+
+	//computes the cut codes of the cells incident to the pending cut edges and finds the
+	//completely cut ones
+	void classifyPendingCells(const std::set<U32>& setRemovedCells,
+							  std::map<U32, U8>& mapCellEdgeCodes,
+							  std::map<U32, U8>& mapCellNodeCodes,
+							  std::map<U32, vector<U32> >& mapEdgeCells,
+							  std::set<U32>& setReadyCells);
+
+	//reuses the cut context of a dry run or of the background task, computes it otherwise
+	int prepareCutContext(const vector<vec3d>& segments,
+						  const vector<vec3d>& quadstrips);
+
+	//subdivides the cut elements and separates the cut nodes of the current context
+	int applyCutContext(const vector<vec3d>& quadstrips);
+
+	//garbage collection, tests, part splitting, stats, AABB and render sync after the cuts
+	void finalizeCut(const vector<vec3d>& vSplitQuads);
+
+	//appends the quads of the strip which have cut edges, 4 vertices per quad
+	void collectSplitQuads(const vector<vec3d>& quadstrips, vector<vec3d>& vSplitQuads) const;
+
+	//computes the cut codes of all cells touched by the cut edges and cut nodes of the context
+	int computeCutCodes(CutContext& ctx) const;
+
+	//parameter of the zero crossing of the distance field over the segment s0 s1
+	static double findSDFCrossing(const SDFCutSurface& sdf, const vec3d& s0, const vec3d& s1,
+								  double d0, double d1);
+
+	//installs a computed context as the current cut context
+	int adoptCutContext(CutContext& ctx);
+
+	//waits for the background task and adopts its context if it belongs to the same inputs
+	bool adoptSpeculativeCut(const vector<vec3d>& segments,
+							 const vector<vec3d>& quadstrips);
+
+	//background task body: computes the latest requested context until no request is left
+	void runSpeculativeCut();
+
+	//cells of the mesh excluding the ones replaced by their sub-elements
+	U32 countLiveCells() const;
+
+	//records the cell growth of a cut
+	void recordCellGrowth(U32 ctCellsBefore);
+
+	//flags the nodes of the faces with a single incident cell. with markFlat the nodes whose
+	//boundary faces are coplanar are flagged 2 instead of 1
+	void computeBoundaryNodes(vector<U8>& vBoundary, bool markFlat = false) const;
+
+	//true if a cell has two faces on the surface at least and its face neighbours stay connected
+	//through the other cells around its nodes once the cell and the removed cells are gone
+	bool keepsNeighborsConnected(U32 idxCell, const std::set<U32>& setRemovedCells) const;
+
+	//longest edge of a cell and its squared length
+	U32 longestCellEdge(U32 idxCell, double& len2) const;
+
+	//records the bounding box of the cut edges and cut nodes of the current context
+	void recordCutRegion();
+
+	//true if the point is within margin of a recent cut region
+	bool isNearRecentCut(const vec3d& p, double margin) const;
+
+	//splits a cut edge with a single node at the cut point and bisects all of its cells
+	U32 bisectCutEdge(U32 idxEdge, const CutEdge& ce, std::set<U32>& setRemovedCells);
+
 	//TODO: Sync physics mesh after cut
 
 	//TODO: Sync vbo after synced physics mesh
 private:
-	VolMeshRender* m_lpRender;
 	TetSubdivider* m_lpSubD;
 	int m_ctCompletedCuts;
 	bool m_flagSplitMeshAfterCut;
 	bool m_flagDetectCutNodes;
+	bool m_flagSnapCutNodes;
+	CutMode m_cutMode;
+	double m_cutNodeROI;
+	int m_lastCutCellGrowth;
+	int m_totalCutCellGrowth;
+
+	//parts labelled below this are not touched by the cuts since the last split
+	U32 m_ctSplitPartLabels;
+
+	//adaptivity
+	double m_refineEdgeLength;
+	double m_sliverQuality;
+	vector<AABB> m_vRecentCutRegions;
+	U64 m_coarsenedVersion;
 
 	//sweep surfaces
-	bool m_flagDrawSweepSurf;
-	bool m_flagDrawAABB;
 	vector<vec3d> m_quadstrips;
 
 	//Cut Nodes
@@ -182,6 +549,35 @@ private:
 	//Cut Edges
 	std::map<U32, CutEdge > m_mapCutEdges;
 	typedef std::map<U32, CutEdge >::iterator CUTEDGEITER;
+
+	//Cut context: affected cells and their codes. The cut edges and nodes live in the maps above
+	bool m_isCutContextValid;
+	CutContext m_cutContext;
+
+	//Speculative cut: the latest swept geometry requested by the tool and its computed context.
+	//The requests and results are guarded by the mutex, the mesh is only read by the task.
+	tbb::task_group* m_lpSpeculativeTask;
+	tbb::mutex m_mtxSpeculativeCut;
+	tbb::atomic<bool> m_isSpeculativeCutCancelled;
+	bool m_isSpeculativeCutRunning;
+	bool m_hasSpeculativeCutRequest;
+	CutContext m_speculativeRequest;
+	CutContext m_speculativeResult;
+
+	//Progressive cut: cut edges and cut nodes of the partially cut elements
+	std::map<U32, CutEdge > m_mapPendingCutEdges;
+	std::map<U32, CutNode > m_mapPendingCutNodes;
+	U64 m_pendingCutEdgesVersion;
+
+	//edges near the swept quads of the frames. The cells replaced in a frame are collected when
+	//the progressive cut ends, so the edge indices stay valid between the frames
+	EdgeGrid m_progressiveEdgeGrid;
+	U32 m_ctProgressiveSubdivided;
+	U32 m_ctProgressiveCellsBefore;
+
+	//journal and the depth of the operations being recorded
+	CutJournal* m_lpJournal;
+	U32 m_journalDepth;
 };
 
 
@@ -0,0 +1,204 @@
+/*
+ * cuttablemeshset.cpp
+ */
+
+#include <algorithm>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
+#include "base/logger.h"
+#include "base/intersections.h"
+#include "elastic/cuttablemeshset.h"
+
+//version of a mesh which is not refitted yet
+#define MESH_VERSION_UNKNOWN ((U64)-1)
+
+namespace ps {
+namespace elastic {
+
+CuttableMeshSet::CuttableMeshSet() {
+	m_isDirty = false;
+}
+
+CuttableMeshSet::~CuttableMeshSet() {
+	clear();
+}
+
+void CuttableMeshSet::add(CuttableMesh* pmesh) {
+	if(pmesh == NULL || std::find(m_vMeshes.begin(), m_vMeshes.end(), pmesh) != m_vMeshes.end())
+		return;
+
+	m_vMeshes.push_back(pmesh);
+	m_vVersions.push_back(MESH_VERSION_UNKNOWN);
+	m_vMeshLo.push_back(vec3d(0.0));
+	m_vMeshHi.push_back(vec3d(0.0));
+	m_isDirty = true;
+}
+
+bool CuttableMeshSet::remove(CuttableMesh* pmesh) {
+	vector<CuttableMesh*>::iterator it = std::find(m_vMeshes.begin(), m_vMeshes.end(), pmesh);
+	if(it == m_vMeshes.end())
+		return false;
+
+	U32 i = (U32)(it - m_vMeshes.begin());
+	m_vMeshes.erase(it);
+	m_vVersions.erase(m_vVersions.begin() + i);
+	m_vMeshLo.erase(m_vMeshLo.begin() + i);
+	m_vMeshHi.erase(m_vMeshHi.begin() + i);
+	m_isDirty = true;
+	return true;
+}
+
+void CuttableMeshSet::clear() {
+	m_vMeshes.resize(0);
+	m_vVersions.resize(0);
+	m_vMeshLo.resize(0);
+	m_vMeshHi.resize(0);
+	m_tree.clear();
+	m_vLastCutMeshes.resize(0);
+	m_isDirty = false;
+}
+
+U32 CuttableMeshSet::update() {
+
+	//meshes changed since the last update
+	vector<U32> vChanged;
+	for(U32 i=0; i < m_vMeshes.size(); i++) {
+		if(m_vVersions[i] != m_vMeshes[i]->version())
+			vChanged.push_back(i);
+	}
+
+	if(vChanged.size() == 0 && !m_isDirty)
+		return 0;
+
+	//refit the tight bounds of the changed meshes in parallel
+	tbb::parallel_for(tbb::blocked_range<U32>(0, (U32)vChanged.size(), 1),
+		[this, &vChanged](const tbb::blocked_range<U32>& r) {
+		for(U32 i = r.begin(); i != r.end(); i++) {
+			U32 idxMesh = vChanged[i];
+			const CuttableMesh* pmesh = m_vMeshes[idxMesh];
+
+			//an empty mesh gets inverted bounds and is left out of the hierarchy
+			vec3d lo(1.0);
+			vec3d hi(-1.0);
+			if(pmesh->countNodes() > 0) {
+				lo = hi = pmesh->const_nodeAt(0).pos;
+				for(U32 j=1; j < pmesh->countNodes(); j++) {
+					const vec3d& p = pmesh->const_nodeAt(j).pos;
+					lo = vec3d::minP(lo, p);
+					hi = vec3d::maxP(hi, p);
+				}
+			}
+
+			m_vMeshLo[idxMesh] = lo;
+			m_vMeshHi[idxMesh] = hi;
+			m_vVersions[idxMesh] = pmesh->version();
+		}
+	});
+
+	//rebuild the hierarchy, there are few meshes compared to their cells
+	vector<U32> vBounded;
+	bool isFirstBox = true;
+	for(U32 i=0; i < m_vMeshes.size(); i++) {
+		if(m_vMeshLo[i].x > m_vMeshHi[i].x)
+			continue;
+		vBounded.push_back(i);
+
+		if(isFirstBox)
+			m_aabb = m_vMeshes[i]->aabb();
+		else
+			m_aabb = m_aabb.united(m_vMeshes[i]->aabb());
+		isFirstBox = false;
+	}
+
+	m_tree.build(m_vMeshLo, m_vMeshHi, vBounded, CUTTABLEMESHSET_LEAF_SIZE);
+
+	m_isDirty = false;
+	return (U32)vChanged.size();
+}
+
+U32 CuttableMeshSet::query(const vec3d& lo, const vec3d& hi, vector<U32>& vOutMeshes) const {
+	return m_tree.query(lo, hi, vOutMeshes);
+}
+
+int CuttableMeshSet::cut(const vector<vec3d>& segments, const vector<vec3d>& quadstrips, bool modifyMesh) {
+	m_vLastCutMeshes.resize(0);
+	if(segments.size() < 2)
+		return CUT_ERR_INVALID_INPUT_ARG;
+	if(quadstrips.size() < 4 || (quadstrips.size() % 2 != 0))
+		return CUT_ERR_INVALID_INPUT_ARG;
+
+	update();
+
+	//broadphase: the meshes overlapping the swept surface
+	vec3d lo = quadstrips[0];
+	vec3d hi = quadstrips[0];
+	for(U32 i=1; i < quadstrips.size(); i++) {
+		lo = vec3d::minP(lo, quadstrips[i]);
+		hi = vec3d::maxP(hi, quadstrips[i]);
+	}
+
+	vector<U32> vTargets;
+	if(query(lo - vec3d(EPSILON), hi + vec3d(EPSILON), vTargets) == 0)
+		return CUT_ERR_NO_INTERSECTION;
+
+	return cutMeshes(vTargets, [&segments, &quadstrips, modifyMesh](CuttableMesh* pmesh) {
+		return pmesh->cut(segments, quadstrips, modifyMesh);
+	});
+}
+
+int CuttableMeshSet::cut(const SDFCutSurface& sdf, bool modifyMesh) {
+	m_vLastCutMeshes.resize(0);
+	update();
+
+	//all meshes with nodes
+	vector<U32> vTargets;
+	for(U32 i=0; i < m_vMeshes.size(); i++) {
+		if(m_vMeshLo[i].x <= m_vMeshHi[i].x)
+			vTargets.push_back(i);
+	}
+	if(vTargets.size() == 0)
+		return CUT_ERR_NO_INTERSECTION;
+
+	return cutMeshes(vTargets, [&sdf, modifyMesh](CuttableMesh* pmesh) {
+		return pmesh->cut(sdf, modifyMesh);
+	});
+}
+
+int CuttableMeshSet::cutMeshes(const vector<U32>& vTargets, std::function<int(CuttableMesh*)> fCut) {
+
+	//the renderers are synced on this thread after all cuts are done
+	for(U32 i=0; i < vTargets.size(); i++)
+		m_vMeshes[vTargets[i]]->setFlagDeferMeshChanged(true);
+
+	vector<int> vResults(vTargets.size(), CUT_ERR_NO_INTERSECTION);
+	tbb::parallel_for(tbb::blocked_range<U32>(0, (U32)vTargets.size(), 1),
+		[this, &vTargets, &vResults, &fCut](const tbb::blocked_range<U32>& r) {
+		for(U32 i = r.begin(); i != r.end(); i++)
+			vResults[i] = fCut(m_vMeshes[vTargets[i]]);
+	});
+
+	for(U32 i=0; i < vTargets.size(); i++)
+		m_vMeshes[vTargets[i]]->setFlagDeferMeshChanged(false);
+
+	//sum up
+	int total = 0;
+	int err = CUT_ERR_NO_INTERSECTION;
+	for(U32 i=0; i < vTargets.size(); i++) {
+		if(vResults[i] > 0) {
+			total += vResults[i];
+			m_vLastCutMeshes.push_back(vTargets[i]);
+		}
+		else if(vResults[i] < 0 && vResults[i] != CUT_ERR_NO_INTERSECTION)
+			err = vResults[i];
+	}
+
+    vloginfo("Cut %u of %u meshes. broadphase candidates: %u, result: %d",
+    		 (U32)m_vLastCutMeshes.size(), count(), (U32)vTargets.size(), total);
+
+	if(m_vLastCutMeshes.size() == 0)
+		return err;
+	return total;
+}
+
+} /* namespace elastic */
+} /* namespace ps */
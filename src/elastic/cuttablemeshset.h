@@ -0,0 +1,95 @@
+/*
+ * cuttablemeshset.h
+ */
+
+#ifndef CUTTABLEMESHSET_H_
+#define CUTTABLEMESHSET_H_
+
+#include <functional>
+#include <vector>
+#include "base/vec.h"
+#include "base/aabb.h"
+#include "elastic/cuttablemesh.h"
+#include "elastic/aabbtree.h"
+
+using namespace std;
+using namespace ps::base;
+
+namespace ps {
+namespace elastic {
+
+//max number of meshes stored in a leaf node
+#define CUTTABLEMESHSET_LEAF_SIZE 1
+
+/*!
+ * Synopsis: broadphase over a set of cuttable meshes, e.g. the pieces of a tissue after its
+ * disjoint parts are converted to separate meshes. Keeps a bounding volume hierarchy over the
+ * mesh bounds, sends a swept surface only to the meshes it overlaps and cuts those meshes
+ * concurrently. The meshes are not owned by the set.
+ */
+class CuttableMeshSet {
+public:
+	CuttableMeshSet();
+	virtual ~CuttableMeshSet();
+
+	//meshes
+	void add(CuttableMesh* pmesh);
+	bool remove(CuttableMesh* pmesh);
+	void clear();
+
+	U32 count() const { return (U32)m_vMeshes.size();}
+	CuttableMesh* meshAt(U32 i) const { return m_vMeshes[i];}
+
+	/*!
+	 * refits the bounds of the meshes changed since the last update and rebuilds the hierarchy.
+	 * @return number of refitted meshes
+	 */
+	U32 update();
+
+	/*!
+	 * collects the meshes whose bounds overlap the box [lo, hi]. Call update after the meshes change.
+	 * @return number of meshes found
+	 */
+	U32 query(const vec3d& lo, const vec3d& hi, vector<U32>& vOutMeshes) const;
+
+	/*!
+	 * cuts all meshes overlapping the swept surface. Every mesh is cut by its own task, the mesh
+	 * changed notifications are held back during the cut and sent from the calling thread.
+	 * @return total result of the cut meshes or a CUT_ERR code if no mesh is cut
+	 */
+	int cut(const vector<vec3d>& segments, const vector<vec3d>& quadstrips, bool modifyMesh);
+
+	/*!
+	 * cuts all meshes along the zero set of a signed distance function. The field is not bounded
+	 * so there is no broadphase, the meshes are cut concurrently the same way.
+	 * @return total result of the cut meshes or a CUT_ERR code if no mesh is cut
+	 */
+	int cut(const SDFCutSurface& sdf, bool modifyMesh);
+
+	//meshes cut by the last call to cut
+	const vector<U32>& lastCutMeshes() const { return m_vLastCutMeshes;}
+
+	//union of the mesh boxes as reported by the meshes. valid after update
+	AABB aabb() const { return m_aabb;}
+
+protected:
+	//cuts the target meshes concurrently and collects the results
+	int cutMeshes(const vector<U32>& vTargets, std::function<int(CuttableMesh*)> fCut);
+
+private:
+	vector<CuttableMesh*> m_vMeshes;
+	vector<U64> m_vVersions;
+	vector<vec3d> m_vMeshLo;
+	vector<vec3d> m_vMeshHi;
+
+	AABBTree m_tree;
+	bool m_isDirty;
+
+	vector<U32> m_vLastCutMeshes;
+	AABB m_aabb;
+};
+
+} /* namespace elastic */
+} /* namespace ps */
+
+#endif /* CUTTABLEMESHSET_H_ */
@@ -0,0 +1,128 @@
+/*
+ * edgegrid.cpp
+ */
+
+#include <algorithm>
+#include "elastic/edgegrid.h"
+
+namespace ps {
+namespace elastic {
+
+EdgeGrid::EdgeGrid() {
+	clear();
+}
+
+EdgeGrid::~EdgeGrid() {
+	clear();
+}
+
+void EdgeGrid::clear() {
+	m_vBuckets.resize(0);
+	m_lo = vec3d(0.0, 0.0, 0.0);
+	m_bucketSize = 1.0;
+	m_dims[0] = m_dims[1] = m_dims[2] = 0;
+	m_ctEdges = 0;
+}
+
+U32 EdgeGrid::build(const VolMesh* pmesh) {
+	clear();
+	if(pmesh == NULL || pmesh->countNodes() == 0 || pmesh->countEdges() == 0)
+		return 0;
+
+	//bounds of the nodes
+	vec3d lo = pmesh->const_nodeAt(0).pos;
+	vec3d hi = lo;
+	for(U32 i=1; i < pmesh->countNodes(); i++) {
+		lo = vec3d::minP(lo, pmesh->const_nodeAt(i).pos);
+		hi = vec3d::maxP(hi, pmesh->const_nodeAt(i).pos);
+	}
+
+	double sum = 0.0;
+	for(U32 i=0; i < pmesh->countEdges(); i++) {
+		const EDGE& e = pmesh->const_edgeAt(i);
+		sum += vec3d::distance(pmesh->const_nodeAt(e.from).pos, pmesh->const_nodeAt(e.to).pos);
+	}
+
+	//buckets as large as the average edge, larger for big meshes
+	m_lo = lo;
+	m_bucketSize = MATHMAX(sum / (double)pmesh->countEdges(), EPSILON);
+	vec3d extent = hi - lo;
+	while(true) {
+		m_dims[0] = (U32)(extent.x / m_bucketSize) + 1;
+		m_dims[1] = (U32)(extent.y / m_bucketSize) + 1;
+		m_dims[2] = (U32)(extent.z / m_bucketSize) + 1;
+		if((U64)m_dims[0] * m_dims[1] * m_dims[2] <= EDGEGRID_MAX_BUCKETS)
+			break;
+		m_bucketSize *= 2.0;
+	}
+
+	m_vBuckets.resize(m_dims[0] * m_dims[1] * m_dims[2]);
+	update(pmesh);
+	return m_ctEdges;
+}
+
+U32 EdgeGrid::update(const VolMesh* pmesh) {
+	if(m_vBuckets.size() == 0)
+		return 0;
+
+	U32 ctAdded = 0;
+	for(U32 i = m_ctEdges; i < pmesh->countEdges(); i++) {
+		insertEdge(pmesh, i);
+		ctAdded++;
+	}
+	m_ctEdges = pmesh->countEdges();
+	return ctAdded;
+}
+
+U32 EdgeGrid::query(const vec3d& lo, const vec3d& hi, vector<U32>& vOutEdges) const {
+	vOutEdges.resize(0);
+	if(m_vBuckets.size() == 0)
+		return 0;
+
+	U32 first[3];
+	U32 last[3];
+	bucketRange(lo, hi, first, last);
+	for(U32 z = first[2]; z <= last[2]; z++) {
+		for(U32 y = first[1]; y <= last[1]; y++) {
+			for(U32 x = first[0]; x <= last[0]; x++) {
+				const vector<U32>& bucket = m_vBuckets[(z * m_dims[1] + y) * m_dims[0] + x];
+				vOutEdges.insert(vOutEdges.end(), bucket.begin(), bucket.end());
+			}
+		}
+	}
+
+	//edges spanning several buckets are found more than once
+	std::sort(vOutEdges.begin(), vOutEdges.end());
+	vOutEdges.erase(std::unique(vOutEdges.begin(), vOutEdges.end()), vOutEdges.end());
+	return (U32)vOutEdges.size();
+}
+
+void EdgeGrid::insertEdge(const VolMesh* pmesh, U32 idxEdge) {
+	const EDGE& e = pmesh->const_edgeAt(idxEdge);
+	const vec3d& p0 = pmesh->const_nodeAt(e.from).pos;
+	const vec3d& p1 = pmesh->const_nodeAt(e.to).pos;
+
+	U32 first[3];
+	U32 last[3];
+	bucketRange(vec3d::minP(p0, p1), vec3d::maxP(p0, p1), first, last);
+	for(U32 z = first[2]; z <= last[2]; z++) {
+		for(U32 y = first[1]; y <= last[1]; y++) {
+			for(U32 x = first[0]; x <= last[0]; x++)
+				m_vBuckets[(z * m_dims[1] + y) * m_dims[0] + x].push_back(idxEdge);
+		}
+	}
+}
+
+void EdgeGrid::bucketRange(const vec3d& lo, const vec3d& hi, U32 first[3], U32 last[3]) const {
+	const double a[3] = {lo.x - m_lo.x, lo.y - m_lo.y, lo.z - m_lo.z};
+	const double b[3] = {hi.x - m_lo.x, hi.y - m_lo.y, hi.z - m_lo.z};
+	for(int i=0; i < 3; i++) {
+		double f = MATHMIN(MATHMAX(a[i] / m_bucketSize, 0.0), (double)(m_dims[i] - 1));
+		double l = MATHMIN(MATHMAX(b[i] / m_bucketSize, 0.0), (double)(m_dims[i] - 1));
+		first[i] = (U32)f;
+		last[i] = (U32)l;
+	}
+}
+
+} /* namespace elastic */
+} /* namespace ps */
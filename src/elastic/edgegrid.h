@@ -0,0 +1,73 @@
+/*
+ * edgegrid.h
+ */
+
+#ifndef EDGEGRID_H_
+#define EDGEGRID_H_
+
+#include <vector>
+#include "base/vec.h"
+#include "elastic/volmesh.h"
+
+using namespace std;
+using namespace ps::base;
+
+namespace ps {
+namespace elastic {
+
+//max number of buckets in the grid, the bucket size grows to stay below it
+#define EDGEGRID_MAX_BUCKETS (1 << 18)
+
+/*!
+ * Synopsis: uniform grid over the edges of a mesh. Every edge is stored in the buckets its bounding
+ * box overlaps, so the edges near a swept quad are found without scanning all edges of the mesh.
+ * Edges are only appended: the grid stays valid while the mesh grows and has to be rebuilt once a
+ * garbage collection shifts the edge indices or the nodes move.
+ */
+class EdgeGrid {
+public:
+	EdgeGrid();
+	virtual ~EdgeGrid();
+
+	void clear();
+
+	/*!
+	 * builds the grid over all edges of the mesh. The buckets are as large as the average edge.
+	 * @return number of edges in the grid
+	 */
+	U32 build(const VolMesh* pmesh);
+
+	/*!
+	 * adds the edges appended to the mesh since the last build or update
+	 * @return number of added edges
+	 */
+	U32 update(const VolMesh* pmesh);
+
+	/*!
+	 * collects the edges stored in the buckets overlapping the box [lo, hi]. The edges are sorted
+	 * and reported once.
+	 * @return number of edges found
+	 */
+	U32 query(const vec3d& lo, const vec3d& hi, vector<U32>& vOutEdges) const;
+
+	U32 countEdges() const { return m_ctEdges;}
+	U32 countBuckets() const { return (U32)m_vBuckets.size();}
+
+protected:
+	void insertEdge(const VolMesh* pmesh, U32 idxEdge);
+
+	//range of buckets overlapping a box, clamped to the grid
+	void bucketRange(const vec3d& lo, const vec3d& hi, U32 first[3], U32 last[3]) const;
+
+private:
+	vec3d m_lo;
+	double m_bucketSize;
+	U32 m_dims[3];
+	vector< vector<U32> > m_vBuckets;
+	U32 m_ctEdges;
+};
+
+} /* namespace elastic */
+} /* namespace ps */
+
+#endif /* EDGEGRID_H_ */
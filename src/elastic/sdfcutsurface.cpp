@@ -0,0 +1,91 @@
+/*
+ * sdfcutsurface.cpp
+ */
+
+#include <emmintrin.h>
+#include "elastic/sdfcutsurface.h"
+
+namespace ps {
+namespace elastic {
+
+///////////////////////////////////////////////////////////////////////////
+void SDFCutSurface::distances(const double* px, const double* py, const double* pz,
+							  U32 count, double* outDist) const {
+	for(U32 i = 0; i < count; i++)
+		outDist[i] = distance(vec3d(px[i], py[i], pz[i]));
+}
+
+vec3d SDFCutSurface::gradient(const vec3d& p) const {
+	const double h = SDF_GRADIENT_STEP;
+	vec3d g(distance(vec3d(p.x + h, p.y, p.z)) - distance(vec3d(p.x - h, p.y, p.z)),
+			distance(vec3d(p.x, p.y + h, p.z)) - distance(vec3d(p.x, p.y - h, p.z)),
+			distance(vec3d(p.x, p.y, p.z + h)) - distance(vec3d(p.x, p.y, p.z - h)));
+	return g * (0.5 / h);
+}
+
+///////////////////////////////////////////////////////////////////////////
+SDFPlane::SDFPlane(const vec3d& point, const vec3d& normal) {
+	m_normal = normal.normalized();
+	m_offset = -vec3d::dot(m_normal, point);
+}
+
+double SDFPlane::distance(const vec3d& p) const {
+	return vec3d::dot(m_normal, p) + m_offset;
+}
+
+void SDFPlane::distances(const double* px, const double* py, const double* pz,
+						 U32 count, double* outDist) const {
+	const __m128d nx = _mm_set1_pd(m_normal.x);
+	const __m128d ny = _mm_set1_pd(m_normal.y);
+	const __m128d nz = _mm_set1_pd(m_normal.z);
+	const __m128d d = _mm_set1_pd(m_offset);
+
+	U32 i = 0;
+	for(; i + 2 <= count; i += 2) {
+		__m128d r = _mm_add_pd(_mm_mul_pd(nx, _mm_loadu_pd(px + i)), d);
+		r = _mm_add_pd(r, _mm_mul_pd(ny, _mm_loadu_pd(py + i)));
+		r = _mm_add_pd(r, _mm_mul_pd(nz, _mm_loadu_pd(pz + i)));
+		_mm_storeu_pd(outDist + i, r);
+	}
+
+	for(; i < count; i++)
+		outDist[i] = m_normal.x * px[i] + m_normal.y * py[i] + m_normal.z * pz[i] + m_offset;
+}
+
+///////////////////////////////////////////////////////////////////////////
+SDFSphere::SDFSphere(const vec3d& center, double radius):m_center(center), m_radius(radius) {
+}
+
+double SDFSphere::distance(const vec3d& p) const {
+	return vec3d::distance(p, m_center) - m_radius;
+}
+
+void SDFSphere::distances(const double* px, const double* py, const double* pz,
+						  U32 count, double* outDist) const {
+	const __m128d cx = _mm_set1_pd(m_center.x);
+	const __m128d cy = _mm_set1_pd(m_center.y);
+	const __m128d cz = _mm_set1_pd(m_center.z);
+	const __m128d r = _mm_set1_pd(m_radius);
+
+	U32 i = 0;
+	for(; i + 2 <= count; i += 2) {
+		__m128d dx = _mm_sub_pd(_mm_loadu_pd(px + i), cx);
+		__m128d dy = _mm_sub_pd(_mm_loadu_pd(py + i), cy);
+		__m128d dz = _mm_sub_pd(_mm_loadu_pd(pz + i), cz);
+		__m128d len2 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz));
+		_mm_storeu_pd(outDist + i, _mm_sub_pd(_mm_sqrt_pd(len2), r));
+	}
+
+	for(; i < count; i++)
+		outDist[i] = distance(vec3d(px[i], py[i], pz[i]));
+}
+
+vec3d SDFSphere::gradient(const vec3d& p) const {
+	vec3d d = p - m_center;
+	if(d.length2() == 0.0)
+		return vec3d(0.0, 0.0, 1.0);
+	return d.normalized();
+}
+
+} /* namespace elastic */
+} /* namespace ps */
@@ -0,0 +1,95 @@
+/*
+ * sdfcutsurface.h
+ */
+
+#ifndef SDFCUTSURFACE_H_
+#define SDFCUTSURFACE_H_
+
+#include <functional>
+#include "base/vec.h"
+
+using namespace ps::base;
+
+namespace ps {
+namespace elastic {
+
+//step for the central difference gradient
+#define SDF_GRADIENT_STEP 1e-6
+
+/*!
+ * Synopsis: signed distance function of an implicit cut surface. The surface is the zero set,
+ * nodes with negative values are behind it. All methods must be thread safe since the mesh
+ * nodes are classified in parallel.
+ */
+class SDFCutSurface {
+public:
+	SDFCutSurface() {}
+	virtual ~SDFCutSurface() {}
+
+	//signed distance at a point
+	virtual double distance(const vec3d& p) const = 0;
+
+	/*!
+	 * signed distances of count points given in structure of arrays layout.
+	 * Analytic surfaces override this with a vectorized version.
+	 */
+	virtual void distances(const double* px, const double* py, const double* pz,
+						   U32 count, double* outDist) const;
+
+	//gradient of the distance field, central differences unless overridden
+	virtual vec3d gradient(const vec3d& p) const;
+};
+
+/*!
+ * Plane through a point with the given normal
+ */
+class SDFPlane : public SDFCutSurface {
+public:
+	SDFPlane(const vec3d& point, const vec3d& normal);
+
+	double distance(const vec3d& p) const;
+	void distances(const double* px, const double* py, const double* pz,
+				   U32 count, double* outDist) const;
+	vec3d gradient(const vec3d& p) const { return m_normal;}
+
+private:
+	vec3d m_normal;
+	double m_offset;
+};
+
+/*!
+ * Sphere, positive outside
+ */
+class SDFSphere : public SDFCutSurface {
+public:
+	SDFSphere(const vec3d& center, double radius);
+
+	double distance(const vec3d& p) const;
+	void distances(const double* px, const double* py, const double* pz,
+				   U32 count, double* outDist) const;
+	vec3d gradient(const vec3d& p) const;
+
+private:
+	vec3d m_center;
+	double m_radius;
+};
+
+/*!
+ * Wraps any callable signed distance function
+ */
+class SDFFunctor : public SDFCutSurface {
+public:
+	typedef std::function<double(const vec3d&)> DistanceFunc;
+
+	SDFFunctor(const DistanceFunc& f):m_func(f) {}
+
+	double distance(const vec3d& p) const { return m_func(p);}
+
+private:
+	DistanceFunc m_func;
+};
+
+} /* namespace elastic */
+} /* namespace ps */
+
+#endif /* SDFCUTSURFACE_H_ */
@@ -0,0 +1,65 @@
+/*
+ * sweptquadbvh.cpp
+ */
+
+#include "base/intersections.h"
+#include "elastic/sweptquadbvh.h"
+
+namespace ps {
+namespace elastic {
+
+SweptQuadBVH::SweptQuadBVH() {
+}
+
+SweptQuadBVH::SweptQuadBVH(const vector<vec3d>& quadstrips) {
+	build(quadstrips);
+}
+
+SweptQuadBVH::~SweptQuadBVH() {
+	m_tree.clear();
+}
+
+bool SweptQuadBVH::isQuadDegenerate(const vec3d sweptquad[4]) {
+	double area = (sweptquad[1] - sweptquad[0]).length2() * (sweptquad[2] - sweptquad[0]).length2();
+	if(area < EPSILON)
+		return true;
+	double l2 = (sweptquad[3] - sweptquad[2]).length2();
+	if(l2 < EPSILON)
+		return true;
+
+	return false;
+}
+
+U32 SweptQuadBVH::build(const vector<vec3d>& quadstrips) {
+	m_tree.clear();
+	if(quadstrips.size() < 4)
+		return 0;
+
+	//bounds of all quads, expanded so that edges touching a quad are not missed
+	U32 ctQuads = (quadstrips.size() - 2) / 2;
+	vector<vec3d> vQuadLo(ctQuads);
+	vector<vec3d> vQuadHi(ctQuads);
+	vector<U32> vQuads;
+	vQuads.reserve(ctQuads);
+
+	const vec3d expand(EPSILON, EPSILON, EPSILON);
+	for(U32 i = 0; i < ctQuads; i++) {
+		const vec3d* q = &quadstrips[i * 2];
+		if(isQuadDegenerate(q))
+			continue;
+
+		vQuadLo[i] = vec3d::minP(vec3d::minP(q[0], q[1]), vec3d::minP(q[2], q[3])) - expand;
+		vQuadHi[i] = vec3d::maxP(vec3d::maxP(q[0], q[1]), vec3d::maxP(q[2], q[3])) + expand;
+		vQuads.push_back(i);
+	}
+
+	return m_tree.build(vQuadLo, vQuadHi, vQuads, SWEPTQUADBVH_LEAF_SIZE);
+}
+
+U32 SweptQuadBVH::query(const vec3d& lo, const vec3d& hi, vector<U32>& vOutQuads) const {
+	//the quads are reported in strip order
+	return m_tree.query(lo, hi, vOutQuads);
+}
+
+} /* namespace elastic */
+} /* namespace ps */
@@ -0,0 +1,57 @@
+/*
+ * sweptquadbvh.h
+ */
+
+#ifndef SWEPTQUADBVH_H_
+#define SWEPTQUADBVH_H_
+
+#include <vector>
+#include "base/vec.h"
+#include "elastic/aabbtree.h"
+
+using namespace std;
+using namespace ps::base;
+
+namespace ps {
+namespace elastic {
+
+//max number of quads stored in a leaf node
+#define SWEPTQUADBVH_LEAF_SIZE 2
+
+/*!
+ * Synopsis: bounding volume hierarchy over the quads of a swept quad strip. Quad i is made of the
+ * strip vertices [2i, 2i + 3]. Lets the cut kernel test each mesh edge against the few quads
+ * it overlaps instead of scanning all edges once per quad.
+ */
+class SweptQuadBVH {
+public:
+	SweptQuadBVH();
+	SweptQuadBVH(const vector<vec3d>& quadstrips);
+	virtual ~SweptQuadBVH();
+
+	/*!
+	 * builds the hierarchy over all non-degenerate quads of the strip.
+	 * @return number of quads in the hierarchy
+	 */
+	U32 build(const vector<vec3d>& quadstrips);
+
+	/*!
+	 * collects the quads whose bounding boxes overlap the box [lo, hi]
+	 * @return number of quads found
+	 */
+	U32 query(const vec3d& lo, const vec3d& hi, vector<U32>& vOutQuads) const;
+
+	U32 countQuads() const { return m_tree.countItems();}
+	U32 countNodes() const { return m_tree.countNodes();}
+
+	//true if the quad is too thin to be intersected
+	static bool isQuadDegenerate(const vec3d sweptquad[4]);
+
+private:
+	AABBTree m_tree;
+};
+
+} /* namespace elastic */
+} /* namespace ps */
+
+#endif /* SWEPTQUADBVH_H_ */
@@ -7,6 +7,7 @@
 #include "TetSubdivider.h"
 #include "base/Logger.h"
 #include <set>
+#include <fstream>
 
 using namespace ps;
 using namespace std;
@@ -44,33 +45,41 @@ U32 g_elementTableCaseB[3][6][4] = {
 		{ {4, 10, 12, 0}, {0, 8, 12, 4}, {0, 8, 1, 4}, {3, 9, 13, 5}, {2, 5, 11, 3}, {3, 13, 5, 11}}
 };
 
+//generate all 64 x 16 configurations at compile time
+#define CUTCASE_1(c, i) TetSubdivider::ClassifyCutCase(c, (U8)((i) >> 4), (U8)((i) & 0x0F))
+#define CUTCASE_4(c, i) CUTCASE_1(c, i), CUTCASE_1(c, i + 1), CUTCASE_1(c, i + 2), CUTCASE_1(c, i + 3)
+#define CUTCASE_16(c, i) { CUTCASE_4(c, i), CUTCASE_4(c, i + 4), CUTCASE_4(c, i + 8), CUTCASE_4(c, i + 12) }
+#define CUTCASE_64(c, i) CUTCASE_16(c, i), CUTCASE_16(c, i + 16), CUTCASE_16(c, i + 32), CUTCASE_16(c, i + 48)
+#define CUTCASE_256(c, i) CUTCASE_64(c, i), CUTCASE_64(c, i + 64), CUTCASE_64(c, i + 128), CUTCASE_64(c, i + 192)
+#define CUTCASE_1024(c) CUTCASE_256(c, 0), CUTCASE_256(c, 256), CUTCASE_256(c, 512), CUTCASE_256(c, 768)
+
+const U8 g_cutCaseTable[2][CUTCODE_EDGE_CONFIGS][CUTCODE_NODE_CONFIGS] = {
+		//partial cuts
+		{ CUTCASE_1024(false) },
+
+		//complete cuts
+		{ CUTCASE_1024(true) }
+};
+
+#undef CUTCASE_1
+#undef CUTCASE_4
+#undef CUTCASE_16
+#undef CUTCASE_64
+#undef CUTCASE_256
+#undef CUTCASE_1024
+
+//the cut codes of the existing tables
+static_assert(TetSubdivider::ClassifyCutCase(true, 56, 0) == TetSubdivider::PackCutCase(TetSubdivider::cutA, 0), "case A entry 0");
+static_assert(TetSubdivider::ClassifyCutCase(true, 22, 0) == TetSubdivider::PackCutCase(TetSubdivider::cutA, 3), "case A entry 3");
+static_assert(TetSubdivider::ClassifyCutCase(true, 46, 0) == TetSubdivider::PackCutCase(TetSubdivider::cutB, 0), "case B entry 0");
+static_assert(TetSubdivider::ClassifyCutCase(true, 51, 0) == TetSubdivider::PackCutCase(TetSubdivider::cutB, 1), "case B entry 1");
+static_assert(TetSubdivider::ClassifyCutCase(true, 29, 0) == TetSubdivider::PackCutCase(TetSubdivider::cutB, 2), "case B entry 2");
+static_assert(TetSubdivider::ClassifyCutCase(true, 7, 0) == TetSubdivider::PackCutCase(TetSubdivider::cutUnknown, 0), "face loop is not a cut");
+
 }
 }
 
 TetSubdivider::TetSubdivider() {
-
-	//case A
-	m_mapCutEdgeCodeToTableEntry[56] = 0;
-	m_mapCutEdgeCodeToTableEntry[37] = 1;
-	m_mapCutEdgeCodeToTableEntry[11] = 2;
-	m_mapCutEdgeCodeToTableEntry[22] = 3;
-
-	//case B
-	m_mapCutEdgeCodeToTableEntry[46] = 0;
-	m_mapCutEdgeCodeToTableEntry[51] = 1;
-	m_mapCutEdgeCodeToTableEntry[29] = 2;
-
-	//map cutcase to alphabet
-	m_mapCutCaseToAlpha[cutA] = 'A';
-	m_mapCutCaseToAlpha[cutB] = 'B';
-	m_mapCutCaseToAlpha[cutC] = 'C';
-	m_mapCutCaseToAlpha[cutD] = 'D';
-	m_mapCutCaseToAlpha[cutE] = 'E';
-	m_mapCutCaseToAlpha[cutX] = 'X';
-	m_mapCutCaseToAlpha[cutY] = 'Y';
-	m_mapCutCaseToAlpha[cutZ] = 'Z';
-	m_mapCutCaseToAlpha[cutUnknown] = 'U';
-
 }
 
 TetSubdivider::~TetSubdivider() {
@@ -203,7 +212,10 @@ int TetSubdivider::generateCaseB(VolMesh* pmesh, U32 idxCell, U8 enteringface,
 }
 
 char TetSubdivider::toAlpha(CUTCASE c) {
-	return m_mapCutCaseToAlpha[c];
+	const char alphabet[] = {'A', 'B', 'C', 'D', 'E', 'X', 'Y', 'Z', 'N', 'U'};
+	if(c < cutA || c > cutUnknown)
+		return 'U';
+	return alphabet[c];
 }
 
 TetSubdivider::CUTCASE TetSubdivider::IdentifyCutCase(bool isCutComplete, U8 cutEdgeCode, U8 cutNodeCode) {
@@ -214,64 +226,117 @@ TetSubdivider::CUTCASE TetSubdivider::IdentifyCutCase(bool isCutComplete, U8 cut
 
 TetSubdivider::CUTCASE TetSubdivider::IdentifyCutCase(bool isCutComplete, U8 cutEdgeCode,
 													  U8 cutNodeCode, U8& countCutEdges, U8& countCutNodes) {
-	countCutEdges = 0;
-
-	//6 edges per tet
-	for(int i=0; i < 6; i++)
-		countCutEdges += ((cutEdgeCode & (1 << i)) != 0);
-
-	countCutNodes = 0;
-	//4 nodes per tet
-	for(int i=0; i < 4; i++)
-		countCutNodes += ((cutNodeCode & (1 << i)) != 0);
-
-	if(countCutNodes == 0) {
-		if(isCutComplete) {
-			if(countCutEdges == 3)
-				return cutA;
-			else if(countCutEdges == 4)
-				return cutB;
-		}
-		else {
-			if(countCutEdges == 1)
-				return cutC;
-			else if(countCutEdges == 2)
-				return cutD;
-			else if(countCutEdges == 3)
-				return cutE;
+	countCutEdges = CountBits(cutEdgeCode & 0x3F);
+	countCutNodes = CountBits(cutNodeCode & 0x0F);
+
+	U8 entry = 0;
+	return LookupCutCase(isCutComplete, cutEdgeCode, cutNodeCode, entry);
+}
+
+TetSubdivider::CUTCASE TetSubdivider::LookupCutCase(bool isCutComplete, U8 cutEdgeCode,
+													U8 cutNodeCode, U8& entry) {
+	if(cutEdgeCode >= CUTCODE_EDGE_CONFIGS || cutNodeCode >= CUTCODE_NODE_CONFIGS) {
+		entry = 0;
+		return cutUnknown;
+	}
+
+	U8 packed = g_cutCaseTable[isCutComplete ? 1 : 0][cutEdgeCode][cutNodeCode];
+	entry = packed & 0x0F;
+	return (CUTCASE)(packed >> 4);
+}
+
+bool TetSubdivider::writeLookUpTable(const char* lpFilePath) {
+
+	//rebuild the codes from each entry and compare against the table
+	int ctErrors = 0;
+	for(int complete = 0; complete < 2; complete++) {
+		for(U8 edgeCode = 0; edgeCode < CUTCODE_EDGE_CONFIGS; edgeCode++) {
+			for(U8 nodeCode = 0; nodeCode < CUTCODE_NODE_CONFIGS; nodeCode++) {
+				U8 entry = 0;
+				CUTCASE cutcase = LookupCutCase(complete != 0, edgeCode, nodeCode, entry);
+
+				int expectedEdgeCode = edgeCode;
+				int expectedNodeCode = nodeCode;
+				switch(cutcase) {
+				case cutA:
+					expectedEdgeCode = NodeEdgesMask(entry);
+					expectedNodeCode = 0;
+					break;
+				case cutB: {
+					const U8 intact[3] = {17, 12, 34};
+					expectedEdgeCode = (entry < 3) ? (~intact[entry] & 63) : -1;
+					expectedNodeCode = 0;
+				}
+				break;
+				case cutX:
+					expectedEdgeCode = NodeEdgesMask(entry & 3) & ~NodeEdgesMask(entry >> 2);
+					expectedNodeCode = 1 << (entry >> 2);
+					break;
+				case cutY:
+					expectedEdgeCode = 1 << entry;
+					expectedNodeCode = ~EdgeNodesMask(entry) & 15;
+					break;
+				case cutZ:
+					expectedEdgeCode = 0;
+					expectedNodeCode = ~(1 << entry) & 15;
+					break;
+				default:
+					break;
+				}
+
+				if(expectedEdgeCode != edgeCode || expectedNodeCode != nodeCode) {
+					vlogerror("Invalid cut table entry. complete = %d, cutEdgeCode = %u, cutNodeCode = %u, case %c:%u",
+							  complete, edgeCode, nodeCode, toAlpha(cutcase), entry);
+					ctErrors++;
+				}
+			}
 		}
 	}
-	else {
-		if(countCutEdges == 2 && countCutNodes == 1)
-			return cutX;
-		else if(countCutEdges == 1 && countCutNodes == 2)
-			return cutY;
-		else if(countCutEdges == 0 && countCutNodes == 3)
-			return cutZ;
+
+	if(lpFilePath == NULL)
+		return (ctErrors == 0);
+
+	ofstream ofs(lpFilePath, ios::out);
+	if(!ofs.is_open()) {
+		vlogerror("Unable to open file for writing: %s", lpFilePath);
+		return false;
+	}
+
+	ofs << "#complete, cutEdgeCode, cutNodeCode, case, entry" << endl;
+	for(int complete = 0; complete < 2; complete++) {
+		for(U8 edgeCode = 0; edgeCode < CUTCODE_EDGE_CONFIGS; edgeCode++) {
+			for(U8 nodeCode = 0; nodeCode < CUTCODE_NODE_CONFIGS; nodeCode++) {
+				U8 entry = 0;
+				CUTCASE cutcase = LookupCutCase(complete != 0, edgeCode, nodeCode, entry);
+				ofs << complete << ", " << (int)edgeCode << ", " << (int)nodeCode << ", "
+					<< toAlpha(cutcase) << ", " << (int)entry << endl;
+			}
+		}
 	}
+	ofs.close();
 
-	return cutUnknown;
+	return (ctErrors == 0);
 }
 
 int TetSubdivider::subdivide(VolMesh* pmesh, U32 idxCell,
 							 U8 cutEdgeCode, U8 cutNodeCode,
 							 U32 midNodes[12]) {
 	//Here an element is subdivided to 4 sub elements depending on the codes
-	U8 ctCutEdges = 0;
-	U8 ctCutNodes = 0;
+	U8 ctCutEdges = CountBits(cutEdgeCode);
+	U8 entry = 0;
 
-	TetSubdivider::CUTCASE cutcase = IdentifyCutCase(true, cutEdgeCode, cutNodeCode, ctCutEdges, ctCutNodes);
-	if(cutcase > cutB) {
-        vlogerror("This case is not handled yet! cutEdgeCode = %u, ctCutEdges = %u, ctCutNodes = %u",
-					 cutEdgeCode, ctCutEdges, ctCutNodes);
+	TetSubdivider::CUTCASE cutcase = LookupCutCase(true, cutEdgeCode, cutNodeCode, entry);
+	if(cutcase == cutNone || cutcase == cutZ)
+		return 0;
+	else if(cutcase != cutA && cutcase != cutB && cutcase != cutX && cutcase != cutY) {
+        vlogerror("This case is not handled! cutEdgeCode = %u, cutNodeCode = %u",
+					 cutEdgeCode, cutNodeCode);
 		return 0;
 	}
 
 	//report
 	printf("Cell: %u, Cut type %c:%d, cutEdgeCode: %u, cutNodeCode: %u\n",
-			idxCell, m_mapCutCaseToAlpha[cutcase],
-			m_mapCutEdgeCodeToTableEntry[cutEdgeCode],
-			cutEdgeCode, cutNodeCode);
+			idxCell, toAlpha(cutcase), entry, cutEdgeCode, cutNodeCode);
 
 
 	//fill the array of virtual nodes
@@ -347,10 +412,6 @@ int TetSubdivider::subdivide(VolMesh* pmesh, U32 idxCell,
 		//Remove the original element
 		pmesh->schedule_remove_cell(idxCell);
 
-		//find the local table entry to handle this case A
-		int entry = m_mapCutEdgeCodeToTableEntry[cutEdgeCode];
-
-
 		//generate 4 new tets
 		for(int e = 0; e < 4; e++) {
 			U32 n[4];
@@ -368,9 +429,6 @@ int TetSubdivider::subdivide(VolMesh* pmesh, U32 idxCell,
 		//Remove the original element
 		pmesh->schedule_remove_cell(idxCell);
 
-		//find the local table entry to handle this case B
-		int entry = m_mapCutEdgeCodeToTableEntry[cutEdgeCode];
-
 		//generate 6 new tets
 		for(int e = 0; e < 6; e++) {
 
@@ -384,25 +442,183 @@ int TetSubdivider::subdivide(VolMesh* pmesh, U32 idxCell,
 		}
 	}
 
-	//Case X: 2 cut edges and 1 cut node
-//	else if(ctCutEdges == 2 && ctCutNodes == 1) {
-//
-//	}
-//	case Y
-//	else if(ctCutEdges == 1 && ctCutNodes == 2) {
-//
-//	}
-//	case Z
-//	else if(ctCutEdges == 0 && ctCutNodes == 3) {
-//
-//	}
+	//Case X: 2 cut edges and 1 cut node. The cut separates the shared node w
+	//of the cut edges from the cut node v and the remaining nodes a and b
+	else if(cutcase == cutX) {
+		pmesh->schedule_remove_cell(idxCell);
+
+		int v = entry >> 2;
+		int w = entry & 3;
+		int ab[2];
+		for(int i = 0, j = 0; i < 4; i++) {
+			if(i != v && i != w)
+				ab[j++] = i;
+		}
+		int a = ab[0];
+		int b = ab[1];
+
+		//1 tet on the side of w and the pyramid (v, a, b, m_bw, m_aw) split into 2 tets
+		const int elements[3][4] = { {v, w, MidNodeNear(w, a), MidNodeNear(w, b)},
+									 {v, a, b, MidNodeNear(b, w)},
+									 {v, a, MidNodeNear(b, w), MidNodeNear(a, w)} };
+
+		for(int e = 0; e < 3; e++) {
+			U32 n[4];
+			for(int i = 0; i < 4; i++)
+				n[i] = vnodes[ elements[e][i] ];
+
+			if(!pmesh->insert_cell(n)) {
+                vlogerror("Failed to add element# %d", e);
+			}
+		}
+	}
+	//Case Y: 1 cut edge and the 2 nodes opposite to it
+	else if(cutcase == cutY) {
+		pmesh->schedule_remove_cell(idxCell);
+
+		const int maskTetEdges[6][2] = { {1, 2}, {2, 3}, {3, 1}, {2, 0}, {0, 3}, {0, 1} };
+		int a = maskTetEdges[entry][0];
+		int b = maskTetEdges[entry][1];
+		int uv[2];
+		for(int i = 0, j = 0; i < 4; i++) {
+			if(i != a && i != b)
+				uv[j++] = i;
+		}
+
+		const int elements[2][4] = { {uv[0], uv[1], a, MidNodeNear(a, b)},
+									 {uv[0], uv[1], MidNodeNear(b, a), b} };
+
+		for(int e = 0; e < 2; e++) {
+			U32 n[4];
+			for(int i = 0; i < 4; i++)
+				n[i] = vnodes[ elements[e][i] ];
+
+			if(!pmesh->insert_cell(n)) {
+                vlogerror("Failed to add element# %d", e);
+			}
+		}
+	}
 
 
 	return 1;
 }
 
+U32 TetSubdivider::bisectEdge(VolMesh* pmesh, U32 idxEdge, double distance, std::set<U32>& setRemovedCells) {
+	const EDGE& e = pmesh->const_edgeAt(idxEdge);
+	U32 from = e.from;
+	U32 to = e.to;
+
+	const NODE& p0 = pmesh->const_nodeAt(from);
+	const NODE& p1 = pmesh->const_nodeAt(to);
+	NODE mid;
+	mid.pos = p0.pos + (p1.pos - p0.pos).normalized() * distance;
+	mid.restpos = p0.restpos + (p1.restpos - p0.restpos).normalized() * distance;
+	U32 idxMid = pmesh->insert_node(mid);
+
+	vector<U32> vcells;
+	pmesh->getEdgeIncidentCells(idxEdge, vcells);
+
+	for(U32 i=0; i < vcells.size(); i++) {
+		if(setRemovedCells.find(vcells[i]) != setRemovedCells.end())
+			continue;
+
+		U32 n0[4];
+		U32 n1[4];
+		const CELL& cell = pmesh->const_cellAt(vcells[i]);
+		for(int j=0; j < COUNT_CELL_NODES; j++) {
+			n0[j] = (cell.nodes[j] == to) ? idxMid : cell.nodes[j];
+			n1[j] = (cell.nodes[j] == from) ? idxMid : cell.nodes[j];
+		}
 
-void TetSubdivider::draw() {
+		pmesh->schedule_remove_cell(vcells[i]);
+		setRemovedCells.insert(vcells[i]);
+		pmesh->insert_cell(n0);
+		pmesh->insert_cell(n1);
+	}
 
+	return idxMid;
 }
 
+int TetSubdivider::collapseEdge(VolMesh* pmesh, U32 kept, U32 removed, double minQuality,
+								std::set<U32>& setRemovedCells) {
+	if(!pmesh->isNodeIndex(kept) || !pmesh->isNodeIndex(removed) || kept == removed)
+		return -1;
+
+	vector<U32> vcells;
+	pmesh->getNodeIncidentCells(removed, vcells);
+
+	//split the cells around the removed node into the ones sharing the edge and the rest
+	vector<U32> vShared;
+	vector<U32> vRemapped;
+	set<U32> setLinkNodes;
+	for(U32 i=0; i < vcells.size(); i++) {
+		if(setRemovedCells.find(vcells[i]) != setRemovedCells.end())
+			return -1;
+
+		const CELL& cell = pmesh->const_cellAt(vcells[i]);
+		if(pmesh->isNodeOfCell(kept, vcells[i])) {
+			vShared.push_back(vcells[i]);
+			for(int j=0; j < COUNT_CELL_NODES; j++) {
+				if(cell.nodes[j] != kept && cell.nodes[j] != removed)
+					setLinkNodes.insert(cell.nodes[j]);
+			}
+		}
+		else
+			vRemapped.push_back(vcells[i]);
+	}
+
+	if(vShared.size() == 0)
+		return -1;
+
+	//link condition: the common neighbors of the two nodes are exactly the nodes around the edge
+	vector<U32> vNborsKept;
+	vector<U32> vNborsRemoved;
+	pmesh->getNodeIncidentNodes(kept, vNborsKept);
+	pmesh->getNodeIncidentNodes(removed, vNborsRemoved);
+
+	set<U32> setNborsKept(vNborsKept.begin(), vNborsKept.end());
+	U32 ctCommon = 0;
+	for(U32 i=0; i < vNborsRemoved.size(); i++) {
+		if(vNborsRemoved[i] == kept || setNborsKept.find(vNborsRemoved[i]) == setNborsKept.end())
+			continue;
+		if(setLinkNodes.find(vNborsRemoved[i]) == setLinkNodes.end())
+			return -1;
+		ctCommon++;
+	}
+
+	if(ctCommon != setLinkNodes.size())
+		return -1;
+
+	//the reconnected cells must keep their orientation and quality
+	const vec3d pk = pmesh->const_nodeAt(kept).pos;
+	vector<U32> vNewNodes(vRemapped.size() * 4);
+	for(U32 i=0; i < vRemapped.size(); i++) {
+		const CELL& cell = pmesh->const_cellAt(vRemapped[i]);
+		vec3d v0[4];
+		vec3d v1[4];
+		for(int j=0; j < COUNT_CELL_NODES; j++) {
+			v0[j] = pmesh->const_nodeAt(cell.nodes[j]).pos;
+			v1[j] = (cell.nodes[j] == removed) ? pk : v0[j];
+			vNewNodes[i * 4 + j] = (cell.nodes[j] == removed) ? kept : cell.nodes[j];
+		}
+
+		double q0 = VolMesh::ComputeCellQuality(v0);
+		double q1 = VolMesh::ComputeCellQuality(v1);
+		if(q0 * q1 <= 0.0 || (fabs(q1) < minQuality && fabs(q1) < fabs(q0)))
+			return -1;
+	}
+
+	//apply
+	for(U32 i=0; i < vcells.size(); i++) {
+		pmesh->schedule_remove_cell(vcells[i]);
+		setRemovedCells.insert(vcells[i]);
+	}
+
+	for(U32 i=0; i < vRemapped.size(); i++) {
+		if(!pmesh->insert_cell(&vNewNodes[i * 4])) {
+            vlogerror("Failed to reconnect cell %u to node %u", vRemapped[i], kept);
+		}
+	}
+
+	return (int)vShared.size();
+}
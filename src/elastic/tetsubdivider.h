@@ -8,6 +8,7 @@
 #ifndef TETSUBDIVIDER_H_
 #define TETSUBDIVIDER_H_
 
+#include <set>
 #include "VolMesh.h"
 
 namespace ps {
@@ -19,22 +20,116 @@ extern U32 g_elementTableCaseA[4][16];
 //case B
 extern U32 g_elementTableCaseB[3][6][4];
 
+//dispatch table for all cut configurations: [isCutComplete][cutEdgeCode][cutNodeCode]
+//each entry packs the cut case in the high nibble and the table entry in the low nibble
+#define CUTCODE_EDGE_CONFIGS 64
+#define CUTCODE_NODE_CONFIGS 16
+extern const U8 g_cutCaseTable[2][CUTCODE_EDGE_CONFIGS][CUTCODE_NODE_CONFIGS];
 
 
-class TetSubdivider : public SGNode {
+class TetSubdivider {
 public:
-	enum CUTCASE {cutA, cutB, cutC, cutD, cutE, cutX, cutY, cutZ, cutUnknown};
+	enum CUTCASE {cutA, cutB, cutC, cutD, cutE, cutX, cutY, cutZ, cutNone, cutUnknown};
 
 
 public:
 	TetSubdivider();
 	virtual ~TetSubdivider();
 
-	void draw();
-	char toAlpha(CUTCASE c);
+	static char toAlpha(CUTCASE c);
 	static CUTCASE IdentifyCutCase(bool isCutComplete, U8 cutEdgeCode, U8 cutNodeCode);
 	static CUTCASE IdentifyCutCase(bool isCutComplete, U8 cutEdgeCode, U8 cutNodeCode, U8& countCutEdges, U8& countCutNodes);
 
+	/*!
+	 * \brief looks up the cut case and the entry in the per case element table
+	 */
+	static CUTCASE LookupCutCase(bool isCutComplete, U8 cutEdgeCode, U8 cutNodeCode, U8& entry);
+
+	//compile time classification of the cut codes. used to generate g_cutCaseTable
+	static constexpr int CountBits(U32 code) {
+		return (code == 0) ? 0 : (int)(code & 1) + CountBits(code >> 1);
+	}
+
+	static constexpr int LowestBit(U32 code) {
+		return (code & 1) ? 0 : 1 + LowestBit(code >> 1);
+	}
+
+	//mask of the 3 edges incident to a node
+	static constexpr U8 NodeEdgesMask(int node) {
+		return (node == 0) ? 56 : (node == 1) ? 37 : (node == 2) ? 11 : 22;
+	}
+
+	//mask of the 2 nodes of an edge
+	static constexpr U8 EdgeNodesMask(int edge) {
+		return (edge == 0) ? 6 : (edge == 1) ? 12 : (edge == 2) ? 10 : (edge == 3) ? 5 : (edge == 4) ? 9 : 3;
+	}
+
+	//the node whose incident edges include all of the cut edges
+	static constexpr int FindNodeCoveringEdges(U8 cutEdgeCode, int node = 0) {
+		return (node > 3) ? -1 :
+			   ((NodeEdgesMask(node) & cutEdgeCode) == cutEdgeCode) ? node :
+			   FindNodeCoveringEdges(cutEdgeCode, node + 1);
+	}
+
+	//local edge connecting two nodes
+	static constexpr int EdgeOfNodes(int a, int b, int edge = 0) {
+		return (edge > 5) ? -1 :
+			   (EdgeNodesMask(edge) == ((1 << a) | (1 << b))) ? edge :
+			   EdgeOfNodes(a, b, edge + 1);
+	}
+
+	//virtual node generated on edge (a, b) next to node a
+	static constexpr int MidNodeNear(int a, int b) {
+		return 4 + EdgeOfNodes(a, b) * 2 + ((a < b) ? 0 : 1);
+	}
+
+	static constexpr U8 PackCutCase(CUTCASE c, int entry) {
+		return (U8)(((int)c << 4) | (entry & 0x0F));
+	}
+
+	//case B entries are indexed by the pair of opposite edges that remain intact
+	static constexpr int CaseBEntry(U8 cutEdgeCode) {
+		return ((~cutEdgeCode & 63) == 17) ? 0 : ((~cutEdgeCode & 63) == 12) ? 1 : ((~cutEdgeCode & 63) == 34) ? 2 : -1;
+	}
+
+	static constexpr U8 ClassifyCutNoNodes(bool isCutComplete, U8 cutEdgeCode) {
+		return (cutEdgeCode == 0) ? PackCutCase(cutNone, 0) :
+			   !isCutComplete ?
+					((CountBits(cutEdgeCode) == 1) ? PackCutCase(cutC, LowestBit(cutEdgeCode)) :
+					 (CountBits(cutEdgeCode) == 2) ? PackCutCase(cutD, 0) :
+					 (CountBits(cutEdgeCode) == 3) ? PackCutCase(cutE, 0) : PackCutCase(cutUnknown, 0)) :
+			   (CountBits(cutEdgeCode) == 3 && FindNodeCoveringEdges(cutEdgeCode) >= 0) ?
+					PackCutCase(cutA, FindNodeCoveringEdges(cutEdgeCode)) :
+			   (CountBits(cutEdgeCode) == 4 && CaseBEntry(cutEdgeCode) >= 0) ?
+					PackCutCase(cutB, CaseBEntry(cutEdgeCode)) :
+			   PackCutCase(cutUnknown, 0);
+	}
+
+	/*!
+	 * X: 2 edges of the face opposite to the cut node, entry = (cut node << 2) | shared node
+	 * Y: 1 edge opposite to the 2 cut nodes, entry = cut edge
+	 * Z: 3 cut nodes, entry = the intact node
+	 * None: the cut only touches the element at 1 or 2 nodes
+	 */
+	static constexpr U8 ClassifyCutWithNodes(U8 cutEdgeCode, U8 cutNodeCode) {
+		return (CountBits(cutNodeCode) == 1 && CountBits(cutEdgeCode) == 2 &&
+				(cutEdgeCode & NodeEdgesMask(LowestBit(cutNodeCode))) == 0) ?
+					PackCutCase(cutX, (LowestBit(cutNodeCode) << 2) | FindNodeCoveringEdges(cutEdgeCode)) :
+			   (CountBits(cutNodeCode) == 2 && CountBits(cutEdgeCode) == 1 &&
+				(EdgeNodesMask(LowestBit(cutEdgeCode)) & cutNodeCode) == 0) ?
+					PackCutCase(cutY, LowestBit(cutEdgeCode)) :
+			   (CountBits(cutNodeCode) == 3 && cutEdgeCode == 0) ?
+					PackCutCase(cutZ, LowestBit(~cutNodeCode & 15)) :
+			   (CountBits(cutNodeCode) <= 2 && cutEdgeCode == 0) ?
+					PackCutCase(cutNone, 0) :
+			   PackCutCase(cutUnknown, 0);
+	}
+
+	static constexpr U8 ClassifyCutCase(bool isCutComplete, U8 cutEdgeCode, U8 cutNodeCode) {
+		return (cutNodeCode == 0) ? ClassifyCutNoNodes(isCutComplete, cutEdgeCode) :
+									ClassifyCutWithNodes(cutEdgeCode, cutNodeCode);
+	}
+
 	int subdivide(VolMesh* pmesh,
 				  U32 idxCell, U8 cutEdgeCode,
 				  U8 cutNodeCode, U32 midNodes[12]);
@@ -64,15 +159,28 @@ public:
 					  U8& cutNodeCode);
 
 
-	bool writeLookUpTable();
-protected:
-
-	//cut edge code
-	std::map<U8, int> m_mapCutEdgeCodeToTableEntry;
+	/*!
+	 * \brief bisects an edge with a new node at the distance from its start node. All cells sharing
+	 * the edge are split in two so the mesh stays conforming. Cells in setRemovedCells are skipped and
+	 * the replaced cells are added to it.
+	 * @return index of the new node
+	 */
+	U32 bisectEdge(VolMesh* pmesh, U32 idxEdge, double distance, std::set<U32>& setRemovedCells);
 
-	//cut cases
-	std::map<TetSubdivider::CUTCASE, char> m_mapCutCaseToAlpha;
+	/*!
+	 * \brief collapses the edge between two nodes by merging the removed node into the kept one.
+	 * The cells sharing the edge are dropped and the other cells around the removed node are
+	 * reconnected to the kept node. The collapse is rejected if it breaks the link condition,
+	 * inverts a cell or leaves a cell with a quality below minQuality and below its current one.
+	 * @return number of dropped cells or -1 if the collapse is rejected
+	 */
+	int collapseEdge(VolMesh* pmesh, U32 kept, U32 removed, double minQuality, std::set<U32>& setRemovedCells);
 
+	/*!
+	 * \brief verifies the generated dispatch table by rebuilding the cut codes from every
+	 * table entry and optionally writes the table as text to the file path.
+	 */
+	static bool writeLookUpTable(const char* lpFilePath = NULL);
 };
 
 }
@@ -8,6 +8,8 @@
 #include <algorithm>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <cmath>
 
 #include <iterator>
 #include <map>
@@ -15,6 +17,7 @@
 #include <stack>
 #include <utility>
 #include <vector>
+#include <tbb/atomic.h>
 
 #include "base/directory.h"
 #include "base/logger.h"
@@ -27,8 +30,6 @@
 
 #include "elastic/volmesh.h"
 #include "elastic/volmeshentities.h"
-#include "scene/sgengine.h"
-#include "glbackend/glselect.h"
 
 using namespace std;
 using namespace ps;
@@ -76,10 +77,8 @@ VolMesh::VolMesh(const VolMesh& other) {
 
 	//set the flags
 	m_verbose = other.m_verbose;
-	m_flagDrawWireFrameMesh = other.m_flagDrawWireFrameMesh;
-	m_flagDrawNodes = other.m_flagDrawNodes;
 	m_flagFilterOutFlatCells = other.m_flagFilterOutFlatCells;
-	m_color = other.m_color;
+	m_flatCellVolume = other.m_flatCellVolume;
 
 	//set the name
 	setName(other.name());
@@ -87,6 +86,13 @@ VolMesh::VolMesh(const VolMesh& other) {
 	//setup vertices
 	setup(vertices, elements);
 
+	//keep the rest pose, setup does not drop or reorder nodes
+	for(U32 i=0; i<ctNodes; i++)
+		m_vNodes[i].restpos = other.const_nodeAt(i).restpos;
+
+	//the repair flags are copied after setup so the copy keeps the nodes of the other mesh
+	m_weldDistance = other.m_weldDistance;
+	m_flagOrientCells = other.m_flagOrientCells;
 }
 
 VolMesh::VolMesh(const vector<double>& vertices, const vector<U32>& elements) {
@@ -101,17 +107,21 @@ VolMesh::~VolMesh() {
 
 void VolMesh::init() {
 
-	m_elemToShow = m_nodeToShow = INVALID_INDEX;
 	m_verbose = false;
-	m_flagDrawNodes = false;
-	m_flagDrawWireFrameMesh = false;
 	m_flagFilterOutFlatCells = true;
-	m_color = Color::skin();
+	m_flatCellVolume = FLAT_CELL_VOLUME;
+	m_weldDistance = 0.0;
+	m_flagOrientCells = false;
 
 	m_fOnNodeEvent = NULL;
 	m_fOnEdgeEvent = NULL;
 	m_fOnFaceEvent = NULL;
 	m_fOnElementEvent = NULL;
+	m_fOnMeshChanged = NULL;
+	m_flagDeferMeshChanged = false;
+	m_isMeshChangedPending = false;
+	m_version = 0;
+	m_ctPartLabels = 0;
 }
 
 void VolMesh::setOnNodeEventCallback(OnNodeEvent f) {
@@ -130,6 +140,28 @@ void VolMesh::setOnElemEventCallback(OnCellEvent f) {
 	m_fOnElementEvent = f;
 }
 
+void VolMesh::setOnMeshChangedCallback(OnMeshChanged f) {
+	m_fOnMeshChanged = f;
+}
+
+void VolMesh::notifyMeshChanged() const {
+	if(m_flagDeferMeshChanged) {
+		m_isMeshChangedPending = true;
+		return;
+	}
+
+	if(m_fOnMeshChanged)
+		m_fOnMeshChanged(this);
+}
+
+void VolMesh::setFlagDeferMeshChanged(bool defer) {
+	m_flagDeferMeshChanged = defer;
+	if(!defer && m_isMeshChangedPending) {
+		m_isMeshChangedPending = false;
+		notifyMeshChanged();
+	}
+}
+
 
 bool VolMesh::setup(const vector<double>& vertices, const vector<U32>& elements) {
 	U32 ctVertices = vertices.size() / 3;
@@ -140,21 +172,298 @@ bool VolMesh::setup(const vector<double>& vertices, const vector<U32>& elements)
 
 bool VolMesh::setup(U32 ctVertices, const double* vertices, U32 ctElements, const U32* elements) {
 
+	ProfileAutoArg("setup");
+
+	//optional repair on copies of the input arrays
+	vector<double> vRepairedVertices;
+	vector<U32> vRepairedElements;
+	if(m_weldDistance > 0.0 || m_flagOrientCells) {
+		vRepairedVertices.assign(vertices, vertices + (size_t)ctVertices * 3);
+		vRepairedElements.assign(elements, elements + (size_t)ctElements * 4);
+
+		U32 ctWelded = WeldNodes(m_weldDistance, vRepairedVertices, vRepairedElements);
+		U32 ctOriented = m_flagOrientCells ? OrientCells(vRepairedVertices, vRepairedElements) : 0;
+		if(ctWelded > 0 || ctOriented > 0)
+			vloginfo("Welded %u nodes and reoriented %u cells before setup", ctWelded, ctOriented);
+
+		ctVertices = (U32)(vRepairedVertices.size() / 3);
+		ctElements = (U32)(vRepairedElements.size() / 4);
+		vertices = vRepairedVertices.size() > 0 ? &vRepairedVertices[0] : NULL;
+		elements = vRepairedElements.size() > 0 ? &vRepairedElements[0] : NULL;
+	}
+
 	//cleanup to setup the mesh
 	cleanup();
+	m_version++;
+
+	//element masks, the same as insert_cell. The edges are listed in the order and direction
+	//they are first met while walking the faces
+	const int maskTetFaceNodes[4][3] = { {1, 2, 3}, {2, 0, 3}, {3, 0, 1}, {1, 0, 2} };
+	const int maskTetFaceEdges[4][3] = { {0, 1, 2}, {3, 4, 1}, {4, 5, 2}, {5, 3, 0} };
+	const int maskTetEdges[6][2] = { {1, 2}, {2, 3}, {3, 1}, {2, 0}, {0, 3}, {0, 1} };
 
 	//add all vertices first
-	for(U32 i=0; i<ctVertices; i++) {
-		NODE node;
-		node.pos = node.restpos = vec3d(&vertices[i*3]);
-		insert_node(node);
+	m_vNodes.resize(ctVertices);
+	m_incident_edges_per_node.resize(ctVertices);
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctVertices, SETUP_BLOCK_SIZE),
+		[this, vertices](const tbb::blocked_range<U32>& r) {
+		for(U32 i = r.begin(); i != r.end(); i++)
+			m_vNodes[i].pos = m_vNodes[i].restpos = vec3d(&vertices[i * 3]);
+	});
+
+	//1.accepted elements: valid distinct nodes and not flat
+	vector<U8> vAccepted(ctElements, 0);
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctElements, SETUP_BLOCK_SIZE),
+		[this, ctVertices, elements, &vAccepted](const tbb::blocked_range<U32>& r) {
+		for(U32 i = r.begin(); i != r.end(); i++) {
+			const U32* nodes = &elements[i * 4];
+			bool isValid = true;
+			for(int j=0; j < COUNT_CELL_NODES && isValid; j++) {
+				isValid = (nodes[j] < ctVertices);
+				for(int k=0; k < j && isValid; k++)
+					isValid = (nodes[j] != nodes[k]);
+			}
+			if(!isValid)
+				continue;
+
+			vAccepted[i] = 1;
+			if(m_flagFilterOutFlatCells) {
+				vec3d v[COUNT_CELL_NODES];
+				for(int j=0; j < COUNT_CELL_NODES; j++)
+					v[j] = m_vNodes[nodes[j]].pos;
+				if(ComputeCellVolume(v) < m_flatCellVolume)
+					vAccepted[i] = 2;
+			}
+		}
+	});
+
+	vector<U32> vElements;
+	vElements.reserve(ctElements);
+	for(U32 i=0; i < ctElements; i++) {
+		if(vAccepted[i] == 1)
+			vElements.push_back(i);
+		else if(vAccepted[i] == 0)
+            vlogerror("Invalid element passed in. %u", i);
+	}
+	vector<U8>().swap(vAccepted);
+
+	U32 ctCells = (U32)vElements.size();
+	m_vCells.resize(ctCells);
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctCells, SETUP_BLOCK_SIZE),
+		[this, elements, &vElements](const tbb::blocked_range<U32>& r) {
+		for(U32 i = r.begin(); i != r.end(); i++) {
+			for(int j=0; j < COUNT_CELL_NODES; j++)
+				m_vCells[i].nodes[j] = elements[vElements[i] * 4 + j];
+		}
+	});
+	vector<U32>().swap(vElements);
+
+	//2.edges: the element edges are bucketed by their lower node and sorted within the buckets.
+	//the first element edge of every node pair owns the edge
+	vector<U32> vEdgeOffsets(ctVertices + 1, 0);
+	for(U32 i=0; i < ctCells; i++) {
+		for(int e=0; e < COUNT_CELL_EDGES; e++) {
+			U32 a = m_vCells[i].nodes[maskTetEdges[e][0]];
+			U32 b = m_vCells[i].nodes[maskTetEdges[e][1]];
+			vEdgeOffsets[std::min(a, b) + 1]++;
+		}
+	}
+	for(U32 i=0; i < ctVertices; i++)
+		vEdgeOffsets[i + 1] += vEdgeOffsets[i];
+
+	//upper node and element edge of every entry
+	vector< std::pair<U32, U32> > vEdgeBuckets(ctCells * COUNT_CELL_EDGES);
+	{
+		vector<U32> vCursor(vEdgeOffsets.begin(), vEdgeOffsets.end() - 1);
+		for(U32 i=0; i < ctCells; i++) {
+			for(int e=0; e < COUNT_CELL_EDGES; e++) {
+				U32 a = m_vCells[i].nodes[maskTetEdges[e][0]];
+				U32 b = m_vCells[i].nodes[maskTetEdges[e][1]];
+				vEdgeBuckets[vCursor[std::min(a, b)]++] = std::make_pair(std::max(a, b), i * COUNT_CELL_EDGES + e);
+			}
+		}
+	}
+
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctVertices, SETUP_BLOCK_SIZE),
+		[&vEdgeOffsets, &vEdgeBuckets](const tbb::blocked_range<U32>& r) {
+		for(U32 i = r.begin(); i != r.end(); i++)
+			std::sort(vEdgeBuckets.begin() + vEdgeOffsets[i], vEdgeBuckets.begin() + vEdgeOffsets[i + 1]);
+	});
+
+	vector<U8> vIsOwner(ctCells * COUNT_CELL_EDGES, 0);
+	for(U32 i=0; i < ctVertices; i++) {
+		for(U32 j = vEdgeOffsets[i]; j < vEdgeOffsets[i + 1]; j++) {
+			if(j == vEdgeOffsets[i] || vEdgeBuckets[j].first != vEdgeBuckets[j - 1].first)
+				vIsOwner[vEdgeBuckets[j].second] = 1;
+		}
+	}
+
+	//edges of an element are added in the order of their keys
+	vector<U32> vCellEdges(ctCells * COUNT_CELL_EDGES, (U32)INVALID_INDEX);
+	for(U32 i=0; i < ctCells; i++) {
+		std::pair<U64, U32> owned[COUNT_CELL_EDGES];
+		int ctOwned = 0;
+		for(int e=0; e < COUNT_CELL_EDGES; e++) {
+			U32 idx = i * COUNT_CELL_EDGES + e;
+			if(vIsOwner[idx])
+				owned[ctOwned++] = std::make_pair(EdgeKey(m_vCells[i].nodes[maskTetEdges[e][0]],
+														  m_vCells[i].nodes[maskTetEdges[e][1]]).key, idx);
+		}
+		std::sort(&owned[0], &owned[ctOwned]);
+
+		for(int k=0; k < ctOwned; k++) {
+			int e = owned[k].second - i * COUNT_CELL_EDGES;
+			vCellEdges[owned[k].second] = (U32)m_vEdges.size();
+			m_vEdges.push_back(EDGE(m_vCells[i].nodes[maskTetEdges[e][0]], m_vCells[i].nodes[maskTetEdges[e][1]]));
+		}
+	}
+	vector<U8>().swap(vIsOwner);
+
+	//all element edges point to the owned ones. the edges map is filled in key order
+	for(U32 i=0; i < ctVertices; i++) {
+		U32 first = INVALID_INDEX;
+		for(U32 j = vEdgeOffsets[i]; j < vEdgeOffsets[i + 1]; j++) {
+			if(j == vEdgeOffsets[i] || vEdgeBuckets[j].first != vEdgeBuckets[j - 1].first) {
+				first = vEdgeBuckets[j].second;
+				m_mapEdgesIndex.insert(m_mapEdgesIndex.end(),
+									   std::make_pair(EdgeKey(i, vEdgeBuckets[j].first), vCellEdges[first]));
+			}
+			else
+				vCellEdges[vEdgeBuckets[j].second] = vCellEdges[first];
+		}
+	}
+	vector< std::pair<U32, U32> >().swap(vEdgeBuckets);
+	vector<U32>().swap(vEdgeOffsets);
+
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctCells, SETUP_BLOCK_SIZE),
+		[this, &vCellEdges](const tbb::blocked_range<U32>& r) {
+		for(U32 i = r.begin(); i != r.end(); i++) {
+			for(int e=0; e < COUNT_CELL_EDGES; e++)
+				m_vCells[i].edges[e] = vCellEdges[i * COUNT_CELL_EDGES + e];
+		}
+	});
+
+	//3.faces: bucketed by their lowest node the same way. faces are added in element order
+	struct FACEENTRY {
+		U32 b, c;
+		U32 idx;
+
+		bool operator<(const FACEENTRY& rhs) const {
+			if(b != rhs.b)
+				return b < rhs.b;
+			if(c != rhs.c)
+				return c < rhs.c;
+			return idx < rhs.idx;
+		}
+	};
+
+	vector<U32> vFaceOffsets(ctVertices + 1, 0);
+	for(U32 i=0; i < ctCells; i++) {
+		for(int f=0; f < COUNT_CELL_FACES; f++) {
+			U32 a = m_vCells[i].nodes[maskTetFaceNodes[f][0]];
+			U32 b = m_vCells[i].nodes[maskTetFaceNodes[f][1]];
+			U32 c = m_vCells[i].nodes[maskTetFaceNodes[f][2]];
+			FaceKey::order_lo2hi(a, b, c);
+			vFaceOffsets[a + 1]++;
+		}
 	}
+	for(U32 i=0; i < ctVertices; i++)
+		vFaceOffsets[i + 1] += vFaceOffsets[i];
 
+	vector<FACEENTRY> vFaceBuckets(ctCells * COUNT_CELL_FACES);
+	{
+		vector<U32> vCursor(vFaceOffsets.begin(), vFaceOffsets.end() - 1);
+		for(U32 i=0; i < ctCells; i++) {
+			for(int f=0; f < COUNT_CELL_FACES; f++) {
+				U32 a = m_vCells[i].nodes[maskTetFaceNodes[f][0]];
+				U32 b = m_vCells[i].nodes[maskTetFaceNodes[f][1]];
+				U32 c = m_vCells[i].nodes[maskTetFaceNodes[f][2]];
+				FaceKey::order_lo2hi(a, b, c);
+
+				FACEENTRY& entry = vFaceBuckets[vCursor[a]++];
+				entry.b = b;
+				entry.c = c;
+				entry.idx = i * COUNT_CELL_FACES + f;
+			}
+		}
+	}
 
-	//insert element
-	for(U32 i=0; i<ctElements; i++)
-		insert_cell(const_cast<U32 *>(&elements[i * 4]));
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctVertices, SETUP_BLOCK_SIZE),
+		[&vFaceOffsets, &vFaceBuckets](const tbb::blocked_range<U32>& r) {
+		for(U32 i = r.begin(); i != r.end(); i++)
+			std::sort(vFaceBuckets.begin() + vFaceOffsets[i], vFaceBuckets.begin() + vFaceOffsets[i + 1]);
+	});
+
+	//first element face of every node triple owns the face
+	vector<U32> vCellFaces(ctCells * COUNT_CELL_FACES, (U32)INVALID_INDEX);
+	for(U32 i=0; i < ctVertices; i++) {
+		for(U32 j = vFaceOffsets[i]; j < vFaceOffsets[i + 1]; j++) {
+			const FACEENTRY& entry = vFaceBuckets[j];
+			if(j == vFaceOffsets[i] || entry.b != vFaceBuckets[j - 1].b || entry.c != vFaceBuckets[j - 1].c)
+				vCellFaces[entry.idx] = entry.idx;
+		}
+	}
 
+	//the face edges follow the nodes of the owner element
+	for(U32 i=0; i < vCellFaces.size(); i++) {
+		if(vCellFaces[i] != i)
+			continue;
+
+		U32 idxCell = i / COUNT_CELL_FACES;
+		U32 f = i % COUNT_CELL_FACES;
+		FACE face;
+		for(int e=0; e < COUNT_FACE_EDGES; e++)
+			face.edges[e] = m_vCells[idxCell].edges[maskTetFaceEdges[f][e]];
+
+		vCellFaces[i] = (U32)m_vFaces.size();
+		m_vFaces.push_back(face);
+	}
+
+	for(U32 i=0; i < ctVertices; i++) {
+		U32 first = INVALID_INDEX;
+		for(U32 j = vFaceOffsets[i]; j < vFaceOffsets[i + 1]; j++) {
+			const FACEENTRY& entry = vFaceBuckets[j];
+			if(j == vFaceOffsets[i] || entry.b != vFaceBuckets[j - 1].b || entry.c != vFaceBuckets[j - 1].c)
+				first = entry.idx;
+			else
+				vCellFaces[entry.idx] = vCellFaces[first];
+		}
+	}
+	vector<FACEENTRY>().swap(vFaceBuckets);
+	vector<U32>().swap(vFaceOffsets);
+
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctCells, SETUP_BLOCK_SIZE),
+		[this, &vCellFaces](const tbb::blocked_range<U32>& r) {
+		for(U32 i = r.begin(); i != r.end(); i++) {
+			for(int f=0; f < COUNT_CELL_FACES; f++)
+				m_vCells[i].faces[f] = vCellFaces[i * COUNT_CELL_FACES + f];
+		}
+	});
+	vector<U32>().swap(vCellFaces);
+
+	//4.bottom-up incidents, every list is in increasing handle order
+	m_incident_faces_per_edge.resize(countEdges());
+	m_incident_cells_per_face.resize(countFaces());
+	for(U32 i=0; i < countEdges(); i++) {
+		m_incident_edges_per_node[m_vEdges[i].from].push_back(i);
+		m_incident_edges_per_node[m_vEdges[i].to].push_back(i);
+	}
+
+	for(U32 i=0; i < countFaces(); i++) {
+		for(int e=0; e < COUNT_FACE_EDGES; e++)
+			m_incident_faces_per_edge[m_vFaces[i].edges[e]].push_back(i);
+	}
+
+	for(U32 i=0; i < ctCells; i++) {
+		for(int f=0; f < COUNT_CELL_FACES; f++)
+			m_incident_cells_per_face[m_vCells[i].faces[f]].push_back(i);
+	}
+
+	m_vCellParts.assign(ctCells, (U32)INVALID_INDEX);
+	if(m_fOnElementEvent) {
+		for(U32 i=0; i < ctCells; i++)
+			m_fOnElementEvent(m_vCells[i], i, teAdded);
+	}
 
 	//Compute AABB
 	computeAABB();
@@ -165,8 +474,11 @@ bool VolMesh::setup(U32 ctVertices, const double* vertices, U32 ctElements, cons
 }
 
 void VolMesh::cleanup() {
+	m_version++;
 	m_mapEdgesIndex.clear();
 	m_pendingToDeleteCells.resize(0);
+	m_vCellParts.resize(0);
+	m_vDirtyParts.resize(0);
 	m_incident_cells_per_face.resize(0);
 	m_incident_edges_per_node.resize(0);
 	m_incident_faces_per_edge.resize(0);
@@ -384,19 +696,215 @@ double VolMesh::ComputeCellVolume(const vec3d v[4]) {
 	return (1.0 / 6.0) * fabs ( vec3d::dot(v[0] - v[3], vec3d::cross(v[1] - v[3], v[2] - v[3])));
 }
 
-U32 VolMesh::removeZeroVolumeCells() {
-	U32 ctRemoved = 0;
-	for(U32 i=0; i < countCells(); i++) {
-		double v = computeCellVolume(i);
-		if(v < FLAT_CELL_VOLUME) {
-			schedule_remove_cell(i);
-			ctRemoved++;
+double VolMesh::ComputeCellQuality(const vec3d v[4]) {
+	//6 * sqrt(2) * volume / rms edge length ^ 3
+	const int edges[6][2] = { {0, 1}, {0, 2}, {0, 3}, {1, 2}, {1, 3}, {2, 3} };
+	double sum2 = 0.0;
+	for(int e=0; e < 6; e++)
+		sum2 += (v[edges[e][1]] - v[edges[e][0]]).length2();
+
+	double lrms = sqrt(sum2 / 6.0);
+	if(lrms == 0.0)
+		return 0.0;
+
+	return 6.0 * sqrt(2.0) * (ComputeCellDeterminant(v) / 6.0) / (lrms * lrms * lrms);
+}
+
+//grid cell of a point in the weld hash
+static inline void WeldCell(const double* p, double dist, I64 cell[3]) {
+	for(int i=0; i < 3; i++)
+		cell[i] = (I64)floor(p[i] / dist);
+}
+
+static inline U32 WeldBucket(I64 x, I64 y, I64 z, U32 mask) {
+	U64 h = (U64)x * 73856093ULL ^ (U64)y * 19349663ULL ^ (U64)z * 83492791ULL;
+	return (U32)(h ^ (h >> 32)) & mask;
+}
+
+U32 VolMesh::WeldNodes(double dist, vector<double>& vertices, vector<U32>& elements) {
+	U32 ctVertices = (U32)(vertices.size() / 3);
+	if(dist <= 0.0 || ctVertices < 2)
+		return 0;
+
+	//hash of the grid cells, nodes are listed in their buckets in index order
+	U32 ctBuckets = 1;
+	while(ctBuckets < ctVertices && ctBuckets < 0x80000000U)
+		ctBuckets <<= 1;
+	const U32 mask = ctBuckets - 1;
+
+	vector<U32> vNodeBuckets(ctVertices);
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctVertices, SETUP_BLOCK_SIZE),
+		[&](const tbb::blocked_range<U32>& r) {
+		I64 cell[3];
+		for(U32 i = r.begin(); i != r.end(); i++) {
+			WeldCell(&vertices[i * 3], dist, cell);
+			vNodeBuckets[i] = WeldBucket(cell[0], cell[1], cell[2], mask);
+		}
+	});
+
+	vector<U32> vBucketOffsets(ctBuckets + 1, 0);
+	for(U32 i=0; i < ctVertices; i++)
+		vBucketOffsets[vNodeBuckets[i] + 1]++;
+	for(U32 i=0; i < ctBuckets; i++)
+		vBucketOffsets[i + 1] += vBucketOffsets[i];
+
+	vector<U32> vBucketNodes(ctVertices);
+	{
+		vector<U32> vCursor(vBucketOffsets.begin(), vBucketOffsets.end() - 1);
+		for(U32 i=0; i < ctVertices; i++)
+			vBucketNodes[vCursor[vNodeBuckets[i]]++] = i;
+	}
+	vector<U32>().swap(vNodeBuckets);
+
+	//every node points to the first node within dist in the 27 cells around it
+	const double dist2 = dist * dist;
+	vector<U32> vKept(ctVertices);
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctVertices, SETUP_BLOCK_SIZE),
+		[&](const tbb::blocked_range<U32>& r) {
+		I64 cell[3];
+		for(U32 i = r.begin(); i != r.end(); i++) {
+			const vec3d p(&vertices[i * 3]);
+			WeldCell(&vertices[i * 3], dist, cell);
+
+			U32 first = i;
+			for(int dx = -1; dx <= 1; dx++) {
+				for(int dy = -1; dy <= 1; dy++) {
+					for(int dz = -1; dz <= 1; dz++) {
+						U32 b = WeldBucket(cell[0] + dx, cell[1] + dy, cell[2] + dz, mask);
+						for(U32 j = vBucketOffsets[b]; j < vBucketOffsets[b + 1] && vBucketNodes[j] < first; j++) {
+							U32 n = vBucketNodes[j];
+							if((vec3d(&vertices[n * 3]) - p).length2() <= dist2)
+								first = n;
+						}
+					}
+				}
+			}
+			vKept[i] = first;
 		}
+	});
+	vector<U32>().swap(vBucketOffsets);
+	vector<U32>().swap(vBucketNodes);
+
+	//the first node of a chain is kept, it comes before the others
+	U32 ctKept = 0;
+	vector<U32> vRemap(ctVertices);
+	for(U32 i=0; i < ctVertices; i++) {
+		if(vKept[i] == i)
+			vRemap[i] = ctKept++;
+		else
+			vRemap[i] = vRemap[vKept[i]];
 	}
 
-	if(ctRemoved > 0)
-		garbage_collection();
-	return ctRemoved;
+	if(ctKept == ctVertices)
+		return 0;
+
+	vector<double> vWelded((size_t)ctKept * 3);
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctVertices, SETUP_BLOCK_SIZE),
+		[&](const tbb::blocked_range<U32>& r) {
+		for(U32 i = r.begin(); i != r.end(); i++) {
+			if(vKept[i] == i)
+				memcpy(&vWelded[(size_t)vRemap[i] * 3], &vertices[(size_t)i * 3], sizeof(double) * 3);
+		}
+	});
+	vertices.swap(vWelded);
+
+	//remap the cells, invalid nodes stay invalid and collapsed cells are removed in order
+	U32 ctElements = (U32)(elements.size() / 4);
+	vector<U8> vCollapsed(ctElements, 0);
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctElements, SETUP_BLOCK_SIZE),
+		[&](const tbb::blocked_range<U32>& r) {
+		for(U32 i = r.begin(); i != r.end(); i++) {
+			U32* nodes = &elements[(size_t)i * 4];
+			for(int j=0; j < COUNT_CELL_NODES; j++) {
+				nodes[j] = (nodes[j] < ctVertices) ? vRemap[nodes[j]] : (U32)INVALID_INDEX;
+				for(int k=0; k < j; k++)
+					vCollapsed[i] |= (nodes[j] == nodes[k] && nodes[j] != (U32)INVALID_INDEX);
+			}
+		}
+	});
+
+	U32 ctCells = 0;
+	for(U32 i=0; i < ctElements; i++) {
+		if(vCollapsed[i])
+			continue;
+		if(ctCells != i)
+			memcpy(&elements[(size_t)ctCells * 4], &elements[(size_t)i * 4], sizeof(U32) * 4);
+		ctCells++;
+	}
+	elements.resize((size_t)ctCells * 4);
+
+	return ctVertices - ctKept;
+}
+
+U32 VolMesh::OrientCells(const vector<double>& vertices, vector<U32>& elements) {
+	U32 ctVertices = (U32)(vertices.size() / 3);
+	U32 ctElements = (U32)(elements.size() / 4);
+	tbb::atomic<U32> ctSwapped;
+	ctSwapped = 0;
+
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctElements, SETUP_BLOCK_SIZE),
+		[&](const tbb::blocked_range<U32>& r) {
+		U32 ctLocal = 0;
+		vec3d v[COUNT_CELL_NODES];
+		for(U32 i = r.begin(); i != r.end(); i++) {
+			U32* nodes = &elements[(size_t)i * 4];
+			bool isValid = true;
+			for(int j=0; j < COUNT_CELL_NODES && isValid; j++) {
+				isValid = (nodes[j] < ctVertices);
+				if(isValid)
+					v[j] = vec3d(&vertices[(size_t)nodes[j] * 3]);
+			}
+
+			if(isValid && ComputeCellDeterminant(v) < 0.0) {
+				std::swap(nodes[2], nodes[3]);
+				ctLocal++;
+			}
+		}
+		ctSwapped += ctLocal;
+	});
+
+	return ctSwapped;
+}
+
+U32 VolMesh::findDegenerateCells(double minVolume, double minQuality, vector<U32>& vCells) const {
+	vCells.clear();
+	if(minVolume <= 0.0 && minQuality <= 0.0)
+		return 0;
+
+	//flag in parallel, collect in order
+	U32 ctCells = countCells();
+	vector<U8> vDegenerate(ctCells, 0);
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctCells, DEGENERATE_CELL_BLOCK_SIZE),
+		[this, minVolume, minQuality, &vDegenerate](const tbb::blocked_range<U32>& r) {
+		for(U32 i = r.begin(); i != r.end(); i++) {
+			const CELL& cell = const_cellAt(i);
+			vec3d v[COUNT_CELL_NODES];
+			for(int j=0; j < COUNT_CELL_NODES; j++)
+				v[j] = const_nodeAt(cell.nodes[j]).pos;
+
+			if(ComputeCellVolume(v) < minVolume || fabs(ComputeCellQuality(v)) < minQuality)
+				vDegenerate[i] = 1;
+		}
+	});
+
+	for(U32 i=0; i < ctCells; i++) {
+		if(vDegenerate[i])
+			vCells.push_back(i);
+	}
+
+	return vCells.size();
+}
+
+U32 VolMesh::removeZeroVolumeCells() {
+	vector<U32> vCells;
+	findDegenerateCells(m_flatCellVolume, 0.0, vCells);
+	if(vCells.size() == 0)
+		return 0;
+
+	m_pendingToDeleteCells.insert(m_pendingToDeleteCells.end(), vCells.begin(), vCells.end());
+	m_version++;
+	garbage_collection();
+	return vCells.size();
 }
 
 //add/remove
@@ -425,7 +933,9 @@ bool VolMesh::insert_cell(const CELL& cell) {
 	}
 
 	m_vCells.push_back(cell);
+	m_vCellParts.push_back((U32)INVALID_INDEX);
 	U32 idxCell = countCells() - 1;
+	m_version++;
 
 	//update
 	for(int i=0; i < 4; i++)
@@ -453,7 +963,7 @@ bool VolMesh::insert_cell(U32 nodes[4]) {
 			v[i] = const_nodeAt(nodes[i]).pos;
 		}
 		double cellvol = ComputeCellVolume(v);
-		if(cellvol < FLAT_CELL_VOLUME)
+		if(cellvol < m_flatCellVolume)
 			return false;
 	}
 
@@ -553,6 +1063,7 @@ bool VolMesh::insert_cell(U32 nodes[4]) {
 }
 
 void VolMesh::set_edge(U32 idxEdge, U32 from, U32 to) {
+	m_version++;
 	assert(isEdgeIndex(idxEdge));
 
 	//edge e
@@ -585,6 +1096,7 @@ void VolMesh::set_edge(U32 idxEdge, U32 from, U32 to) {
 }
 
 void VolMesh::set_face(U32 idxFace, U32 edges[3]) {
+	m_version++;
 
 	assert(isFaceIndex(idxFace));
 
@@ -610,6 +1122,7 @@ void VolMesh::set_face(U32 idxFace, U32 edges[3]) {
 }
 
 void VolMesh::remove_cell_core(U32 idxCell) {
+	m_version++;
 	assert(isCellIndex(idxCell));
 
 	//1. remove cell from the list of incident cell per face
@@ -631,10 +1144,14 @@ void VolMesh::remove_cell_core(U32 idxCell) {
 
 
 	//remove the cell from list
+	if(m_vCellParts[idxCell] != INVALID_INDEX)
+		m_vDirtyParts.push_back(m_vCellParts[idxCell]);
+	m_vCellParts.erase(m_vCellParts.begin() + idxCell);
 	m_vCells.erase(m_vCells.begin() + idxCell);
 }
 
 void VolMesh::remove_face_core(U32 idxFace) {
+	m_version++;
 	assert(isFaceIndex(idxFace));
 
 	ProfileAutoArg("gc:remove face core");
@@ -730,6 +1247,7 @@ void VolMesh::remove_face_core(U32 idxFace) {
 }
 
 void VolMesh::remove_edge_core(U32 idxEdge) {
+	m_version++;
 	assert(isEdgeIndex(idxEdge));
 
 	//1. Delete bottom-up links from incident edges per node
@@ -838,6 +1356,7 @@ void VolMesh::remove_edge_core(U32 idxEdge) {
 }
 
 void VolMesh::remove_node_core(U32 idxNode) {
+	m_version++;
 	assert(isNodeIndex(idxNode));
 
 	//1. Decrease all vertex handles > idxNode in incident edges per node
@@ -935,52 +1454,91 @@ int VolMesh::get_disjoint_parts(vector<vector<U32>>& cellgroups) {
 
 	ProfileAutoArg("get_disjoint_parts");
 
-	std::set<U32> setCells;
+	update_disjoint_parts();
 
-	for(U32 i=0; i < m_vCells.size(); i++)
-		setCells.insert(i);
+	//group the cells by their part labels. parts are ordered by their first cell
+	vector<U32> vGroups(m_ctPartLabels, (U32)INVALID_INDEX);
+	for(U32 i=0; i < m_vCells.size(); i++) {
+		U32 label = m_vCellParts[i];
+		if(vGroups[label] == INVALID_INDEX) {
+			vGroups[label] = cellgroups.size();
+			cellgroups.push_back(vector<U32>());
+		}
 
-	while(setCells.size() > 0) {
+		cellgroups[vGroups[label]].push_back(i);
+	}
 
-		set<U32> curPart;
+	return cellgroups.size();
+}
 
-		std::stack<U32> stkCurrentCells;
-		stkCurrentCells.push(* setCells.begin());
+U32 VolMesh::update_disjoint_parts(vector<U32>* pvOutChangedParts) {
 
-		while(stkCurrentCells.size() > 0) {
-			U32 idxCell = stkCurrentCells.top();
+	if(pvOutChangedParts)
+		pvOutChangedParts->resize(0);
 
-			//remove from local stack
-			stkCurrentCells.pop();
+	//the parts which lost cells and the parts touching the new cells
+	vector<U8> vDirtyLabels(m_ctPartLabels, 0);
+	for(U32 i=0; i < m_vDirtyParts.size(); i++)
+		vDirtyLabels[m_vDirtyParts[i]] = 1;
+	m_vDirtyParts.resize(0);
 
-			//remove from global set of cells
-			setCells.erase(idxCell);
+	vector<U32> vAffected;
+	for(U32 i=0; i < m_vCells.size(); i++) {
+		if(m_vCellParts[i] != INVALID_INDEX)
+			continue;
 
-			//add to mesh parts
-			curPart.insert(idxCell);
+		vAffected.push_back(i);
+		const CELL& cell = const_cellAt(i);
+		for(int j=0; j < COUNT_CELL_FACES; j++) {
+			const vector<U32>& cells = m_incident_cells_per_face[cell.faces[j]];
+			for(U32 k=0; k < cells.size(); k++) {
+				if(m_vCellParts[cells[k]] != INVALID_INDEX)
+					vDirtyLabels[m_vCellParts[cells[k]]] = 1;
+			}
+		}
+	}
 
-			//current cell
-			const CELL& cell = const_cellAt(idxCell);
+	//all cells of the dirty parts are relabelled
+	for(U32 i=0; i < m_vCells.size(); i++) {
+		if(m_vCellParts[i] != INVALID_INDEX && vDirtyLabels[m_vCellParts[i]]) {
+			m_vCellParts[i] = INVALID_INDEX;
+			vAffected.push_back(i);
+		}
+	}
 
-			set<U32> setCurFaces;
-			for(U32 i=0; i < 4; i++)
-				setCurFaces.insert(cell.faces[i]);
+	if(vAffected.size() == 0)
+		return 0;
 
-			set<U32> incidentCells;
-			if(get_incident_cells(setCurFaces, incidentCells) > 0) {
-				for(set<U32>::const_iterator it = incidentCells.begin(); it != incidentCells.end(); it++) {
-					if((*it != idxCell) && curPart.find(*it) == curPart.end())
-						stkCurrentCells.push(*it);
+	//flood the affected cells through their shared faces. the other parts are not reached
+	std::sort(vAffected.begin(), vAffected.end());
+	vector<U32> stkCells;
+	for(U32 i=0; i < vAffected.size(); i++) {
+		if(m_vCellParts[vAffected[i]] != INVALID_INDEX)
+			continue;
+
+		U32 label = m_ctPartLabels++;
+		if(pvOutChangedParts)
+			pvOutChangedParts->push_back(label);
+
+		m_vCellParts[vAffected[i]] = label;
+		stkCells.push_back(vAffected[i]);
+		while(stkCells.size() > 0) {
+			const CELL& cell = const_cellAt(stkCells.back());
+			stkCells.pop_back();
+
+			for(int j=0; j < COUNT_CELL_FACES; j++) {
+				const vector<U32>& cells = m_incident_cells_per_face[cell.faces[j]];
+				for(U32 k=0; k < cells.size(); k++) {
+					if(m_vCellParts[cells[k]] == INVALID_INDEX) {
+						m_vCellParts[cells[k]] = label;
+						stkCells.push_back(cells[k]);
+					}
 				}
 			}
 		}
-
-		//push back part to cells
-		vector<U32> vCurPart(curPart.begin(), curPart.end());
-		cellgroups.push_back(vCurPart);
 	}
 
-	return cellgroups.size();
+	return vAffected.size();
 }
 
 void VolMesh::printParts() {
@@ -1002,6 +1560,7 @@ void VolMesh::schedule_remove_cell(U32 idxCell) {
 	if(!isCellIndex(idxCell))
 		return;
 	m_pendingToDeleteCells.push_back(idxCell);
+	m_version++;
 }
 
 void VolMesh::remove_cell(U32 idxCell) {
@@ -1113,6 +1672,7 @@ void VolMesh::remove_node(U32 idxNode) {
 
 
 U32 VolMesh::insert_node(const NODE& n) {
+	m_version++;
 	m_vNodes.push_back(n);
 	m_incident_edges_per_node.resize(countNodes());
 
@@ -1125,6 +1685,7 @@ U32 VolMesh::insert_edge(const EDGE& e) {
 
 	m_vEdges.push_back(e);
 	m_incident_faces_per_edge.resize(countEdges());
+	m_version++;
 	U32 idxEdge = countEdges() - 1;
 
 	//update incident edges per vertex
@@ -1140,6 +1701,7 @@ U32 VolMesh::insert_edge(const EDGE& e) {
 
 //inserting a face uniquely
 U32 VolMesh::insert_face(U32 nodes[3]) {
+	m_version++;
 
 	U32 idxFace = face_handle_by_nodes(nodes);
 	if(isFaceIndex(idxFace)) {
@@ -1183,83 +1745,134 @@ U32 VolMesh::insert_face(U32 nodes[3]) {
 
 void VolMesh::garbage_collection() {
 	ProfileAutoArg("gc");
+	m_version++;
 
 	//acquire lock to mesh
 	//if(m_verbose)
 	printf("GC BEGIN\n");
 
-	//1.delete all pending cells
-	U32 ctRemovedCells = 0;
-	{
-		ProfileAutoArg("gc:cells");
-		if(m_pendingToDeleteCells.size() > 0) {
-			remove_cells(m_pendingToDeleteCells);
-			ctRemovedCells = m_pendingToDeleteCells.size();
-			m_pendingToDeleteCells.resize(0);
-		}
-	}
-
-	//2.faces
-	//most expensive
-	U32 ctRemovedFaces = 0;
-	{
-		ProfileAutoArg("gc:faces");
-		std::set<U32> setToBeRemoved;
-		for(U32 i = 0; i < countFaces(); i++) {
-			if(m_incident_cells_per_face[i].size() == 0) {
-				setToBeRemoved.insert(i);
-
-				if(m_verbose)
-					printf("GC: face %u should be removed.\n", i);
-			}
-		}
+	//1.mark the live entities: the pending cells are removed, then the faces without cells,
+	//the edges without faces and the nodes without edges.
+	vector<U8> vCellAlive(countCells(), 1);
+	for(U32 i=0; i < m_pendingToDeleteCells.size(); i++) {
+		U32 idxCell = m_pendingToDeleteCells[i];
+		if(!isCellIndex(idxCell) || !vCellAlive[idxCell])
+			continue;
 
-		//remove batch of faces in increasing index order
-		remove_faces(setToBeRemoved);
-		ctRemovedFaces = setToBeRemoved.size();
+		//the part of a removed cell may fall apart
+		vCellAlive[idxCell] = 0;
+		if(m_vCellParts[idxCell] != INVALID_INDEX)
+			m_vDirtyParts.push_back(m_vCellParts[idxCell]);
 	}
+	m_pendingToDeleteCells.resize(0);
 
-
-	//3.edges
-	U32 ctRemovedEdges = 0;
-	{
-		ProfileAutoArg("gc:edges");
-		std::set<U32> setToBeRemoved;
-		for(U32 i = 0; i < countEdges(); i++) {
-			if(m_incident_faces_per_edge[i].size() == 0) {
-				setToBeRemoved.insert(i);
-
-				if(m_verbose)
-					printf("GC: edge %u should be removed.\n", i);
-			}
+	vector<U8> vFaceAlive(countFaces(), 0);
+	for(U32 i = 0; i < countFaces(); i++) {
+		const vector<U32>& cells = m_incident_cells_per_face[i];
+		for(U32 j=0; j < cells.size() && !vFaceAlive[i]; j++)
+			vFaceAlive[i] = isCellIndex(cells[j]) && vCellAlive[cells[j]];
+	}
+
+	vector<U8> vEdgeAlive(countEdges(), 0);
+	for(U32 i = 0; i < countEdges(); i++) {
+		const vector<U32>& faces = m_incident_faces_per_edge[i];
+		for(U32 j=0; j < faces.size() && !vEdgeAlive[i]; j++)
+			vEdgeAlive[i] = isFaceIndex(faces[j]) && vFaceAlive[faces[j]];
+	}
+
+	vector<U8> vNodeAlive(countNodes(), 0);
+	for(U32 i = 0; i < countNodes(); i++) {
+		const vector<U32>& edges = m_incident_edges_per_node[i];
+		for(U32 j=0; j < edges.size() && !vNodeAlive[i]; j++)
+			vNodeAlive[i] = isEdgeIndex(edges[j]) && vEdgeAlive[edges[j]];
+	}
+
+	//2.new handles. Removed entities map to INVALID_INDEX and the order of the remaining ones
+	//is kept, so the handles are the same as removing them one by one
+	vector<U32> vCellMap, vFaceMap, vEdgeMap, vNodeMap;
+	U32 ctRemovedCells = compute_handle_map(vCellAlive, vCellMap);
+	U32 ctRemovedFaces = compute_handle_map(vFaceAlive, vFaceMap);
+	U32 ctRemovedEdges = compute_handle_map(vEdgeAlive, vEdgeMap);
+	U32 ctRemovedNodes = compute_handle_map(vNodeAlive, vNodeMap);
+
+	//3.compact all containers and correct the handles in a single pass
+	if(ctRemovedCells + ctRemovedFaces + ctRemovedEdges + ctRemovedNodes > 0) {
+		ProfileAutoArg("gc:compact");
+
+		//cells
+		U32 idx = 0;
+		for(U32 i = 0; i < m_vCells.size(); i++) {
+			if(!vCellAlive[i])
+				continue;
+
+			CELL cell = m_vCells[i];
+			for(int j=0; j < COUNT_CELL_NODES; j++)
+				cell.nodes[j] = isNodeIndex(cell.nodes[j]) ? vNodeMap[cell.nodes[j]] : INVALID_INDEX;
+			for(int j=0; j < COUNT_CELL_FACES; j++)
+				cell.faces[j] = isFaceIndex(cell.faces[j]) ? vFaceMap[cell.faces[j]] : INVALID_INDEX;
+			for(int j=0; j < COUNT_CELL_EDGES; j++)
+				cell.edges[j] = isEdgeIndex(cell.edges[j]) ? vEdgeMap[cell.edges[j]] : INVALID_INDEX;
+			m_vCells[idx] = cell;
+			m_vCellParts[idx] = m_vCellParts[i];
+			idx++;
 		}
-
-		//remove batch of edges in increasing index order
-		remove_edges(setToBeRemoved);
-		ctRemovedEdges = setToBeRemoved.size();
-	}
-
-
-	//4.nodes
-	U32 ctRemovedNodes = 0;
-	{
-		ProfileAutoArg("gc:nodes");
-		std::set<U32> setToBeRemoved;
-		for(U32 i = 0; i < countNodes(); i++) {
-			if(m_incident_edges_per_node[i].size() == 0) {
-				setToBeRemoved.insert(i);
-
-				if(m_verbose)
-					printf("GC: node %u should be removed.\n", i);
-			}
+		m_vCells.resize(idx);
+		m_vCellParts.resize(idx);
+
+		//faces and the cells per face
+		idx = 0;
+		for(U32 i = 0; i < m_vFaces.size(); i++) {
+			if(!vFaceAlive[i])
+				continue;
+
+			FACE face = m_vFaces[i];
+			for(int j=0; j < COUNT_FACE_EDGES; j++)
+				face.edges[j] = isEdgeIndex(face.edges[j]) ? vEdgeMap[face.edges[j]] : INVALID_INDEX;
+			m_vFaces[idx] = face;
+			compact_handles(m_incident_cells_per_face[i], vCellMap);
+			m_incident_cells_per_face[idx].swap(m_incident_cells_per_face[i]);
+			idx++;
+		}
+		m_vFaces.resize(idx);
+		m_incident_cells_per_face.resize(idx);
+
+		//edges and the faces per edge
+		idx = 0;
+		for(U32 i = 0; i < m_vEdges.size(); i++) {
+			if(!vEdgeAlive[i])
+				continue;
+
+			EDGE e = m_vEdges[i];
+			e.from = isNodeIndex(e.from) ? vNodeMap[e.from] : INVALID_INDEX;
+			e.to = isNodeIndex(e.to) ? vNodeMap[e.to] : INVALID_INDEX;
+			m_vEdges[idx] = e;
+			compact_handles(m_incident_faces_per_edge[i], vFaceMap);
+			m_incident_faces_per_edge[idx].swap(m_incident_faces_per_edge[i]);
+			idx++;
 		}
+		m_vEdges.resize(idx);
+		m_incident_faces_per_edge.resize(idx);
+
+		//nodes and the edges per node
+		idx = 0;
+		for(U32 i = 0; i < m_vNodes.size(); i++) {
+			if(!vNodeAlive[i])
+				continue;
+
+			m_vNodes[idx] = m_vNodes[i];
+			compact_handles(m_incident_edges_per_node[i], vEdgeMap);
+			m_incident_edges_per_node[idx].swap(m_incident_edges_per_node[i]);
+			idx++;
+		}
+		m_vNodes.resize(idx);
+		m_incident_edges_per_node.resize(idx);
 
-		//remove batch of nodes in increasing index order
-		remove_nodes(setToBeRemoved);
-		ctRemovedNodes = setToBeRemoved.size();
+		//edges map
+		m_mapEdgesIndex.clear();
+		for(U32 i = 0; i < m_vEdges.size(); i++)
+			m_mapEdgesIndex.insert(std::make_pair(EdgeKey(m_vEdges[i].from, m_vEdges[i].to), i));
 	}
 
-
 	printf("garbage collection removed: Cells# %u, Faces# %u, Edges# %u, Nodes# %u\n",
 			ctRemovedCells, ctRemovedFaces, ctRemovedEdges, ctRemovedNodes);
 
@@ -1271,28 +1884,45 @@ void VolMesh::garbage_collection() {
 	printf("GC END\n");
 }
 
+U32 VolMesh::compute_handle_map(const vector<U8>& vAlive, vector<U32>& vHandleMap) {
+	vHandleMap.resize(vAlive.size());
+
+	U32 idx = 0;
+	for(U32 i = 0; i < vAlive.size(); i++)
+		vHandleMap[i] = vAlive[i] ? idx++ : INVALID_INDEX;
+
+	//number of removed handles
+	return (U32)vAlive.size() - idx;
+}
+
+void VolMesh::compact_handles(vector<U32>& vHandles, const vector<U32>& vHandleMap) {
+	U32 idx = 0;
+	for(U32 i = 0; i < vHandles.size(); i++) {
+		if(vHandles[i] < vHandleMap.size() && vHandleMap[vHandles[i]] != INVALID_INDEX)
+			vHandles[idx++] = vHandleMap[vHandles[i]];
+	}
+	vHandles.resize(idx);
+}
+
 bool VolMesh::getFaceNodes(U32 idxFace, U32 (&nodes)[3]) const {
 	if(!isFaceIndex(idxFace))
 		return false;
 
 	const FACE& face = const_faceAt(idxFace);
 
-	std::set<U32> setFaceNodes;
-	for(int i=0; i < 3; i++) {
-		setFaceNodes.insert(edge_from_node(face.edges[i]));
-		setFaceNodes.insert(edge_to_node(face.edges[i]));
+	//distinct nodes of the face edges in increasing order
+	U32 arrNodes[COUNT_FACE_EDGES * 2];
+	for(int i=0; i < COUNT_FACE_EDGES; i++) {
+		arrNodes[i * 2] = edge_from_node(face.edges[i]);
+		arrNodes[i * 2 + 1] = edge_to_node(face.edges[i]);
 	}
 
-	int i = 0;
-	for(std::set<U32>::const_iterator it = setFaceNodes.begin(); it != setFaceNodes.end(); ++it) {
-		nodes[i] = *it;
-		i++;
+	std::sort(arrNodes, arrNodes + COUNT_FACE_EDGES * 2);
+	int ctNodes = (int)(std::unique(arrNodes, arrNodes + COUNT_FACE_EDGES * 2) - arrNodes);
+	for(int i=0; i < ctNodes && i < COUNT_FACE_EDGES; i++)
+		nodes[i] = arrNodes[i];
 
-		if(i == COUNT_FACE_EDGES)
-			break;
-	}
-
-	return (setFaceNodes.size() == COUNT_FACE_EDGES);
+	return (ctNodes == COUNT_FACE_EDGES);
 }
 
 bool VolMesh::isNodeOfCell(U32 idxNode, U32 idxCell) const {
@@ -1333,21 +1963,25 @@ bool VolMesh::isEdgeOfCell(U32 idxEdge, U32 idxCell) const {
 
 CELL& VolMesh::cellAt(U32 i) {
 	assert(isCellIndex(i));
+	m_version++;
 	return m_vCells[i];
 }
 
 FACE& VolMesh::faceAt(U32 i) {
 	assert(isFaceIndex(i));
+	m_version++;
 	return m_vFaces[i];
 }
 
 EDGE& VolMesh::edgeAt(U32 i) {
 	assert(isEdgeIndex(i));
+	m_version++;
 	return m_vEdges[i];
 }
 
 NODE& VolMesh::nodeAt(U32 i) {
 	assert(isNodeIndex(i));
+	m_version++;
 	return m_vNodes[i];
 }
 
@@ -1441,6 +2075,7 @@ void VolMesh::displace(U32 countDegreesOfFreedom, const double * u) {
 	for(U32 i=0; i < countNodes(); i++) {
 		m_vNodes[i].pos = m_vNodes[i].restpos + vec3d(&u[i * 3]);
 	}
+	m_version++;
 
 	computeAABB();
 }
@@ -1581,7 +2216,7 @@ int VolMesh::get_incident_edges(const ContainerT& in_nodes, set<U32>& out_edges)
 		vTempEdges.assign(m_incident_edges_per_node[*n_it].begin(), m_incident_edges_per_node[*n_it].end());
 		for(U32 j=0; j < vTempEdges.size(); j++) {
 			U32 idxEdge = vTempEdges[j];
-			if(isNodeIndex(idxEdge))
+			if(isEdgeIndex(idxEdge))
 				out_edges.insert(idxEdge);
 		}
 	}
@@ -1750,6 +2385,33 @@ int VolMesh::getNodeIncidentNodes(U32 idxNode, vector<U32>& incidentNodes) const
 	return (int)incidentNodes.size();
 }
 
+int VolMesh::getNodeIncidentCells(U32 idxNode, vector<U32>& incidentCells) const {
+	if(!isNodeIndex(idxNode))
+		return 0;
+
+	vector<U32> vnodes(1, idxNode);
+	set<U32> setEdges, setFaces, setCells;
+	get_incident_edges(vnodes, setEdges);
+	get_incident_faces(setEdges, setFaces);
+	get_incident_cells(setFaces, setCells);
+
+	incidentCells.assign(setCells.begin(), setCells.end());
+	return (int)incidentCells.size();
+}
+
+int VolMesh::getEdgeIncidentCells(U32 idxEdge, vector<U32>& incidentCells) const {
+	if(!isEdgeIndex(idxEdge))
+		return 0;
+
+	vector<U32> vedges(1, idxEdge);
+	set<U32> setFaces, setCells;
+	get_incident_faces(vedges, setFaces);
+	get_incident_cells(setFaces, setCells);
+
+	incidentCells.assign(setCells.begin(), setCells.end());
+	return (int)incidentCells.size();
+}
+
 bool VolMesh::getCellFacesExpensive(U32 idxCell, U32 (&faces)[4]) {
 	if(!isCellIndex(idxCell))
 		return false;
@@ -1785,138 +2447,6 @@ bool VolMesh::getCellEdgesExpensive(U32 idxCell, U32 (&edges)[6])  {
 
 
 
-void VolMesh::setElemToShow(U32 elem) {
-	if(elem == m_elemToShow)
-		return;
-	m_elemToShow = elem;
-}
-
-void VolMesh::setNodeToShow(U32 idxNode) {
-	if(idxNode == m_nodeToShow)
-		return;
-	m_nodeToShow = idxNode;
-}
-
-
-void VolMesh::draw() {
-	glPushAttrib(GL_ALL_ATTRIB_BITS);
-	//glDisable(GL_LIGHTING);
-
-	const U8 ctColors = 7;
-	vec3d colors[ctColors] = {vec3d(0.7, 0.7, 0.7), vec3d(1, 0.3, 0), vec3d(0.3, 1, 0), vec3d(0, 0.3, 1),
-					   	   	   vec3d(1, 1, 0), vec3d(0.5, 0.5, 0.5), vec3d(0, 1, 1)};
-
-	//Draw filled faces
-	glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-	glDisable(GL_CULL_FACE);
-	if(isCellIndex(m_elemToShow))
-	{
-		glColor3dv(colors[m_elemToShow % ctColors].cptr());
-		drawElement(m_elemToShow);
-	}
-	else {
-		glColor3fv(m_color.toVec4f().cptr());
-		for (U32 i = 0; i < countCells(); i++) {
-			drawElement(i);
-		}
-	}
-	glEnable(GL_CULL_FACE);
-
-
-	//Draw outlined faces
-	if(m_flagDrawWireFrameMesh) {
-		glDisable(GL_CULL_FACE);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-		glEnable(GL_BLEND);
-
-		glLineWidth(2.0f);
-		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-		glColor4f(0.0f, 0.0f, 0.0f, 0.6f);
-
-		for(U32 i=0; i< countCells(); i++) {
-			drawElement(i);
-		}
-
-		glDisable(GL_BLEND);
-		glEnable(GL_CULL_FACE);
-	}
-
-	//Draw vertices
-	if (m_flagDrawNodes) {
-		glPointSize(3.0f);
-		glColor3f(1.0f, 0.0f, 0.0f);
-		glBegin(GL_POINTS);
-		for (U32 i = 0; i < m_vNodes.size(); i++) {
-			NODE n = const_nodeAt(i);
-			glVertex3dv(n.pos.cptr());
-		}
-		glEnd();
-	}
-
-	//selected node
-	if(isNodeIndex(m_nodeToShow)) {
-		vector<U32> incidentNodes;
-		getNodeIncidentNodes(m_nodeToShow, incidentNodes);
-		vec3d pos = const_nodeAt(m_nodeToShow).pos;
-		glPointSize(7.0f);
-		glColor3f(0.0, 1.0, 0.0);
-		glBegin(GL_POINTS);
-		glVertex3dv(pos.cptr());
-		glEnd();
-
-		//orange lines
-		glLineWidth(3.0f);
-		glColor3f(0.0, 0.0, 1.0);
-		glBegin(GL_LINES);
-		for(U32 i=0; i < incidentNodes.size(); i++) {
-			glVertex3dv(pos.cptr());
-			glVertex3dv(const_nodeAt(incidentNodes[i]).pos.cptr());
-		}
-		glEnd();
-
-	}
-
-	//glEnable(GL_LIGHTING);
-	glPopAttrib();
-}
-
-void VolMesh::drawElement(U32 i) const {
-	if(!isCellIndex(i))
-		return;
-
-	const CELL& cell = const_cellAt(i);
-
-	glBegin(GL_TRIANGLES);
-		for(U32 f=0; f<4; f++)
-		{
-			U32 nodes[3];
-			getFaceNodes(cell.faces[f], nodes);
-
-			vec3d p0 = const_nodeAt(nodes[0]).pos;
-			vec3d p1 = const_nodeAt(nodes[1]).pos;
-			vec3d p2 = const_nodeAt(nodes[2]).pos;
-
-			vec3d n = vec3d::cross(p1 - p0, p2 - p0).normalized();
-            vec3f cp = TheEngine::Instance().camera().pos();
-			vec3d cpd = vec3d(cp.x, cp.y, cp.z);
-			vec3d cd = (cpd - p0).normalized();
-
-			if(vec3d::dot(cd, n) < 0) {
-				n = n * -1.0;
-				vec3d temp = p0;
-				p0 = p2;
-				p2 = temp;
-			}
-
-			//to gl
-			glNormal3dv(n.cptr());
-			glVertex3dv(p0.cptr());
-			glVertex3dv(p1.cptr());
-			glVertex3dv(p2.cptr());
-		}
-	glEnd();
-}
-
 AABB VolMesh::computeNodalAABB() const {
 	double vMin[3], vMax[3];
 	vMin[0] = vMin[1] = vMin[2] = GetMaxLimit<double>();
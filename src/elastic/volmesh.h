@@ -9,10 +9,12 @@
 #define VOLMESH_H
 
 #include <functional>
+#include <map>
 #include <set>
+#include <string>
 #include "base/Vec.h"
-#include "base/color.h"
-#include "scene/sgnode.h"
+#include "base/aabb.h"
+#include "base/ray.h"
 #include "elastic/volmeshentities.h"
 
 /*!Stories:
@@ -24,11 +26,12 @@
  *
 */
 using namespace ps;
-using namespace ps::scene;
 using namespace std;
 
 #define FLAT_CELL_VOLUME 1e-4
 #define MIN_EDGE_LENGTH 1e-4
+#define DEGENERATE_CELL_BLOCK_SIZE 4096
+#define SETUP_BLOCK_SIZE 4096
 
 namespace ps {
 namespace elastic {
@@ -42,7 +45,9 @@ namespace elastic {
 
 
 //template <typename T>
-class VolMesh : public SGNode {
+class VolMesh {
+	//the native binary format stores and adopts the topology arrays as they are
+	friend class VolMeshIO;
 public:
 	static const U32 INVALID_INDEX = -1;
 	enum TopologyEvent {teAdded, teRemoved, teUpdated};
@@ -60,6 +65,7 @@ public:
 	typedef std::function<void(EDGE, U32 handle, TopologyEvent event)> OnEdgeEvent;
 	typedef std::function<void(FACE, U32 handle, TopologyEvent event)> OnFaceEvent;
 	typedef std::function<void(CELL, U32 handle, TopologyEvent event)> OnCellEvent;
+	typedef std::function<void(const VolMesh* mesh)> OnMeshChanged;
 public:
 	VolMesh();
 	VolMesh(const VolMesh& other);
@@ -73,7 +79,20 @@ public:
 	void setOnFaceEventCallback(OnFaceEvent f);
 	void setOnElemEventCallback(OnCellEvent f);
 
-	//Build
+	//called after a batch of changes to the nodes or the topology, e.g. to sync a renderer
+	void setOnMeshChangedCallback(OnMeshChanged f);
+	void notifyMeshChanged() const;
+
+	//holds back the mesh changed notifications, e.g. while the mesh is cut on a worker thread.
+	//a held back notification is sent when the deferral ends
+	void setFlagDeferMeshChanged(bool defer);
+	bool getFlagDeferMeshChanged() const {return m_flagDeferMeshChanged;}
+
+	/*!
+	 * Builds the mesh from flat node and element arrays in bulk. Edges and faces are found by
+	 * sorting the element edges and faces in parallel, the handles come out in the same order as
+	 * inserting the elements one by one.
+	 */
 	bool setup(const vector<double>& vertices, const vector<U32>& elements);
 	bool setup(U32 ctVertices, const double* vertices, U32 ctElements, const U32* elements);
 	void cleanup();
@@ -103,6 +122,20 @@ public:
 	static double ComputeCellDeterminant(const vec3d v[4]);
 	static double ComputeCellVolume(const vec3d v[4]);
 
+	/*!
+	 * \brief mean ratio quality of a tetrahedron, 1 for the regular one and 0 for a flat one.
+	 * The sign follows the orientation of the nodes.
+	 */
+	static double ComputeCellQuality(const vec3d v[4]);
+
+	/*!
+	 * \brief finds the cells with a volume below minVolume or an absolute quality below minQuality.
+	 * The cells are tested in parallel. Pass zero to skip either test.
+	 * @return number of cells found
+	 */
+	U32 findDegenerateCells(double minVolume, double minQuality, vector<U32>& vCells) const;
+
+	//removes the cells below the flat cell volume with a single garbage collection
 	U32 removeZeroVolumeCells();
 
 
@@ -169,6 +202,17 @@ public:
 	int get_disjoint_parts(vector<vector<U32>>& cellgroups);
 	void printParts();
 
+	/*!
+	 * relabels the parts changed since the last update: the parts which lost cells, the new cells
+	 * and the parts next to them. The other parts keep their labels.
+	 * @return number of relabelled cells
+	 */
+	U32 update_disjoint_parts(vector<U32>* pvOutChangedParts = NULL);
+
+	//part label of a cell, valid after update_disjoint_parts. Labels only grow.
+	U32 cell_part(U32 idxCell) const { return m_vCellParts[idxCell];}
+	U32 count_part_labels() const { return m_ctPartLabels;}
+
 	//schedule a cell removal at the next GC
 	void schedule_remove_cell(U32 idxCell);
 
@@ -206,42 +250,55 @@ public:
 	//algorithmic functions
 	int getNodeIncidentEdges(U32 idxNode, vector<U32>& incidentEdges) const;
 	int getNodeIncidentNodes(U32 idxNode, vector<U32>& incidentNodes) const;
+	int getNodeIncidentCells(U32 idxNode, vector<U32>& incidentCells) const;
+	int getEdgeIncidentCells(U32 idxEdge, vector<U32>& incidentCells) const;
 	bool getCellFacesExpensive(U32 idxCell, U32 (&faces)[4]);
 	bool getCellEdgesExpensive(U32 idxCell, U32 (&edges)[6]);
 
-	//show individual entities
-	void setElemToShow(U32 elem = INVALID_INDEX);
-	U32 getElemToShow() const {return m_elemToShow;}
-	void setNodeToShow(U32 idxNode = INVALID_INDEX);
-	U32 getNodeToShow() const {return m_nodeToShow;}
-
-	//flag on what to show
-	void setFlagDrawWireFrame(bool drawWireFrame) { m_flagDrawWireFrameMesh = drawWireFrame;}
-	bool getFlagDrawWireFrame() const {return m_flagDrawWireFrameMesh;}
-
-	void setFlagDrawNodes(bool drawNodes) { m_flagDrawNodes = drawNodes;}
-	bool getFlagDrawNodes() const {return m_flagDrawNodes;}
-
 	void setFlagFilterOutFlatCells(bool flag) { m_flagFilterOutFlatCells = flag;}
 	bool getFlagFilterOutFlatCells() const {return m_flagFilterOutFlatCells;}
 
+	//cells below this volume are flat. defaults to FLAT_CELL_VOLUME
+	void setFlatCellVolume(double vol) { m_flatCellVolume = vol;}
+	double getFlatCellVolume() const {return m_flatCellVolume;}
 
-	//set base color
-	Color getColor() const {return m_color;}
-	void setColor(const Color& c) { m_color = c;}
+	/*!
+	 * optional repair of the input arrays in setup, before the topology is built. Nodes within the
+	 * weld distance are merged and the cells with a negative determinant are reoriented. Both are
+	 * off by default. Meshes read from the native binary format are not repaired.
+	 */
+	void setWeldDistance(double dist) { m_weldDistance = dist;}
+	double getWeldDistance() const {return m_weldDistance;}
 
+	void setFlagOrientCells(bool flag) { m_flagOrientCells = flag;}
+	bool getFlagOrientCells() const {return m_flagOrientCells;}
 
-	//draw
-	void draw();
-	void drawElement(U32 i) const;
+	/*!
+	 * merges every node into the first node within dist of it, directly or through other merged
+	 * nodes. Nodes are found with a spatial hash of dist sized cells and searched in parallel.
+	 * The cells are remapped to the kept nodes and the collapsed ones are removed.
+	 * @return number of merged nodes
+	 */
+	static U32 WeldNodes(double dist, vector<double>& vertices, vector<U32>& elements);
+
+	//swaps two nodes of the cells with a negative determinant. returns the number of swapped cells
+	static U32 OrientCells(const vector<double>& vertices, vector<U32>& elements);
+
+	//name
+	string name() const {return m_name;}
+	void setName(const string& name) {m_name = name;}
 
 	//aabb
 	AABB computeAABB();
+	virtual AABB aabb() const { return m_aabb;}
 
 
 	//selects a node using a ray intersection test
 	int selectNode(const Ray& ray) const;
 
+	//incremented on every change to the mesh nodes or topology
+	U64 version() const { return m_version;}
+
 	bool verbose() const { return m_verbose;}
 	void setVerbose(bool b) { m_verbose = b;}
 
@@ -286,20 +343,30 @@ protected:
 	void remove_edge_core(U32 idxEdge);
 	void remove_node_core(U32 idxNode);
 
+	//garbage collection: maps the old handles to the compacted ones, INVALID_INDEX when removed
+	static U32 compute_handle_map(const vector<U8>& vAlive, vector<U32>& vHandleMap);
+
+	//drops the removed handles from an incident list and maps the remaining ones
+	static void compact_handles(vector<U32>& vHandles, const vector<U32>& vHandleMap);
+
 protected:
-	U32 m_elemToShow;
-	U32 m_nodeToShow;
+	string m_name;
+	AABB m_aabb;
 	bool m_verbose;
-	bool m_flagDrawWireFrameMesh;
-	bool m_flagDrawNodes;
 	bool m_flagFilterOutFlatCells;
-	Color m_color;
+	double m_flatCellVolume;
+	double m_weldDistance;
+	bool m_flagOrientCells;
+	U64 m_version;
 
 	//topology events
 	OnNodeEvent m_fOnNodeEvent;
 	OnEdgeEvent m_fOnEdgeEvent;
 	OnFaceEvent m_fOnFaceEvent;
 	OnCellEvent m_fOnElementEvent;
+	OnMeshChanged m_fOnMeshChanged;
+	bool m_flagDeferMeshChanged;
+	mutable bool m_isMeshChangedPending;
 
 	//containers
 	vector<CELL> m_vCells;
@@ -310,6 +377,11 @@ protected:
 	//marked cells to be deleted at the next GC
 	vector<U32> m_pendingToDeleteCells;
 
+	//disjoint parts: label per cell, INVALID_INDEX for the cells added since the last update
+	vector<U32> m_vCellParts;
+	vector<U32> m_vDirtyParts;
+	U32 m_ctPartLabels;
+
 	//top-down access
 	vector< vector<U32> > m_incident_edges_per_node;
 	vector< vector<U32> > m_incident_faces_per_edge;
@@ -5,214 +5,449 @@
  *      Author: pourya
  */
 
+#include <algorithm>
 #include <fstream>
+#include <string.h>
+#include <float.h>
+#include <stdio.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
 #include "VolMeshIO.h"
 #include "base/directory.h"
 #include "base/logger.h"
 #include "base/flatarray.h"
-#include "scene/surfacemesh.h"
+#include "base/mappedfile.h"
+#include "base/textparse.h"
+#include "base/profiler.h"
 #include "elastic/volmesh.h"
+#include "elastic/volmeshsamples.h"
 
 using namespace std;
 using namespace ps::elastic;
 using namespace ps::base;
 using namespace ps::dir;
-using namespace ps::scene;
 
 namespace ps {
 namespace elastic {
 
+//vega sections are parsed in chunks of about this many bytes
+#define VEGA_PARSE_CHUNK_SIZE (256 * 1024)
+
+namespace {
+
+//a section of the file: from the line after its '*' keyword up to the next keyword
+struct VEGASECTION {
+	const char* first;
+	const char* last;
+};
+
+/*!
+ * finds the count line of a section, e.g. "1024 3 0 0" and returns the data after it.
+ * Lines with less than two tokens like TETS are skipped the same way the old reader did.
+ */
+bool ReadSectionHeader(VEGASECTION& section, U32& count, U32& step) {
+	const char* p = section.first;
+	const char* end = section.last;
+	while(p < end) {
+		const char* eol = LineEnd(p, end);
+		const char* q = SkipBlanks(p, eol);
+		if(q < eol && *q != '#') {
+			const char* r = q;
+			if(ParseU32(r, eol, count) && ParseU32(r, eol, step)) {
+				section.first = (eol < end) ? eol + 1 : end;
+				return true;
+			}
+		}
+		p = (eol < end) ? eol + 1 : end;
+	}
+
+	return false;
+}
+
+/*!
+ * parses the rows of a section in parallel. The data is split into chunks at line breaks and
+ * every row is written straight to its slot from its row index, so no merge is needed. The rows
+ * are numbered from idxFirstRow, the columns after the first ctCols are ignored.
+ * @return number of rows read or -1 on a malformed row
+ */
+template <typename T, typename Parser>
+int ParseSectionRows(const VEGASECTION& section, U32 ctRows, U32 ctCols, U32 idxFirstRow, vector<T>& vOut, Parser fParse) {
+	const char* first = section.first;
+	const char* last = section.last;
+
+	//chunk boundaries
+	vector<const char*> vChunks;
+	vChunks.push_back(first);
+	while(vChunks.back() < last) {
+		const char* p = last;
+		if(last - vChunks.back() > VEGA_PARSE_CHUNK_SIZE) {
+			p = LineEnd(vChunks.back() + VEGA_PARSE_CHUNK_SIZE, last);
+			if(p < last)
+				p++;
+		}
+		vChunks.push_back(p);
+	}
+
+	vOut.resize((size_t)ctRows * ctCols);
+	vector<int> vChunkRows(vChunks.size(), 0);
+
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, vChunks.size() - 1, 1),
+		[&](const tbb::blocked_range<size_t>& r) {
+		for(size_t c = r.begin(); c != r.end(); c++) {
+			const char* p = vChunks[c];
+			const char* end = vChunks[c + 1];
+			int ctRead = 0;
+			while(p < end) {
+				const char* eol = LineEnd(p, end);
+				const char* q = SkipBlanks(p, eol);
+				if(q < eol && *q != '#') {
+					U32 row = 0;
+					if(!ParseU32(q, eol, row) || row < idxFirstRow || row - idxFirstRow >= ctRows) {
+						ctRead = -1;
+						break;
+					}
+
+					T* lpRow = &vOut[(size_t)(row - idxFirstRow) * ctCols];
+					bool isValid = true;
+					for(U32 i=0; i < ctCols && isValid; i++)
+						isValid = fParse(q, eol, lpRow[i]);
+
+					if(!isValid) {
+						ctRead = -1;
+						break;
+					}
+					ctRead++;
+				}
+				p = (eol < end) ? eol + 1 : end;
+			}
+			vChunkRows[c] = ctRead;
+		}
+	});
+
+	int total = 0;
+	for(U32 i=0; i < vChunkRows.size(); i++) {
+		if(vChunkRows[i] < 0)
+			return -1;
+		total += vChunkRows[i];
+	}
+	return total;
+}
+
+}
+
 bool VolMeshIO::readVega(VolMesh* vm, const AnsiStr& strPath) {
 
 	if ((vm == NULL) || !FileExists(strPath))
 		return false;
-	char chrLine[1024];
-	ifstream fpIn(strPath.cptr());
-	if (!fpIn.is_open())
-		return false;
 
+	ProfileAutoArg(strPath.cptr());
 
-	vector<double> vertices;
-	vector<U32> elements;
+	MappedFile mf;
+	if(!mf.open(strPath))
+		return false;
 
-	U32 ctLine = 0;
+	const char* data = mf.data();
+	const char* end = data + mf.size();
+
+	//find the sections, a keyword is the first token of its line
+	VEGASECTION secVertices = {NULL, NULL};
+	VEGASECTION secElements = {NULL, NULL};
+	VEGASECTION* lpCurrent = NULL;
+	const char* p = data;
+	while(p < end) {
+		const char* eol = LineEnd(p, end);
+		const char* q = SkipBlanks(p, eol);
+		if(q < eol && *q == '*') {
+			if(lpCurrent)
+				lpCurrent->last = p;
+			lpCurrent = NULL;
+
+			const char* r = q;
+			while(r < eol && !IsBlank(*r))
+				r++;
+			AnsiStr strKey(q, (int)(r - q));
+			if(strKey == "*VERTICES")
+				lpCurrent = &secVertices;
+			else if(strKey == "*ELEMENTS")
+				lpCurrent = &secElements;
+
+			if(lpCurrent)
+				lpCurrent->first = (eol < end) ? eol + 1 : end;
+		}
+		p = (eol < end) ? eol + 1 : end;
+	}
+	if(lpCurrent)
+		lpCurrent->last = end;
+
+	if(secVertices.first == NULL || secElements.first == NULL) {
+		vlogerror("Missing vertices or elements section in %s", strPath.cptr());
+		return false;
+	}
 
-	U32 idxVertex = 0;
 	U32 ctVertices = 0;
 	U32 ctVertexStep = 0;
+	if(!ReadSectionHeader(secVertices, ctVertices, ctVertexStep) || ctVertices == 0 || ctVertexStep != 3)
+		return false;
 
-	U32 idxElement = 0;
 	U32 ctElements = 0;
 	U32 ctElementStep = 0;
+	if(!ReadSectionHeader(secElements, ctElements, ctElementStep) || ctElements == 0 || ctElementStep != 4)
+		return false;
 
-	enum READMODE {
-		modeReadHeader, modeReadVertex, modeReadElements,
-		modeReadMaterial, modeReadRegion
-	};
+	//parse the rows
+	vector<double> vertices;
+	int ctReadVertices = ParseSectionRows(secVertices, ctVertices, 3, 1, vertices, ParseDouble);
 
-	READMODE mode = modeReadHeader;
-	READMODE prevMode = mode;
+	vector<U32> elements;
+	int ctReadElements = ParseSectionRows(secElements, ctElements, 4, 1, elements,
+		[](const char*& q, const char* eol, U32& out) {
+			if(!ParseU32(q, eol, out) || out == 0)
+				return false;
+			out--;
+			return true;
+		});
 
-	while (!fpIn.eof()) {
-		fpIn.getline(chrLine, 1024);
+	//check read amount
+	if(ctReadVertices != (int)ctVertices || ctReadElements != (int)ctElements) {
+		vlogerror("Read %d of %u vertices and %d of %u elements from %s",
+				  ctReadVertices, ctVertices, ctReadElements, ctElements, strPath.cptr());
+		return false;
+	}
+	mf.close();
 
-		AnsiStr strLine(chrLine);
-		strLine.trim();
-		strLine.removeStartEndSpaces();
-		if (strLine.length() == 0)
-			continue;
+	//setup mesh
+	vm->cleanup();
+	vm->setName(ExtractFileTitleOnly(strPath).cptr());
+	return vm->setup(ctVertices, &vertices[0], ctElements, &elements[0]);
+}
 
-		if (strLine.firstChar() == '#')
-			continue;
-		if (strLine.firstChar() == '*') {
-			vector<AnsiStr> tokens;
-			strLine.decompose(' ', tokens);
-			if (tokens[0] == "*VERTICES")
-				mode = modeReadVertex;
-			else if (tokens[0] == "*ELEMENTS")
-				mode = modeReadElements;
-			else if (tokens[0] == "*MATERIAL")
-				mode = modeReadMaterial;
-			else if (tokens[0] == "*REGION")
-				mode = modeReadRegion;
+//text exporters format this many rows per task
+#define EXPORT_BLOCK_SIZE 4096
 
-			continue;
-		}
-		else if(strLine == "TETS")
-			continue;
+//formatter helpers, every one writes to p and returns the end of the written text
+namespace {
 
-		//count tokens
-		{
-			vector<AnsiStr> tokens;
-			int ctTokens = strLine.decompose(' ', tokens);
-			if(ctTokens < 2)
-				continue;
-		}
+char* FormatU32(char* p, U32 v) {
+	char digits[10];
+	int ct = 0;
+	do {
+		digits[ct++] = (char)('0' + v % 10);
+		v /= 10;
+	} while(v != 0);
 
-		if (prevMode != mode) {
-			if (mode == modeReadVertex && idxVertex == 0) {
-				sscanf(strLine.cptr(), "%u %u", &ctVertices, &ctVertexStep);
-				if (ctVertices <= 0 || ctVertexStep != 3) {
-					fpIn.close();
-					return false;
-				}
+	while(ct > 0)
+		*p++ = digits[--ct];
+	return p;
+}
 
-				vertices.reserve(ctVertices * ctVertexStep);
-				prevMode = mode;
-				continue;
-			} else if (mode == modeReadElements && idxElement == 0) {
-				sscanf(strLine.cptr(), "%u %u", &ctElements, &ctElementStep);
-				if (ctElements <= 0 || ctElementStep != 4) {
-					fpIn.close();
-					return false;
-				}
+/*!
+ * locale independent double to text which reads back to the same value. Values in the usual
+ * range of mesh coordinates are written in fixed point with the fewest decimals that round
+ * trip: the scaled value is an exact integer and the power of ten is exact, so one divide
+ * tells whether the decimals read back. Other values use the fewest of 15 to 17 significant
+ * digits which read back.
+ */
+char* FormatDouble(char* p, double v) {
+	if(v != v) {
+		memcpy(p, "nan", 3);
+		return p + 3;
+	}
 
-				elements.reserve(ctElements * ctElementStep);
-				prevMode = mode;
-				continue;
-			}
-		}
+	if(v < 0.0 || (v == 0.0 && 1.0 / v < 0.0)) {
+		*p++ = '-';
+		v = -v;
+	}
 
-		if (mode == modeReadVertex) {
-			vec3d v;
-			vector<AnsiStr> arrWords;
-			int ctWords = strLine.decompose(' ', arrWords);
+	if(v == 0.0) {
+		*p++ = '0';
+		return p;
+	}
 
-			if (ctWords >= 4) {
-				U32 row = atoi(arrWords[0].cptr()) - 1;
-				assert(row == idxVertex);
+	if(v > DBL_MAX) {
+		memcpy(p, "inf", 3);
+		return p + 3;
+	}
 
-				v.x = atof(arrWords[1].cptr());
-				v.y = atof(arrWords[2].cptr());
-				v.z = atof(arrWords[3].cptr());
-			}
+	if(v >= 1e-5 && v < 1e15) {
+		for(int k=0; k < EXACT_POW10_COUNT; k++) {
+			double scaled = v * g_arrPow10[k];
+			if(scaled >= 9007199254740992.0)
+				break;
+
+			//scaled is exact in its fraction here, so the rounding can not tie to even
+			U64 m = (U64)scaled;
+			if(scaled - (double)m >= 0.5)
+				m++;
+			if((double)m / g_arrPow10[k] != v)
+				continue;
 
-			//add vertex to the array
-			vertices.push_back(v.x);
-			vertices.push_back(v.y);
-			vertices.push_back(v.z);
-			idxVertex++;
-
-		} else if (mode == modeReadElements) {
-			vec4u32 e;
-			vector<AnsiStr> arrWords;
-			int ctWords = strLine.decompose(' ', arrWords);
-			if (ctWords >= 5) {
-				U32 row = atoi(arrWords[0].cptr()) - 1;
-				assert(row == idxElement);
-
-				e.x = atoi(arrWords[1].cptr()) - 1;
-				e.y = atoi(arrWords[2].cptr()) - 1;
-				e.z = atoi(arrWords[3].cptr()) - 1;
-				e.w = atoi(arrWords[4].cptr()) - 1;
+			//integer part then k decimals
+			char digits[24];
+			int ct = 0;
+			do {
+				digits[ct++] = (char)('0' + m % 10);
+				m /= 10;
+			} while(m != 0);
+
+			while(ct <= k)
+				digits[ct++] = '0';
+
+			while(ct > k)
+				*p++ = digits[--ct];
+			if(k > 0) {
+				*p++ = '.';
+				while(ct > 0)
+					*p++ = digits[--ct];
 			}
+			return p;
+		}
+	}
 
-			//add element to the array
-			elements.push_back(e.x);
-			elements.push_back(e.y);
-			elements.push_back(e.z);
-			elements.push_back(e.w);
-
-			idxElement++;
+	//the fewest significant digits which read back. The decimal separator is the only locale
+	//dependent part of printf
+	char buf[32];
+	int len = 0;
+	for(int precision = 15; precision <= 17; precision++) {
+		len = snprintf(buf, sizeof(buf), "%.*g", precision, v);
+		for(int i=0; i < len; i++) {
+			char c = buf[i];
+			if(!((c >= '0' && c <= '9') || c == 'e' || c == '-' || c == '+'))
+				buf[i] = '.';
 		}
 
-		prevMode = mode;
-		ctLine++;
+		const char* q = buf;
+		double readback = 0.0;
+		if(ParseDouble(q, buf + len, readback) && readback == v)
+			break;
 	}
-	fpIn.close();
 
-	//check read amount
-	if((vertices.size() / ctVertexStep) != ctVertices)
-		return false;
+	memcpy(p, buf, len);
+	return p + len;
+}
 
-	if((elements.size() / ctElementStep) != ctElements)
-		return false;
+/*!
+ * formats the rows in blocks of EXPORT_BLOCK_SIZE in parallel and writes the blocks in order.
+ * fRow writes row i to p and returns its end, a row is at most szMaxRow bytes.
+ */
+template <typename RowFunc>
+bool WriteRows(ofstream& fpOut, U32 ctRows, U32 szMaxRow, RowFunc fRow) {
+	U32 ctBlocks = (ctRows + EXPORT_BLOCK_SIZE - 1) / EXPORT_BLOCK_SIZE;
+	vector<string> vBlocks(ctBlocks);
+
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctBlocks, 1),
+		[&](const tbb::blocked_range<U32>& r) {
+		for(U32 b = r.begin(); b != r.end(); b++) {
+			U32 first = b * EXPORT_BLOCK_SIZE;
+			U32 last = std::min<U32>(first + EXPORT_BLOCK_SIZE, ctRows);
+
+			string& block = vBlocks[b];
+			block.resize((size_t)(last - first) * szMaxRow);
+			char* p = &block[0];
+			for(U32 i = first; i < last; i++)
+				p = fRow(p, i);
+			block.resize(p - &block[0]);
+		}
+	});
+
+	for(U32 b=0; b < ctBlocks; b++)
+		fpOut.write(vBlocks[b].data(), vBlocks[b].size());
+	return fpOut.good();
+}
 
-	//setup mesh
-	vm->cleanup();
-	vm->setName(ExtractFileTitleOnly(strPath).cptr());
-	return vm->setup(vertices, elements);
+}
+
+void VolMeshIO::snapshot(const VolMesh* vm, VOLMESHSNAPSHOT& outSnapshot, bool withFaces) {
+	U32 ctNodes = vm->countNodes();
+	U32 ctCells = vm->countCells();
+
+	outSnapshot.name = vm->name();
+	outSnapshot.vNodes.resize((size_t)ctNodes * 3);
+	outSnapshot.vCells.resize((size_t)ctCells * COUNT_CELL_NODES);
+	outSnapshot.vCellFaces.resize(withFaces ? (size_t)ctCells * COUNT_CELL_FACES * 3 : 0);
+
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctNodes, EXPORT_BLOCK_SIZE),
+		[&](const tbb::blocked_range<U32>& r) {
+		for(U32 i = r.begin(); i != r.end(); i++) {
+			const vec3d& pos = vm->const_nodeAt(i).pos;
+			outSnapshot.vNodes[i * 3 + 0] = pos.x;
+			outSnapshot.vNodes[i * 3 + 1] = pos.y;
+			outSnapshot.vNodes[i * 3 + 2] = pos.z;
+		}
+	});
+
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctCells, EXPORT_BLOCK_SIZE),
+		[&](const tbb::blocked_range<U32>& r) {
+		for(U32 i = r.begin(); i != r.end(); i++) {
+			const CELL& cell = vm->const_cellAt(i);
+			for(int j=0; j < COUNT_CELL_NODES; j++)
+				outSnapshot.vCells[i * COUNT_CELL_NODES + j] = cell.nodes[j];
+
+			if(withFaces) {
+				U32 nodes[3];
+				for(int j=0; j < COUNT_CELL_FACES; j++) {
+					vm->getFaceNodes(cell.faces[j], nodes);
+					for(int k=0; k < 3; k++)
+						outSnapshot.vCellFaces[(i * COUNT_CELL_FACES + j) * 3 + k] = nodes[k];
+				}
+			}
+		}
+	});
 }
 
 bool VolMeshIO::writeVega(const VolMesh* vm, const AnsiStr& strPath) {
 	if(vm == NULL)
 		return false;
 
-	if (vm->countNodes() == 0 || vm->countCells() == 0)
+	VOLMESHSNAPSHOT snap;
+	snapshot(vm, snap, false);
+	return writeVega(snap, strPath);
+}
+
+bool VolMeshIO::writeVega(const VOLMESHSNAPSHOT& snap, const AnsiStr& strPath) {
+	U32 ctNodes = (U32)(snap.vNodes.size() / 3);
+	U32 ctCells = (U32)(snap.vCells.size() / COUNT_CELL_NODES);
+	if (ctNodes == 0 || ctCells == 0)
 		return false;
 
 	//Output veg file
 	AnsiStr strVegFP = ChangeFileExt(strPath, ".veg");
 	ofstream fpOut(strVegFP.cptr());
+	if(!fpOut.is_open())
+		return false;
 
 	//Include Node File
 	fpOut << "# Vega Mesh File, Generated by FemBrain.\n";
-	fpOut << "# " << vm->countNodes() << " vertices, " << vm->countCells() << " elements\n";
+	fpOut << "# " << ctNodes << " vertices, " << ctCells << " elements\n";
 	fpOut << "\n";
 	fpOut << "*VERTICES\n";
-	fpOut << vm->countNodes() << " 3 0 0\n";
-
-	for (U32 i = 0; i < vm->countNodes(); i++) {
-		vec3d v = vm->const_nodeAt(i).pos;
-
-		//VEGA expects one based index for everything
-		fpOut << i + 1 << " " << v.x << " " << v.y << " " << v.z << "\n";
-	}
+	fpOut << ctNodes << " 3 0 0\n";
+
+	//VEGA expects one based index for everything
+	bool res = WriteRows(fpOut, ctNodes, 96, [&snap](char* p, U32 i) {
+		p = FormatU32(p, i + 1);
+		for(int j=0; j < 3; j++) {
+			*p++ = ' ';
+			p = FormatDouble(p, snap.vNodes[i * 3 + j]);
+		}
+		*p++ = '\n';
+		return p;
+	});
 
 	//Line Separator
 	fpOut << "\n";
 	fpOut << "*ELEMENTS\n";
 	fpOut << "TET\n";
-	fpOut << vm->countCells() << " 4 0\n";
-
-	for (U32 i = 0; i < vm->countCells(); i++) {
-		const CELL& cell = vm->const_cellAt(i);
-		vec4u32 n = vec4u32(&cell.nodes[0]);
+	fpOut << ctCells << " 4 0\n";
 
-		//VEGA expects one based index for everything
-		fpOut << i + 1 << " " << n.x + 1 << " " << n.y + 1 << " " << n.z + 1
-				<< " " << n.w + 1 << "\n";
-	}
+	res &= WriteRows(fpOut, ctCells, 64, [&snap](char* p, U32 i) {
+		p = FormatU32(p, i + 1);
+		for(int j=0; j < COUNT_CELL_NODES; j++) {
+			*p++ = ' ';
+			p = FormatU32(p, snap.vCells[i * COUNT_CELL_NODES + j] + 1);
+		}
+		*p++ = '\n';
+		return p;
+	});
 
 	//Add Default Material
 	fpOut << "\n";
@@ -224,41 +459,1340 @@ bool VolMeshIO::writeVega(const VolMesh* vm, const AnsiStr& strPath) {
 	fpOut << "allElements, BODY\n";
 
 	//Include Element File
+	res &= fpOut.good();
 	fpOut.close();
 
+	return res;
+}
+
+/*
+ * Native binary layout, all values little-endian:
+ * header, section table, then the sections each starting at a VOLMESH_BINARY_ALIGN boundary.
+ * A section is a flat array of fixed size records. The incidence tables are stored as an
+ * offsets array with one more entry than the list count followed by the concatenated lists.
+ * Readers skip the sections they do not know.
+ */
+#define VOLMESH_BINARY_MAGIC "TCVMESH"
+#define VOLMESH_BINARY_ENDIAN 0x01020304
+#define VOLMESH_BINARY_ALIGN 64
+
+namespace {
+
+enum VOLMESH_BINARY_SECTION {
+	vmbName = 1, vmbNodes, vmbEdges, vmbFaces, vmbCells,
+	vmbNodeEdgeOffsets, vmbNodeEdges, vmbEdgeFaceOffsets, vmbEdgeFaces,
+	vmbFaceCellOffsets, vmbFaceCells, vmbEdgeMap, vmbCellParts,
+	vmbCount
+};
+
+struct VOLMESH_BINARY_HEADER {
+	char magic[8];
+	U32 version;
+	U32 endian;
+	U32 ctSections;
+	U32 ctPartLabels;
+	U32 reserved[10];
+};
+
+struct VOLMESH_BINARY_SECTION_ENTRY {
+	U32 id;
+	U32 szRecord;
+	U64 count;
+	U64 offset;
+	U64 reserved;
+};
+
+struct VOLMESH_BINARY_EDGEMAP_ENTRY {
+	U64 key;
+	U64 idxEdge;
+};
+
+bool IsLittleEndianHost() {
+	const U32 marker = 1;
+	return *(const U8*)&marker == 1;
+}
+
+//flattens incidence lists to offsets and values
+void FlattenLists(const vector< vector<U32> >& vLists, vector<U32>& vOffsets, vector<U32>& vValues) {
+	vOffsets.resize(vLists.size() + 1);
+	vOffsets[0] = 0;
+	for(U32 i=0; i < vLists.size(); i++)
+		vOffsets[i + 1] = vOffsets[i] + (U32)vLists[i].size();
+
+	vValues.resize(vOffsets.back());
+	for(U32 i=0; i < vLists.size(); i++) {
+		if(vLists[i].size() > 0)
+			memcpy(&vValues[vOffsets[i]], &vLists[i][0], vLists[i].size() * sizeof(U32));
+	}
+}
+
+//rebuilds incidence lists from offsets and values, the values must be below ctHandles
+bool UnflattenLists(const U32* lpOffsets, const U32* lpValues, U64 ctValues, U32 ctLists, U32 ctHandles,
+					vector< vector<U32> >& vLists) {
+	if(lpOffsets[0] != 0 || lpOffsets[ctLists] != ctValues)
+		return false;
+	for(U32 i=0; i < ctLists; i++) {
+		if(lpOffsets[i] > lpOffsets[i + 1])
+			return false;
+	}
+	for(U64 i=0; i < ctValues; i++) {
+		if(lpValues[i] >= ctHandles)
+			return false;
+	}
+
+	vLists.resize(ctLists);
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctLists, SETUP_BLOCK_SIZE),
+		[&](const tbb::blocked_range<U32>& r) {
+		for(U32 i = r.begin(); i != r.end(); i++)
+			vLists[i].assign(lpValues + lpOffsets[i], lpValues + lpOffsets[i + 1]);
+	});
 	return true;
 }
 
-bool VolMeshIO::writeObj(const VolMesh* vm, const AnsiStr& strPath) {
+}
+
+bool VolMeshIO::readBinary(VolMesh* vm, const AnsiStr& strPath) {
+	if ((vm == NULL) || !FileExists(strPath))
+		return false;
+
+	if(!IsLittleEndianHost()) {
+		vlogerror("The binary mesh format is little-endian only");
+		return false;
+	}
+
+	ProfileAutoArg(strPath.cptr());
+
+	MappedFile mf;
+	if(!mf.open(strPath))
+		return false;
+
+	//header
+	const VOLMESH_BINARY_HEADER* lpHeader = (const VOLMESH_BINARY_HEADER*)mf.data();
+	if(mf.size() < sizeof(VOLMESH_BINARY_HEADER) ||
+	   memcmp(lpHeader->magic, VOLMESH_BINARY_MAGIC, sizeof(lpHeader->magic)) != 0) {
+		vlogerror("Not a binary mesh file: %s", strPath.cptr());
+		return false;
+	}
+
+	if(lpHeader->version > VOLMESH_BINARY_VERSION || lpHeader->endian != VOLMESH_BINARY_ENDIAN) {
+		vlogerror("Unsupported binary mesh version %u in %s", lpHeader->version, strPath.cptr());
+		return false;
+	}
+
+	U64 szTable = sizeof(VOLMESH_BINARY_HEADER) + (U64)lpHeader->ctSections * sizeof(VOLMESH_BINARY_SECTION_ENTRY);
+	if(szTable > mf.size())
+		return false;
+
+	//sections
+	const VOLMESH_BINARY_SECTION_ENTRY* lpTable = (const VOLMESH_BINARY_SECTION_ENTRY*)(lpHeader + 1);
+	const void* arrData[vmbCount] = {NULL};
+	U64 arrCount[vmbCount] = {0};
+	bool arrFound[vmbCount] = {false};
+	const U32 arrRecordSize[vmbCount] = {0, sizeof(char), sizeof(NODE), sizeof(EDGE), sizeof(FACE), sizeof(CELL),
+		sizeof(U32), sizeof(U32), sizeof(U32), sizeof(U32), sizeof(U32), sizeof(U32),
+		sizeof(VOLMESH_BINARY_EDGEMAP_ENTRY), sizeof(U32) };
+
+	for(U32 i=0; i < lpHeader->ctSections; i++) {
+		const VOLMESH_BINARY_SECTION_ENTRY& entry = lpTable[i];
+		if(entry.id == 0 || entry.id >= vmbCount)
+			continue;
+
+		if(entry.szRecord != arrRecordSize[entry.id] || entry.offset % VOLMESH_BINARY_ALIGN != 0 ||
+		   entry.offset > mf.size() || entry.count > (mf.size() - entry.offset) / entry.szRecord) {
+			vlogerror("Corrupt section %u in %s", entry.id, strPath.cptr());
+			return false;
+		}
+
+		arrData[entry.id] = mf.data() + entry.offset;
+		arrCount[entry.id] = entry.count;
+		arrFound[entry.id] = true;
+	}
+
+	//the name and the part labels are optional
+	for(U32 i = vmbNodes; i < vmbCellParts; i++) {
+		if(!arrFound[i]) {
+			vlogerror("Missing section %u in %s", i, strPath.cptr());
+			return false;
+		}
+	}
+
+	U64 ctNodes = arrCount[vmbNodes];
+	U64 ctEdges = arrCount[vmbEdges];
+	U64 ctFaces = arrCount[vmbFaces];
+	U64 ctCells = arrCount[vmbCells];
+	if(ctNodes >= VolMesh::INVALID_INDEX || ctEdges >= VolMesh::INVALID_INDEX ||
+	   ctFaces >= VolMesh::INVALID_INDEX || ctCells >= VolMesh::INVALID_INDEX ||
+	   arrCount[vmbNodeEdgeOffsets] != ctNodes + 1 || arrCount[vmbEdgeFaceOffsets] != ctEdges + 1 ||
+	   arrCount[vmbFaceCellOffsets] != ctFaces + 1 || arrCount[vmbEdgeMap] != ctEdges ||
+	   (arrFound[vmbCellParts] && arrCount[vmbCellParts] != ctCells)) {
+		vlogerror("Inconsistent entity counts in %s", strPath.cptr());
+		return false;
+	}
+
+	//entities, every handle must be in range
+	const NODE* lpNodes = (const NODE*)arrData[vmbNodes];
+	const EDGE* lpEdges = (const EDGE*)arrData[vmbEdges];
+	const FACE* lpFaces = (const FACE*)arrData[vmbFaces];
+	const CELL* lpCells = (const CELL*)arrData[vmbCells];
+
+	bool isValid = true;
+	for(U64 i=0; i < ctEdges && isValid; i++)
+		isValid = (lpEdges[i].from < ctNodes && lpEdges[i].to < ctNodes);
+	for(U64 i=0; i < ctFaces && isValid; i++) {
+		for(int j=0; j < COUNT_FACE_EDGES; j++)
+			isValid &= (lpFaces[i].edges[j] < ctEdges);
+	}
+	for(U64 i=0; i < ctCells && isValid; i++) {
+		for(int j=0; j < COUNT_CELL_NODES; j++)
+			isValid &= (lpCells[i].nodes[j] < ctNodes && lpCells[i].faces[j] < ctFaces);
+		for(int j=0; j < COUNT_CELL_EDGES; j++)
+			isValid &= (lpCells[i].edges[j] < ctEdges);
+	}
+
+	//edge map keys are sorted so the map is filled in linear time
+	const VOLMESH_BINARY_EDGEMAP_ENTRY* lpEdgeMap = (const VOLMESH_BINARY_EDGEMAP_ENTRY*)arrData[vmbEdgeMap];
+	for(U64 i=0; i < ctEdges && isValid; i++) {
+		isValid = (lpEdgeMap[i].idxEdge < ctEdges);
+		if(i > 0)
+			isValid &= (lpEdgeMap[i - 1].key < lpEdgeMap[i].key);
+	}
+
+	if(!isValid) {
+		vlogerror("Handles out of range in %s", strPath.cptr());
+		return false;
+	}
+
+	//adopt the arrays
+	vm->cleanup();
+	vm->m_vNodes.assign(lpNodes, lpNodes + ctNodes);
+	vm->m_vEdges.assign(lpEdges, lpEdges + ctEdges);
+	vm->m_vFaces.assign(lpFaces, lpFaces + ctFaces);
+	vm->m_vCells.assign(lpCells, lpCells + ctCells);
+
+	if(!UnflattenLists((const U32*)arrData[vmbNodeEdgeOffsets], (const U32*)arrData[vmbNodeEdges],
+					   arrCount[vmbNodeEdges], (U32)ctNodes, (U32)ctEdges, vm->m_incident_edges_per_node) ||
+	   !UnflattenLists((const U32*)arrData[vmbEdgeFaceOffsets], (const U32*)arrData[vmbEdgeFaces],
+					   arrCount[vmbEdgeFaces], (U32)ctEdges, (U32)ctFaces, vm->m_incident_faces_per_edge) ||
+	   !UnflattenLists((const U32*)arrData[vmbFaceCellOffsets], (const U32*)arrData[vmbFaceCells],
+					   arrCount[vmbFaceCells], (U32)ctFaces, (U32)ctCells, vm->m_incident_cells_per_face)) {
+		vlogerror("Corrupt incidence tables in %s", strPath.cptr());
+		vm->cleanup();
+		return false;
+	}
+
+	for(U64 i=0; i < ctEdges; i++)
+		vm->m_mapEdgesIndex.insert(vm->m_mapEdgesIndex.end(),
+								   std::make_pair(EdgeKey(lpEdgeMap[i].key), (U32)lpEdgeMap[i].idxEdge));
+
+	//part labels are recomputed when they are not stored or out of range
+	const U32* lpParts = (const U32*)arrData[vmbCellParts];
+	vm->m_ctPartLabels = 0;
+	if(arrFound[vmbCellParts]) {
+		vm->m_vCellParts.assign(lpParts, lpParts + ctCells);
+		vm->m_ctPartLabels = lpHeader->ctPartLabels;
+		for(U64 i=0; i < ctCells; i++) {
+			if(vm->m_vCellParts[i] != VolMesh::INVALID_INDEX && vm->m_vCellParts[i] >= vm->m_ctPartLabels)
+				vm->m_vCellParts[i] = VolMesh::INVALID_INDEX;
+		}
+	}
+	else
+		vm->m_vCellParts.assign(ctCells, (U32)VolMesh::INVALID_INDEX);
+
+	//name
+	if(arrFound[vmbName] && arrCount[vmbName] > 0)
+		vm->setName(string((const char*)arrData[vmbName], arrCount[vmbName]));
+	else
+		vm->setName(ExtractFileTitleOnly(strPath).cptr());
+
+	if(vm->m_fOnElementEvent) {
+		for(U32 i=0; i < vm->countCells(); i++)
+			vm->m_fOnElementEvent(vm->m_vCells[i], i, VolMesh::teAdded);
+	}
 
+	vm->computeAABB();
+	return true;
+}
+
+bool VolMeshIO::writeBinary(const VolMesh* vm, const AnsiStr& strPath) {
 	if(vm == NULL)
 		return false;
 
-	Mesh objMesh;
-	MeshNode* aNode = new MeshNode();
+	if(!IsLittleEndianHost()) {
+		vlogerror("The binary mesh format is little-endian only");
+		return false;
+	}
 
-	//output nodes
-	for (U32 i = 0; i < vm->countNodes(); i++) {
-		vec3d v = vm->const_nodeAt(i).pos;
+	ofstream fpOut(strPath.cptr(), ios::out | ios::binary | ios::trunc);
+	if(!fpOut.is_open())
+		return false;
 
-		aNode->addVertex(vec3f(v.x, v.y, v.z));
+	//flat incidence tables and the edge map in key order
+	vector<U32> vNodeEdgeOffsets, vNodeEdges;
+	vector<U32> vEdgeFaceOffsets, vEdgeFaces;
+	vector<U32> vFaceCellOffsets, vFaceCells;
+	FlattenLists(vm->m_incident_edges_per_node, vNodeEdgeOffsets, vNodeEdges);
+	FlattenLists(vm->m_incident_faces_per_edge, vEdgeFaceOffsets, vEdgeFaces);
+	FlattenLists(vm->m_incident_cells_per_face, vFaceCellOffsets, vFaceCells);
+
+	vector<VOLMESH_BINARY_EDGEMAP_ENTRY> vEdgeMap;
+	vEdgeMap.reserve(vm->m_mapEdgesIndex.size());
+	for(std::map<EdgeKey, U32>::const_iterator it = vm->m_mapEdgesIndex.begin(); it != vm->m_mapEdgesIndex.end(); ++it) {
+		VOLMESH_BINARY_EDGEMAP_ENTRY entry;
+		entry.key = it->first.key;
+		entry.idxEdge = it->second;
+		vEdgeMap.push_back(entry);
 	}
 
-	//output cell faces
-	for (U32 i = 0; i < vm->countCells(); i++) {
-		const CELL& cell = vm->const_cellAt(i);
-		U32 nodes[3];
+	string strName = vm->name();
 
-		for(U32 j=0; j < COUNT_CELL_FACES; j++) {
+	//sections
+	struct SECTIONDATA {
+		U32 id;
+		U32 szRecord;
+		U64 count;
+		const void* lpData;
+	};
 
-			vm->getFaceNodes(cell.faces[j], nodes);
-			aNode->addTriangle(nodes);
+	#define VMB_SECTION(id, vec) { (U32)(id), (U32)sizeof(vec[0]), (U64)vec.size(), vec.size() ? (const void*)&vec[0] : NULL }
+	const SECTIONDATA arrSections[] = {
+		{ vmbName, sizeof(char), strName.length(), strName.c_str() },
+		VMB_SECTION(vmbNodes, vm->m_vNodes),
+		VMB_SECTION(vmbEdges, vm->m_vEdges),
+		VMB_SECTION(vmbFaces, vm->m_vFaces),
+		VMB_SECTION(vmbCells, vm->m_vCells),
+		VMB_SECTION(vmbNodeEdgeOffsets, vNodeEdgeOffsets),
+		VMB_SECTION(vmbNodeEdges, vNodeEdges),
+		VMB_SECTION(vmbEdgeFaceOffsets, vEdgeFaceOffsets),
+		VMB_SECTION(vmbEdgeFaces, vEdgeFaces),
+		VMB_SECTION(vmbFaceCellOffsets, vFaceCellOffsets),
+		VMB_SECTION(vmbFaceCells, vFaceCells),
+		VMB_SECTION(vmbEdgeMap, vEdgeMap),
+		VMB_SECTION(vmbCellParts, vm->m_vCellParts)
+	};
+	#undef VMB_SECTION
+	const U32 ctSections = sizeof(arrSections) / sizeof(arrSections[0]);
+
+	//header and table
+	VOLMESH_BINARY_HEADER header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, VOLMESH_BINARY_MAGIC, sizeof(header.magic));
+	header.version = VOLMESH_BINARY_VERSION;
+	header.endian = VOLMESH_BINARY_ENDIAN;
+	header.ctSections = ctSections;
+	header.ctPartLabels = vm->m_ctPartLabels;
+
+	vector<VOLMESH_BINARY_SECTION_ENTRY> vTable(ctSections);
+	U64 offset = sizeof(header) + ctSections * sizeof(VOLMESH_BINARY_SECTION_ENTRY);
+	for(U32 i=0; i < ctSections; i++) {
+		offset = (offset + VOLMESH_BINARY_ALIGN - 1) / VOLMESH_BINARY_ALIGN * VOLMESH_BINARY_ALIGN;
+
+		memset(&vTable[i], 0, sizeof(VOLMESH_BINARY_SECTION_ENTRY));
+		vTable[i].id = arrSections[i].id;
+		vTable[i].szRecord = arrSections[i].szRecord;
+		vTable[i].count = arrSections[i].count;
+		vTable[i].offset = offset;
+		offset += arrSections[i].count * arrSections[i].szRecord;
+	}
+
+	fpOut.write((const char*)&header, sizeof(header));
+	fpOut.write((const char*)&vTable[0], ctSections * sizeof(VOLMESH_BINARY_SECTION_ENTRY));
+
+	//data
+	const char padding[VOLMESH_BINARY_ALIGN] = {0};
+	U64 pos = sizeof(header) + ctSections * sizeof(VOLMESH_BINARY_SECTION_ENTRY);
+	for(U32 i=0; i < ctSections; i++) {
+		fpOut.write(padding, vTable[i].offset - pos);
+		if(arrSections[i].count > 0)
+			fpOut.write((const char*)arrSections[i].lpData, arrSections[i].count * arrSections[i].szRecord);
+		pos = vTable[i].offset + arrSections[i].count * arrSections[i].szRecord;
+	}
+
+	bool res = fpOut.good();
+	fpOut.close();
+	return res;
+}
+
+//tetrahedra and the nodes of the other element types in the imported formats
+#define GMSH_TET4 4
+#define GMSH_TET10 11
+#define VTK_TETRA 10
+#define VTK_QUADRATIC_TETRA 24
+
+//helpers of the tetgen, gmsh and vtk importers
+namespace {
+
+inline bool IsSpace(char c) {
+	return (c == ' ' || c == '\t' || c == '\r' || c == '\n');
+}
+
+inline bool ParseU64(const char*& p, const char* end, U64& out) {
+	const char* q = SkipBlanks(p, end);
+	if(q == end || *q < '0' || *q > '9')
+		return false;
+
+	U64 v = 0;
+	while(q < end && *q >= '0' && *q <= '9') {
+		if(v > (0xFFFFFFFFFFFFFFFFULL - 9) / 10)
+			return false;
+		v = v * 10 + (*q - '0');
+		q++;
+	}
+
+	out = v;
+	p = q;
+	return true;
+}
+
+//index of the first data row of a tetgen section, files are numbered from 0 or 1
+bool FindFirstRowIndex(const VEGASECTION& section, U32& idxFirstRow) {
+	const char* p = section.first;
+	while(p < section.last) {
+		const char* eol = LineEnd(p, section.last);
+		const char* q = SkipBlanks(p, eol);
+		if(q < eol && *q != '#')
+			return ParseU32(q, eol, idxFirstRow) && idxFirstRow <= 1;
+		p = (eol < section.last) ? eol + 1 : section.last;
+	}
+	return false;
+}
+
+/*!
+ * reads the numbers of a memory mapped mesh file either as text tokens separated by white space
+ * or as raw binary values. Binary values are byte swapped when the file byte order differs from
+ * the host.
+ */
+struct MESHSTREAM {
+	const char* p;
+	const char* end;
+	bool isBinary;
+	bool isSwapped;
+
+	MESHSTREAM(const char* first, const char* last): p(first), end(last), isBinary(false), isSwapped(false) {}
+
+	void skipSpaces() {
+		while(p < end && IsSpace(*p))
+			p++;
+	}
+
+	//next line with text, without the line break and trailing blanks
+	bool readLine(const char*& first, const char*& last) {
+		skipSpaces();
+		if(p == end)
+			return false;
+
+		first = p;
+		last = LineEnd(p, end);
+		p = (last < end) ? last + 1 : end;
+		while(last > first && IsSpace(*(last - 1)))
+			last--;
+		return true;
+	}
+
+	//moves past the next occurrence of the marker
+	bool seek(const char* lpMarker) {
+		size_t szMarker = strlen(lpMarker);
+		const char* q = std::search(p, end, lpMarker, lpMarker + szMarker);
+		if(q == end)
+			return false;
+		p = q + szMarker;
+		return true;
+	}
+
+	//true if the rest of the file can hold ctValues values of szBinary bytes, or text values with a separator
+	bool canHold(U64 ctValues, U32 szBinary) const {
+		U64 szLeft = (U64)(end - p);
+		return ctValues <= (isBinary ? szLeft / szBinary : szLeft / 2 + 1);
+	}
+
+	template <typename T>
+	bool readRaw(T& out) {
+		if((size_t)(end - p) < sizeof(T))
+			return false;
+
+		U8 bytes[sizeof(T)];
+		memcpy(bytes, p, sizeof(T));
+		if(isSwapped)
+			std::reverse(bytes, bytes + sizeof(T));
+		memcpy(&out, bytes, sizeof(T));
+		p += sizeof(T);
+		return true;
+	}
+
+	//non negative integer stored in szBinary bytes, signed unless it is a size
+	bool readIndex(U64& out, U32 szBinary, bool isSigned) {
+		if(!isBinary) {
+			skipSpaces();
+			return ParseU64(p, end, out);
+		}
+
+		if(szBinary == 4) {
+			U32 v;
+			if(!readRaw(v) || (isSigned && (v & 0x80000000U)))
+				return false;
+			out = v;
+			return true;
+		}
+
+		if(szBinary == 8) {
+			U64 v;
+			if(!readRaw(v) || (isSigned && (v & 0x8000000000000000ULL)))
+				return false;
+			out = v;
+			return true;
 		}
+
+		return false;
 	}
 
-	//
-	objMesh.addNode(aNode);
-	return objMesh.store(strPath.cptr());
+	//float or double value stored in szBinary bytes
+	bool readReal(double& out, U32 szBinary) {
+		if(!isBinary) {
+			skipSpaces();
+			return ParseDouble(p, end, out);
+		}
+
+		if(szBinary == 4) {
+			float v;
+			if(!readRaw(v))
+				return false;
+			out = v;
+			return true;
+		}
+
+		return (szBinary == 8) && readRaw(out);
+	}
+};
+
+//first token of a line and the rest of it
+bool SplitKeyword(const char* first, const char* last, string& strKey, const char*& rest) {
+	const char* q = first;
+	while(q < last && !IsBlank(*q))
+		q++;
+	if(q == first)
+		return false;
+
+	strKey.assign(first, q);
+	rest = q;
+	return true;
+}
+
+//nodes of a gmsh element type, 0 for the unknown types
+U32 GmshElementNodes(U64 type) {
+	const U32 arrNodes[] = { 0, 2, 3, 4, 4, 8, 6, 5, 3, 6, 9, 10, 27, 18, 14, 1, 8, 20, 15, 13 };
+	return (type < sizeof(arrNodes) / sizeof(arrNodes[0])) ? arrNodes[type] : 0;
+}
+
+}
+
+bool VolMeshIO::readTetGen(VolMesh* vm, const AnsiStr& strPath) {
+	if(vm == NULL)
+		return false;
+
+	AnsiStr strNodes = ChangeFileExt(strPath, AnsiStr(".node"));
+	AnsiStr strElements = ChangeFileExt(strPath, AnsiStr(".ele"));
+	if(!FileExists(strNodes) || !FileExists(strElements)) {
+		vlogerror("TetGen meshes need both %s and %s", strNodes.cptr(), strElements.cptr());
+		return false;
+	}
+
+	ProfileAutoArg(strPath.cptr());
+
+	MappedFile mfNodes, mfElements;
+	if(!mfNodes.open(strNodes) || !mfElements.open(strElements))
+		return false;
+
+	//the files are a count line followed by one row per node or element, same as a vega section
+	VEGASECTION secNodes = {mfNodes.data(), mfNodes.data() + mfNodes.size()};
+	VEGASECTION secElements = {mfElements.data(), mfElements.data() + mfElements.size()};
+
+	U32 ctNodes = 0, ctDim = 0;
+	U32 ctElements = 0, ctElementNodes = 0;
+	if(!ReadSectionHeader(secNodes, ctNodes, ctDim) || ctNodes == 0 || ctDim != 3 ||
+	   !ReadSectionHeader(secElements, ctElements, ctElementNodes) || ctElements == 0 ||
+	   (ctElementNodes != 4 && ctElementNodes != 10)) {
+		vlogerror("Invalid TetGen header in %s", strPath.cptr());
+		return false;
+	}
+
+	//the element rows refer to the nodes by their numbers
+	U32 idxFirstNode = 0, idxFirstElement = 0;
+	if(!FindFirstRowIndex(secNodes, idxFirstNode) || !FindFirstRowIndex(secElements, idxFirstElement))
+		return false;
+
+	vector<double> vertices;
+	int ctReadNodes = ParseSectionRows(secNodes, ctNodes, 3, idxFirstNode, vertices, ParseDouble);
+
+	//second order tetrahedra list their corners first
+	vector<U32> elements;
+	int ctReadElements = ParseSectionRows(secElements, ctElements, 4, idxFirstElement, elements,
+		[idxFirstNode](const char*& q, const char* eol, U32& out) {
+			if(!ParseU32(q, eol, out) || out < idxFirstNode)
+				return false;
+			out -= idxFirstNode;
+			return true;
+		});
+
+	if(ctReadNodes != (int)ctNodes || ctReadElements != (int)ctElements) {
+		vlogerror("Read %d of %u nodes and %d of %u elements from %s",
+				  ctReadNodes, ctNodes, ctReadElements, ctElements, strPath.cptr());
+		return false;
+	}
+
+	vm->cleanup();
+	vm->setName(ExtractFileTitleOnly(strPath).cptr());
+	return vm->setup(ctNodes, &vertices[0], ctElements, &elements[0]);
+}
+
+bool VolMeshIO::readGmsh(VolMesh* vm, const AnsiStr& strPath) {
+	if((vm == NULL) || !FileExists(strPath))
+		return false;
+
+	ProfileAutoArg(strPath.cptr());
+
+	MappedFile mf;
+	if(!mf.open(strPath))
+		return false;
+
+	MESHSTREAM ms(mf.data(), mf.data() + mf.size());
+	U32 szSizeT = 8;
+	bool hasFormat = false;
+	vector<double> vertices;
+	vector<U64> vNodeTags;
+	vector<U64> vElementTags;
+	U64 minNodeTag = 0, maxNodeTag = 0;
+	U64 ctSkipped = 0;
+
+	const char* first;
+	const char* last;
+	while(ms.readLine(first, last)) {
+		string strSection(first, last);
+
+		if(strSection == "$MeshFormat") {
+			//version, file type and size of size_t
+			const char* q = ms.p;
+			double version = 0.0;
+			U32 fileType = 0;
+			if(!ParseDouble(q, ms.end, version) || !ParseU32(q, ms.end, fileType) || !ParseU32(q, ms.end, szSizeT) ||
+			   version < 4.1 || version >= 5.0 || (szSizeT != 4 && szSizeT != 8)) {
+				vlogerror("Only Gmsh 4.1 files are supported, save as msh41: %s", strPath.cptr());
+				return false;
+			}
+			ms.p = (LineEnd(q, ms.end) < ms.end) ? LineEnd(q, ms.end) + 1 : ms.end;
+
+			//binary files store the integer 1 to tell the byte order
+			ms.isBinary = (fileType == 1);
+			if(ms.isBinary) {
+				I32 one = 0;
+				if(!ms.readRaw(one) || (one != 1 && one != 0x01000000)) {
+					vlogerror("Invalid byte order mark in %s", strPath.cptr());
+					return false;
+				}
+				ms.isSwapped = (one != 1);
+			}
+			hasFormat = true;
+		}
+		else if(strSection == "$Nodes" && hasFormat) {
+			U64 ctBlocks, ctNodes;
+			if(!ms.readIndex(ctBlocks, szSizeT, false) || !ms.readIndex(ctNodes, szSizeT, false) ||
+			   !ms.readIndex(minNodeTag, szSizeT, false) || !ms.readIndex(maxNodeTag, szSizeT, false))
+				return false;
+
+			//every node has three coordinates
+			if(ctNodes >= VolMesh::INVALID_INDEX || !ms.canHold(ctNodes * 3, 8)) {
+				vlogerror("Corrupt node count %llu in %s", (unsigned long long)ctNodes, strPath.cptr());
+				return false;
+			}
+
+			vertices.resize(ctNodes * 3);
+			vNodeTags.resize(ctNodes);
+			U64 idxNode = 0;
+			for(U64 b = 0; b < ctBlocks; b++) {
+				U64 dim, tag, parametric, ctBlockNodes;
+				if(!ms.readIndex(dim, 4, true) || !ms.readIndex(tag, 4, true) || !ms.readIndex(parametric, 4, true) ||
+				   !ms.readIndex(ctBlockNodes, szSizeT, false) || ctBlockNodes > ctNodes - idxNode || dim > 3)
+					return false;
+
+				//the tags of a block come before its coordinates
+				for(U64 i = 0; i < ctBlockNodes; i++) {
+					if(!ms.readIndex(vNodeTags[idxNode + i], szSizeT, false))
+						return false;
+				}
+
+				for(U64 i = 0; i < ctBlockNodes; i++) {
+					double* lpPos = &vertices[(idxNode + i) * 3];
+					if(!ms.readReal(lpPos[0], 8) || !ms.readReal(lpPos[1], 8) || !ms.readReal(lpPos[2], 8))
+						return false;
+
+					double uvw;
+					for(U64 j = 0; parametric && j < dim; j++) {
+						if(!ms.readReal(uvw, 8))
+							return false;
+					}
+				}
+				idxNode += ctBlockNodes;
+			}
+
+			if(idxNode != ctNodes)
+				return false;
+		}
+		else if(strSection == "$Elements" && hasFormat) {
+			U64 ctBlocks, ctElements, minTag, maxTag;
+			if(!ms.readIndex(ctBlocks, szSizeT, false) || !ms.readIndex(ctElements, szSizeT, false) ||
+			   !ms.readIndex(minTag, szSizeT, false) || !ms.readIndex(maxTag, szSizeT, false))
+				return false;
+
+			//every element has a tag and at least one node tag
+			if(ctElements >= VolMesh::INVALID_INDEX || !ms.canHold(ctElements * 2, szSizeT)) {
+				vlogerror("Corrupt element count %llu in %s", (unsigned long long)ctElements, strPath.cptr());
+				return false;
+			}
+
+			vElementTags.reserve(ctElements * 4);
+			for(U64 b = 0; b < ctBlocks; b++) {
+				U64 dim, tag, type, ctBlockElements;
+				if(!ms.readIndex(dim, 4, true) || !ms.readIndex(tag, 4, true) || !ms.readIndex(type, 4, true) ||
+				   !ms.readIndex(ctBlockElements, szSizeT, false))
+					return false;
+
+				U32 ctElementNodes = GmshElementNodes(type);
+				if(ctElementNodes == 0) {
+					vlogerror("Unknown Gmsh element type %u in %s", (U32)type, strPath.cptr());
+					return false;
+				}
+
+				bool isTet = (type == GMSH_TET4 || type == GMSH_TET10);
+				if(!isTet)
+					ctSkipped += ctBlockElements;
+
+				//element tag and its node tags, second order tetrahedra list their corners first
+				for(U64 i = 0; i < ctBlockElements; i++) {
+					U64 elementTag, nodeTag;
+					if(!ms.readIndex(elementTag, szSizeT, false))
+						return false;
+					for(U32 j = 0; j < ctElementNodes; j++) {
+						if(!ms.readIndex(nodeTag, szSizeT, false))
+							return false;
+						if(isTet && j < COUNT_CELL_NODES)
+							vElementTags.push_back(nodeTag);
+					}
+				}
+			}
+		}
+		else if(strSection.size() > 1 && strSection[0] == '$' && strSection.compare(0, 4, "$End") != 0) {
+			//sections which are not needed, binary ones too
+			string strEnd = "\n$End" + strSection.substr(1);
+			if(!ms.seek(strEnd.c_str())) {
+				vlogerror("Section %s is not closed in %s", strSection.c_str(), strPath.cptr());
+				return false;
+			}
+		}
+	}
+
+	if(vertices.size() == 0 || vElementTags.size() == 0) {
+		vlogerror("No nodes or tetrahedra found in %s", strPath.cptr());
+		return false;
+	}
+
+	if(ctSkipped > 0)
+		vloginfo("Skipped %u elements which are not tetrahedra in %s", (U32)ctSkipped, strPath.cptr());
+
+	//node tags to indices. dense tags are mapped with a table, sparse ones by a search
+	U32 ctNodes = (U32)vNodeTags.size();
+	U32 ctElements = (U32)(vElementTags.size() / 4);
+	vector<U32> elements(vElementTags.size());
+	if(maxNodeTag >= minNodeTag && maxNodeTag - minNodeTag < (U64)ctNodes * 2 + 1024) {
+		vector<U32> vTable((size_t)(maxNodeTag - minNodeTag + 1), (U32)VolMesh::INVALID_INDEX);
+		for(U32 i = 0; i < ctNodes; i++) {
+			if(vNodeTags[i] >= minNodeTag && vNodeTags[i] <= maxNodeTag)
+				vTable[vNodeTags[i] - minNodeTag] = i;
+		}
+
+		for(U32 i = 0; i < elements.size(); i++) {
+			U64 tag = vElementTags[i];
+			elements[i] = (tag >= minNodeTag && tag <= maxNodeTag) ? vTable[tag - minNodeTag] : (U32)VolMesh::INVALID_INDEX;
+		}
+	}
+	else {
+		vector< std::pair<U64, U32> > vSorted(ctNodes);
+		for(U32 i = 0; i < ctNodes; i++)
+			vSorted[i] = std::make_pair(vNodeTags[i], i);
+		std::sort(vSorted.begin(), vSorted.end());
+
+		for(U32 i = 0; i < elements.size(); i++) {
+			vector< std::pair<U64, U32> >::const_iterator it = std::lower_bound(vSorted.begin(), vSorted.end(),
+				std::make_pair(vElementTags[i], (U32)0));
+			elements[i] = (it != vSorted.end() && it->first == vElementTags[i]) ? it->second : (U32)VolMesh::INVALID_INDEX;
+		}
+	}
+	mf.close();
+
+	vm->cleanup();
+	vm->setName(ExtractFileTitleOnly(strPath).cptr());
+	return vm->setup(ctNodes, &vertices[0], ctElements, &elements[0]);
+}
+
+bool VolMeshIO::readVTK(VolMesh* vm, const AnsiStr& strPath) {
+	if((vm == NULL) || !FileExists(strPath))
+		return false;
+
+	ProfileAutoArg(strPath.cptr());
+
+	MappedFile mf;
+	if(!mf.open(strPath))
+		return false;
+
+	//version line, title, encoding and the data set type. legacy binary files are big-endian
+	MESHSTREAM ms(mf.data(), mf.data() + mf.size());
+	const char* first;
+	const char* last;
+	U32 version = 0;
+	if(!ms.readLine(first, last) || string(first, last).find("# vtk DataFile Version") != 0) {
+		vlogerror("Not a legacy VTK file: %s", strPath.cptr());
+		return false;
+	}
+	const char* q = first + strlen("# vtk DataFile Version");
+	ParseU32(q, last, version);
+
+	//the title may be empty
+	ms.p = (LineEnd(ms.p, ms.end) < ms.end) ? LineEnd(ms.p, ms.end) + 1 : ms.end;
+
+	string strEncoding, strDataSet;
+	if(!ms.readLine(first, last))
+		return false;
+	strEncoding.assign(first, last);
+	ms.isBinary = (strEncoding == "BINARY");
+	ms.isSwapped = ms.isBinary && IsLittleEndianHost();
+
+	if(!ms.readLine(first, last) || string(first, last) != "DATASET UNSTRUCTURED_GRID") {
+		vlogerror("Only VTK unstructured grids are supported: %s", strPath.cptr());
+		return false;
+	}
+
+	vector<double> vertices;
+	vector<U64> vOffsets;
+	vector<U64> vConnectivity;
+	vector<U64> vTypes;
+	while(ms.readLine(first, last)) {
+		string strKey;
+		const char* rest;
+		if(!SplitKeyword(first, last, strKey, rest))
+			continue;
+
+		if(strKey == "POINTS") {
+			U64 ctPoints;
+			if(!ParseU64(rest, last, ctPoints))
+				return false;
+			string strType(SkipBlanks(rest, last), last);
+			U32 szValue = (strType == "double") ? 8 : ((strType == "float") ? 4 : 0);
+			if(szValue == 0) {
+				vlogerror("Unsupported VTK points [%s] in %s", strType.c_str(), strPath.cptr());
+				return false;
+			}
+
+			if(ctPoints >= VolMesh::INVALID_INDEX || !ms.canHold(ctPoints * 3, szValue)) {
+				vlogerror("Corrupt VTK point count %llu in %s", (unsigned long long)ctPoints, strPath.cptr());
+				return false;
+			}
+
+			vertices.resize(ctPoints * 3);
+			for(U64 i = 0; i < vertices.size(); i++) {
+				if(!ms.readReal(vertices[i], szValue))
+					return false;
+			}
+		}
+		else if(strKey == "CELLS" && version < 5) {
+			//count of every cell followed by its points
+			U64 ctCells, ctValues;
+			if(!ParseU64(rest, last, ctCells) || !ParseU64(rest, last, ctValues))
+				return false;
+
+			if(ctCells > ctValues || !ms.canHold(ctValues, 4)) {
+				vlogerror("Corrupt VTK cell counts %llu, %llu in %s", (unsigned long long)ctCells,
+						  (unsigned long long)ctValues, strPath.cptr());
+				return false;
+			}
+
+			vOffsets.resize(ctCells + 1);
+			vConnectivity.resize(0);
+			vConnectivity.reserve(ctValues - std::min(ctValues, ctCells));
+			vOffsets[0] = 0;
+			for(U64 i = 0; i < ctCells; i++) {
+				U64 ct, idx;
+				if(!ms.readIndex(ct, 4, true) || vConnectivity.size() + ct > ctValues)
+					return false;
+				for(U64 j = 0; j < ct; j++) {
+					if(!ms.readIndex(idx, 4, true))
+						return false;
+					vConnectivity.push_back(idx);
+				}
+				vOffsets[i + 1] = vConnectivity.size();
+			}
+		}
+		else if(strKey == "CELLS") {
+			//version 5 stores the offsets and the connectivity as separate arrays
+			U64 ctOffsets, ctConnectivity;
+			if(!ParseU64(rest, last, ctOffsets) || !ParseU64(rest, last, ctConnectivity))
+				return false;
+
+			vector<U64>* arrArrays[2] = {&vOffsets, &vConnectivity};
+			U64 arrCounts[2] = {ctOffsets, ctConnectivity};
+			for(int a = 0; a < 2; a++) {
+				if(!ms.readLine(first, last) || !SplitKeyword(first, last, strKey, rest))
+					return false;
+				string strType(SkipBlanks(rest, last), last);
+				U32 szValue = (strType == "vtktypeint64") ? 8 : ((strType == "vtktypeint32") ? 4 : 0);
+				if(szValue == 0)
+					return false;
+
+				if(!ms.canHold(arrCounts[a], szValue)) {
+					vlogerror("Corrupt VTK %s count %llu in %s", strKey.c_str(), (unsigned long long)arrCounts[a], strPath.cptr());
+					return false;
+				}
+
+				arrArrays[a]->resize(arrCounts[a]);
+				for(U64 i = 0; i < arrCounts[a]; i++) {
+					if(!ms.readIndex((*arrArrays[a])[i], szValue, true))
+						return false;
+				}
+			}
+		}
+		else if(strKey == "CELL_TYPES") {
+			U64 ctCells;
+			if(!ParseU64(rest, last, ctCells))
+				return false;
+
+			if(!ms.canHold(ctCells, 4)) {
+				vlogerror("Corrupt VTK cell type count %llu in %s", (unsigned long long)ctCells, strPath.cptr());
+				return false;
+			}
+
+			vTypes.resize(ctCells);
+			for(U64 i = 0; i < ctCells; i++) {
+				if(!ms.readIndex(vTypes[i], 4, true))
+					return false;
+			}
+		}
+		else if(strKey == "METADATA") {
+			//ends at an empty line
+			while(ms.p < ms.end) {
+				const char* eol = LineEnd(ms.p, ms.end);
+				bool isEmpty = (SkipBlanks(ms.p, eol) == eol);
+				ms.p = (eol < ms.end) ? eol + 1 : ms.end;
+				if(isEmpty)
+					break;
+			}
+		}
+		else if(strKey == "POINT_DATA" || strKey == "CELL_DATA")
+			break;
+		else {
+			vlogerror("Unknown VTK section %s in %s", strKey.c_str(), strPath.cptr());
+			return false;
+		}
+	}
+
+	if(vertices.size() == 0 || vOffsets.size() < 2 || vTypes.size() + 1 != vOffsets.size()) {
+		vlogerror("Missing VTK points, cells or cell types in %s", strPath.cptr());
+		return false;
+	}
+
+	//tetrahedra, second order ones list their corners first
+	vector<U32> elements;
+	elements.reserve(vTypes.size() * 4);
+	U32 ctSkipped = 0;
+	for(U64 i = 0; i < vTypes.size(); i++) {
+		U64 offset = vOffsets[i];
+		U64 ct = vOffsets[i + 1] - offset;
+		if(vOffsets[i + 1] < offset || vOffsets[i + 1] > vConnectivity.size())
+			return false;
+
+		if((vTypes[i] == VTK_TETRA || vTypes[i] == VTK_QUADRATIC_TETRA) && ct >= COUNT_CELL_NODES) {
+			for(U32 j = 0; j < COUNT_CELL_NODES; j++)
+				elements.push_back((vConnectivity[offset + j] < vertices.size() / 3) ? (U32)vConnectivity[offset + j] : (U32)VolMesh::INVALID_INDEX);
+		}
+		else
+			ctSkipped++;
+	}
+	mf.close();
+
+	if(elements.size() == 0) {
+		vlogerror("No tetrahedra found in %s", strPath.cptr());
+		return false;
+	}
+
+	if(ctSkipped > 0)
+		vloginfo("Skipped %u cells which are not tetrahedra in %s", ctSkipped, strPath.cptr());
+
+	vm->cleanup();
+	vm->setName(ExtractFileTitleOnly(strPath).cptr());
+	return vm->setup((U32)(vertices.size() / 3), &vertices[0], (U32)(elements.size() / 4), &elements[0]);
+}
+
+//helpers of the voxel mask readers
+namespace {
+
+//voxel value type of a nrrd file
+bool NrrdVoxelType(const string& strType, U32& szVoxel, bool& isSigned) {
+	const char* arrTypes[] = {"uchar", "unsigned char", "uint8", "uint8_t",
+							  "signed char", "int8", "int8_t",
+							  "ushort", "unsigned short", "unsigned short int", "uint16", "uint16_t",
+							  "short", "short int", "signed short", "signed short int", "int16", "int16_t",
+							  "uint", "unsigned int", "uint32", "uint32_t",
+							  "int", "signed int", "int32", "int32_t"};
+	const U32 arrSizes[] = {1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 4, 4, 4, 4, 4, 4, 4, 4};
+	const bool arrSigned[] = {false, false, false, false, true, true, true, false, false, false, false, false,
+							  true, true, true, true, true, true, false, false, false, false, true, true, true, true};
+
+	for(U32 i=0; i < sizeof(arrSizes) / sizeof(arrSizes[0]); i++) {
+		if(strType == arrTypes[i]) {
+			szVoxel = arrSizes[i];
+			isSigned = arrSigned[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+//reads a vector written as (x,y,z)
+bool ParseNrrdVector(const char*& p, const char* end, vec3d& out) {
+	p = SkipBlanks(p, end);
+	if(p == end || *p != '(')
+		return false;
+	p++;
+
+	//the commas are skipped as blanks
+	for(int i=0; i < 3; i++) {
+		double v;
+		if(!ParseDouble(p, end, v))
+			return false;
+		out.setElement(i, v);
+	}
+
+	p = SkipBlanks(p, end);
+	if(p == end || *p != ')')
+		return false;
+	p++;
+	return true;
+}
+
+/*!
+ * converts raw voxels to occupancy in parallel blocks. The voxels equal to label are occupied,
+ * all nonzero ones when label is negative.
+ */
+void ConvertVoxels(const U8* lpData, U32 szVoxel, bool isSigned, bool isSwapped, int label, VOXELMASK& mask) {
+	U64 ctVoxels = mask.countVoxels();
+	mask.vOccupied.resize(ctVoxels);
+	tbb::parallel_for(tbb::blocked_range<U64>(0, ctVoxels, VOXEL_BLOCK_SIZE),
+		[&](const tbb::blocked_range<U64>& r) {
+		U8 bytes[4];
+		for(U64 i = r.begin(); i != r.end(); i++) {
+			memcpy(bytes, lpData + i * szVoxel, szVoxel);
+			if(isSwapped)
+				std::reverse(bytes, bytes + szVoxel);
+
+			I64 value;
+			if(szVoxel == 1) {
+				value = isSigned ? (I64)(signed char)bytes[0] : (I64)bytes[0];
+			}
+			else if(szVoxel == 2) {
+				U16 v;
+				memcpy(&v, bytes, 2);
+				value = isSigned ? (I64)(I16)v : (I64)v;
+			}
+			else {
+				U32 v;
+				memcpy(&v, bytes, 4);
+				value = isSigned ? (I64)(I32)v : (I64)v;
+			}
+
+			mask.vOccupied[i] = (label < 0) ? (value != 0) : (value == label);
+		}
+	});
+}
+
+}
+
+bool VolMeshIO::readVoxelMask(VOXELMASK& mask, const AnsiStr& strPath, int label) {
+	if(!FileExists(strPath)) {
+		vlogerror("Voxel mask file not found: %s", strPath.cptr());
+		return false;
+	}
+
+	ProfileAutoArg(strPath.cptr());
+
+	MappedFile mf;
+	if(!mf.open(strPath))
+		return false;
+
+	MESHSTREAM ms(mf.data(), mf.data() + mf.size());
+	if(mf.size() < 7 || strncmp(mf.data(), "NRRD000", 7) != 0) {
+		vlogerror("Not a nrrd file: %s", strPath.cptr());
+		return false;
+	}
+	ms.p = (LineEnd(ms.p, ms.end) < ms.end) ? LineEnd(ms.p, ms.end) + 1 : ms.end;
+
+	//fields until the first empty line, which ends the header of a file with attached data
+	string strType, strEncoding = "raw", strEndian = "little", strDataFile;
+	U32 ctDim = 0;
+	U64 szSkip = 0;
+	vec3i dim(0, 0, 0);
+	vec3d spacing(1.0), origin(0.0);
+	while(ms.p < ms.end) {
+		const char* first = ms.p;
+		const char* last = LineEnd(ms.p, ms.end);
+		ms.p = (last < ms.end) ? last + 1 : ms.end;
+		while(last > first && IsSpace(*(last - 1)))
+			last--;
+		if(first == last)
+			break;
+		if(*first == '#')
+			continue;
+
+		//fields are written as key: value, key/value pairs with := are skipped
+		const char* colon = std::find(first, last, ':');
+		if(colon == last || (colon + 1 < last && colon[1] == '='))
+			continue;
+
+		string strKey(first, colon);
+		const char* q = SkipBlanks(colon + 1, last);
+		string strValue(q, last);
+
+		if(strKey == "type")
+			strType = strValue;
+		else if(strKey == "dimension")
+			ParseU32(q, last, ctDim);
+		else if(strKey == "encoding")
+			strEncoding = strValue;
+		else if(strKey == "endian")
+			strEndian = strValue;
+		else if(strKey == "data file" || strKey == "datafile")
+			strDataFile = strValue;
+		else if(strKey == "byte skip" || strKey == "byteskip") {
+			U64 v = 0;
+			if(!ParseU64(q, last, v)) {
+				vlogerror("Only non negative byte skips are supported in %s", strPath.cptr());
+				return false;
+			}
+			szSkip = v;
+		}
+		else if(strKey == "sizes") {
+			for(int i=0; i < 3; i++) {
+				U32 v = 0;
+				if(!ParseU32(q, last, v) || v == 0 || v > 0x7FFFFFFF) {
+					vlogerror("Invalid sizes in %s", strPath.cptr());
+					return false;
+				}
+				dim.setElement(i, (I32)v);
+			}
+		}
+		else if(strKey == "spacings") {
+			for(int i=0; i < 3; i++) {
+				double v;
+				q = SkipBlanks(q, last);
+				if(ParseDouble(q, last, v) && v > 0.0)
+					spacing.setElement(i, v);
+			}
+		}
+		else if(strKey == "space directions") {
+			//the spacing is the length of the axis directions
+			for(int i=0; i < 3; i++) {
+				vec3d dir;
+				if(!ParseNrrdVector(q, last, dir))
+					break;
+				spacing.setElement(i, dir.length());
+			}
+		}
+		else if(strKey == "space origin") {
+			ParseNrrdVector(q, last, origin);
+		}
+	}
+
+	U32 szVoxel = 0;
+	bool isSigned = false;
+	if(ctDim != 3 || dim.x == 0 || !NrrdVoxelType(strType, szVoxel, isSigned)) {
+		vlogerror("Only 3D nrrd volumes of 8, 16 or 32 bit integers are supported: %s", strPath.cptr());
+		return false;
+	}
+
+	if(strEncoding != "raw") {
+		vlogerror("Only raw nrrd encoding is supported, found %s in %s", strEncoding.c_str(), strPath.cptr());
+		return false;
+	}
+
+	//the data follows the header or is in a file next to it
+	MappedFile mfData;
+	const char* lpData = ms.p;
+	U64 szData = (U64)(ms.end - ms.p);
+	if(strDataFile.length() > 0) {
+		AnsiStr strDataPath(strDataFile.c_str());
+		if(!FileExists(strDataPath))
+			strDataPath = ExtractFilePath(strPath) + strDataPath;
+		if(!mfData.open(strDataPath)) {
+			vlogerror("Unable to open the nrrd data file: %s", strDataPath.cptr());
+			return false;
+		}
+		lpData = mfData.data();
+		szData = mfData.size();
+	}
+
+	mask.dim = dim;
+	mask.spacing = spacing;
+	mask.origin = origin;
+	U64 szVoxels = mask.countVoxels() * szVoxel;
+	if(szSkip > szData || szData - szSkip < szVoxels) {
+		vlogerror("Nrrd data of %s is shorter than %llu bytes", strPath.cptr(), (unsigned long long)szVoxels);
+		return false;
+	}
+
+	bool isSwapped = (szVoxel > 1) && ((strEndian == "big") == IsLittleEndianHost());
+	ConvertVoxels(reinterpret_cast<const U8*>(lpData) + szSkip, szVoxel, isSigned, isSwapped, label, mask);
+	return true;
+}
+
+bool VolMeshIO::readVoxelMaskRaw(VOXELMASK& mask, const AnsiStr& strPath, const vec3i& dim,
+								 U32 szVoxel, int label) {
+	if(dim.x <= 0 || dim.y <= 0 || dim.z <= 0 || (szVoxel != 1 && szVoxel != 2 && szVoxel != 4)) {
+		vlogerror("Invalid raw voxel mask params: %d x %d x %d of %u bytes", dim.x, dim.y, dim.z, szVoxel);
+		return false;
+	}
+
+	ProfileAutoArg(strPath.cptr());
+
+	MappedFile mf;
+	if(!mf.open(strPath))
+		return false;
+
+	mask.dim = dim;
+	mask.spacing = vec3d(1.0);
+	mask.origin = vec3d(0.0);
+	if(mf.size() < mask.countVoxels() * szVoxel) {
+		vlogerror("Raw voxel mask %s is shorter than %d x %d x %d voxels", strPath.cptr(), dim.x, dim.y, dim.z);
+		return false;
+	}
+
+	//raw voxels are unsigned in the host byte order
+	ConvertVoxels(reinterpret_cast<const U8*>(mf.data()), szVoxel, false, false, label, mask);
+	return true;
+}
+
+bool VolMeshIO::readMesh(VolMesh* vm, const AnsiStr& strPath) {
+	AnsiStr strExt = ExtractFileExt(strPath);
+	strExt.toLower();
+
+	if(strExt == AnsiStr("vmb"))
+		return readBinary(vm, strPath);
+	else if(strExt == AnsiStr("node") || strExt == AnsiStr("ele"))
+		return readTetGen(vm, strPath);
+	else if(strExt == AnsiStr("msh"))
+		return readGmsh(vm, strPath);
+	else if(strExt == AnsiStr("vtk"))
+		return readVTK(vm, strPath);
+	else if(strExt == AnsiStr("nrrd") || strExt == AnsiStr("nhdr")) {
+		VOXELMASK mask;
+		vector<double> vertices;
+		vector<U32> elements;
+		if(vm == NULL || !readVoxelMask(mask, strPath) ||
+		   !VolMeshSamples::TetrahedralizeVoxelMask(mask, 6, vertices, elements))
+			return false;
+
+		vm->cleanup();
+		vm->setName(ExtractFileTitleOnly(strPath).cptr());
+		return vm->setup(vertices, elements);
+	}
+	return readVega(vm, strPath);
+}
+
+bool VolMeshIO::writeObj(const VolMesh* vm, const AnsiStr& strPath) {
+
+	if(vm == NULL)
+		return false;
+
+	VOLMESHSNAPSHOT snap;
+	snapshot(vm, snap, true);
+	return writeObj(snap, strPath);
+}
+
+bool VolMeshIO::writeObj(const VOLMESHSNAPSHOT& snap, const AnsiStr& strPath) {
+	U32 ctNodes = (U32)(snap.vNodes.size() / 3);
+	U32 ctFaces = (U32)(snap.vCellFaces.size() / 3);
+
+	ofstream fp(strPath.cptr());
+	if(!fp.is_open())
+		return false;
+
+	fp << "# Generated by PS::MESH\n";
+	fp << "# Number of vertices: " << ctNodes << "\n";
+	fp << "# Number of faces: " << ctFaces << "\n";
+
+	//output nodes
+	bool res = WriteRows(fp, ctNodes, 96, [&snap](char* p, U32 i) {
+		*p++ = 'v';
+		for(int j=0; j < 3; j++) {
+			*p++ = ' ';
+			p = FormatDouble(p, snap.vNodes[i * 3 + j]);
+		}
+		*p++ = '\n';
+		return p;
+	});
+
+	//output cell faces, obj indices are 1-based
+	res &= WriteRows(fp, ctFaces, 48, [&snap](char* p, U32 i) {
+		*p++ = 'f';
+		for(int j=0; j < 3; j++) {
+			*p++ = ' ';
+			p = FormatU32(p, snap.vCellFaces[i * 3 + j] + 1);
+		}
+		*p++ = '\n';
+		return p;
+	});
+
+	res &= fp.good();
+	fp.close();
+	return res;
+}
+
+VolMeshAsyncExporter::VolMeshAsyncExporter() {
+	m_isBusy = false;
+}
+
+VolMeshAsyncExporter::~VolMeshAsyncExporter() {
+	wait();
+}
+
+void VolMeshAsyncExporter::write(const VolMesh* vm, const vector<AnsiStr>& vPaths) {
+	if(vm == NULL || vPaths.size() == 0)
+		return;
+
+	//one export at a time, the next snapshot waits for the previous files
+	wait();
+
+	bool withFaces = false;
+	for(U32 i=0; i < vPaths.size(); i++) {
+		AnsiStr strExt = ExtractFileExt(vPaths[i]);
+		strExt.toLower();
+		withFaces |= (strExt == AnsiStr("obj"));
+	}
+
+	VolMeshIO::snapshot(vm, m_snapshot, withFaces);
+	m_vPaths = vPaths;
+	m_isBusy = true;
+	m_task.run([this]() {
+		for(U32 i=0; i < m_vPaths.size(); i++) {
+			AnsiStr strExt = ExtractFileExt(m_vPaths[i]);
+			strExt.toLower();
+
+			bool res = (strExt == AnsiStr("obj")) ? VolMeshIO::writeObj(m_snapshot, m_vPaths[i]) :
+													VolMeshIO::writeVega(m_snapshot, m_vPaths[i]);
+			if(res)
+				vloginfo("Stored the mesh at: %s", m_vPaths[i].cptr());
+			else
+				vlogerror("Unable to store the mesh at: %s", m_vPaths[i].cptr());
+		}
+		m_isBusy = false;
+	});
+}
+
+void VolMeshAsyncExporter::wait() {
+	m_task.wait();
 }
 
 bool VolMeshIO::fitmesh(VolMesh* vm, const AABB& toBox) {
@@ -8,19 +8,75 @@
 #ifndef VOLMESHEXPORT_H_
 #define VOLMESHEXPORT_H_
 
+#include <tbb/task_group.h>
+#include <tbb/atomic.h>
 #include "VolMesh.h"
+#include "VolMeshSamples.h"
+#include "base/str.h"
 
 namespace ps {
 namespace elastic {
 
+//version of the native binary mesh format
+#define VOLMESH_BINARY_VERSION 1
+
+//flat copy of the data written by the text exporters
+struct VOLMESHSNAPSHOT {
+	string name;
+	vector<double> vNodes;
+	vector<U32> vCells;
+
+	//three nodes per cell face, only taken for obj files
+	vector<U32> vCellFaces;
+};
+
 class VolMeshIO {
 public:
 
 	static bool readVega(VolMesh* vm, const AnsiStr& strPath);
 	static bool writeVega(const VolMesh* vm, const AnsiStr& strPath);
+	static bool writeVega(const VOLMESHSNAPSHOT& snap, const AnsiStr& strPath);
+
+	/*!
+	 * native binary format (.vmb). Keeps the current and rest positions, edges, faces, cells,
+	 * incidence tables and part labels as flat little-endian arrays, so a mesh is loaded from a
+	 * memory map with block copies and no topology rebuild.
+	 */
+	static bool readBinary(VolMesh* vm, const AnsiStr& strPath);
+	static bool writeBinary(const VolMesh* vm, const AnsiStr& strPath);
+
+	/*!
+	 * importers which build the mesh straight from the mapped file. TetGen reads the .node and
+	 * .ele pair of the given path, Gmsh reads 4.1 text and binary files and VTK reads legacy
+	 * unstructured grids in text or binary. Only the tetrahedra are kept, second order ones are
+	 * reduced to their corners.
+	 */
+	static bool readTetGen(VolMesh* vm, const AnsiStr& strPath);
+	static bool readGmsh(VolMesh* vm, const AnsiStr& strPath);
+	static bool readVTK(VolMesh* vm, const AnsiStr& strPath);
+
+	/*!
+	 * voxel masks of segmented volumes. Nrrd headers describe 3D volumes of 8, 16 or 32 bit
+	 * integers in raw encoding, attached or in a detached data file. Raw files are read with the
+	 * given dimensions in the host byte order. The voxels equal to label are occupied, all nonzero
+	 * voxels when label is negative.
+	 */
+	static bool readVoxelMask(VOXELMASK& mask, const AnsiStr& strPath, int label = -1);
+	static bool readVoxelMaskRaw(VOXELMASK& mask, const AnsiStr& strPath, const vec3i& dim,
+								 U32 szVoxel = 1, int label = -1);
+
+	//reads a mesh by its extension: vmb, node or ele, msh, vtk, nrrd or nhdr masks and veg otherwise
+	static bool readMesh(VolMesh* vm, const AnsiStr& strPath);
 
 	//only export to obj file for inspection purposes
 	static bool writeObj(const VolMesh* vm, const AnsiStr& strPath);
+	static bool writeObj(const VOLMESHSNAPSHOT& snap, const AnsiStr& strPath);
+
+	/*!
+	 * copies the nodes and cells for the text exporters. The exporters format the rows in
+	 * parallel blocks and write them with a few large writes.
+	 */
+	static void snapshot(const VolMesh* vm, VOLMESHSNAPSHOT& outSnapshot, bool withFaces);
 
 	static bool fitmesh(VolMesh* vm, const AABB& toBox);
 	static bool fitmesh(VolMesh* vm, const vec3d& scale, const vec3d& translate);
@@ -33,6 +89,28 @@ public:
 								   	    const AnsiStr& strCellsFP);
 };
 
+/*!
+ * Writes meshes on a background task. The snapshot is taken on the calling thread so the mesh
+ * can be cut while its files are formatted and written. The file format follows the extension.
+ */
+class VolMeshAsyncExporter {
+public:
+	VolMeshAsyncExporter();
+	virtual ~VolMeshAsyncExporter();
+
+	//waits for the previous export then starts a new one
+	void write(const VolMesh* vm, const vector<AnsiStr>& vPaths);
+	void wait();
+
+	bool isBusy() const { return m_isBusy;}
+
+private:
+	tbb::task_group m_task;
+	tbb::atomic<bool> m_isBusy;
+	VOLMESHSNAPSHOT m_snapshot;
+	vector<AnsiStr> m_vPaths;
+};
+
 }
 }
 
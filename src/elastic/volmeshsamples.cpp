@@ -5,6 +5,9 @@
  *      Author: hupf2020
  */
 
+#include <string.h>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
 #include "VolMeshSamples.h"
 #include "base/FlatArray.h"
 #include "base/Logger.h"
@@ -12,6 +15,24 @@
 using namespace ps;
 using namespace ps::elastic;
 
+//tetrahedra of a cube or a shell segment
+#define CUBE_TETS 6
+
+//corner defs
+enum CellCorners {LBN = 0, LBF = 1, LTN = 2, LTF = 3, RBN = 4, RBF = 5, RTN = 6, RTF = 7};
+
+//splits a cube into tetrahedra sharing its RTN-LBF diagonal
+static inline void StoreCubeTets(const U32 cn[8], U32* lpOut) {
+	const U32 tets[CUBE_TETS][COUNT_CELL_NODES] = {
+		{cn[LBN], cn[LTN], cn[RBN], cn[LBF]},
+		{cn[RTN], cn[LTN], cn[LBF], cn[RBN]},
+		{cn[RTN], cn[LTN], cn[LTF], cn[LBF]},
+		{cn[RTN], cn[RBN], cn[LBF], cn[RBF]},
+		{cn[RTN], cn[LBF], cn[LTF], cn[RBF]},
+		{cn[RTN], cn[LTF], cn[RTF], cn[RBF]}};
+	memcpy(lpOut, tets, sizeof(tets));
+}
+
 VolMesh* VolMeshSamples::CreateOneTetra() {
 	vector<double> vertices;
 	vector<U32> elements;
@@ -70,59 +91,55 @@ VolMesh* VolMeshSamples::CreateTruthCube(int nx, int ny, int nz, double cellsize
 		return NULL;
 	}
 
-	vector< vec3d > vertices;
-	vector< vec4u32 > elements;
+	U64 ctNodes = (U64)nx * ny * nz;
+	U64 ctCubes = (U64)(nx - 1) * (ny - 1) * (nz - 1);
+	if(ctCubes * CUBE_TETS * COUNT_CELL_NODES > 0xFFFFFFFFULL) {
+        vlogerror("Truth cube %dx%dx%d is too large", nx, ny, nz);
+		return NULL;
+	}
 
 	vec3d start = vec3d(- (double)(nx)/2.0, 0, - (double)(nz)/2.0) * (cellsize);
 
-	//add all nodes
-	for(int i=0; i < nx; i++) {
-		for(int j=0; j < ny; j++) {
-			for(int k=0; k < nz; k++) {
-				vec3d v = start + vec3d(i, j, k) * cellsize;
-				vertices.push_back(v);
-			}
+	//nodes and cells are written straight to their slots from their grid index
+	vector<double> vFlatVertices(ctNodes * 3);
+	tbb::parallel_for(tbb::blocked_range<U32>(0, (U32)ctNodes, SETUP_BLOCK_SIZE),
+		[&](const tbb::blocked_range<U32>& r) {
+		for(U32 n = r.begin(); n != r.end(); n++) {
+			U32 i = n / (ny * nz);
+			U32 j = (n / nz) % ny;
+			U32 k = n % nz;
+			vec3d v = start + vec3d(i, j, k) * cellsize;
+			v.store(&vFlatVertices[(size_t)n * 3]);
 		}
-	}
+	});
 
-	//corner defs
-	enum CellCorners {LBN = 0, LBF = 1, LTN = 2, LTF = 3, RBN = 4, RBF = 5, RTN = 6, RTF = 7};
-	U32 cn[8];
-	//add all elements
-	for(int i=0; i < nx-1; i++) {
-		for(int j=0; j < ny-1; j++) {
-			for(int k=0; k < nz-1; k++) {
-				//collect cell nodes
-				cn[LBN] = i * ny * nz + j * nz + k;
-				cn[LBF] = i * ny * nz + j * nz + k + 1;
-
-				cn[LTN] = i * ny * nz + (j+1) * nz + k;
-				cn[LTF] = i * ny * nz + (j+1) * nz + k + 1;
-
-				cn[RBN] = (i+1) * ny * nz + j * nz + k;
-				cn[RBF] = (i+1) * ny * nz + j * nz + k + 1;
-
-				cn[RTN] = (i+1) * ny * nz + (j+1) * nz + k;
-				cn[RTF] = (i+1) * ny * nz + (j+1) * nz + k + 1;
-
-				//add elements
-				elements.push_back(vec4u32(cn[LBN], cn[LTN], cn[RBN], cn[LBF]));
-				elements.push_back(vec4u32(cn[RTN], cn[LTN], cn[LBF], cn[RBN]));
-				elements.push_back(vec4u32(cn[RTN], cn[LTN], cn[LTF], cn[LBF]));
-				elements.push_back(vec4u32(cn[RTN], cn[RBN], cn[LBF], cn[RBF]));
-				elements.push_back(vec4u32(cn[RTN], cn[LBF], cn[LTF], cn[RBF]));
-				elements.push_back(vec4u32(cn[RTN], cn[LTF], cn[RTF], cn[RBF]));
-			}
-		}
-	}
+	vector<U32> vFlatElements(ctCubes * CUBE_TETS * COUNT_CELL_NODES);
+	tbb::parallel_for(tbb::blocked_range<U32>(0, (U32)ctCubes, SETUP_BLOCK_SIZE),
+		[&](const tbb::blocked_range<U32>& r) {
+		U32 cn[8];
+		for(U32 c = r.begin(); c != r.end(); c++) {
+			U32 i = c / ((ny - 1) * (nz - 1));
+			U32 j = (c / (nz - 1)) % (ny - 1);
+			U32 k = c % (nz - 1);
 
-	//build the final mesh
-	vector<double> vFlatVertices;
-	vector<U32> vFlatElements;
-	FlattenVec3<double>(vertices, vFlatVertices);
-	FlattenVec4<U32>(elements, vFlatElements);
+			//collect cell nodes
+			cn[LBN] = i * ny * nz + j * nz + k;
+			cn[LBF] = i * ny * nz + j * nz + k + 1;
+
+			cn[LTN] = i * ny * nz + (j+1) * nz + k;
+			cn[LTF] = i * ny * nz + (j+1) * nz + k + 1;
 
+			cn[RBN] = (i+1) * ny * nz + j * nz + k;
+			cn[RBF] = (i+1) * ny * nz + j * nz + k + 1;
 
+			cn[RTN] = (i+1) * ny * nz + (j+1) * nz + k;
+			cn[RTF] = (i+1) * ny * nz + (j+1) * nz + k + 1;
+
+			StoreCubeTets(cn, &vFlatElements[(size_t)c * CUBE_TETS * COUNT_CELL_NODES]);
+		}
+	});
+
+	//build the final mesh
 	AnsiStr strName = printToAStr("truthcube_%dx%dx%d", nx, ny, nz);
 	VolMesh* cube = new VolMesh(vFlatVertices, vFlatElements);
 	cube->setName(strName.cptr());
@@ -140,58 +157,46 @@ VolMesh* VolMeshSamples::CreateEggShell(int hseg, int vseg, double radius, doubl
 		return NULL;
 	}
 
-	vector< vec3d > vertices;
-	vector< vec4u32 > elements;
+	U64 ctLayerNodes = (U64)(vseg + 1) * hseg;
+	U64 ctQuads = (U64)vseg * hseg;
+	if(ctQuads * CUBE_TETS * COUNT_CELL_NODES > 0xFFFFFFFFULL) {
+        vlogerror("Eggshell with %d x %d segments is too large", hseg, vseg);
+		return NULL;
+	}
 
 	float vSegInv = 1.0f / (float)vseg;
 	float hSegInv = 1.0f / (float)hseg;
 
-	//Loop Over
-	for(int v=0; v<vseg+1; v++) {
-		double p = DEGTORAD(v * vSegInv * 180.0);
-
-		for(int h=0; h<hseg; h++) {
-			double o = DEGTORAD(h * hSegInv * 360.0);
-
-			//vertex
-			vec3d v1;
-			v1.x = radius * sin(p) * sin(o);
-			v1.z = radius * sin(p) * cos(o);
-			v1.y = radius * cos(p);
-
-			//Add Vertex
-			vertices.push_back(v1);
-		}
-	}
-
-	//layer 2
-	U32 layeroffset = vertices.size();
-	radius -= shelltickness;
-	for(int v=0; v<vseg+1; v++) {
-		double p = DEGTORAD(v * vSegInv * 180.0);
-
-		for(int h=0; h<hseg; h++) {
+	//outer and inner layers of nodes
+	vector<vec3d> vertices(ctLayerNodes * 2);
+	tbb::parallel_for(tbb::blocked_range<U32>(0, (U32)ctLayerNodes * 2, SETUP_BLOCK_SIZE),
+		[&](const tbb::blocked_range<U32>& r) {
+		for(U32 n = r.begin(); n != r.end(); n++) {
+			U32 idxLayer = n / (U32)ctLayerNodes;
+			int v = (int)((n % (U32)ctLayerNodes) / hseg);
+			int h = (int)(n % hseg);
+			double rad = (idxLayer == 0) ? radius : radius - shelltickness;
+
+			double p = DEGTORAD(v * vSegInv * 180.0);
 			double o = DEGTORAD(h * hSegInv * 360.0);
 
 			//vertex
-			vec3d v1;
-			v1.x = radius * sin(p) * sin(o);
-			v1.z = radius * sin(p) * cos(o);
-			v1.y = radius * cos(p);
-
-			//Add Vertex
-			vertices.push_back(v1);
+			vec3d& v1 = vertices[n];
+			v1.x = rad * sin(p) * sin(o);
+			v1.z = rad * sin(p) * cos(o);
+			v1.y = rad * cos(p);
 		}
-	}
-
+	});
 
 	//Indices
-	enum CellCorners {LBN = 0, LBF = 1, LTN = 2, LTF = 3, RBN = 4, RBF = 5, RTN = 6, RTF = 7};
-	U32 cn[8];
-
-	//Add all elements
-	for(int v=0; v<vseg; v++) {
-		for(int h=0; h<hseg; h++) {
+	U32 layeroffset = (U32)ctLayerNodes;
+	vector<U32> vFlatElements(ctQuads * CUBE_TETS * COUNT_CELL_NODES);
+	tbb::parallel_for(tbb::blocked_range<U32>(0, (U32)ctQuads, SETUP_BLOCK_SIZE),
+		[&](const tbb::blocked_range<U32>& r) {
+		U32 cn[8];
+		for(U32 q = r.begin(); q != r.end(); q++) {
+			U32 v = q / hseg;
+			U32 h = q % hseg;
 
 			//top
 			cn[LTN] = h + v*hseg;
@@ -199,7 +204,7 @@ VolMesh* VolMeshSamples::CreateEggShell(int hseg, int vseg, double radius, doubl
 			cn[RTN] = h + (v+1)*hseg;
 			cn[RTF] = cn[RTN] + 1;
 
-			if(h == hseg-1) {
+			if(h == (U32)hseg-1) {
 				cn[LTF] = v*hseg;
 				cn[RTF] = (v+1)*hseg;
 			}
@@ -210,44 +215,234 @@ VolMesh* VolMeshSamples::CreateEggShell(int hseg, int vseg, double radius, doubl
 			cn[RBN] = layeroffset + h + (v+1)*hseg;
 			cn[RBF] = layeroffset + cn[RTN] + 1;
 
-			if(h == hseg-1) {
+			if(h == (U32)hseg-1) {
 				cn[LBF] = layeroffset + v*hseg;
 				cn[RBF] = layeroffset + (v+1)*hseg;
 			}
 
-			//add elements
-			elements.push_back(vec4u32(cn[LBN], cn[LTN], cn[RBN], cn[LBF]));
-			elements.push_back(vec4u32(cn[RTN], cn[LTN], cn[LBF], cn[RBN]));
-			elements.push_back(vec4u32(cn[RTN], cn[LTN], cn[LTF], cn[LBF]));
-			elements.push_back(vec4u32(cn[RTN], cn[RBN], cn[LBF], cn[RBF]));
-			elements.push_back(vec4u32(cn[RTN], cn[LBF], cn[LTF], cn[RBF]));
-			elements.push_back(vec4u32(cn[RTN], cn[LTF], cn[RTF], cn[RBF]));
+			StoreCubeTets(cn, &vFlatElements[(size_t)q * CUBE_TETS * COUNT_CELL_NODES]);
 		}
+	});
+
+	//remove slivers at the poles, the rest keep their order
+	U32 ctElements = (U32)(ctQuads * CUBE_TETS);
+	vector<U8> vIsSliver(ctElements, 0);
+	tbb::parallel_for(tbb::blocked_range<U32>(0, ctElements, SETUP_BLOCK_SIZE),
+		[&](const tbb::blocked_range<U32>& r) {
+		vec3d v[COUNT_CELL_NODES];
+		for(U32 i = r.begin(); i != r.end(); i++) {
+			for(U32 j=0; j < COUNT_CELL_NODES; j++)
+				v[j] = vertices[vFlatElements[i * COUNT_CELL_NODES + j]];
+			vIsSliver[i] = (VolMesh::ComputeCellVolume(v) < 0.0001);
+		}
+	});
+
+	U32 ctKept = 0;
+	for(U32 i=0; i < ctElements; i++) {
+		if(vIsSliver[i])
+			continue;
+		if(ctKept != i)
+			memcpy(&vFlatElements[ctKept * COUNT_CELL_NODES], &vFlatElements[i * COUNT_CELL_NODES], sizeof(U32) * COUNT_CELL_NODES);
+		ctKept++;
 	}
-
-	//remove slivers
-	U32 i = 0;
-	while(i < elements.size()) {
-		//fetch vertices
-		vec4u32 e = elements[i];
-		vec3d v[4];
-		for(U32 j=0; j < COUNT_CELL_NODES; j++)
-			v[j] = vertices[e[j]];
-
-		if(VolMesh::ComputeCellVolume(v) < 0.0001)
-			elements.erase(elements.begin() + i);
-		else
-			i++;
-	}
+	vFlatElements.resize((size_t)ctKept * COUNT_CELL_NODES);
 
 	//build the final mesh
 	vector<double> vFlatVertices;
-	vector<U32> vFlatElements;
 	FlattenVec3<double>(vertices, vFlatVertices);
-	FlattenVec4<U32>(elements, vFlatElements);
 
 	AnsiStr strName = printToAStr("eggshell_h%d_v%d", hseg, vseg);
 	VolMesh* eggshell = new VolMesh(vFlatVertices, vFlatElements);
 	eggshell->setName(strName.cptr());
 	return eggshell;
 }
+
+//splits a cube into 5 tetrahedra, odd cubes take the mirrored split so shared faces match
+static inline void StoreCubeTets5(const U32 cn[8], bool isOdd, U32* lpOut) {
+	const U32 evenTets[5][COUNT_CELL_NODES] = {
+		{cn[LBN], cn[LTN], cn[RBN], cn[LBF]},
+		{cn[LTF], cn[LBF], cn[RTF], cn[LTN]},
+		{cn[RBF], cn[RTF], cn[LBF], cn[RBN]},
+		{cn[RBN], cn[RTN], cn[RTF], cn[LTN]},
+		{cn[LTN], cn[LBF], cn[RTF], cn[RBN]}};
+	const U32 oddTets[5][COUNT_CELL_NODES] = {
+		{cn[LBF], cn[RBF], cn[LTF], cn[LBN]},
+		{cn[LTN], cn[LTF], cn[RTN], cn[LBN]},
+		{cn[LBN], cn[RBN], cn[RBF], cn[RTN]},
+		{cn[RTN], cn[RTF], cn[RBF], cn[LTF]},
+		{cn[LBN], cn[RBF], cn[LTF], cn[RTN]}};
+	memcpy(lpOut, isOdd ? oddTets : evenTets, sizeof(evenTets));
+}
+
+//set bits of a word
+static inline U32 CountBits(U64 word) {
+#if defined(__GNUC__)
+	return (U32)__builtin_popcountll(word);
+#else
+	U32 ct = 0;
+	for(; word != 0; ct++)
+		word &= word - 1;
+	return ct;
+#endif
+}
+
+bool VolMeshSamples::TetrahedralizeVoxelMask(const VOXELMASK& mask, int tetsPerVoxel,
+											 vector<double>& vOutVertices, vector<U32>& vOutElements) {
+	if(tetsPerVoxel != 5 && tetsPerVoxel != CUBE_TETS) {
+        vlogerror("Voxels are split into 5 or 6 tetrahedra, not %d", tetsPerVoxel);
+		return false;
+	}
+
+	if(mask.dim.x <= 0 || mask.dim.y <= 0 || mask.dim.z <= 0 || mask.vOccupied.size() != mask.countVoxels()) {
+        vlogerror("Invalid voxel mask of %d x %d x %d", mask.dim.x, mask.dim.y, mask.dim.z);
+		return false;
+	}
+
+	const U64 nx = mask.dim.x;
+	const U64 ny = mask.dim.y;
+	const U64 nz = mask.dim.z;
+	const U64 ctVoxels = mask.countVoxels();
+
+	//voxel corners are a grid one larger than the mask along each axis. Every row of the grid
+	//starts a new word of the used nodes bitmask, so rows are filled independently.
+	const U64 gx = nx + 1;
+	const U64 gy = ny + 1;
+	const U64 ctRows = gy * (nz + 1);
+	const U64 ctRowWords = (gx + 63) / 64;
+	const U64 ctWords = ctRows * ctRowWords;
+	const U8* lpOccupied = &mask.vOccupied[0];
+
+	//a grid node is used when one of the 8 voxels around it is occupied
+	vector<U64> vUsed(ctWords, 0);
+	tbb::parallel_for(tbb::blocked_range<U64>(0, ctRows, 64),
+		[&](const tbb::blocked_range<U64>& r) {
+		vector<U8> vAny(nx);
+		for(U64 row = r.begin(); row != r.end(); row++) {
+			U64 j = row % gy;
+			U64 k = row / gy;
+
+			//voxel rows touching this row of nodes
+			std::fill(vAny.begin(), vAny.end(), 0);
+			for(U64 dk = (k > 0) ? k - 1 : k; dk <= k && dk < nz; dk++) {
+				for(U64 dj = (j > 0) ? j - 1 : j; dj <= j && dj < ny; dj++) {
+					const U8* lpRow = lpOccupied + (dk * ny + dj) * nx;
+					for(U64 i = 0; i < nx; i++)
+						vAny[i] |= lpRow[i];
+				}
+			}
+
+			U64* lpWords = &vUsed[row * ctRowWords];
+			for(U64 i = 0; i < gx; i++) {
+				if((i < nx && vAny[i]) || (i > 0 && vAny[i - 1]))
+					lpWords[i / 64] |= (1ULL << (i % 64));
+			}
+		}
+	});
+
+	//the index of a used node is the number of used nodes before its word plus those before it in the word
+	vector<U32> vWordBase(ctWords);
+	U64 ctNodes = 0;
+	for(U64 w = 0; w < ctWords; w++) {
+		vWordBase[w] = (U32)ctNodes;
+		ctNodes += CountBits(vUsed[w]);
+	}
+
+	//occupied voxels of every block
+	const U64 ctBlocks = (ctVoxels + VOXEL_BLOCK_SIZE - 1) / VOXEL_BLOCK_SIZE;
+	vector<U64> vBlockBase(ctBlocks + 1, 0);
+	tbb::parallel_for(tbb::blocked_range<U64>(0, ctBlocks, 1),
+		[&](const tbb::blocked_range<U64>& r) {
+		for(U64 b = r.begin(); b != r.end(); b++) {
+			U64 last = std::min<U64>((b + 1) * VOXEL_BLOCK_SIZE, ctVoxels);
+			U64 ct = 0;
+			for(U64 v = b * VOXEL_BLOCK_SIZE; v < last; v++)
+				ct += (lpOccupied[v] != 0);
+			vBlockBase[b + 1] = ct;
+		}
+	});
+
+	for(U64 b = 0; b < ctBlocks; b++)
+		vBlockBase[b + 1] += vBlockBase[b];
+
+	const U64 ctOccupied = vBlockBase[ctBlocks];
+	if(ctOccupied == 0) {
+        vlogerror("Voxel mask has no occupied voxels");
+		return false;
+	}
+
+	if(ctNodes > 0xFFFFFFFFULL || ctOccupied * tetsPerVoxel * COUNT_CELL_NODES > 0xFFFFFFFFULL) {
+        vlogerror("Voxel mask with %llu occupied voxels is too large", (unsigned long long)ctOccupied);
+		return false;
+	}
+
+	//nodes are placed at the voxel corners
+	const vec3d start = mask.origin - mask.spacing * 0.5;
+	vOutVertices.resize(ctNodes * 3);
+	tbb::parallel_for(tbb::blocked_range<U64>(0, ctWords, SETUP_BLOCK_SIZE / 64),
+		[&](const tbb::blocked_range<U64>& r) {
+		for(U64 w = r.begin(); w != r.end(); w++) {
+			U64 word = vUsed[w];
+			U32 idxNode = vWordBase[w];
+			U64 row = w / ctRowWords;
+			for(U64 b = 0; word != 0; b++, word >>= 1) {
+				if((word & 1) == 0)
+					continue;
+
+				vec3d ijk((double)((w % ctRowWords) * 64 + b), (double)(row % gy), (double)(row / gy));
+				vec3d p = start + vec3d::mul(ijk, mask.spacing);
+				p.store(&vOutVertices[(size_t)idxNode * 3]);
+				idxNode++;
+			}
+		}
+	});
+
+	//cells of the occupied voxels in voxel order
+	const U32 szVoxelCells = tetsPerVoxel * COUNT_CELL_NODES;
+	vOutElements.resize(ctOccupied * szVoxelCells);
+	tbb::parallel_for(tbb::blocked_range<U64>(0, ctBlocks, 1),
+		[&](const tbb::blocked_range<U64>& r) {
+		U32 cn[8];
+		for(U64 b = r.begin(); b != r.end(); b++) {
+			U64 last = std::min<U64>((b + 1) * VOXEL_BLOCK_SIZE, ctVoxels);
+			U32* lpOut = &vOutElements[0] + vBlockBase[b] * szVoxelCells;
+			for(U64 v = b * VOXEL_BLOCK_SIZE; v < last; v++) {
+				if(lpOccupied[v] == 0)
+					continue;
+
+				U64 i = v % nx;
+				U64 j = (v / nx) % ny;
+				U64 k = v / (nx * ny);
+
+				//left/right along x, bottom/top along y and near/far along z
+				for(int c = 0; c < 8; c++) {
+					U64 ci = i + ((c & 4) ? 1 : 0);
+					U64 cj = j + ((c & 2) ? 1 : 0);
+					U64 ck = k + ((c & 1) ? 1 : 0);
+					U64 w = (ck * gy + cj) * ctRowWords + ci / 64;
+					cn[c] = vWordBase[w] + CountBits(vUsed[w] & ((1ULL << (ci % 64)) - 1));
+				}
+
+				if(tetsPerVoxel == CUBE_TETS)
+					StoreCubeTets(cn, lpOut);
+				else
+					StoreCubeTets5(cn, ((i + j + k) & 1) != 0, lpOut);
+				lpOut += szVoxelCells;
+			}
+		}
+	});
+
+	return true;
+}
+
+VolMesh* VolMeshSamples::CreateFromVoxelMask(const VOXELMASK& mask, int tetsPerVoxel) {
+	vector<double> vFlatVertices;
+	vector<U32> vFlatElements;
+	if(!TetrahedralizeVoxelMask(mask, tetsPerVoxel, vFlatVertices, vFlatElements))
+		return NULL;
+
+	//build the final mesh
+	AnsiStr strName = printToAStr("voxels_%dx%dx%d", mask.dim.x, mask.dim.y, mask.dim.z);
+	VolMesh* voxels = new VolMesh(vFlatVertices, vFlatElements);
+	voxels->setName(strName.cptr());
+	return voxels;
+}
@@ -14,6 +14,23 @@
 namespace ps {
 namespace elastic {
 
+//voxels of a mask handled by one task of the voxel mesher
+#define VOXEL_BLOCK_SIZE 65536
+
+/*!
+ * occupancy of a segmented volume, one byte per voxel with x varying fastest. The origin is the
+ * center of the first voxel and the spacing is the voxel size along each axis.
+ */
+struct VOXELMASK {
+	vec3i dim;
+	vec3d spacing;
+	vec3d origin;
+	vector<U8> vOccupied;
+
+	VOXELMASK(): dim(0, 0, 0), spacing(1.0), origin(0.0) {}
+
+	U64 countVoxels() const { return (U64)dim.x * dim.y * dim.z;}
+};
 
 class VolMeshSamples{
 public:
@@ -23,6 +40,15 @@ public:
 	static VolMesh* CreateTwoTetra();
 	static VolMesh* CreateTruthCube(int nx, int ny, int nz, double cellsize);
 	static VolMesh* CreateEggShell(int hseg = 8, int vseg = 8, double radius = 2.0, double shelltickness = 0.3);
+
+	/*!
+	 * meshes the occupied voxels of a mask with 5 or 6 tetrahedra each. Voxel corners are shared
+	 * by neighboring voxels and only the corners of occupied voxels become nodes. The 5 tetrahedra
+	 * split alternates between neighbors so the faces of adjacent voxels match.
+	 */
+	static VolMesh* CreateFromVoxelMask(const VOXELMASK& mask, int tetsPerVoxel = 6);
+	static bool TetrahedralizeVoxelMask(const VOXELMASK& mask, int tetsPerVoxel,
+										vector<double>& vOutVertices, vector<U32>& vOutElements);
 };
 
 }
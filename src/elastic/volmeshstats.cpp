@@ -51,7 +51,7 @@ bool VolMeshStats::computeVolMaxMin(const VolMesh* pmesh, double& outVolMax, dou
 	for(U32 i=0; i < pmesh->countCells(); i++) {
 		double v = pmesh->computeCellVolume(i);
 
-		if(v > FLAT_CELL_VOLUME) {
+		if(v > pmesh->getFlatCellVolume()) {
 			outVolMax = MATHMAX(v, outVolMax);
 			outVolMin = MATHMIN(v, outVolMin);
 		}
@@ -6,7 +6,7 @@
  */
 
 #include "base/Logger.h"
-#include "elastic/avatarring.h"
+#include "elasticrender/avatarring.h"
 #include "glbackend/glselect.h"
 #include "glbackend/gltypes.h"
 
@@ -174,11 +174,11 @@ void AvatarRing::onTranslate(const vec3f& delta, const vec3f& pos) {
 	m_aabbCurrent.transform(m_spTransform->forward());
 
 	//1.If boxes donot intersect and sweptquad is invalid then return
-	if (!m_lpTissue->aabb().intersect(m_aabbCurrent) || isGripActive()) {
+	if (!intersectsTissue(m_aabbCurrent) || isGripActive()) {
 
 		if(m_isSweptQuadValid) {
 			//call the cut method if the tool has passed through the tissue
-			int res = m_lpTissue->cut(m_vSegmentsCur, m_vSweptQuads, true);
+			int res = cutTissue(m_vSegmentsCur, m_vSweptQuads);
             vloginfo("Tissue cut. res = %d", res);
 			if((res > 0) && (m_fOnCutFinished != NULL))
 				m_fOnCutFinished();
@@ -217,6 +217,10 @@ void AvatarRing::onTranslate(const vec3f& delta, const vec3f& pos) {
 		m_isSweptQuadValid = true;
 	}
 
+	//speculative: the quads swept so far are what the exit event commits
+	if(m_flagSpeculativeCut && m_isSweptQuadValid)
+		m_lpTissue->speculateCut(m_vSegmentsCur, m_vSweptQuads);
+
 
 	//Insert new scalpal position into buffer
 	m_vCuttingPath.push_back(m_vSegmentsCur.back());
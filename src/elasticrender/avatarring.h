@@ -8,7 +8,7 @@
 #ifndef AVATARRING_H_
 #define AVATARRING_H_
 
-#include "elastic/iavatar.h"
+#include "elasticrender/iavatar.h"
 #include "glbackend/gltexture.h"
 
 using namespace ps::opengl;
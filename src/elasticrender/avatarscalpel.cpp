@@ -35,7 +35,9 @@ AvatarScalpel::~AvatarScalpel() {
 void AvatarScalpel::init() {
 
 	m_isSweptQuadValid = false;
+	m_flagProgressiveCut = false;
 	m_vSweptQuad.resize(4);
+	m_vFrameQuad.resize(4);
 	m_edgeref0 = vec3f(-2.0, 0, 0);
 	m_edgeref1 = vec3f(2.0, 0, 0);
 	vec3f lo = vec3f(m_edgeref0.x, 0.0f, -0.001f);
@@ -151,7 +153,7 @@ void AvatarScalpel::onTranslate(const vec3f& delta, const vec3f& pos) {
 	m_aabbCurrent.transform(m_spTransform->forward());
 
 	//1.If boxes donot intersect and sweptquad is invalid then return
-	if (!m_lpTissue->aabb().intersect(m_aabbCurrent)) {
+	if (!intersectsTissue(m_aabbCurrent)) {
 
 		if(m_isSweptQuadValid) {
 			//call the cut method if the tool has passed through the tissue
@@ -159,7 +161,11 @@ void AvatarScalpel::onTranslate(const vec3f& delta, const vec3f& pos) {
 			m_vBladeSegments[0] = m_vCuttingPathEdge0.back();
 			m_vBladeSegments[1] = m_vCuttingPathEdge1.back();
 
-			int res = m_lpTissue->cut(m_vBladeSegments, m_vSweptQuad, true);
+			int res = 0;
+			if(m_flagProgressiveCut)
+				res = m_lpTissue->endProgressiveCut(m_vSweptQuad);
+			else
+				res = cutTissue(m_vBladeSegments, m_vSweptQuad);
             vloginfo("Tissue cut. res = %d", res);
 			if((res > 0) && (m_fOnCutFinished != NULL))
 				m_fOnCutFinished();
@@ -221,6 +227,31 @@ void AvatarScalpel::onTranslate(const vec3f& delta, const vec3f& pos) {
 	}
 
 
+	//progressive: cut the quad swept since the last frame
+	if(m_flagProgressiveCut && m_isSweptQuadValid) {
+		m_vFrameQuad[0] = m_vCuttingPathEdge0.back();
+		m_vFrameQuad[1] = edge0;
+		m_vFrameQuad[2] = m_vCuttingPathEdge1.back();
+		m_vFrameQuad[3] = edge1;
+
+		m_vBladeSegments.resize(2);
+		m_vBladeSegments[0] = edge0;
+		m_vBladeSegments[1] = edge1;
+
+		int res = m_lpTissue->cutProgressive(m_vBladeSegments, m_vFrameQuad);
+		if(res > 0)
+			vloginfo("Progressive cut. subdivided = %d, pending cut edges = %u", res, m_lpTissue->countPendingCutEdges());
+		else if(res < 0)
+			vlogerror("Progressive cut failed. res = %d", res);
+	}
+	else if(m_flagSpeculativeCut && m_isSweptQuadValid) {
+		//speculative: the quad swept so far is what the exit event commits
+		m_vBladeSegments.resize(2);
+		m_vBladeSegments[0] = edge0;
+		m_vBladeSegments[1] = edge1;
+		m_lpTissue->speculateCut(m_vBladeSegments, m_vSweptQuad);
+	}
+
 	//Insert new scalpal position into buffer
 	m_vCuttingPathEdge0.push_back(edge0);
 	m_vCuttingPathEdge1.push_back(edge1);
@@ -232,8 +263,6 @@ void AvatarScalpel::onTranslate(const vec3f& delta, const vec3f& pos) {
 	if (m_vCuttingPathEdge1.size() > MAX_SCALPEL_TRAJECTORY_NODES)
 		m_vCuttingPathEdge1.erase(m_vCuttingPathEdge1.begin());
 
-	//int res = m_lpTissue->cut(m_vCuttingPathEdge0, m_vCuttingPathEdge1, m_sweptQuad, false);
-	//LogInfoArg1("Progressive cutting not implemented. res = %d", res);
 }
 
 }
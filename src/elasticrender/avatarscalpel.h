@@ -32,10 +32,15 @@ public:
     void onTranslate(const vec3f& delta, const vec3f& pos) override;
 	void clearCutContext();
 
+	//progressive cutting opens the tissue while the blade moves inside it
+	bool getFlagProgressiveCut() const { return m_flagProgressiveCut;}
+	void setFlagProgressiveCut(bool flag) { m_flagProgressiveCut = flag;}
+
 
 protected:
 	//flags
 	bool m_isSweptQuadValid;
+	bool m_flagProgressiveCut;
 	AABB m_aabbCurrent;
 
 	//Outline mesh for easier view
@@ -51,6 +56,7 @@ protected:
 	vector<vec3d> m_vCuttingPathEdge1;
 	vector<vec3d> m_vSweptQuad;
 	vector<vec3d> m_vBladeSegments;
+	vector<vec3d> m_vFrameQuad;
 };
 
 }
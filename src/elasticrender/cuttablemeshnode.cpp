@@ -0,0 +1,237 @@
+/*
+ * cuttablemeshnode.cpp
+ */
+
+#include "base/logger.h"
+#include "scene/sgengine.h"
+#include "glbackend/glselect.h"
+#include "elasticrender/cuttablemeshnode.h"
+
+namespace ps {
+namespace elastic {
+
+CuttableMeshNode::CuttableMeshNode(CuttableMesh* pmesh): SGNode(), m_lpMesh(pmesh) {
+	m_elemToShow = m_nodeToShow = VolMesh::INVALID_INDEX;
+	m_flagDrawSweepSurf = false;
+	m_flagDrawAABB = false;
+
+	resetTransform();
+	if(TheShaderManager::Instance().has("phong")) {
+        m_spEffect = SmartPtrSGEffect(new SGEffect(TheShaderManager::Instance().get("phong")));
+    }
+
+	//Create Renderer
+	m_lpRender = new VolMeshRender();
+	m_lpRender->setFlagDrawWireFrame(false);
+	m_lpRender->setFlagDrawNodes(false);
+
+	if(m_lpMesh) {
+		setName(m_lpMesh->name());
+		m_lpMesh->setOnMeshChangedCallback([this](const VolMesh* pmesh) { this->syncRender(); });
+	}
+
+	//Create render
+	syncRender();
+}
+
+CuttableMeshNode::~CuttableMeshNode() {
+	if(m_lpMesh)
+		m_lpMesh->setOnMeshChangedCallback(NULL);
+	SAFE_DELETE(m_lpRender);
+}
+
+void CuttableMeshNode::syncRender() {
+	if(m_lpMesh == NULL)
+		return;
+
+	m_lpRender->sync(m_lpMesh);
+	m_aabb = m_lpMesh->aabb();
+}
+
+void CuttableMeshNode::setElemToShow(U32 elem) {
+	if(elem == m_elemToShow)
+		return;
+	m_elemToShow = elem;
+}
+
+void CuttableMeshNode::setNodeToShow(U32 idxNode) {
+	if(idxNode == m_nodeToShow)
+		return;
+	m_nodeToShow = idxNode;
+}
+
+void CuttableMeshNode::setFlagDrawWireFrame(bool drawWireFrame) {
+	m_lpRender->setFlagDrawWireFrame(drawWireFrame);
+}
+
+void CuttableMeshNode::setFlagDrawNodes(bool drawNodes) {
+	m_lpRender->setFlagDrawNodes(drawNodes);
+}
+
+void CuttableMeshNode::setColor(const Color& c) {
+	m_lpRender->setColor(c);
+}
+
+void CuttableMeshNode::draw() {
+	if(m_lpMesh == NULL)
+		return;
+
+	//draw volmesh
+	if(m_spEffect)
+		m_spEffect->bind();
+	if(m_spTransform)
+		m_spTransform->bind();
+
+	if(m_flagDrawAABB)
+		drawBBox();
+
+	m_lpRender->draw();
+
+	//selected element
+	if(m_lpMesh->isCellIndex(m_elemToShow)) {
+		glPushAttrib(GL_ALL_ATTRIB_BITS);
+		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		glDisable(GL_CULL_FACE);
+		glColor3f(1.0f, 0.3f, 0.0f);
+		drawElement(m_elemToShow);
+		glEnable(GL_CULL_FACE);
+		glPopAttrib();
+	}
+
+	if(m_spTransform)
+		m_spTransform->unbind();
+	if(m_spEffect)
+		m_spEffect->unbind();
+
+	//selected node and its neighbors
+	if(m_lpMesh->isNodeIndex(m_nodeToShow)) {
+		vector<U32> incidentNodes;
+		m_lpMesh->getNodeIncidentNodes(m_nodeToShow, incidentNodes);
+		vec3d pos = m_lpMesh->const_nodeAt(m_nodeToShow).pos;
+
+		glDisable(GL_LIGHTING);
+		glPushAttrib(GL_ALL_ATTRIB_BITS);
+		glPointSize(7.0f);
+		glColor3f(0.0, 1.0, 0.0);
+		glBegin(GL_POINTS);
+		glVertex3dv(pos.cptr());
+		glEnd();
+
+		glLineWidth(3.0f);
+		glColor3f(0.0, 0.0, 1.0);
+		glBegin(GL_LINES);
+		for(U32 i=0; i < incidentNodes.size(); i++) {
+			glVertex3dv(pos.cptr());
+			glVertex3dv(m_lpMesh->const_nodeAt(incidentNodes[i]).pos.cptr());
+		}
+		glEnd();
+		glPopAttrib();
+		glEnable(GL_LIGHTING);
+	}
+
+	//draw cut context
+	const std::map<U32, CuttableMesh::CutEdge>& mapCutEdges = m_lpMesh->cutEdges();
+	const std::map<U32, CuttableMesh::CutNode>& mapCutNodes = m_lpMesh->cutNodes();
+	if(mapCutNodes.size() > 0 || mapCutEdges.size() > 0) {
+		glDisable(GL_LIGHTING);
+		glPushAttrib(GL_ALL_ATTRIB_BITS);
+			//Draw nodes
+			glPointSize(7.0f);
+			glBegin(GL_POINTS);
+			//Draw cutedges crossing
+			for(std::map<U32, CuttableMesh::CutEdge>::const_iterator it = mapCutEdges.begin(); it != mapCutEdges.end(); ++it) {
+				glColor3f(0.0, 0.0, 0.0);
+				if(m_lpMesh->isNodeIndex(it->second.idxNP0))
+					glVertex3dv(m_lpMesh->const_nodeAt(it->second.idxNP0).pos.cptr());
+
+				glColor3f(0.0, 0.0, 1.0);
+				glVertex3dv(it->second.pos.cptr());
+
+				glColor3f(0.0, 0.0, 0.0);
+				if(m_lpMesh->isNodeIndex(it->second.idxNP1))
+					glVertex3dv(m_lpMesh->const_nodeAt(it->second.idxNP1).pos.cptr());
+			}
+			glEnd();
+
+			glColor3f(0, 0, 0);
+			glBegin(GL_POINTS);
+			//Draw cutnodes
+			for(std::map<U32, CuttableMesh::CutNode>::const_iterator it = mapCutNodes.begin(); it != mapCutNodes.end(); ++it) {
+				glVertex3dv(it->second.pos.cptr());
+			}
+			glEnd();
+
+		glPopAttrib();
+		glEnable(GL_LIGHTING);
+	}
+
+	if(m_flagDrawSweepSurf) {
+		const vector<vec3d>& quadstrips = m_lpMesh->sweptSurface();
+
+		glDisable(GL_CULL_FACE);
+		glDisable(GL_LIGHTING);
+		glPushAttrib(GL_ALL_ATTRIB_BITS);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glEnable(GL_BLEND);
+
+		glColor4f(1.0, 0.0, 0.0, 0.3);
+		glBegin(GL_QUAD_STRIP);
+		for(U32 i=0; i < quadstrips.size(); i++) {
+			glVertex3dv(quadstrips[i].cptr());
+		}
+		glEnd();
+
+		glDisable(GL_BLEND);
+		glPopAttrib();
+		glEnable(GL_LIGHTING);
+		glEnable(GL_CULL_FACE);
+	}
+}
+
+void CuttableMeshNode::drawElement(U32 i) const {
+	if(!m_lpMesh->isCellIndex(i))
+		return;
+
+	const CELL& cell = m_lpMesh->const_cellAt(i);
+	vec3f cp = TheEngine::Instance().camera().pos();
+	vec3d cpd = vec3d(cp.x, cp.y, cp.z);
+
+	glBegin(GL_TRIANGLES);
+		for(U32 f=0; f<4; f++)
+		{
+			U32 nodes[3];
+			m_lpMesh->getFaceNodes(cell.faces[f], nodes);
+
+			vec3d p0 = m_lpMesh->const_nodeAt(nodes[0]).pos;
+			vec3d p1 = m_lpMesh->const_nodeAt(nodes[1]).pos;
+			vec3d p2 = m_lpMesh->const_nodeAt(nodes[2]).pos;
+
+			vec3d n = vec3d::cross(p1 - p0, p2 - p0).normalized();
+			vec3d cd = (cpd - p0).normalized();
+
+			if(vec3d::dot(cd, n) < 0) {
+				n = n * -1.0;
+				vec3d temp = p0;
+				p0 = p2;
+				p2 = temp;
+			}
+
+			//to gl
+			glNormal3dv(n.cptr());
+			glVertex3dv(p0.cptr());
+			glVertex3dv(p1.cptr());
+			glVertex3dv(p2.cptr());
+		}
+	glEnd();
+}
+
+void CuttableMeshNode::applyTransformToMeshThenResetTransform() {
+	if(!m_spTransform || m_lpMesh == NULL)
+		return;
+
+	m_lpMesh->applyTransform(m_spTransform->forward());
+	m_spTransform->reset();
+}
+
+} /* namespace elastic */
+} /* namespace ps */
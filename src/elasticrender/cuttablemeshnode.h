@@ -0,0 +1,79 @@
+/*
+ * cuttablemeshnode.h
+ */
+
+#ifndef CUTTABLEMESHNODE_H_
+#define CUTTABLEMESHNODE_H_
+
+#include "base/color.h"
+#include "scene/sgnode.h"
+#include "elastic/cuttablemesh.h"
+#include "elasticrender/volmeshrender.h"
+
+namespace ps {
+namespace elastic {
+
+/*!
+ * Synopsis: scene graph adapter for a cuttable mesh. Draws the mesh surface, the current cut context
+ * and the swept surface of the last cut. The render buffers are synced every time the mesh reports
+ * a change. The mesh is not owned by the node.
+ */
+class CuttableMeshNode : public SGNode {
+public:
+	CuttableMeshNode(CuttableMesh* pmesh);
+	virtual ~CuttableMeshNode();
+
+	CuttableMesh* mesh() const { return m_lpMesh;}
+
+	//draw
+	void draw();
+
+	//sync renderer
+	void syncRender();
+
+	//show individual entities
+	void setElemToShow(U32 elem = VolMesh::INVALID_INDEX);
+	U32 getElemToShow() const {return m_elemToShow;}
+	void setNodeToShow(U32 idxNode = VolMesh::INVALID_INDEX);
+	U32 getNodeToShow() const {return m_nodeToShow;}
+
+	//flag on what to show
+	void setFlagDrawWireFrame(bool drawWireFrame);
+	bool getFlagDrawWireFrame() const {return m_lpRender->getFlagDrawWireFrame();}
+
+	void setFlagDrawNodes(bool drawNodes);
+	bool getFlagDrawNodes() const {return m_lpRender->getFlagDrawNodes();}
+
+	bool getFlagDrawSweepSurf() const { return m_flagDrawSweepSurf;}
+	void setFlagDrawSweepSurf(bool flag) { m_flagDrawSweepSurf = flag;}
+
+	bool getFlagDrawAABB() const { return m_flagDrawAABB;}
+	void setFlagDrawAABB(bool flag) { m_flagDrawAABB = flag;}
+
+	//set base color
+	Color getColor() const {return m_lpRender->getColor();}
+	void setColor(const Color& c);
+
+	/*!
+	 * This is a convenient function to aid in transforming original volume meshes and placing them
+	 * in the right projection view. Later the transform is applied to all mesh nodes and then the
+	 * transform itself is reset.
+	 */
+	void applyTransformToMeshThenResetTransform();
+
+protected:
+	void drawElement(U32 i) const;
+
+private:
+	CuttableMesh* m_lpMesh;
+	VolMeshRender* m_lpRender;
+	U32 m_elemToShow;
+	U32 m_nodeToShow;
+	bool m_flagDrawSweepSurf;
+	bool m_flagDrawAABB;
+};
+
+} /* namespace elastic */
+} /* namespace ps */
+
+#endif /* CUTTABLEMESHNODE_H_ */
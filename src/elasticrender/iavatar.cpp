@@ -6,7 +6,7 @@
  */
 
 #include "base/logger.h"
-#include "elastic/iavatar.h"
+#include "elasticrender/iavatar.h"
 
 #include "scene/sgengine.h"
 
@@ -32,8 +32,10 @@ void IAvatar::init() {
 	setName("scalpel");
 	m_fOnCutFinished = NULL;
 	m_lpTissue = NULL;
+	m_lpTissueSet = NULL;
 	m_isToolActive = false;
 	m_applyGripper = false;
+	m_flagSpeculativeCut = false;
 
 	//Add a header
     TheEngine::Instance().headers()->addHeaderLine("scalpel", "scalpel");
@@ -50,6 +52,22 @@ void IAvatar::setTissue(CuttableMesh* tissue) {
 		updateVolMeshInfoHeader();
 }
 
+bool IAvatar::intersectsTissue(const AABB& box) {
+	if(m_lpTissueSet && m_lpTissueSet->count() > 0) {
+		m_lpTissueSet->update();
+		return m_lpTissueSet->aabb().intersect(box);
+	}
+
+	return m_lpTissue && m_lpTissue->aabb().intersect(box);
+}
+
+int IAvatar::cutTissue(const vector<vec3d>& segments, const vector<vec3d>& quadstrips) {
+	if(m_lpTissueSet && m_lpTissueSet->count() > 0)
+		return m_lpTissueSet->cut(segments, quadstrips, true);
+
+	return m_lpTissue->cut(segments, quadstrips, true);
+}
+
 void IAvatar::onStart() {
     if (m_lpTissue) {
         m_isToolActive = true;
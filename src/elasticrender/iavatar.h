@@ -12,10 +12,13 @@
 #include <scene/gizmo.h>
 #include <scene/sgmesh.h>
 #include "elastic/cuttablemesh.h"
+#include "elastic/cuttablemeshset.h"
 
 #define MAX_SCALPEL_TRAJECTORY_ANGLE  60.0
 #define MAX_SCALPEL_TRAJECTORY_NODES 1024
 
+using namespace ps::scene;
+
 namespace ps {
 namespace elastic {
 
@@ -33,6 +36,10 @@ public:
 	//Tool
 	void setOnCutFinishedEventHandler(OnCutFinished f) {m_fOnCutFinished = f;}
 	void setTissue(CuttableMesh* tissue);
+
+	//pieces of the tissue cut together with it. progressive and speculative cuts stay on the tissue
+	void setTissueSet(CuttableMeshSet* pset) { m_lpTissueSet = pset;}
+	CuttableMeshSet* getTissueSet() const { return m_lpTissueSet;}
 	virtual void grip();
 	bool isGripActive() const {return m_applyGripper;}
 
@@ -40,6 +47,10 @@ public:
 	bool isActive() const {return m_isToolActive;}
 	void updateVolMeshInfoHeader() const;
 
+	//speculative cutting computes the cut context in the background while the tool moves
+	bool getFlagSpeculativeCut() const { return m_flagSpeculativeCut;}
+	void setFlagSpeculativeCut(bool flag) { m_flagSpeculativeCut = flag;}
+
 	//From Gizmo Manager
     virtual void onStart() override;
     virtual void onStop() override;
@@ -49,13 +60,21 @@ public:
 protected:
 	void init();
 
+	//box test against the tissue or the tissue set
+	bool intersectsTissue(const AABB& box);
+
+	//cuts the tissue or all the pieces of the tissue set the swept surface overlaps
+	int cutTissue(const vector<vec3d>& segments, const vector<vec3d>& quadstrips);
+
 protected:
 	bool m_isToolActive;
 	bool m_applyGripper;
+	bool m_flagSpeculativeCut;
 	OnCutFinished m_fOnCutFinished;
 
 
 	CuttableMesh* m_lpTissue;
+	CuttableMeshSet* m_lpTissueSet;
 };
 
 } /* namespace MESH */
@@ -5,7 +5,7 @@
  *      Author: pourya
  */
 
-#include "elastic/volmeshrender.h"
+#include "elasticrender/volmeshrender.h"
 #include "base/FlatArray.h"
 #include "scene/sgengine.h"
 #include "glbackend/glselect.h"
@@ -55,6 +55,10 @@ VolMeshRender::~VolMeshRender() {
 }
 
 void VolMeshRender::init() {
+	m_color = Color::skin();
+	m_flagDrawWireFrame = true;
+	m_flagDrawNodes = true;
+
 	resetTransform();
 	if(TheShaderManager::Instance().has("volmeshphong")) {
         m_spEffect = SmartPtrSGEffect(new VolMeshEffect(TheShaderManager::Instance().get("volmeshphong")));
@@ -147,7 +151,7 @@ bool VolMeshRender::sync(const VolMesh* pmesh) {
 	//setup surface mesh
     m_meshbuffer.setupVertexAttribsT<double>(GL_DOUBLE, vFlatNodes, 3, gbtPosition);
     m_meshbuffer.setupVertexAttribsT<double>(GL_DOUBLE, vFlatNodeNormals, 3, gbtNormal);
-    m_meshbuffer.setupPerVertexColorT<float>(GL_FLOAT, pmesh->getColor(), pmesh->countNodes(), 3);
+    m_meshbuffer.setupPerVertexColorT<float>(GL_FLOAT, m_color, pmesh->countNodes(), 3);
     m_meshbuffer.setupFaceIndexBufferT<U32>(GL_UNSIGNED_INT, vIndices, ftTriangles);
 
 	//setup wireframe
@@ -205,20 +209,23 @@ void VolMeshRender::draw() {
     SGMesh::drawNoEffect();
 
 	//draw wireframe
-	m_sgWireFrame.drawNoEffect();
+	if(m_flagDrawWireFrame)
+		m_sgWireFrame.drawNoEffect();
 
 	if(peff)
 		peff->unbind();
 
 
 	//draw points
-	glPushAttrib(GL_ALL_ATTRIB_BITS);
-	glPointSize(3.0f);
-	glDisable(GL_LIGHTING);
-		m_sgVertices.drawNoEffect();
-		//m_sgNormals.drawNoEffect();
-	glEnable(GL_LIGHTING);
-	glPopAttrib();
+	if(m_flagDrawNodes) {
+		glPushAttrib(GL_ALL_ATTRIB_BITS);
+		glPointSize(3.0f);
+		glDisable(GL_LIGHTING);
+			m_sgVertices.drawNoEffect();
+			//m_sgNormals.drawNoEffect();
+		glEnable(GL_LIGHTING);
+		glPopAttrib();
+	}
 	glEnable(GL_CULL_FACE);
 }
 
@@ -8,9 +8,12 @@
 #ifndef VOLMESHRENDER_H_
 #define VOLMESHRENDER_H_
 
+#include "base/color.h"
 #include "scene/sgmesh.h"
 #include "elastic/volmesh.h"
 
+using namespace ps::scene;
+
 namespace ps {
 namespace elastic {
 
@@ -24,13 +27,24 @@ public:
 
 	void draw();
 
+	//surface color used at the next sync
+	Color getColor() const {return m_color;}
+	void setColor(const Color& c) { m_color = c;}
+
+	//flag on what to show
+	void setFlagDrawWireFrame(bool drawWireFrame) { m_flagDrawWireFrame = drawWireFrame;}
+	bool getFlagDrawWireFrame() const {return m_flagDrawWireFrame;}
+
+	void setFlagDrawNodes(bool drawNodes) { m_flagDrawNodes = drawNodes;}
+	bool getFlagDrawNodes() const {return m_flagDrawNodes;}
+
 protected:
 	void init();
 
 private:
-//	bool m_flagDrawSurface;
-//	bool m_flagDrawWireframe;
-//	bool m_flagDrawVertices;
+	Color m_color;
+	bool m_flagDrawWireFrame;
+	bool m_flagDrawNodes;
 	SGMesh m_sgWireFrame;
 	SGMesh m_sgVertices;
 	SGMesh m_sgNormals;
@@ -218,6 +218,14 @@ int GLShader::compileCode(const char* vShaderCode, const char* vFragmentCode, co
     return true;
 }
 
+void GLShader::setFilePaths(const AnsiStr& strVertexShaderFP,
+                            const AnsiStr& strFragmentShaderFP,
+                            const AnsiStr& strGeometryShaderFP) {
+    m_strVertexFP = strVertexShaderFP;
+    m_strFragmentFP = strFragmentShaderFP;
+    m_strGeometryFP = strGeometryShaderFP;
+}
+
 void GLShader::bind()
 {
     if(!isReadyToRun())
@@ -87,6 +87,20 @@ namespace ps {
              * @return 1 if successfully compile and link the shader program
              */
             int  compileCode(const char* vShaderCode, const char* vFragmentCode, const char* vGeometryCode = NULL);
+
+            /*
+             * Sets the file paths reported with the compile errors when the code is read
+             * by the caller and compiled with compileCode.
+             */
+            void setFilePaths(const AnsiStr& strVertexShaderFP,
+                              const AnsiStr& strFragmentShaderFP,
+                              const AnsiStr& strGeometryShaderFP = AnsiStr("inline"));
+
+            /*
+             * Reads the whole content of a shader file. Does not touch the gl context so it can
+             * be called from any thread.
+             */
+            static bool readShaderCode(const AnsiStr& strFilePath, AnsiStr& strCode);
             
             //Load and Save Binary Shaders
             static bool isBinaryShaderSupported();
@@ -105,7 +119,6 @@ namespace ps {
         private:
             void reportShaderCompileErrors(U32 uShaderName, const AnsiStr& shadertype, const AnsiStr& filepath);
             bool removeAllCppComments(AnsiStr& strCode);
-            bool readShaderCode(const AnsiStr& strFilePath, AnsiStr& strCode);
             
         private:
             U32   m_glShader;
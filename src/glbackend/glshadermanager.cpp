@@ -1,3 +1,5 @@
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
 #include "glshadermanager.h"
 #include "glfuncs.h"
 #include "base/logger.h"
@@ -10,6 +12,20 @@ using namespace ps::opengl;
 using namespace ps::utils;
 
 
+namespace {
+
+//source files of a shader program read ahead of compiling
+struct SHADERFILES {
+    AnsiStr arrPaths[3];
+    AnsiStr arrCode[3];
+    bool isRead;
+    bool hasGeometry;
+
+    SHADERFILES(): isRead(false), hasGeometry(false) {}
+};
+
+}
+
 void ReleaseShader(U32 shader) {
     if(glIsProgram(shader))
         glDeleteProgram(shader);
@@ -99,28 +115,52 @@ bool ShaderManager::addFromFile(const char* name,
 
 int ShaderManager::addFromFolder(const char* chrShadersPath)
 {
-    int count = 0;
     vector<AnsiStr> vFiles;
     ListFilesInDir(vFiles, chrShadersPath, "vsh", true);
 
-    for(int i=0; i<(int)vFiles.size(); i++) {
-        AnsiStr strVShaderFP = vFiles[i];
-        AnsiStr strFShaderFP = ChangeFileExt(strVShaderFP, AnsiStr(".fsh"));
-        AnsiStr strGShaderFP = ChangeFileExt(strVShaderFP, AnsiStr(".gsh"));
-        AnsiStr strTitle = ExtractFileTitleOnly(strVShaderFP);
+    //the shader files are read in parallel, the programs are compiled on the thread owning the context
+    vector<SHADERFILES> vShaders(vFiles.size());
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, vFiles.size(), 1),
+        [&vFiles, &vShaders](const tbb::blocked_range<size_t>& r) {
+        for(size_t i = r.begin(); i != r.end(); i++) {
+            SHADERFILES& s = vShaders[i];
+            s.arrPaths[GLShader::stVertex] = vFiles[i];
+            s.arrPaths[GLShader::stFragment] = ChangeFileExt(vFiles[i], AnsiStr(".fsh"));
+            s.arrPaths[GLShader::stGeometry] = ChangeFileExt(vFiles[i], AnsiStr(".gsh"));
+
+            s.isRead = GLShader::readShaderCode(s.arrPaths[GLShader::stVertex], s.arrCode[GLShader::stVertex]) &&
+                       GLShader::readShaderCode(s.arrPaths[GLShader::stFragment], s.arrCode[GLShader::stFragment]);
+            s.hasGeometry = FileExists(s.arrPaths[GLShader::stGeometry]) &&
+                            GLShader::readShaderCode(s.arrPaths[GLShader::stGeometry], s.arrCode[GLShader::stGeometry]) &&
+                            s.arrCode[GLShader::stGeometry].length() > 0;
+        }
+    });
 
-        if(FileExists(strGShaderFP)) {
-            if(addFromFile(strTitle.cptr(), strVShaderFP, strFShaderFP, strGShaderFP)) {
-                count++;
-            }
+    int count = 0;
+    for(int i=0; i<(int)vShaders.size(); i++) {
+        const SHADERFILES& s = vShaders[i];
+        AnsiStr strTitle = ExtractFileTitleOnly(s.arrPaths[GLShader::stVertex]);
+        if(!s.isRead) {
+            vlogerror("Unable to read the shader files. Name: %s", strTitle.cptr());
+            continue;
+        }
+
+        GLShader* aShader = new GLShader();
+        aShader->setFilePaths(s.arrPaths[GLShader::stVertex], s.arrPaths[GLShader::stFragment], s.arrPaths[GLShader::stGeometry]);
+        aShader->compileCode(s.arrCode[GLShader::stVertex].cptr(), s.arrCode[GLShader::stFragment].cptr(),
+                             s.hasGeometry ? s.arrCode[GLShader::stGeometry].cptr() : NULL);
+
+        const char* chrType = s.hasGeometry ? "Vertex-Geometry-Fragment" : "Vertex-Fragment";
+        if(aShader->isCompiled() && ShaderManagerParent::add(aShader, strTitle.cptr())) {
+            AnsiStr strArg = TheEventLogger::Instance().shortenPathBasedOnRoot(s.arrPaths[GLShader::stVertex]);
+            vloginfo("Added %s Shader from file: %s, Name: %s.", chrType, strArg.cptr(), strTitle.cptr());
+            count++;
         }
         else {
-            if(addFromFile(strTitle.cptr(), strVShaderFP, strFShaderFP)) {
-                count++;
-            }
+            SAFE_DELETE(aShader);
+            vlogerror("Unable to add %s Shader from file. Name: %s", chrType, strTitle.cptr());
         }
     }
 
     return count;
 }
-
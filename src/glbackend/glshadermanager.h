@@ -50,6 +50,11 @@ public:
                      const AnsiStr& strFShaderFP,
                      const AnsiStr& strGShaderFP);
 
+    /*!
+     * adds all vsh/fsh(/gsh) programs in a folder. The files are read in parallel and compiled
+     * on the calling thread which must own the gl context.
+     * @return number of programs added
+     */
     int addFromFolder(const char* chrShadersPath);
 };
 
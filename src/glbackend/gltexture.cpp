@@ -77,13 +77,37 @@ GLTexture* GLTexture::CheckerBoard()
 
 
 bool GLTexture::read(const AnsiStr& strFP) {
+    vector<U8> pixels;
+    vec3i dim;
+    if(!DecodeFile(strFP, pixels, dim))
+        return false;
+
+    return upload(pixels, dim);
+}
+
+bool GLTexture::DecodeFile(const AnsiStr& strFP, vector<U8>& pixels, vec3i& dim) {
     if(!FileExists(strFP))
         return false;
     ImageFileType ft = GetFileType(strFP);
     if(ft != iftPNG)
         return false;
 
-    //Cleanup before reading the image file
+    U32 w, h;
+    U32 error = lodepng::decode(pixels, w, h, strFP.cptr());
+    if(error) {
+        vlogerror("Unable to load png image from file: %s", strFP.cptr());
+        return false;
+    }
+
+    dim = vec3i(w, h, 4);
+    return true;
+}
+
+bool GLTexture::upload(const vector<U8>& pixels, const vec3i& dim) {
+    if(pixels.size() < (size_t)dim.x * dim.y * 4)
+        return false;
+
+    //Cleanup before creating the texture
     this->cleanup();
 
     //Generate Texture
@@ -92,14 +116,8 @@ bool GLTexture::read(const AnsiStr& strFP) {
     glGenTextures(1, &m_glTex);
     glBindTexture(GL_TEXTURE_2D, m_glTex);
 
-    //Load image data
-    switch (ft) {
-    case iftPNG:
-        read_png(strFP);
-        break;
-    default:
-        break;
-    }
+    m_dim = dim;
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_dim.x, m_dim.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
 
     //Params
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -111,21 +129,6 @@ bool GLTexture::read(const AnsiStr& strFP) {
     return true;
 }
 
-bool GLTexture::read_png(const AnsiStr& strFP) {
-
-    vector<U8> data;
-    U32 w, h;
-    U32 error = lodepng::decode(data, w, h, strFP.cptr());
-    if(error) {
-        vlogerror("Unable to load png image from file: %s", strFP.cptr());
-        return false;
-    }
-
-    m_dim = vec3i(w, h, 4);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_dim.x, m_dim.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, &data[0]);
-    return true;
-}
-
 bool GLTexture::write(const AnsiStr& strFP) {
     return false;
 }
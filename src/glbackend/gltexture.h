@@ -1,6 +1,7 @@
 #ifndef GLTEXTURE_H
 #define GLTEXTURE_H
 
+#include <vector>
 #include "base/vec.h"
 #include "base/str.h"
 #include "glbindable.h"
@@ -25,6 +26,9 @@ namespace ps {
             bool read(const AnsiStr& strFP);
             bool write(const AnsiStr& strFP);
             void set(const vec3i& dim, U32 handle, int texunit = 0);
+
+            //creates the texture from RGBA8 pixels. Must be called on the thread owning the gl context
+            bool upload(const std::vector<U8>& pixels, const vec3i& dim);
             
             //Binding
             void bind();
@@ -40,8 +44,9 @@ namespace ps {
             //Statics
             static ImageFileType GetFileType(const AnsiStr& strFP);
             static GLTexture* CheckerBoard();
-        private:
-            bool read_png(const AnsiStr& strFP);
+
+            //decodes an image file to RGBA8 pixels. Does not touch the gl context
+            static bool DecodeFile(const AnsiStr& strFP, std::vector<U8>& pixels, vec3i& dim);
             
         protected:
             int m_texunit;
@@ -1,5 +1,8 @@
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
 #include "gltexturemanager.h"
 #include "base/directory.h"
+#include "base/logger.h"
 
 using namespace ps::opengl;
 
@@ -20,3 +23,29 @@ bool TexManager::add(const AnsiStr &strFP) {
     SAFE_DELETE(tex);
     return false;
 }
+
+int TexManager::add(const vector<AnsiStr>& vFilePaths) {
+    vector< vector<U8> > vPixels(vFilePaths.size());
+    vector<vec3i> vDims(vFilePaths.size());
+    vector<U8> vDecoded(vFilePaths.size(), 0);
+    tbb::parallel_for(tbb::blocked_range<size_t>(0, vFilePaths.size(), 1),
+        [&](const tbb::blocked_range<size_t>& r) {
+        for(size_t i = r.begin(); i != r.end(); i++)
+            vDecoded[i] = GLTexture::DecodeFile(vFilePaths[i], vPixels[i], vDims[i]);
+    });
+
+    //failed textures are still added under their names the same way as a single add
+    int count = 0;
+    for(U32 i=0; i < vFilePaths.size(); i++) {
+        GLTexture* tex = new GLTexture();
+        if(vDecoded[i] && tex->upload(vPixels[i], vDims[i]))
+            count++;
+        else
+            vlogerror("Texture creation failed for file: %s", vFilePaths[i].cptr());
+        vector<U8>().swap(vPixels[i]);
+
+        TexManagerParent::add(tex, ps::dir::ExtractFileTitleOnly(vFilePaths[i]).cptr());
+    }
+
+    return count;
+}
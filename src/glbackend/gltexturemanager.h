@@ -17,6 +17,13 @@ namespace ps {
         TexManager();
         virtual ~TexManager();
         bool add(const AnsiStr& strFP);
+
+        /*!
+         * adds several textures. The images are decoded in parallel and uploaded on the calling
+         * thread which must own the gl context.
+         * @return number of textures created
+         */
+        int add(const std::vector<AnsiStr>& vFilePaths);
     };
     
     typedef SingletonHolder<TexManager, CreateUsingNew, PhoenixSingleton> TheTexManager;
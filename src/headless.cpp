@@ -0,0 +1,614 @@
+/*!
+ * \brief tetcutter_headless - loads a tetrahedral mesh, replays a cut script and writes the result
+ * without a window or GL context. Prints the timing of every stage.
+ *
+ * Cut script, one command per line, # starts a comment:
+ *   scalpel                  starts a scalpel trajectory
+ *   ring                     starts a ring trajectory
+ *   pose x y z x y z ...     one frame of the tool inside the tissue: blade edge end points for
+ *                            the scalpel, ring segment points for the ring
+ *   end                      the tool leaves the tissue, the trajectory is cut
+ *   plane px py pz nx ny nz  implicit plane cut through point p with normal n
+ *   sphere cx cy cz r        implicit sphere cut
+ *
+ * With --disjoint the parts of every cut mesh become separate meshes. The following cuts are sent
+ * to the overlapping meshes only and the meshes are cut concurrently.
+ *
+ * With --journal the operations on the mesh are recorded in a cut journal. --replay rebuilds the
+ * mesh of a journal and uses it as the input, so a crashed session is recovered and continued.
+ *
+ * \author Pourya Shirazian
+ */
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <tbb/task_scheduler_init.h>
+#include <tbb/tick_count.h>
+
+#include "base/directory.h"
+#include "base/logger.h"
+#include "base/cmdlineparser.h"
+
+#include "elastic/cuttablemesh.h"
+#include "elastic/cuttablemeshset.h"
+#include "elastic/cutjournal.h"
+#include "elastic/sdfcutsurface.h"
+#include "elastic/volmeshsamples.h"
+#include "elastic/volmeshio.h"
+#include "elastic/volmeshstats.h"
+
+using namespace ps;
+using namespace ps::utils;
+using namespace ps::dir;
+using namespace ps::elastic;
+
+using namespace std;
+
+//timing of one stage
+struct STAGE {
+	string name;
+	double ms;
+	int result;
+	int growth;
+};
+
+//tool trajectory being replayed
+struct TRAJECTORY {
+	enum ToolType {ttNone, ttScalpel, ttRing};
+
+	ToolType tool;
+	U32 ctPoses;
+	U32 line;
+	double ms;
+	vector<vec3d> vSegments;
+	vector<vec3d> vSweptQuads;
+	vector<vec3d> vFrameQuad;
+
+	TRAJECTORY() { reset(ttNone, 0);}
+
+	void reset(ToolType t, U32 l) {
+		tool = t;
+		ctPoses = 0;
+		line = l;
+		ms = 0.0;
+		vSegments.resize(0);
+		vSweptQuads.resize(0);
+		vFrameQuad.resize(0);
+	}
+};
+
+//global vars
+CmdLineParser g_parser;
+vector<STAGE> g_vStages;
+CuttableMesh* g_lpTissue = NULL;
+CuttableMeshSet g_tissueSet;
+CutJournal g_journal;
+
+//funcs
+double elapsedMS(const tbb::tick_count& t0);
+void addStage(const string& name, double ms, int result, int growth = 0);
+VolMesh* loadMesh(const AnsiStr& strInput);
+void configureMesh(CuttableMesh* pmesh);
+int cutTissue(const vector<vec3d>& segments, const vector<vec3d>& quadstrips, int& growth);
+int cutTissue(const SDFCutSurface& sdf, int& growth);
+void splitTissue();
+int replayPose(TRAJECTORY& traj, const vector<vec3d>& vPoints);
+int replayEnd(TRAJECTORY& traj);
+int replayScript(const AnsiStr& strScript);
+void coarsenMesh(U32 line);
+bool writeMesh(const AnsiStr& strOutput);
+void benchmarkLoad(const VolMesh* pmesh, const AnsiStr& strPrefix, int ctRuns);
+void printStages();
+
+double elapsedMS(const tbb::tick_count& t0) {
+	return (tbb::tick_count::now() - t0).seconds() * 1000.0;
+}
+
+void addStage(const string& name, double ms, int result, int growth) {
+	STAGE s;
+	s.name = name;
+	s.ms = ms;
+	s.result = result;
+	s.growth = growth;
+	g_vStages.push_back(s);
+}
+
+VolMesh* loadMesh(const AnsiStr& strInput) {
+	int pos = -1;
+	VolMesh* temp = NULL;
+
+	if(FileExists(strInput)) {
+		temp = new VolMesh();
+		temp->setFlagFilterOutFlatCells(false);
+		temp->setVerbose(g_parser.value_to_int("verbose") != 0);
+		temp->setWeldDistance(g_parser.value_to_double("weld"));
+		temp->setFlagOrientCells(g_parser.value("orient") == "true");
+
+		//segmented volumes are meshed with the selected label
+		AnsiStr strExt = ExtractFileExt(strInput);
+		strExt.toLower();
+		if(strExt == AnsiStr("nrrd") || strExt == AnsiStr("nhdr")) {
+			VOXELMASK mask;
+			vector<double> vertices;
+			vector<U32> elements;
+			vloginfo("Begin to mesh voxel mask from: %s", strInput.cptr());
+			if(!VolMeshIO::readVoxelMask(mask, strInput, g_parser.value_to_int("label")) ||
+			   !VolMeshSamples::TetrahedralizeVoxelMask(mask, g_parser.value_to_int("voxeltets"), vertices, elements) ||
+			   !temp->setup(vertices, elements)) {
+				vlogerror("Unable to mesh voxel mask from: %s", strInput.cptr());
+				SAFE_DELETE(temp);
+			}
+			else
+				temp->setName(ExtractFileTitleOnly(strInput).cptr());
+		}
+		else {
+			vloginfo("Begin to read mesh file from: %s", strInput.cptr());
+			if(!VolMeshIO::readMesh(temp, strInput)) {
+				vlogerror("Unable to load mesh from: %s", strInput.cptr());
+				SAFE_DELETE(temp);
+			}
+		}
+	}
+	else if(strInput == AnsiStr("one"))
+		temp = VolMeshSamples::CreateOneTetra();
+	else if(strInput == AnsiStr("two"))
+		temp = VolMeshSamples::CreateTwoTetra();
+	else if(strInput.lfindstr(AnsiStr("cube"), pos)) {
+		U32 nx = 0, ny = 0, nz = 0;
+		if(sscanf(strInput.cptr(), "cube_%u_%u_%u", &nx, &ny, &nz) == 3)
+			temp = VolMeshSamples::CreateTruthCube(nx, ny, nz, 0.2);
+	}
+	else if(strInput.lfindstr(AnsiStr("eggshell"), pos)) {
+		U32 nx = 0, ny = 0;
+		if(sscanf(strInput.cptr(), "eggshell_%u_%u", &nx, &ny) == 2)
+			temp = VolMeshSamples::CreateEggShell(nx, ny);
+	}
+
+	if(temp == NULL)
+		vlogerror("Input is neither a mesh file nor an internal model: [%s]", strInput.cptr());
+
+	return temp;
+}
+
+void configureMesh(CuttableMesh* pmesh) {
+	pmesh->setFlagSplitMeshAfterCut(g_parser.value_to_int("split") != 0);
+	pmesh->setVerbose(g_parser.value_to_int("verbose") != 0);
+	if(g_parser.value("mode") == "virtualnode")
+		pmesh->setCutMode(CuttableMesh::cmVirtualNode);
+	pmesh->setRefineEdgeLength(g_parser.value_to_double("refine"));
+	pmesh->setSliverQuality(g_parser.value_to_double("sliver"));
+	//a flat volume of zero turns the filter off
+	double flatVolume = g_parser.value_to_double("flatvolume");
+	pmesh->setFlagFilterOutFlatCells(flatVolume > 0.0);
+	if(flatVolume > 0.0)
+		pmesh->setFlatCellVolume(flatVolume);
+	if(g_parser.value_to_double("snap") > 0.0) {
+		pmesh->setFlagSnapCutNodes(true);
+		pmesh->setCutNodeROI(g_parser.value_to_double("snap"));
+	}
+}
+
+int cutTissue(const vector<vec3d>& segments, const vector<vec3d>& quadstrips, int& growth) {
+	if(g_tissueSet.count() == 0) {
+		int res = g_lpTissue->cut(segments, quadstrips, true);
+		growth = g_lpTissue->getLastCutCellGrowth();
+		return res;
+	}
+
+	int res = g_tissueSet.cut(segments, quadstrips, true);
+	growth = 0;
+	for(U32 i = 0; i < g_tissueSet.lastCutMeshes().size(); i++)
+		growth += g_tissueSet.meshAt(g_tissueSet.lastCutMeshes()[i])->getLastCutCellGrowth();
+	splitTissue();
+	return res;
+}
+
+int cutTissue(const SDFCutSurface& sdf, int& growth) {
+	if(g_tissueSet.count() == 0) {
+		int res = g_lpTissue->cut(sdf, true);
+		growth = g_lpTissue->getLastCutCellGrowth();
+		return res;
+	}
+
+	int res = g_tissueSet.cut(sdf, true);
+	growth = 0;
+	for(U32 i = 0; i < g_tissueSet.lastCutMeshes().size(); i++)
+		growth += g_tissueSet.meshAt(g_tissueSet.lastCutMeshes()[i])->getLastCutCellGrowth();
+	splitTissue();
+	return res;
+}
+
+void splitTissue() {
+
+	//the parts of the cut meshes become separate meshes
+	vector<CuttableMesh*> vCutMeshes;
+	for(U32 i = 0; i < g_tissueSet.lastCutMeshes().size(); i++)
+		vCutMeshes.push_back(g_tissueSet.meshAt(g_tissueSet.lastCutMeshes()[i]));
+
+	for(U32 i = 0; i < vCutMeshes.size(); i++) {
+		//tiny pieces may lose all their cells to the flat cell filter
+		if(vCutMeshes[i]->countCells() == 0 && g_tissueSet.count() > 1) {
+			g_tissueSet.remove(vCutMeshes[i]);
+			SAFE_DELETE(vCutMeshes[i]);
+			continue;
+		}
+
+		vector<CuttableMesh*> vMeshes;
+		vCutMeshes[i]->convertDisjointPartsToMeshes(vMeshes);
+		if(vMeshes.size() == 0)
+			continue;
+
+		g_tissueSet.remove(vCutMeshes[i]);
+		for(U32 j = 0; j < vMeshes.size(); j++) {
+			configureMesh(vMeshes[j]);
+			g_tissueSet.add(vMeshes[j]);
+		}
+		SAFE_DELETE(vCutMeshes[i]);
+	}
+
+	//progressive and speculative cuts go to the largest mesh
+	g_lpTissue = g_tissueSet.meshAt(0);
+	for(U32 i = 1; i < g_tissueSet.count(); i++) {
+		if(g_tissueSet.meshAt(i)->countCells() > g_lpTissue->countCells())
+			g_lpTissue = g_tissueSet.meshAt(i);
+	}
+}
+
+int replayPose(TRAJECTORY& traj, const vector<vec3d>& vPoints) {
+	if(traj.tool == TRAJECTORY::ttScalpel && vPoints.size() != 2) {
+		vlogerror("Scalpel pose needs the two blade edge end points. line %u", traj.line);
+		return CUT_ERR_INVALID_INPUT_ARG;
+	}
+
+	if(traj.tool == TRAJECTORY::ttRing) {
+		if(vPoints.size() < 2 || (traj.ctPoses > 0 && vPoints.size() != traj.vSegments.size())) {
+			vlogerror("Ring poses need the same number of segment points. line %u", traj.line);
+			return CUT_ERR_INVALID_INPUT_ARG;
+		}
+	}
+
+	tbb::tick_count t0 = tbb::tick_count::now();
+
+	//the swept surface spans the first pose to the current one, same as the avatars
+	if(traj.ctPoses == 0)
+		traj.vSweptQuads.resize(vPoints.size() * 2);
+
+	int res = 0;
+	for(U32 i = 0; i < vPoints.size(); i++)
+		traj.vSweptQuads[i * 2 + (traj.ctPoses == 0 ? 0 : 1)] = vPoints[i];
+
+	if(traj.ctPoses > 0) {
+		if(traj.tool == TRAJECTORY::ttScalpel && g_parser.value("progressive") == "true") {
+			traj.vFrameQuad.resize(4);
+			traj.vFrameQuad[0] = traj.vSegments[0];
+			traj.vFrameQuad[1] = vPoints[0];
+			traj.vFrameQuad[2] = traj.vSegments[1];
+			traj.vFrameQuad[3] = vPoints[1];
+			res = g_lpTissue->cutProgressive(vPoints, traj.vFrameQuad);
+		}
+		else if(g_parser.value("speculative") == "true")
+			g_lpTissue->speculateCut(vPoints, traj.vSweptQuads);
+	}
+
+	traj.vSegments = vPoints;
+	traj.ctPoses++;
+	traj.ms += elapsedMS(t0);
+
+	return res;
+}
+
+int replayEnd(TRAJECTORY& traj) {
+	if(traj.ctPoses < 2) {
+		vlogwarn("Trajectory started at line %u has less than two poses. No cut.", traj.line);
+		traj.reset(TRAJECTORY::ttNone, 0);
+		return 0;
+	}
+
+	tbb::tick_count t0 = tbb::tick_count::now();
+	int res = 0;
+	int growth = 0;
+	if(traj.tool == TRAJECTORY::ttScalpel && g_parser.value("progressive") == "true") {
+		res = g_lpTissue->endProgressiveCut(traj.vSweptQuads);
+		growth = g_lpTissue->getLastCutCellGrowth();
+	}
+	else
+		res = cutTissue(traj.vSegments, traj.vSweptQuads, growth);
+	traj.ms += elapsedMS(t0);
+
+	string name = printToAStr("%s line %u, %u poses", traj.tool == TRAJECTORY::ttScalpel ? "scalpel" : "ring",
+							  traj.line, traj.ctPoses).cptr();
+	addStage(name, traj.ms, res, growth);
+	vloginfo("Tissue cut. res = %d", res);
+	coarsenMesh(traj.line);
+
+	traj.reset(TRAJECTORY::ttNone, 0);
+	return res;
+}
+
+int replayScript(const AnsiStr& strScript) {
+	ifstream fpIn(strScript.cptr());
+	if(!fpIn.is_open()) {
+		vlogerror("Unable to open cut script: [%s]", strScript.cptr());
+		return -1;
+	}
+
+	TRAJECTORY traj;
+	string strLine;
+	U32 ctLine = 0;
+	U32 ctCuts = 0;
+
+	while(std::getline(fpIn, strLine)) {
+		ctLine++;
+
+		//strip comments
+		size_t posComment = strLine.find('#');
+		if(posComment != string::npos)
+			strLine = strLine.substr(0, posComment);
+
+		istringstream ss(strLine);
+		string cmd;
+		if(!(ss >> cmd))
+			continue;
+
+		vector<double> args;
+		double v;
+		while(ss >> v)
+			args.push_back(v);
+
+		if(cmd == "scalpel" || cmd == "ring") {
+			if(traj.tool != TRAJECTORY::ttNone && replayEnd(traj) > 0)
+				ctCuts++;
+			traj.reset(cmd == "scalpel" ? TRAJECTORY::ttScalpel : TRAJECTORY::ttRing, ctLine);
+		}
+		else if(cmd == "pose") {
+			if(traj.tool == TRAJECTORY::ttNone || args.size() == 0 || args.size() % 3 != 0) {
+				vlogerror("Invalid pose at line %u", ctLine);
+				return -1;
+			}
+
+			vector<vec3d> vPoints(args.size() / 3);
+			for(U32 i = 0; i < vPoints.size(); i++)
+				vPoints[i] = vec3d(args[i * 3], args[i * 3 + 1], args[i * 3 + 2]);
+
+			if(replayPose(traj, vPoints) < 0)
+				return -1;
+		}
+		else if(cmd == "end") {
+			if(traj.tool == TRAJECTORY::ttNone) {
+				vlogerror("end without a trajectory at line %u", ctLine);
+				return -1;
+			}
+
+			if(replayEnd(traj) > 0)
+				ctCuts++;
+		}
+		else if(cmd == "plane" || cmd == "sphere") {
+			if((cmd == "plane" && args.size() != 6) || (cmd == "sphere" && args.size() != 4)) {
+				vlogerror("Invalid %s at line %u", cmd.c_str(), ctLine);
+				return -1;
+			}
+
+			tbb::tick_count t0 = tbb::tick_count::now();
+			int res = 0;
+			int growth = 0;
+			if(cmd == "plane")
+				res = cutTissue(SDFPlane(vec3d(args[0], args[1], args[2]), vec3d(args[3], args[4], args[5])), growth);
+			else
+				res = cutTissue(SDFSphere(vec3d(args[0], args[1], args[2]), args[3]), growth);
+			addStage(printToAStr("%s line %u", cmd.c_str(), ctLine).cptr(), elapsedMS(t0), res, growth);
+			coarsenMesh(ctLine);
+
+			if(res > 0)
+				ctCuts++;
+		}
+		else {
+			vlogerror("Unknown command [%s] at line %u", cmd.c_str(), ctLine);
+			return -1;
+		}
+	}
+
+	//tool still inside the tissue at the end of the script
+	if(traj.tool != TRAJECTORY::ttNone && replayEnd(traj) > 0)
+		ctCuts++;
+
+	return (int)ctCuts;
+}
+
+void coarsenMesh(U32 line) {
+	double len = g_parser.value_to_double("coarsen");
+	if(len <= 0.0)
+		return;
+
+	tbb::tick_count t0 = tbb::tick_count::now();
+	U32 ctCells = g_lpTissue->countCells();
+	int res = g_lpTissue->coarsen(len, len, g_lpTissue->countEdges());
+	addStage(printToAStr("coarsen after line %u", line).cptr(), elapsedMS(t0), res,
+			 (int)g_lpTissue->countCells() - (int)ctCells);
+}
+
+bool writeMesh(const AnsiStr& strOutput) {
+	AnsiStr strExt = ExtractFileExt(strOutput);
+	strExt.toLower();
+
+	if(strExt == AnsiStr("obj"))
+		return VolMeshIO::writeObj(g_lpTissue, strOutput);
+	else if(strExt == AnsiStr("vmb"))
+		return VolMeshIO::writeBinary(g_lpTissue, strOutput);
+	return VolMeshIO::writeVega(g_lpTissue, strOutput);
+}
+
+//writes the mesh in vega and binary formats and times loading each of them
+void benchmarkLoad(const VolMesh* pmesh, const AnsiStr& strPrefix, int ctRuns) {
+	AnsiStr arrPaths[2] = { strPrefix + AnsiStr(".veg"), strPrefix + AnsiStr(".vmb") };
+	if(!VolMeshIO::writeVega(pmesh, arrPaths[0]) || !VolMeshIO::writeBinary(pmesh, arrPaths[1])) {
+		vlogerror("Unable to write the benchmark meshes at: %s", strPrefix.cptr());
+		return;
+	}
+
+	for(int i = 0; i < 2; i++) {
+		double best = 0.0;
+		int ctCells = 0;
+		for(int j = 0; j < ctRuns; j++) {
+			VolMesh temp;
+			temp.setFlagFilterOutFlatCells(false);
+			tbb::tick_count t0 = tbb::tick_count::now();
+			bool loaded = VolMeshIO::readMesh(&temp, arrPaths[i]);
+			double ms = elapsedMS(t0);
+			if(j == 0 || ms < best)
+				best = ms;
+			ctCells = loaded ? (int)temp.countCells() : -1;
+		}
+
+		AnsiStr strExt = ExtractFileExt(arrPaths[i]);
+		addStage(printToAStr("benchmark load %s, best of %d", strExt.cptr(), ctRuns).cptr(), best, ctCells);
+	}
+}
+
+void printStages() {
+	double total = 0.0;
+	printf("%-40s %12s %10s %10s\n", "stage", "time [ms]", "result", "growth");
+	for(U32 i = 0; i < g_vStages.size(); i++) {
+		printf("%-40s %12.2f %10d %10d\n", g_vStages[i].name.c_str(), g_vStages[i].ms, g_vStages[i].result,
+			   g_vStages[i].growth);
+		total += g_vStages[i].ms;
+	}
+	printf("%-40s %12.2f\n", "total", total);
+}
+
+int main(int argc, char* argv[]) {
+	int ctThreads = tbb::task_scheduler_init::default_num_threads();
+	tbb::task_scheduler_init init(ctThreads);
+	cout << "started tbb with " << ctThreads << " threads." << endl;
+
+	//parser
+	g_parser.addSwitch("--input", "-i", "[filepath or one, two, cube_nx_ny_nz, eggshell_h_v] vega, vmb, tetgen, gmsh, vtk or nrrd voxel mask file or internal model", "cube_8_8_8");
+	g_parser.addSwitch("--label", "-t", "[label] voxels of a nrrd input with this label are meshed, all nonzero voxels when negative", "-1");
+	g_parser.addSwitch("--voxeltets", "-x", "[5 or 6] tetrahedra per voxel of a nrrd input", "6");
+	g_parser.addSwitch("--script", "-c", "[filepath] cut script to replay");
+	g_parser.addSwitch("--output", "-o", "[filepath] writes the cut mesh in vega format, binary when the extension is vmb or obj when it is obj");
+	g_parser.addSwitch("--journal", "-j", "[filepath] records the operations on the mesh in a cut journal with checkpoints next to it");
+	g_parser.addSwitch("--checkpoint", "-e", "[records] number of journal records between two checkpoints", "32");
+	g_parser.addSwitch("--replay", "-l", "[filepath] rebuilds the mesh of a cut journal and uses it as the input");
+	g_parser.addSwitch("--benchload", "-b", "[filepath without extension] writes the loaded mesh as veg and vmb there and times loading both");
+	g_parser.addSwitch("--split", "-z", "splits the mesh parts after every cut", "1");
+	g_parser.addSwitch("--disjoint", "-d", "converts the parts of every cut mesh to separate meshes and cuts the overlapping ones concurrently", "0");
+	g_parser.addSwitch("--progressive", "-p", "If the switch presents then the scalpel trajectories are cut progressively per pose", "", true);
+	g_parser.addSwitch("--speculative", "-s", "If the switch presents then the cut context is computed in the background per pose", "", true);
+	g_parser.addSwitch("--mode", "-m", "[subdivide, virtualnode] subdivides the cut elements or duplicates them using virtual nodes", "subdivide");
+	g_parser.addSwitch("--snap", "-n", "[0 to 0.45] snaps mesh nodes within this fraction of a cut edge onto the cut surface. 0 disables snapping", "0");
+	g_parser.addSwitch("--refine", "-f", "[length] refines the cells along the tool path to this edge length before every cut. 0 disables refinement", "0");
+	g_parser.addSwitch("--coarsen", "-k", "[length] collapses the edges shorter than this away from the recent cuts after every cut. 0 disables coarsening", "0");
+	g_parser.addSwitch("--sliver", "-q", "[0 to 1] repairs or removes the cells below this quality after every cut. 0 disables the cleanup", "0");
+	g_parser.addSwitch("--weld", "-w", "[distance] merges the nodes of an input file within this distance before its topology is built. 0 disables welding", "0");
+	g_parser.addSwitch("--orient", "-u", "If the switch presents then the cells of an input file with a negative determinant are reoriented before its topology is built", "", true);
+	g_parser.addSwitch("--flatvolume", "-a", "[volume] cells below this volume are flat and filtered out, 0 turns the filter off", "0.0001");
+	g_parser.addSwitch("--verbose", "-v", "prints detailed description.");
+
+	if(g_parser.parse(argc, argv) < 0 || g_parser.value("help") == "true")
+		exit(0);
+
+	tbb::tick_count t0 = tbb::tick_count::now();
+	int ctRestoredCuts = 0;
+	int restoredGrowth = 0;
+	if(g_parser.isValid("replay")) {
+		//the journal has the settings of every recorded operation
+		JOURNALREPLAYSTATS stats;
+		AnsiStr strJournal = AnsiStr(g_parser.value("replay").c_str());
+		g_lpTissue = CutJournal::Replay(strJournal, &stats);
+		if(g_lpTissue == NULL)
+			exit(1);
+		addStage(printToAStr("replay %u records, %u mismatches", stats.ctApplied, stats.ctMismatches).cptr(),
+				 elapsedMS(t0), (int)g_lpTissue->countCells());
+
+		//the report continues from the cut state of the journal
+		ctRestoredCuts = g_lpTissue->countCompletedCuts();
+		restoredGrowth = g_lpTissue->getTotalCutCellGrowth();
+	}
+	else {
+		//load
+		AnsiStr strInput = AnsiStr(g_parser.value("input").c_str());
+		VolMesh* temp = loadMesh(strInput);
+		if(temp == NULL)
+			exit(1);
+		addStage("load", elapsedMS(t0), (int)temp->countCells());
+
+		if(g_parser.isValid("benchload"))
+			benchmarkLoad(temp, AnsiStr(g_parser.value("benchload").c_str()), 5);
+
+		t0 = tbb::tick_count::now();
+		g_lpTissue = new CuttableMesh(*temp);
+		SAFE_DELETE(temp);
+		addStage("setup", elapsedMS(t0), (int)g_lpTissue->countCells());
+	}
+
+	configureMesh(g_lpTissue);
+	if(g_parser.value_to_int("disjoint") != 0)
+		g_tissueSet.add(g_lpTissue);
+
+	//a journal follows a single mesh
+	if(g_parser.isValid("journal")) {
+		if(g_parser.value_to_int("disjoint") != 0)
+			vlogwarn("The cut journal records a single mesh. It is not used with disjoint meshes.");
+		else {
+			t0 = tbb::tick_count::now();
+			AnsiStr strJournal = AnsiStr(g_parser.value("journal").c_str());
+			if(!g_journal.create(strJournal, g_lpTissue, (U32)g_parser.value_to_int("checkpoint")))
+				exit(1);
+			g_lpTissue->setJournal(&g_journal);
+			addStage("journal", elapsedMS(t0), 1);
+		}
+	}
+
+	//replay
+	int res = 0;
+	if(g_parser.isValid("script"))
+		res = replayScript(AnsiStr(g_parser.value("script").c_str()));
+
+	//write
+	if(res >= 0 && g_parser.isValid("output")) {
+		AnsiStr strOutput = AnsiStr(g_parser.value("output").c_str());
+		t0 = tbb::tick_count::now();
+		bool written = writeMesh(strOutput);
+		addStage("write", elapsedMS(t0), written ? 1 : 0);
+
+		if(written)
+			vloginfo("Stored the mesh at: %s", strOutput.cptr());
+		else {
+			vlogerror("Unable to store the mesh at: %s", strOutput.cptr());
+			res = -1;
+		}
+	}
+
+	VolMeshStats::printAllStats(g_lpTissue);
+
+	//totals over all meshes
+	U32 ctCells = 0, ctNodes = 0, ctParts = 0;
+	int ctCuts = (res < 0) ? res : ctRestoredCuts + res;
+	int growth = restoredGrowth;
+	for(U32 i = 0; i < g_vStages.size(); i++)
+		growth += g_vStages[i].growth;
+
+	vector<CuttableMesh*> vMeshes(1, g_lpTissue);
+	if(g_tissueSet.count() > 0) {
+		vMeshes.resize(g_tissueSet.count());
+		for(U32 i = 0; i < g_tissueSet.count(); i++)
+			vMeshes[i] = g_tissueSet.meshAt(i);
+	}
+
+	for(U32 i = 0; i < vMeshes.size(); i++) {
+		vector< vector<U32> > vParts;
+		ctCells += vMeshes[i]->countCells();
+		ctNodes += vMeshes[i]->countNodes();
+		ctParts += (U32)vMeshes[i]->get_disjoint_parts(vParts);
+	}
+	printf("cuts %d, meshes %u, cells %u, nodes %u, parts %u, cell growth %d\n", ctCuts, (U32)vMeshes.size(),
+		   ctCells, ctNodes, ctParts, growth);
+	printStages();
+
+	g_journal.close();
+	for(U32 i = 0; i < vMeshes.size(); i++)
+		SAFE_DELETE(vMeshes[i]);
+	g_tissueSet.clear();
+
+	return res < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
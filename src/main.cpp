@@ -5,6 +5,9 @@
 #include <iostream>
 #include <functional>
 #include <tbb/task_scheduler_init.h>
+#include <tbb/task_group.h>
+#include <tbb/atomic.h>
+#include <tbb/tick_count.h>
 
 #include "base/directory.h"
 #include "base/logger.h"
@@ -19,8 +22,11 @@
 #include "glbackend/glselect.h"
 #include "glbackend/glscreen.h"
 
-#include "elastic/avatarscalpel.h"
-#include "elastic/avatarring.h"
+#include "elasticrender/avatarscalpel.h"
+#include "elasticrender/avatarring.h"
+#include "elasticrender/cuttablemeshnode.h"
+#include "elastic/cuttablemeshset.h"
+#include "elastic/cutjournal.h"
 #include "elastic/tetsubdivider.h"
 #include "elastic/volmeshsamples.h"
 #include "elastic/volmeshio.h"
@@ -40,6 +46,12 @@ using namespace ps::elastic;
 
 using namespace std;
 
+//edge collapses per frame while coarsening the tissue
+#define COARSEN_COLLAPSES_PER_FRAME 32
+
+//phases of the tissue loader, shown in the headers while the frames go on
+enum TissueLoadPhase {tlpIdle, tlpReading, tlpBuilding, tlpReady};
+
 
 //global vars
 GLFWwindow* g_lpWindow = NULL;
@@ -48,14 +60,30 @@ AvatarRing* g_lpRing = NULL;
 IAvatar* g_lpAvatar = NULL;
 
 CuttableMesh* g_lpTissue = NULL;
+CuttableMeshNode* g_lpTissueNode = NULL;
+CuttableMeshSet g_tissueSet;
+CutJournal g_journal;
+VolMeshAsyncExporter g_exporter;
 CmdLineParser g_parser;
 AnsiStr g_strIniFilePath;
 U32 g_current = 3;
 U32 g_cutCase = 0;
 
+//the tissue is read and built on a worker and swapped in by the frame loop
+tbb::task_group g_tissueLoader;
+tbb::atomic<int> g_tissueLoadPhase;
+tbb::tick_count g_tissueLoadStart;
+CuttableMesh* g_lpLoadedTissue = NULL;
+
 //funcs
 void closeApp();
 bool resetMesh();
+void resetMeshAsync();
+void updateTissueLoader();
+void waitTissueLoader();
+CuttableMesh* loadTissue();
+void configureTissue(CuttableMesh* pmesh);
+void setTissue(CuttableMesh* pmesh);
 void cutFinished();
 void runTestSubDivide(int current);
 void handleElementEvent(CELL element, U32 handle, VolMesh::TopologyEvent event);
@@ -109,12 +137,12 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
         int w, h;
         glfwGetFramebufferSize(window, &w, &h);
         Ray ray = TheEngine::Instance().screenToWorldRay(x, y);
-        int idxVertex = g_lpTissue->selectNode(ray);
+        int idxVertex = g_lpTissue ? g_lpTissue->selectNode(ray) : -1;
 
         //select vertex
         if (idxVertex >= 0) {
             vloginfo("Selected Vertex Index = %d ", idxVertex);
-            g_lpTissue->setNodeToShow(idxVertex);
+            g_lpTissueNode->setNodeToShow(idxVertex);
         }
     }
 }
@@ -209,6 +237,8 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
 
         case(GLFW_KEY_F7):
         {
+            if(!g_lpTissue)
+                break;
             g_lpTissue->setFlagSplitMeshAfterCut(!g_lpTissue->getFlagSplitMeshAfterCut());
             vloginfo("Tissue splitting is set to: %d", g_lpTissue->getFlagSplitMeshAfterCut());
             break;
@@ -230,7 +260,7 @@ static void key_callback(GLFWwindow* window, int key, int scancode, int action,
         }
 
         case(GLFW_KEY_F10): {
-            resetMesh();
+            resetMeshAsync();
             vloginfo("reset mesh");
 
             break;
@@ -262,6 +292,11 @@ void draw() {
 void timestep() {
     TheEngine::Instance().timestep();
 	TheGizmoManager::Instance().timestep();
+
+	//coarsen the tissue away from the recent cuts in small steps
+	double len = g_parser.value_to_double("coarsen");
+	if(g_lpTissue && len > 0.0)
+		g_lpTissue->coarsen(len, len, COARSEN_COLLAPSES_PER_FRAME);
 }
 
 void normal_key(unsigned char key, int x, int y)
@@ -272,18 +307,19 @@ void normal_key(unsigned char key, int x, int y)
 	{
 
 	case('/'): {
-		g_lpTissue->setFlagDrawSweepSurf(!g_lpTissue->getFlagDrawSweepSurf());
-        vloginfo("Draw sweep surf set to: %d", g_lpTissue->getFlagDrawSweepSurf());
+		if(!g_lpTissueNode) return;
+		g_lpTissueNode->setFlagDrawSweepSurf(!g_lpTissueNode->getFlagDrawSweepSurf());
+        vloginfo("Draw sweep surf set to: %d", g_lpTissueNode->getFlagDrawSweepSurf());
 	}
 	break;
 	case('a'): {
 		if(!g_lpTissue) return;
 
-		U32 i = g_lpTissue->getElemToShow();
+		U32 i = g_lpTissueNode->getElemToShow();
 		if(g_lpTissue->isCellIndex(i))
-			g_lpTissue->setElemToShow(--i);
+			g_lpTissueNode->setElemToShow(--i);
 		else
-			g_lpTissue->setElemToShow(0);
+			g_lpTissueNode->setElemToShow(0);
 
 		if(g_lpTissue->isCellIndex(i)) {
 			const CELL& cell = g_lpTissue->const_cellAt(i);
@@ -297,11 +333,11 @@ void normal_key(unsigned char key, int x, int y)
 	case('d'): {
 		if(!g_lpTissue) return;
 
-		U32 i = g_lpTissue->getElemToShow();
+		U32 i = g_lpTissueNode->getElemToShow();
 		if(g_lpTissue->isCellIndex(i))
-			g_lpTissue->setElemToShow(++i);
+			g_lpTissueNode->setElemToShow(++i);
 		else
-			g_lpTissue->setElemToShow(0);
+			g_lpTissueNode->setElemToShow(0);
 
 		if(g_lpTissue->isCellIndex(i)) {
 			const CELL& cell = g_lpTissue->const_cellAt(i);
@@ -320,9 +356,9 @@ void normal_key(unsigned char key, int x, int y)
 		printf("Insert element index to show: [0:%u]\n", ctElems-1);
 		scanf("%u", &idxElem);
 		if(g_lpTissue->isCellIndex(idxElem))
-			g_lpTissue->setElemToShow(idxElem);
+			g_lpTissueNode->setElemToShow(idxElem);
 		else
-			g_lpTissue->setElemToShow();
+			g_lpTissueNode->setElemToShow();
 	}
 	break;
 
@@ -365,9 +401,9 @@ void normal_key(unsigned char key, int x, int y)
 	}
 
 	case('.'):{
-		if(g_lpTissue)
-			g_lpTissue->setFlagDrawWireFrame(!g_lpTissue->getFlagDrawWireFrame());
-        vloginfo("Wireframe mode is %d", g_lpTissue->getFlagDrawWireFrame());
+		if(!g_lpTissueNode) return;
+		g_lpTissueNode->setFlagDrawWireFrame(!g_lpTissueNode->getFlagDrawWireFrame());
+        vloginfo("Wireframe mode is %d", g_lpTissueNode->getFlagDrawWireFrame());
 		break;
 	}
 
@@ -407,6 +443,7 @@ void normal_key(unsigned char key, int x, int y)
 	}
 	break;
 	case('w'):{
+		if(!g_lpTissue) return;
 		AnsiStr strRoot = ExtractOneLevelUp(ExtractFilePath(GetExePath()));
 		AnsiStr strOutput = strRoot + "data/output/";
 		AnsiStr strVegOutput = strOutput + printToAStr("%s_cuts%d.veg",
@@ -418,12 +455,12 @@ void normal_key(unsigned char key, int x, int y)
 									  g_lpTissue->countCompletedCuts());
 
         vloginfo("Attempt to store at %s. Make sure all the required directories are present!", strVegOutput.cptr());
-		if(VolMeshIO::writeVega(g_lpTissue, strVegOutput))
-            vloginfo("Stored the mesh at: %s", strVegOutput.cptr());
 
-        vloginfo("Attempt to store at %s. Make sure all the required directories are present!", strObjOutput.cptr());
-		if(VolMeshIO::writeObj(g_lpTissue, strObjOutput))
-            vloginfo("Stored the mesh at: %s", strObjOutput.cptr());
+		//formats and writes a snapshot in the background while cutting goes on
+		vector<AnsiStr> vPaths;
+		vPaths.push_back(strVegOutput);
+		vPaths.push_back(strObjOutput);
+		g_exporter.write(g_lpTissue, vPaths);
 	}
 	break;
 
@@ -437,11 +474,17 @@ void normal_key(unsigned char key, int x, int y)
 
 
 void closeApp() {
+	//finish the files still being written and the tissue still loading
+	g_exporter.wait();
+	waitTissueLoader();
+
     TheGizmoManager::Instance().writeConfig(g_strIniFilePath);
     TheEngine::Instance().writeConfig(g_strIniFilePath);
 
 	SAFE_DELETE(g_lpScalpel);
 	SAFE_DELETE(g_lpRing);
+	SAFE_DELETE(g_lpTissueNode);
+	g_journal.close();
 	SAFE_DELETE(g_lpTissue);
 }
 
@@ -454,13 +497,87 @@ void handleElementEvent(CELL element, U32 handle, VolMesh::TopologyEvent event)
 }
 
 bool resetMesh() {
-	//remove it from scenegraph
-    TheEngine::Instance().remove(g_lpTissue);
-	SAFE_DELETE(g_lpTissue);
+	//a tissue still loading in the background is dropped
+	waitTissueLoader();
 
+	CuttableMesh* pmesh = loadTissue();
+	g_tissueLoadPhase = tlpIdle;
+	if(pmesh == NULL)
+		return false;
+
+	setTissue(pmesh);
+	return true;
+}
+
+void resetMeshAsync() {
+	//one load at a time
+	waitTissueLoader();
+
+	//without worker threads the task would only run when waited for
+	if(tbb::task_scheduler_init::default_num_threads() < 2) {
+		resetMesh();
+		return;
+	}
+
+	g_tissueLoadStart = tbb::tick_count::now();
+	g_tissueLoadPhase = tlpReading;
+	g_tissueLoader.run([]() {
+		g_lpLoadedTissue = loadTissue();
+		g_tissueLoadPhase = tlpReady;
+	});
+}
+
+void updateTissueLoader() {
+	int phase = g_tissueLoadPhase;
+	if(phase == tlpIdle)
+		return;
+
+	double elapsed = (tbb::tick_count::now() - g_tissueLoadStart).seconds();
+	if(phase != tlpReady) {
+		char chrMsg[256];
+		sprintf(chrMsg, "%s the tissue... %.1f s", (phase == tlpReading) ? "reading" : "building", elapsed);
+		TheEngine::Instance().headers()->updateHeaderLine("tissue", AnsiStr(chrMsg));
+		return;
+	}
+
+	g_tissueLoader.wait();
+	CuttableMesh* pmesh = g_lpLoadedTissue;
+	g_lpLoadedTissue = NULL;
+	g_tissueLoadPhase = tlpIdle;
+	if(pmesh == NULL) {
+		TheEngine::Instance().headers()->updateHeaderLine("tissue", AnsiStr("unable to load the tissue"));
+		return;
+	}
+
+	setTissue(pmesh);
+
+	char chrMsg[256];
+	sprintf(chrMsg, "TISSUE CELLS# %u, NODES# %u, LOADED IN %.2f s", pmesh->countCells(), pmesh->countNodes(), elapsed);
+	TheEngine::Instance().headers()->updateHeaderLine("tissue", AnsiStr(chrMsg));
+}
+
+void waitTissueLoader() {
+	g_tissueLoader.wait();
+	SAFE_DELETE(g_lpLoadedTissue);
+	g_tissueLoadPhase = tlpIdle;
+}
+
+CuttableMesh* loadTissue() {
     if(!FileExists(g_strIniFilePath)) {
         vlogerror("ini file not exists! [%s]", g_strIniFilePath.c_str());
-        return false;
+        return NULL;
+    }
+
+    //the journal has the mesh and the cut settings of a recorded session
+    if(g_parser.isValid("replay")) {
+        CuttableMesh* pmesh = CutJournal::Replay(AnsiStr(g_parser.value("replay").c_str()));
+        if(pmesh == NULL)
+            return NULL;
+
+        g_tissueLoadPhase = tlpBuilding;
+        configureTissue(pmesh);
+        VolMeshStats::printAllStats(pmesh);
+        return pmesh;
     }
 
     vloginfo("reading model config from ini file: [%s]", g_strIniFilePath.c_str());
@@ -498,6 +615,8 @@ bool resetMesh() {
         temp = new VolMesh();
         temp->setFlagFilterOutFlatCells(false);
         temp->setVerbose(g_parser.value_to_int("verbose"));
+        temp->setWeldDistance(g_parser.value_to_double("weld"));
+        temp->setFlagOrientCells(g_parser.value("orient") == "true");
 
         if(!FileExists(mdl_name)) {
             AnsiStr data_root_path = ini.readString("system", "data");
@@ -505,33 +624,73 @@ bool resetMesh() {
             vloginfo("resolved model name to [%s]", mdl_name.cptr());
         }
 
-        vloginfo("Begin to read vega file from: %s", mdl_name.cptr());
-        bool res = VolMeshIO::readVega(temp, mdl_name);
+        vloginfo("Begin to read mesh file from: %s", mdl_name.cptr());
+        bool res = VolMeshIO::readMesh(temp, mdl_name);
         if(!res)
             vlogerror("Unable to load mesh from: %s", mdl_name.cptr());
     }
 
 
     vloginfo("Loaded mesh to temp");
-	g_lpTissue = new CuttableMesh(*temp);
-	g_lpTissue->setFlagSplitMeshAfterCut(true);
-	g_lpTissue->setFlagDrawNodes(true);
-	g_lpTissue->setFlagDrawWireFrame(false);
-    g_lpTissue->setFlagDrawSweepSurf(ini.readBool("visible", "sweepsurf"));
-	g_lpTissue->setColor(Color::skin());
-    g_lpTissue->setVerbose(g_parser.value_to_int("verbose") != 0);
-	g_lpTissue->syncRender();
+    g_tissueLoadPhase = tlpBuilding;
+	CuttableMesh* pmesh = new CuttableMesh(*temp);
+	configureTissue(pmesh);
 	SAFE_DELETE(temp);
 
-    TheEngine::Instance().add(g_lpTissue);
+	//print stats
+	VolMeshStats::printAllStats(pmesh);
+	return pmesh;
+}
+
+void configureTissue(CuttableMesh* pmesh) {
+	pmesh->setFlagSplitMeshAfterCut(true);
+    pmesh->setVerbose(g_parser.value_to_int("verbose") != 0);
+    pmesh->setRefineEdgeLength(g_parser.value_to_double("refine"));
+    pmesh->setSliverQuality(g_parser.value_to_double("sliver"));
+    //a flat volume of zero turns the filter off
+    double flatVolume = g_parser.value_to_double("flatvolume");
+    pmesh->setFlagFilterOutFlatCells(flatVolume > 0.0);
+    if(flatVolume > 0.0)
+    	pmesh->setFlatCellVolume(flatVolume);
+    if(g_parser.value("mode") == "virtualnode")
+    	pmesh->setCutMode(CuttableMesh::cmVirtualNode);
+    if(g_parser.value_to_double("snap") > 0.0) {
+    	pmesh->setFlagSnapCutNodes(true);
+    	pmesh->setCutNodeROI(g_parser.value_to_double("snap"));
+    }
+}
+
+void setTissue(CuttableMesh* pmesh) {
+	//remove it from scenegraph
+    TheEngine::Instance().remove(g_lpTissueNode);
+	SAFE_DELETE(g_lpTissueNode);
+	g_journal.close();
+	SAFE_DELETE(g_lpTissue);
+	g_tissueSet.clear();
+
+    IniFile ini(g_strIniFilePath, IniFile::fmRead);
+	g_lpTissue = pmesh;
+
+	//a journal follows a single mesh, every reset starts a new one
+	if(g_parser.isValid("journal") && !g_parser.value_to_int("disjoint")) {
+		AnsiStr strJournal = AnsiStr(g_parser.value("journal").c_str());
+		if(g_journal.create(strJournal, g_lpTissue, (U32)g_parser.value_to_int("checkpoint")))
+			g_lpTissue->setJournal(&g_journal);
+	}
+
+	g_lpTissueNode = new CuttableMeshNode(g_lpTissue);
+	g_lpTissueNode->setFlagDrawNodes(true);
+	g_lpTissueNode->setFlagDrawWireFrame(false);
+    g_lpTissueNode->setFlagDrawSweepSurf(ini.readBool("visible", "sweepsurf"));
+	g_lpTissueNode->setColor(Color::skin());
+	g_lpTissueNode->syncRender();
+
+    TheEngine::Instance().add(g_lpTissueNode);
     if(g_parser.value_to_int("ringscalpel") == 1)
 		g_lpRing->setTissue(g_lpTissue);
 	else
 		g_lpScalpel->setTissue(g_lpTissue);
 
-	//print stats
-	VolMeshStats::printAllStats(g_lpTissue);
-
     vloginfo("mesh load completed");
 }
 
@@ -556,29 +715,50 @@ void cutFinished() {
     if(!g_parser.value_to_int("disjoint"))
 		return;
 
+	//every piece the last cut went through may have fallen apart
+	vector<CuttableMesh*> vCutMeshes;
+	if(g_tissueSet.count() > 0) {
+		const vector<U32>& vLastCut = g_tissueSet.lastCutMeshes();
+		for(U32 i=0; i < vLastCut.size(); i++)
+			vCutMeshes.push_back(g_tissueSet.meshAt(vLastCut[i]));
+	}
+	else
+		vCutMeshes.push_back(g_lpTissue);
+
+	for(U32 i=0; i < vCutMeshes.size(); i++) {
+		vector<CuttableMesh*> vMeshes;
+		vCutMeshes[i]->convertDisjointPartsToMeshes(vMeshes);
+
+		if(vMeshes.size() == 0)
+			continue;
+		g_tissueSet.remove(vCutMeshes[i]);
+
+		U32 ctMaxCells = 0;
+		U32 idxMaxCell = 0;
+		vector<CuttableMeshNode*> vNodes;
+		for(U32 j=0; j < vMeshes.size(); j++) {
+			vMeshes[j]->computeAABB();
+			g_tissueSet.add(vMeshes[j]);
+
+			CuttableMeshNode* node = new CuttableMeshNode(vMeshes[j]);
+			node->setElemToShow(0);
+			TheEngine::Instance().add(node);
+			vNodes.push_back(node);
+
+			if(vMeshes[j]->countCells() > ctMaxCells) {
+				ctMaxCells = vMeshes[j]->countCells();
+				idxMaxCell = j;
+			}
+		}
 
-	vector<CuttableMesh*> vMeshes;
-	g_lpTissue->convertDisjointPartsToMeshes(vMeshes);
-
-	if(vMeshes.size() == 0)
-		return;
-
-	U32 ctMaxCells = 0;
-	U32 idxMaxCell = 0;
-	for(U32 i=0; i < vMeshes.size(); i++) {
-		vMeshes[i]->computeAABB();
-		vMeshes[i]->setElemToShow(0);
-        TheEngine::Instance().add(vMeshes[i]);
-
-		if(vMeshes[i]->countCells() > ctMaxCells) {
-			ctMaxCells = vMeshes[i]->countCells();
-			idxMaxCell = i;
+		//the largest piece of the tissue stays the tissue
+		if(vCutMeshes[i] == g_lpTissue) {
+			g_lpTissue = vMeshes[idxMaxCell];
+			g_lpTissueNode = vNodes[idxMaxCell];
+			g_lpTissueNode->setElemToShow();
 		}
 	}
 
-	g_lpTissue = vMeshes[idxMaxCell];
-
-	g_lpTissue->setElemToShow();
 	if(g_lpAvatar)
 		g_lpAvatar->setTissue(g_lpTissue);
 }
@@ -591,14 +771,30 @@ int main(int argc, char* argv[]) {
 	//parser
     g_parser.addSwitch("--disjoint", "-d", "converts splitted part to disjoint meshes", "0");
     g_parser.addSwitch("--ringscalpel", "-r", "If the switch presents then the ring scalpel will be used");
+    g_parser.addSwitch("--progressive", "-p", "If the switch presents then the scalpel cuts progressively while moving inside the tissue", "", true);
+    g_parser.addSwitch("--speculative", "-s", "If the switch presents then the cut context is computed in the background while the tool moves", "", true);
+    g_parser.addSwitch("--mode", "-m", "[subdivide, virtualnode] subdivides the cut elements or duplicates them using virtual nodes", "subdivide");
+    g_parser.addSwitch("--snap", "-n", "[0 to 0.45] snaps mesh nodes within this fraction of a cut edge onto the cut surface. 0 disables snapping", "0");
+    g_parser.addSwitch("--refine", "-f", "[length] refines the cells along the tool path to this edge length before every cut. 0 disables refinement", "0");
+    g_parser.addSwitch("--coarsen", "-k", "[length] collapses the edges shorter than this away from the recent cuts between frames. 0 disables coarsening", "0");
+    g_parser.addSwitch("--sliver", "-q", "[0 to 1] repairs or removes the cells below this quality after every cut. 0 disables the cleanup", "0");
+    g_parser.addSwitch("--weld", "-w", "[distance] merges the nodes of an input file within this distance before its topology is built. 0 disables welding", "0");
+    g_parser.addSwitch("--orient", "-u", "If the switch presents then the cells of an input file with a negative determinant are reoriented before its topology is built", "", true);
+    g_parser.addSwitch("--flatvolume", "-a", "[volume] cells below this volume are flat and filtered out, 0 turns the filter off", "0.0001");
     g_parser.addSwitch("--verbose", "-v", "prints detailed description.");
-    g_parser.addSwitch("--input", "-i", "[filepath] set input file in vega format", "internal");
+    g_parser.addSwitch("--journal", "-j", "[filepath] records the operations on the tissue in a cut journal with checkpoints next to it");
+    g_parser.addSwitch("--checkpoint", "-e", "[records] number of journal records between two checkpoints", "32");
+    g_parser.addSwitch("--replay", "-l", "[filepath] rebuilds the tissue of a cut journal and uses it instead of the model of the ini file");
+    g_parser.addSwitch("--input", "-i", "[filepath] set input file in vega, vmb, tetgen (.node/.ele), gmsh (.msh) or vtk format", "internal");
     //g_parser.addSwitch("--example", "-e", "[one, two, cube, eggshell] set an internal example", "two");
     //g_parser.addSwitch("--gizmo", "-g", "loads a file to set gizmo location and orientation", "gizmo.ini");
 
-	if(g_parser.parse(argc, argv) < 0)
+	if(g_parser.parse(argc, argv) < 0 || g_parser.value("help") == "true")
 		exit(0);
 
+	if(g_parser.isValid("journal") && g_parser.value_to_int("disjoint"))
+		vlogwarn("The cut journal records a single mesh. It is not used with disjoint meshes.");
+
 	//file path
     g_strIniFilePath = AnsiStr(g_parser.value("input").c_str());
     if(FileExists(g_strIniFilePath))
@@ -657,13 +853,18 @@ int main(int argc, char* argv[]) {
 // 	VolMeshIO::convertMatlabTextToVega(strNodesFP, strFacesFP, strCellsFP);
 
 
+	//the tissue is built on the workers while the gl resources load
+	resetMeshAsync();
+
 	//Load Shaders
 	TheShaderManager::Instance().addFromFolder(strShaderRoot.cptr());
 
-	//Load Textures
-	TheTexManager::Instance().add(strTextureRoot + "wood.png");
-	TheTexManager::Instance().add(strTextureRoot + "spin.png");
-	TheTexManager::Instance().add(strTextureRoot + "icefloor.png");
+	//Load Textures, the images are decoded in parallel
+	vector<AnsiStr> vTextures;
+	vTextures.push_back(strTextureRoot + "wood.png");
+	vTextures.push_back(strTextureRoot + "spin.png");
+	vTextures.push_back(strTextureRoot + "icefloor.png");
+	TheTexManager::Instance().add(vTextures);
 //	TheTexManager::Instance().add(strTextureRoot + "rendermask.png");
 //	TheTexManager::Instance().add(strTextureRoot + "maskalpha.png");
 //	TheTexManager::Instance().add(strTextureRoot + "maskalphafilled.png");
@@ -681,9 +882,14 @@ int main(int argc, char* argv[]) {
 	//Create Scalpel
 	g_lpScalpel = new AvatarScalpel();
 	g_lpScalpel->setVisible(false);
+	g_lpScalpel->setFlagProgressiveCut(g_parser.value("progressive") == "true");
+	g_lpScalpel->setFlagSpeculativeCut(g_parser.value("speculative") == "true");
+	g_lpScalpel->setTissueSet(&g_tissueSet);
 
 	g_lpRing = new AvatarRing(TheTexManager::Instance().get("spin"));
 	g_lpRing->setVisible(false);
+	g_lpRing->setFlagSpeculativeCut(g_parser.value("speculative") == "true");
+	g_lpRing->setTissueSet(&g_tissueSet);
     TheEngine::Instance().add(g_lpScalpel);
     TheEngine::Instance().add(g_lpRing);
 
@@ -704,11 +910,9 @@ int main(int argc, char* argv[]) {
     //setup engine
     TheEngine::Instance().readConfig(g_strIniFilePath);
     TheEngine::Instance().headers()->addHeaderLine("cell", "info");
+    TheEngine::Instance().headers()->addHeaderLine("tissue", "loading the tissue");
     TheEngine::Instance().print();
 
-	//reset cuttable mesh
-    resetMesh();
-
 
     //mainloop
     while (!glfwWindowShouldClose(g_lpWindow))
@@ -719,6 +923,9 @@ int main(int argc, char* argv[]) {
         glfwGetFramebufferSize(g_lpWindow, &width, &height);
         def_resize(width, height);
 
+        //swap in the tissue once it is loaded
+        updateTissueLoader();
+
         //draw frame
         draw();
 
@@ -3,6 +3,9 @@
 #include <assert.h>
 #include <base/directory.h>
 #include <base/logger.h>
+#include <base/mappedfile.h>
+#include <base/textparse.h>
+#include <base/profiler.h>
 #include <base/base.h>
 
 #include <stddef.h>
@@ -12,6 +15,8 @@
 #include <map>
 #include <string>
 #include <utility>
+#include <tbb/parallel_for.h>
+#include <tbb/blocked_range.h>
 
 using namespace ps;
 using namespace ps::opengl;
@@ -866,263 +871,415 @@ void Mesh::fitToBBox(const AABB& box) {
         this->getNode(i)->fitToBBox(box);
 }
 
-bool Mesh::loadObj(const char* chrFileName)
-{
-	std::vector<AnsiStr> content;
-    if(!ReadTextFile(chrFileName, content))
-		return false;
+//obj files are parsed in chunks of about this many bytes
+#define OBJ_PARSE_CHUNK_SIZE (256 * 1024)
+
+//helpers of the obj reader
+namespace {
+
+enum ObjLineType {oltOther, oltVertex, oltNormal, oltTexCoord, oltFace, oltObject, oltMaterialLib, oltUseMaterial};
+
+//lines which are applied in file order after all chunks are counted
+struct OBJDIRECTIVE {
+	ObjLineType type;
+	const char* first;
+	const char* last;
+	U32 idxFace;
+};
+
+/*!
+ * a part of the file which starts and ends at line breaks. The counts of the attribute and face
+ * lines give the offsets of the chunk in the output arrays, so all chunks are parsed in parallel.
+ */
+struct OBJCHUNK {
+	const char* first;
+	const char* last;
+	U32 arrCount[oltFace + 1];
+	U32 arrUnit[oltFace + 1];
+	U32 arrOffset[oltFace + 1];
+	U32 ctIrregularFaces;
+	U32 ctSplitFaces;
+	vector<OBJDIRECTIVE> vDirectives;
+
+	OBJCHUNK(const char* p, const char* q): first(p), last(q) {
+		reset();
+	}
 
-	//Process content line by line
-	AnsiStr strLine;
-	std::vector<AnsiStr> words;
-	std::vector<bool> arrProcessed;
-	arrProcessed.resize(content.size());
-	std::fill(arrProcessed.begin(), arrProcessed.end(), false);
-
-	//Memory for mesh object
-	vector<float> arrVertices;
-	vector<float> arrNormals;
-	vector<float> arrTexCoords;
-	vector<U32> arrIndices;
-	U32 iFace = 0;
-	U32 ctFaces = 0;
-	U8 faceUnit = 0;
-	U32 ctMeshNodes = 0;
-	U32 ctMaterialNodes = 0;
-
-	U8 arrAttribUnit[gbtCount];
-	U32 arrAttribCount[gbtCount];
-	U32 idxCurrent[gbtCount];
-	for(int i=0; i<gbtCount; i++) {
-		arrAttribUnit[i] = 0;
-		arrAttribCount[i] = 0;
-		idxCurrent[i] = 0;
+	void reset() {
+		for(int i=0; i <= oltFace; i++)
+			arrCount[i] = arrUnit[i] = arrOffset[i] = 0;
+		ctIrregularFaces = ctSplitFaces = 0;
+		vDirectives.resize(0);
+	}
+};
+
+//reads the keyword at the start of a line and moves p after it
+ObjLineType ReadObjKeyword(const char*& p, const char* eol) {
+	const char* q = SkipBlanks(p, eol);
+	const char* r = q;
+	while(r < eol && !IsBlank(*r))
+		r++;
+	p = r;
+
+	size_t len = r - q;
+	if(len == 1) {
+		if(q[0] == 'v')
+			return oltVertex;
+		else if(q[0] == 'f')
+			return oltFace;
+		else if(q[0] == 'o')
+			return oltObject;
 	}
+	else if(len == 2 && q[0] == 'v') {
+		if(q[1] == 'n')
+			return oltNormal;
+		else if(q[1] == 't')
+			return oltTexCoord;
+	}
+	else if(len == 6 && strncmp(q, "mtllib", 6) == 0)
+		return oltMaterialLib;
+	else if(len == 6 && strncmp(q, "usemtl", 6) == 0)
+		return oltUseMaterial;
 
-	//Pre-process once and reserve memory
-	for(U32 i=0; i<content.size(); i++)
-	{
-		strLine = content[i];
+	return oltOther;
+}
 
-		if(strLine.firstChar() == '#')
-		{
-			arrProcessed[i] = true;
-			continue;
-		}
-		if(strLine.decompose(' ', words) == 0)
-		{
-			arrProcessed[i] = true;
-			continue;
-		}
+U32 CountObjTokens(const char* p, const char* eol) {
+	U32 ct = 0;
+	p = SkipBlanks(p, eol);
+	while(p < eol) {
+		while(p < eol && !IsBlank(*p))
+			p++;
+		p = SkipBlanks(p, eol);
+		ct++;
+	}
+	return ct;
+}
 
-		int ctWords = (int)words.size();
+//the name after o, mtllib or usemtl. Names with spaces are not supported
+bool ReadObjName(const OBJDIRECTIVE& d, string& strName) {
+	if(CountObjTokens(d.first, d.last) != 1)
+		return false;
 
-		//Position
-		if(words[0] == "v")
-		{
-			if(arrAttribCount[gbtPosition] == 0)
-				arrAttribUnit[gbtPosition] = ctWords-1;
-			arrAttribCount[gbtPosition] ++;
-		}
-		//Normal
-		else if(words[0] == "vn")
-		{
-			if(arrAttribCount[gbtNormal] == 0)
-				arrAttribUnit[gbtNormal] = ctWords-1;
-			arrAttribCount[gbtNormal] ++;
+	const char* p = SkipBlanks(d.first, d.last);
+	const char* q = p;
+	while(q < d.last && !IsBlank(*q))
+		q++;
+	strName.assign(p, q);
+	return true;
+}
+
+/*!
+ * vertex index of a face corner written as v, v/t, v//n or v/t/n. Indices start at 1, negative
+ * ones count back from the last vertex read before the face.
+ */
+bool ParseObjCorner(const char*& p, const char* eol, U32 ctVerticesBefore, U32& out) {
+	const char* q = SkipBlanks(p, eol);
+	bool neg = (q < eol && *q == '-');
+	if(neg)
+		q++;
+
+	U32 idx = 0;
+	if(!ParseU32(q, eol, idx))
+		return false;
+	out = neg ? ctVerticesBefore - idx : idx - 1;
+
+	//texture and normal indices are not used
+	while(q < eol && !IsBlank(*q))
+		q++;
+	p = q;
+	return true;
+}
+
+/*!
+ * number of faces stored for a face line. Faces with more vertices than the face unit are split
+ * into a fan around their first vertex, faces with less are padded with their last vertex.
+ */
+U32 CountObjFanFaces(U32 ctCorners, U32 unitFace) {
+	if(ctCorners <= unitFace)
+		return 1;
+	return (ctCorners - 2 + unitFace - 3) / (unitFace - 2);
+}
+
+/*!
+ * first pass: counts the lines of every kind in a chunk and keeps the named lines. Faces are
+ * counted with the given face unit or with the unit of the first face in the chunk when it is 0.
+ */
+void CountObjChunk(OBJCHUNK& chunk, U32 unitFace = 0) {
+	chunk.reset();
+	const char* p = chunk.first;
+	while(p < chunk.last) {
+		const char* eol = LineEnd(p, chunk.last);
+		const char* q = p;
+		ObjLineType type = ReadObjKeyword(q, eol);
+		switch(type) {
+		case oltVertex:
+		case oltNormal:
+		case oltTexCoord: {
+			if(chunk.arrCount[type] == 0)
+				chunk.arrUnit[type] = CountObjTokens(q, eol);
+			chunk.arrCount[type]++;
 		}
-		//TexCoords
-		else if(words[0] == "vt")
-		{
-			if(arrAttribCount[gbtTexCoord] == 0)
-				arrAttribUnit[gbtTexCoord] = ctWords-1;
-			arrAttribCount[gbtTexCoord] ++;
+		break;
+
+		case oltFace: {
+			U32 ctCorners = CountObjTokens(q, eol);
+			if(ctCorners >= 3) {
+				if(chunk.arrUnit[oltFace] == 0)
+					chunk.arrUnit[oltFace] = (unitFace > 0) ? unitFace : ctCorners;
+				chunk.arrCount[oltFace] += CountObjFanFaces(ctCorners, chunk.arrUnit[oltFace]);
+			}
 		}
-		else if(words[0] == "f") {
-			if(ctFaces == 0)
-				faceUnit = ctWords - 1;
-			else if(faceUnit != ctWords -1)
-                vlogerror("Irregular mesh file! Face %d has %d vertices!", ctFaces, ctWords-1);
+		break;
 
-			ctFaces++;
+		case oltObject:
+		case oltMaterialLib:
+		case oltUseMaterial: {
+			OBJDIRECTIVE d = {type, q, eol, chunk.arrCount[oltFace]};
+			chunk.vDirectives.push_back(d);
 		}
-		else if((words[0] == "o")&&(ctWords == 2))
-		{
-			//Create a new mesh node
-			MeshNode* aNode = new MeshNode(string(words[1].cptr()));
-			addNode(aNode);
-			ctMeshNodes++;
-		}
-		else if((words[0] == "mtllib")&&(ctWords == 2))
-		{
-			AnsiStr strFP = ExtractFilePath(AnsiStr(chrFileName)) + words[1];
-
-            //Load Material
-            MeshMaterial* aMtrl = new MeshMaterial(string(words[1].cptr()));
-            aMtrl->load(strFP.cptr());
-            addMeshMaterial(aMtrl);
-            ctMaterialNodes ++;
+		break;
+
+		default:
+			break;
 		}
-	}
 
-	//Normals
-	if(arrAttribCount[gbtPosition] != arrAttribCount[gbtNormal]) {
-        vlogerror("Number of normals not match vertices. V# %d, N# %d", arrAttribCount[gbtPosition], arrAttribCount[gbtNormal]);
-		arrAttribCount[gbtNormal] = 0;
+		p = (eol < chunk.last) ? eol + 1 : chunk.last;
 	}
+}
 
-	//Allocate memory
-	arrVertices.resize(arrAttribCount[gbtPosition] * arrAttribUnit[gbtPosition]);
-	arrNormals.resize(arrAttribCount[gbtNormal] * arrAttribUnit[gbtNormal]);
-	arrTexCoords.resize(arrAttribCount[gbtTexCoord] * arrAttribUnit[gbtTexCoord]);
-
-	//We won't triangulate quad meshes. Might use quad mesh for subdivision or Micropolygon rendering!
-	arrIndices.resize(ctFaces * faceUnit);
-
-	//Now we can process faces and assemble them from the list of vertices normals
-	U32 idxMeshNode = 0;
-	MeshNode* lpCurrentMeshNode = NULL;
-	if(ctMeshNodes > 0)
-		lpCurrentMeshNode = getNode(0);
-	else {
-		lpCurrentMeshNode = new MeshNode();
-		this->addNode(lpCurrentMeshNode);
-	}
+//second pass: parses the attributes and faces of a chunk straight to their slots in the arrays
+void ParseObjChunk(OBJCHUNK& chunk, const U32* arrUnit, const U32* arrTotal,
+				   vector<float>& vVertices, vector<float>& vNormals, vector<float>& vTexCoords, vector<U32>& vIndices) {
+	U32 arrIndex[oltFace + 1];
+	for(int i=0; i <= oltFace; i++)
+		arrIndex[i] = chunk.arrOffset[i];
+
+	double x;
+	vector<U32> vCorners;
+	const char* p = chunk.first;
+	while(p < chunk.last) {
+		const char* eol = LineEnd(p, chunk.last);
+		const char* q = p;
+		ObjLineType type = ReadObjKeyword(q, eol);
+		if(type == oltVertex || type == oltNormal || type == oltTexCoord) {
+			if(arrTotal[type] > 0) {
+				vector<float>& vOut = (type == oltVertex) ? vVertices : ((type == oltNormal) ? vNormals : vTexCoords);
+				float* lpOut = vOut.data() + (size_t)arrIndex[type] * arrUnit[type];
+				for(U32 i=0; i < arrUnit[type] && ParseDouble(q, eol, x); i++)
+					lpOut[i] = static_cast<float>(x);
+			}
+			arrIndex[type]++;
+		}
+		else if(type == oltFace && CountObjTokens(q, eol) >= 3) {
+
+			//we won't triangulate quad meshes. Irregular faces are split or padded to the face unit
+			U32 unitFace = arrUnit[oltFace];
+			U32 ctCorners = CountObjTokens(q, eol);
+			U32 idxVertex = (U32)-1;
+			vCorners.resize(0);
+			while(ParseObjCorner(q, eol, arrIndex[oltVertex], idxVertex))
+				vCorners.push_back(idxVertex);
+			vCorners.resize(ctCorners, idxVertex);
+
+			U32 ctFaces = CountObjFanFaces(ctCorners, unitFace);
+			for(U32 f=0; f < ctFaces; f++) {
+				U32* lpFace = vIndices.data() + (size_t)(arrIndex[oltFace] + f) * unitFace;
+				lpFace[0] = vCorners[0];
+				for(U32 i=1; i < unitFace; i++)
+					lpFace[i] = vCorners[std::min(f * (unitFace - 2) + i, ctCorners - 1)];
+			}
 
-	//Process all obj file content
-	for(U32 i=0; i<content.size(); i++)
-	{
-		strLine = content[i];
+			if(ctCorners < unitFace)
+				chunk.ctIrregularFaces++;
+			else if(ctCorners > unitFace)
+				chunk.ctSplitFaces++;
+			arrIndex[oltFace] += ctFaces;
+		}
 
-		if(arrProcessed[i])
-			continue;
-		if(strLine.firstChar() == '#')
-			continue;
-		if(strLine.decompose(' ', words) == 0)
-			continue;
+		p = (eol < chunk.last) ? eol + 1 : chunk.last;
+	}
+}
 
+}
 
-		int ctWords = (int)words.size();
-		if((words[0] == "v") && (arrAttribCount[gbtPosition] > 0)) {
-			if(arrAttribUnit[gbtPosition] == 3) {
-				vec3f v;
-				v.x = static_cast<float>(atof(words[1].ptr()));
-				v.y = static_cast<float>(atof(words[2].ptr()));
-				v.z = static_cast<float>(atof(words[3].ptr()));
+bool Mesh::loadObj(const char* chrFileName)
+{
+	ProfileAutoArg(chrFileName);
 
-				v.store(&arrVertices[idxCurrent[gbtPosition] * arrAttribUnit[gbtPosition]]);
-			}
-			else if(arrAttribUnit[gbtPosition] == 4) {
-				vec4f v;
-				v.x = static_cast<float>(atof(words[1].ptr()));
-				v.y = static_cast<float>(atof(words[2].ptr()));
-				v.z = static_cast<float>(atof(words[3].ptr()));
-				v.w = static_cast<float>(atof(words[4].ptr()));
-
-				v.store(&arrVertices[idxCurrent[gbtPosition] * arrAttribUnit[gbtPosition]]);
-			}
+	MappedFile mf;
+	if(!mf.open(AnsiStr(chrFileName)))
+		return false;
 
-			idxCurrent[gbtPosition] ++;
-		}
-		else if((words[0] == "vn") && (arrAttribCount[gbtNormal] > 0)) {
-
-			vec3f n;
-			n.x = static_cast<float>(atof(words[1].ptr()));
-			n.y = static_cast<float>(atof(words[2].ptr()));
-			n.z = static_cast<float>(atof(words[3].ptr()));
-			n.store(&arrNormals[idxCurrent[gbtNormal] * 3]);
-			idxCurrent[gbtNormal] ++;
-		}
-		else if((words[0] == "vt" && arrAttribCount[gbtTexCoord] > 0)) {
-			U32 idxTex = idxCurrent[gbtTexCoord] * arrAttribUnit[gbtTexCoord];
-			for(int j=0; j<arrAttribUnit[gbtTexCoord]; j++)
-				arrTexCoords[idxTex + j] = static_cast<float>(atof(words[j+1].ptr()));
-			idxCurrent[gbtTexCoord] ++;
+	//split the file at line breaks
+	vector<OBJCHUNK> vChunks;
+	const char* first = mf.data();
+	const char* last = first + mf.size();
+	for(const char* p = first; p < last; ) {
+		const char* q = last;
+		if(last - p > OBJ_PARSE_CHUNK_SIZE) {
+			q = LineEnd(p + OBJ_PARSE_CHUNK_SIZE, last);
+			if(q < last)
+				q++;
 		}
-		else if((words[0] == "o")&&(ctWords == 2)) {
+		vChunks.push_back(OBJCHUNK(p, q));
+		p = q;
+	}
 
-			if(lpCurrentMeshNode != NULL)
-				lpCurrentMeshNode->setFaceIndices(arrIndices, faceUnit);
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, vChunks.size(), 1),
+		[&vChunks](const tbb::blocked_range<size_t>& r) {
+		for(size_t c = r.begin(); c != r.end(); c++)
+			CountObjChunk(vChunks[c]);
+	});
+
+	//the face unit comes from the first face of the file, chunks starting with another one are recounted
+	U32 unitFace = 0;
+	for(U32 c=0; c < vChunks.size() && unitFace == 0; c++)
+		unitFace = vChunks[c].arrUnit[oltFace];
+	for(U32 c=0; c < vChunks.size(); c++) {
+		if(vChunks[c].arrCount[oltFace] > 0 && vChunks[c].arrUnit[oltFace] != unitFace)
+			CountObjChunk(vChunks[c], unitFace);
+	}
 
-			lpCurrentMeshNode = getNode(string(words[1].cptr()));
-			idxMeshNode++;
+	//offsets of the chunks. The units come from the first line of each kind
+	U32 arrUnit[oltFace + 1];
+	U32 arrTotal[oltFace + 1];
+	for(int i=0; i <= oltFace; i++)
+		arrUnit[i] = arrTotal[i] = 0;
+
+	for(U32 c=0; c < vChunks.size(); c++) {
+		for(int i = oltVertex; i <= oltFace; i++) {
+			vChunks[c].arrOffset[i] = arrTotal[i];
+			if(arrTotal[i] == 0 && vChunks[c].arrCount[i] > 0)
+				arrUnit[i] = vChunks[c].arrUnit[i];
+			arrTotal[i] += vChunks[c].arrCount[i];
 		}
-		else if((words[0] == "usemtl")&&(lpCurrentMeshNode)&&(ctWords == 2))
-		{
-			lpCurrentMeshNode->setMaterial(getMaterial(string(words[1].cptr())));
-		}
-        else if((words[0] == "f")&&(ctWords > 3)&&(ctFaces > 0))
-		{
-			int idxVertex[4];
-			int idxTexCoords[4];
-			int idxNormal[4];
-
-			//Process line of face
-			for(int j=0; j<ctWords-1; j++)
-			{
-				std::vector<AnsiStr> segments;
-				strLine = words[j + 1];
-				strLine.removeStartEndSpaces();
-				strLine.replaceChars('/', ' ');
-				if(strLine.decompose(' ', segments) > 1)
-				{
-					int ctSegs = (U32)segments.size();
-					if(ctSegs == 3)
-					{
-						idxVertex[j] 	= atoi(segments[0].ptr()) - 1;
-						idxTexCoords[j] = atoi(segments[1].ptr()) - 1;
-						idxNormal[j] 	= atoi(segments[2].ptr()) - 1;
-					}
-					else
-					{
-						idxVertex[j] 	= atoi(segments[0].ptr()) - 1;
-						idxNormal[j] 	= atoi(segments[1].ptr()) - 1;
-					}
-				}
-				else
-				{
-					idxVertex[j] = atoi(words[j + 1].ptr()) - 1;
-					idxNormal[j] = idxVertex[j];
-				}
-
-
-				//Add to index buffer
-				arrIndices[ iFace * faceUnit + j] = idxVertex[j];
-			}
+	}
 
-			//Increment index of face
-			iFace ++;
-		}
-		else if((words[0] == "s")&&(ctWords == 2))
-		{
-			if(words[1] == "off")
-			{
+	for(int i = oltVertex; i <= oltTexCoord; i++) {
+		if(arrUnit[i] == 0)
+			arrTotal[i] = 0;
+	}
+	arrUnit[oltNormal] = 3;
 
+	//Normals
+	if(arrTotal[oltVertex] != arrTotal[oltNormal]) {
+		if(arrTotal[oltNormal] > 0)
+			vlogerror("Number of normals not match vertices. V# %d, N# %d", arrTotal[oltVertex], arrTotal[oltNormal]);
+		arrTotal[oltNormal] = 0;
+	}
+
+	//mesh nodes and materials in file order. Faces before the first object belong to it
+	vector<MeshNode*> vNodes;
+	vector<U32> vNodeFirstFace;
+	string strName;
+	for(U32 c=0; c < vChunks.size(); c++) {
+		for(U32 i=0; i < vChunks[c].vDirectives.size(); i++) {
+			const OBJDIRECTIVE& d = vChunks[c].vDirectives[i];
+			if(d.type == oltUseMaterial || !ReadObjName(d, strName))
+				continue;
+
+			if(d.type == oltObject) {
+				MeshNode* aNode = new MeshNode(strName);
+				addNode(aNode);
+				vNodes.push_back(aNode);
+				vNodeFirstFace.push_back(vNodes.size() == 1 ? 0 : vChunks[c].arrOffset[oltFace] + d.idxFace);
+			}
+			else {
+				AnsiStr strFP = ExtractFilePath(AnsiStr(chrFileName)) + AnsiStr(strName.c_str());
+
+				//Load Material
+				MeshMaterial* aMtrl = new MeshMaterial(strName);
+				aMtrl->load(strFP.cptr());
+				addMeshMaterial(aMtrl);
 			}
 		}
 	}
 
-	//Add Last Node indices
-	lpCurrentMeshNode->setFaceIndices(arrIndices, faceUnit);
+	if(vNodes.size() == 0) {
+		MeshNode* aNode = new MeshNode();
+		addNode(aNode);
+		vNodes.push_back(aNode);
+		vNodeFirstFace.push_back(0);
+	}
+
+	//materials are applied once all libraries are loaded
+	int idxNode = 0;
+	for(U32 c=0; c < vChunks.size(); c++) {
+		for(U32 i=0; i < vChunks[c].vDirectives.size(); i++) {
+			const OBJDIRECTIVE& d = vChunks[c].vDirectives[i];
+			if(d.type == oltMaterialLib || !ReadObjName(d, strName))
+				continue;
+
+			if(d.type == oltObject)
+				idxNode++;
+			else
+				vNodes[std::max(idxNode - 1, 0)]->setMaterial(getMaterial(strName));
+		}
+	}
 
-	for(U32 i=0; i < countNodes(); i++) {
+	//Allocate memory and parse all chunks
+	vector<float> arrVertices((size_t)arrTotal[oltVertex] * arrUnit[oltVertex], 0.0f);
+	vector<float> arrNormals((size_t)arrTotal[oltNormal] * arrUnit[oltNormal], 0.0f);
+	vector<float> arrTexCoords((size_t)arrTotal[oltTexCoord] * arrUnit[oltTexCoord], 0.0f);
+	vector<U32> arrIndices((size_t)arrTotal[oltFace] * arrUnit[oltFace]);
+
+	tbb::parallel_for(tbb::blocked_range<size_t>(0, vChunks.size(), 1),
+		[&](const tbb::blocked_range<size_t>& r) {
+		for(size_t c = r.begin(); c != r.end(); c++)
+			ParseObjChunk(vChunks[c], arrUnit, arrTotal, arrVertices, arrNormals, arrTexCoords, arrIndices);
+	});
+
+	U32 ctIrregularFaces = 0;
+	U32 ctSplitFaces = 0;
+	for(U32 c=0; c < vChunks.size(); c++) {
+		ctIrregularFaces += vChunks[c].ctIrregularFaces;
+		ctSplitFaces += vChunks[c].ctSplitFaces;
+	}
+	if(ctIrregularFaces > 0)
+		vlogerror("Irregular mesh file! %u faces have less than %u vertices!", ctIrregularFaces, arrUnit[oltFace]);
+	if(ctSplitFaces > 0)
+		vlogwarn("Split %u faces with more than %u vertices into fans", ctSplitFaces, arrUnit[oltFace]);
+
+	//all nodes share the vertex attributes, the last one takes over the arrays
+	for(U32 i=0; i < vNodes.size(); i++) {
+		MeshNode* lpNode = vNodes[i];
+		bool isLast = (i + 1 == vNodes.size());
+
+		if(arrTotal[oltFace] > 0) {
+			size_t idxFirst = (size_t)vNodeFirstFace[i] * arrUnit[oltFace];
+			size_t idxLast = isLast ? arrIndices.size() : (size_t)vNodeFirstFace[i + 1] * arrUnit[oltFace];
+			lpNode->m_szUnitFace = arrUnit[oltFace];
+			if(isLast && idxFirst == 0)
+				lpNode->m_arrIndices.swap(arrIndices);
+			else
+				lpNode->m_arrIndices.assign(arrIndices.begin() + idxFirst, arrIndices.begin() + idxLast);
+		}
 
-		lpCurrentMeshNode = getNode(i);
-		if(arrAttribCount[gbtPosition] > 0)
-			lpCurrentMeshNode->setVertexAttrib(arrVertices, gbtPosition, arrAttribUnit[gbtPosition]);
+		if(arrTotal[oltVertex] > 0) {
+			lpNode->m_szUnitVertex = arrUnit[oltVertex];
+			if(isLast)
+				lpNode->m_arrVertices.swap(arrVertices);
+			else
+				lpNode->m_arrVertices.assign(arrVertices.begin(), arrVertices.end());
+		}
 
-		if(arrAttribCount[gbtNormal] > 0)
-			lpCurrentMeshNode->setVertexAttrib(arrNormals, gbtNormal, arrAttribUnit[gbtNormal]);
+		if(arrTotal[oltNormal] > 0) {
+			if(isLast)
+				lpNode->m_arrNormals.swap(arrNormals);
+			else
+				lpNode->m_arrNormals.assign(arrNormals.begin(), arrNormals.end());
+		}
 
-		if(arrAttribCount[gbtTexCoord] > 0)
-			lpCurrentMeshNode->setVertexAttrib(arrTexCoords, gbtTexCoord, arrAttribUnit[gbtTexCoord]);
+		if(arrTotal[oltTexCoord] > 0) {
+			lpNode->m_szUnitTexCoord = arrUnit[oltTexCoord];
+			if(isLast)
+				lpNode->m_arrTexCoords.swap(arrTexCoords);
+			else
+				lpNode->m_arrTexCoords.assign(arrTexCoords.begin(), arrTexCoords.end());
+		}
 	}
 
-
-	//Cleanup
-	arrProcessed.resize(0);
-	words.resize(0);
-	content.resize(0);
 	return (m_nodes.size() > 0);
 }
 
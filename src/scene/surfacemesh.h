@@ -161,6 +161,8 @@ public:
     void fitToBBox(const AABB& box);
 
 protected:
+	friend class Mesh;
+
 	std::vector<float> m_arrVertices;
 	std::vector<float> m_arrNormals;
 	std::vector<float> m_arrColors;
@@ -215,7 +217,10 @@ public:
     void fitToBBox(const AABB& box);
 private:
 
-    //Loads Obj Mesh File
+    /*!
+     * Loads Obj Mesh File. The file is memory mapped and parsed in parallel chunks straight into
+     * the arrays of the mesh nodes. Every object gets its own faces, all share the vertices.
+     */
 	bool loadObj(const char* chrFileName);
 
 private: